@@ -39,6 +39,10 @@
 #  endif
 #endif
 
+#ifdef HAVE_DIRENT_H
+#  include <dirent.h>
+#endif
+
 #ifndef HAVE_MKDIR
 #  define HAVE_MKDIR  0
 #endif
@@ -95,6 +99,7 @@ static const struct {
   { "plain", CAdPlugDatabase::CRecord::Plain },
   { "songinfo", CAdPlugDatabase::CRecord::SongInfo },
   { "clockspeed", CAdPlugDatabase::CRecord::ClockSpeed },
+  { "songlength", CAdPlugDatabase::CRecord::SongLength },
   {0}
 };
 
@@ -102,13 +107,13 @@ static struct {
   char				*db_file;
   CAdPlugDatabase::CRecord::RecordType	rtype;
   int					message_level;
-  bool					usedefaultdb, usercomment, cmdkeys;
+  bool					usedefaultdb, usercomment, cmdkeys, recurse;
   const char				*homedir;
 } cfg = {
   ADPLUGDB_PATH,
   CAdPlugDatabase::CRecord::Plain,
   MSG_NOTE,
-  false, false, false,
+  false, false, false, false,
   NULL
 };
 
@@ -163,9 +168,13 @@ static void usage()
 #ifdef ADPLUG_DATA_DIR
 	 "  -s               Use system-wide database file (" ADPLUGDB_PATH ")\n"
 #endif
-	 "  -t <type>        Add as different record type (plain, songinfo, clockspeed)\n"
+	 "  -t <type>        Add as different record type (plain, songinfo, clockspeed,\n"
+	 "                   songlength)\n"
 	 "  -c               Prompt for record comment\n"
 	 "  -k               Specify keys instead of files on commandline\n"
+#ifdef HAVE_DIRENT_H
+	 "  -r               Add all files below directories given to add\n"
+#endif
 	 "\n"
 	 "Generic options:\n"
 	 "  -q               Be more quiet\n"
@@ -193,8 +202,74 @@ static const std::string file2type(const char *filename)
   return UNKNOWN_FILETYPE;
 }
 
+static bool file2lengths(const char *filename, CLengthRecord *record)
+/* Measures the length of every subsong of a file */
+{
+  CSilentopl	opl;
+  CPlayer	*p = CAdPlug::factory(filename, &opl);
+  unsigned int	i, subsongs;
+
+  if(!p) return false;
+  subsongs = p->getsubsongs();
+
+  for(i = 0; i < subsongs; i++) {
+    CLengthRecord::Subsong len;
+
+    // Not every player resets all of its state on rewind, so each subsong is
+    // measured in a freshly loaded one.
+    if(i && !(p = CAdPlug::factory(filename, &opl))) return false;
+    len.length = p->songlength(i, len.loopstart, len.loopend);
+    record->set(i, len);
+    delete p;
+  }
+
+  if(!subsongs) delete p;
+  return true;
+}
+
+static bool is_dir(const char *filename)
+{
+#if defined(HAVE_DIRENT_H) && defined(HAVE_SYS_TYPES_H) && defined(HAVE_SYS_STAT_H)
+  struct stat st;
+
+  return !stat(filename, &st) && S_ISDIR(st.st_mode);
+#else
+  return false;
+#endif
+}
+
+static void db_add(const char *filename);
+
+static void db_add_dir(const char *dirname)
+/* Adds all files below a directory to the database */
+{
+#ifdef HAVE_DIRENT_H
+  DIR		*dir = opendir(dirname);
+  struct dirent	*entry;
+
+  if(!dir) {
+    message(MSG_WARN, "can't open directory -- %s", dirname);
+    return;
+  }
+
+  while((entry = readdir(dir)))
+    if(strcmp(entry->d_name, ".") && strcmp(entry->d_name, "..")) {
+      std::string path = std::string(dirname) + "/" + entry->d_name;
+
+      db_add(path.c_str());
+    }
+
+  closedir(dir);
+#endif
+}
+
 static void db_add(const char *filename)
 {
+  if(cfg.recurse && is_dir(filename)) {
+    db_add_dir(filename);
+    return;
+  }
+
   CAdPlugDatabase::CRecord *record = CAdPlugDatabase::CRecord::factory(cfg.rtype);
 
   if(cfg.cmdkeys) {
@@ -215,7 +290,13 @@ static void db_add(const char *filename)
   else
     record->comment = filename;
   if(record->filetype == UNKNOWN_FILETYPE) { delete record; return; }
-  if(!record->user_read(std::cin, std::cout)) {
+  if(record->type == CAdPlugDatabase::CRecord::SongLength) {
+    message(MSG_NOTE, "measuring song length -- %s", filename);
+    if(!file2lengths(filename, (CLengthRecord *)record)) {
+      message(MSG_ERROR, "can't measure song length -- %s", filename);
+      exit(EXIT_FAILURE);
+    }
+  } else if(!record->user_read(std::cin, std::cout)) {
     message(MSG_ERROR, "data entry error");
     exit(EXIT_FAILURE);
   }
@@ -314,7 +395,7 @@ int main(int argc, char *argv[])
   atexit(shutdown);
 
   // Parse options
-  while((opt = getopt(argc, argv, "d:t:qvhVsck")) != -1)
+  while((opt = getopt(argc, argv, "d:t:qvhVsckr")) != -1)
     switch(opt) {
     case 'd': cfg.db_file = optarg; break;		// Set database file
     case 't': // Different record type
@@ -342,6 +423,13 @@ int main(int argc, char *argv[])
       break;
     case 'c': cfg.usercomment = true; break;		// Prompt for comments
     case 'k': cfg.cmdkeys = true; break;		// Keys on commandline
+    case 'r':						// Recurse into directories
+#ifdef HAVE_DIRENT_H
+      cfg.recurse = true;
+#else
+      message(MSG_WARN, "option not supported on this system -- r");
+#endif
+      break;
     case '?': exit(EXIT_FAILURE);
     }
 
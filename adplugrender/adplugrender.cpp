@@ -0,0 +1,529 @@
+/*
+ * AdPlug - Replayer for many OPL2/OPL3 audio file formats.
+ * Copyright (c) 1999 - 2008 Simon Peter <dn.tlp@gmx.net>, et al.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * adplugrender.cpp - AdPlug batch renderer, renders files to WAV or raw PCM
+ *
+ * NOTES:
+ * Files are put into a work queue that a pool of worker threads takes
+ * them from. Each worker has its own player and emulator instance and
+ * renders through a fixed-size sample buffer, so memory use only depends
+ * on the number of workers and the buffer budget, not on song length.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "../src/adplug.h"
+#include "../src/renderer.h"
+#include "../src/emuopl.h"
+#include "../src/kemuopl.h"
+#include "../src/wemuopl.h"
+#include "../src/nemuopl.h"
+#include "../src/resampleopl.h"
+#include "../src/shadowopl.h"
+
+/***** Defines *****/
+
+// Message urgency levels
+#define MSG_PANIC	0	// Unmaskable
+#define MSG_ERROR	1
+#define MSG_WARN	2
+#define MSG_NOTE	3
+#define MSG_DEBUG	4
+
+// Size of one output sample: 16 bit stereo
+#define SAMPLESIZE	4
+
+/***** Global variables *****/
+
+// Available emulators. Emulators that keep global state can't be used by
+// more than one worker at a time. Only some can put out every channel on
+// its own.
+enum Emulator { EMU_MAME, EMU_KEN, EMU_WOODY, EMU_NUKED };
+
+static const struct {
+  const char	*name;
+  Emulator	emu;
+  bool		threadsafe, stems;
+} emus[] = {
+  { "mame", EMU_MAME, true, false },
+  { "ken", EMU_KEN, true, false },
+  { "woody", EMU_WOODY, false, true },
+  { "nuked", EMU_NUKED, true, true },
+  {0}
+};
+
+// Number of channels there may be stems of
+#define STEMS		18
+
+// Resampling quality. The emulator runs at the chip's native rate then.
+static const struct {
+  const char		*name;
+  CResampler::Quality	quality;
+} qualities[] = {
+  { "linear", CResampler::LINEAR },
+  { "sinc8", CResampler::SINC8 },
+  { "sinc32", CResampler::SINC32 },
+  {0}
+};
+
+static struct {
+  const char	*outdir;
+  unsigned long	freq, limit, budget;
+  unsigned int	workers, emu;
+  int		quality;	// index into qualities, -1 = no resampling
+  int		message_level;
+  bool		raw, stems, shadow;
+} cfg = {
+  ".",
+  44100, 600, 1024,
+  0, 3,
+  -1,
+  MSG_NOTE,
+  false, false, false
+};
+
+// Work queue and statistics, shared by all workers
+static struct {
+  pthread_mutex_t	lock;
+  char			**files;
+  int			next, count;
+  unsigned long		songs, failed;
+  double		seconds;	// total length of audio rendered
+  unsigned long		writes, dropped;	// register writes, with -d
+} queue = { PTHREAD_MUTEX_INITIALIZER };
+
+// Opens the songs for all workers, who share their instrument banks
+static CProvider_Filesystem	filesystem;
+static CProvider_Cache		files(filesystem);
+
+static const char	*program_name;
+
+/***** Functions *****/
+
+static void message(int level, const char *fmt, ...)
+{
+  va_list argptr;
+
+  if(cfg.message_level < level) return;
+
+  pthread_mutex_lock(&queue.lock);
+  fprintf(stderr, "%s: ", program_name);
+  va_start(argptr, fmt);
+  vfprintf(stderr, fmt, argptr);
+  va_end(argptr);
+  fprintf(stderr, "\n");
+  pthread_mutex_unlock(&queue.lock);
+}
+
+static void usage()
+{
+  printf("Usage: %s [options] <files>\n\n"
+	 "Output options:\n"
+	 "  -o <dir>         Write output files into <dir> (default: .)\n"
+	 "  -r               Write raw PCM instead of WAV files\n"
+	 "  -f <freq>        Use sample rate <freq> Hz (default: 44100)\n"
+	 "  -l <seconds>     Stop songs after <seconds> (default: 600, 0 = never)\n"
+	 "  -s               Also write every channel that sounds to its own file\n"
+	 "\n"
+	 "Rendering options:\n"
+	 "  -e <emulator>    Use emulator (mame, ken, woody, nuked; default: nuked)\n"
+	 "  -j <n>           Render <n> files at once (default: number of CPUs)\n"
+	 "  -m <kbytes>      Memory budget for sample buffers (default: 1024)\n"
+	 "  -R <quality>     Run the emulator at its native rate and resample\n"
+	 "                   (linear, sinc8, sinc32; default: don't)\n"
+	 "  -d               Drop register writes that don't change the chip\n"
+	 "\n"
+	 "Generic options:\n"
+	 "  -q               Be more quiet\n"
+	 "  -v               Be more verbose\n"
+	 "  -h               Display this help\n"
+	 "  -V               Display version information\n",
+	 program_name);
+}
+
+static void copyright()
+/* Print copyright notice and version information */
+{
+  printf("AdPlug batch renderer %s\n", CAdPlug::get_version().c_str());
+  printf("Copyright (c) 1999 - 2008 Simon Peter <dn.tlp@gmx.net>, et al.\n");
+}
+
+static Copl *make_emu(unsigned long freq)
+/* Creates an emulator instance for 16 bit stereo output at rate 'freq' */
+{
+  switch(emus[cfg.emu].emu) {
+  case EMU_MAME: return new CEmuopl(freq, true, true);
+  case EMU_KEN: return new CKemuopl(freq, true, true);
+  case EMU_WOODY: return new CWemuopl(freq, true, true);
+  case EMU_NUKED: return new CNemuopl(freq);
+  }
+
+  return 0;
+}
+
+static Copl *make_opl()
+/* Creates an emulator instance as configured, for 16 bit stereo output */
+{
+  if(cfg.quality < 0)
+    return make_emu(cfg.freq);
+
+  return new CResampleopl(make_emu(CResampleopl::NATIVE_RATE), cfg.freq, true,
+			  qualities[cfg.quality].quality);
+}
+
+static std::string outname(const char *filename, int stem = -1)
+/* Returns the output file name for an input file, or for one of its stems */
+{
+  const char	*base = strrchr(filename, '/') ? strrchr(filename, '/') + 1 :
+    filename;
+  std::string	name = base;
+  char		suffix[8] = "";
+
+  if(name.find_last_of('.') != std::string::npos)
+    name.erase(name.find_last_of('.'));
+  if(stem >= 0) sprintf(suffix, "-%02d", stem);
+
+  return std::string(cfg.outdir) + "/" + name + suffix +
+    (cfg.raw ? ".raw" : ".wav");
+}
+
+static void put_le(FILE *f, unsigned long val, int size)
+{
+  for(int i = 0; i < size; i++, val >>= 8)
+    fputc(val & 0xff, f);
+}
+
+static void write_wavheader(FILE *f, unsigned long samples)
+/* Writes a WAV header for 'samples' samples of 16 bit stereo at 'cfg.freq' */
+{
+  unsigned long datasize = samples * SAMPLESIZE;
+
+  fputs("RIFF", f); put_le(f, datasize + 36, 4);
+  fputs("WAVEfmt ", f); put_le(f, 16, 4);
+  put_le(f, 1, 2);				// PCM
+  put_le(f, 2, 2);				// channels
+  put_le(f, cfg.freq, 4);
+  put_le(f, cfg.freq * SAMPLESIZE, 4);		// bytes per second
+  put_le(f, SAMPLESIZE, 2);			// block align
+  put_le(f, 16, 2);				// bits per sample
+  fputs("data", f); put_le(f, datasize, 4);
+}
+
+static void fix_endianness(short *buf, unsigned long n)
+/* Converts 'n' native samples in 'buf' to little endian */
+{
+  const unsigned short test = 1;
+
+  if(*(const unsigned char *)&test) return;	// little endian host
+
+  for(unsigned long i = 0; i < n; i++) {
+    unsigned short s = buf[i];
+    buf[i] = (short)((s >> 8) | (s << 8));
+  }
+}
+
+static bool open_stems(const char *filename, FILE **stemf)
+/* Opens the stem files of a file, with a blank WAV header */
+{
+  std::string	fn;
+  int		i;
+
+  for(i = 0; i < STEMS; i++) {
+    fn = outname(filename, i);
+    if(!(stemf[i] = fopen(fn.c_str(), "wb"))) {
+      message(MSG_ERROR, "can't write output file -- %s", fn.c_str());
+      while(i--) {
+	fclose(stemf[i]);
+	remove(outname(filename, i).c_str());
+      }
+      return false;
+    }
+    if(!cfg.raw) write_wavheader(stemf[i], 0);
+  }
+
+  return true;
+}
+
+static void close_stems(const char *filename, FILE **stemf,
+			unsigned long samples, const bool *sounded)
+/* Finishes the stem files of a file, the silent ones are removed again */
+{
+  for(int i = 0; i < STEMS; i++) {
+    if(sounded[i] && !cfg.raw) {
+      fseek(stemf[i], 0, SEEK_SET);
+      write_wavheader(stemf[i], samples);
+    }
+    fclose(stemf[i]);
+    if(!sounded[i]) remove(outname(filename, i).c_str());
+  }
+}
+
+static bool render_file(const char *filename, short *buf,
+			unsigned long bufsamples, short *stembuf)
+/* Renders one file and returns false on failure. With 'stembuf', every
+   channel goes to a file of its own, too. */
+{
+  CShadowopl	*shadow = cfg.shadow ? new CShadowopl(make_opl()) : 0;
+  Copl		*opl = shadow ? shadow : make_opl();
+  CPlayer	*p;
+  std::string	outfn = outname(filename);
+  FILE		*f, *stemf[STEMS];
+  short		*stems[STEMS];
+  bool		sounded[STEMS] = { false };
+  unsigned long	n, i;
+  int		c;
+
+  // rewrites these emulators act on, see shadowopl.h
+  if(shadow && emus[cfg.emu].emu == EMU_MAME)
+    shadow->passrewrites(0x60, 0x95);
+  if(shadow && emus[cfg.emu].emu == EMU_KEN) {
+    shadow->passrewrites(0x40, 0x55);
+    shadow->passrewrites(0xa0, 0xb8);
+  }
+
+  p = CAdPlug::factory(filename, opl, CAdPlug::players, files);
+  if(!p) {
+    message(MSG_WARN, "unknown filetype -- %s", filename);
+    delete opl;
+    return false;
+  }
+
+  if(!(f = fopen(outfn.c_str(), "wb"))) {
+    message(MSG_ERROR, "can't write output file -- %s", outfn.c_str());
+    delete p; delete opl;
+    return false;
+  }
+
+  if(stembuf && !open_stems(filename, stemf)) {
+    fclose(f);
+    delete p; delete opl;
+    return false;
+  }
+  for(c = 0; c < STEMS; c++)
+    stems[c] = stembuf + c * bufsamples * 2;
+
+  CRenderer r(p, opl, cfg.freq, true, true);
+  r.setlimit(cfg.limit * 1000);
+
+  if(!cfg.raw) write_wavheader(f, 0);
+  while((n = r.render(buf, bufsamples, stembuf ? stems : 0))) {
+    fix_endianness(buf, n * 2);
+    fwrite(buf, SAMPLESIZE, n, f);
+    for(c = 0; stembuf && c < STEMS; c++) {
+      for(i = 0; i < n * 2 && !sounded[c]; i++)
+	if(stems[c][i]) sounded[c] = true;
+      fix_endianness(stems[c], n * 2);
+      fwrite(stems[c], SAMPLESIZE, n, stemf[c]);
+    }
+  }
+
+  if(!cfg.raw) {
+    fseek(f, 0, SEEK_SET);
+    write_wavheader(f, r.getrendered());
+  }
+
+  fclose(f);
+  if(stembuf) close_stems(filename, stemf, r.getrendered(), sounded);
+  if(shadow)
+    message(MSG_NOTE, "rendered %lu ms, dropped %lu of %lu writes -- %s",
+	    r.getrendered() * 1000 / cfg.freq, shadow->getdropped(),
+	    shadow->getpassed() + shadow->getdropped(), filename);
+  else
+    message(MSG_NOTE, "rendered %lu ms -- %s",
+	    r.getrendered() * 1000 / cfg.freq, filename);
+
+  pthread_mutex_lock(&queue.lock);
+  queue.seconds += (double)r.getrendered() / cfg.freq;
+  if(shadow) {
+    queue.writes += shadow->getpassed() + shadow->getdropped();
+    queue.dropped += shadow->getdropped();
+  }
+  pthread_mutex_unlock(&queue.lock);
+
+  delete p;
+  delete opl;
+  return true;
+}
+
+static void *worker(void *arg)
+/* Takes files from the work queue and renders them, until it runs dry */
+{
+  unsigned long	bufsamples = *(unsigned long *)arg;
+  short		*buf = new short[bufsamples * 2];
+  short		*stembuf = cfg.stems ? new short[bufsamples * 2 * STEMS] : 0;
+  const char	*filename;
+  bool		ok;
+
+  for(;;) {
+    pthread_mutex_lock(&queue.lock);
+    filename = queue.next < queue.count ? queue.files[queue.next++] : 0;
+    pthread_mutex_unlock(&queue.lock);
+
+    if(!filename) break;
+    ok = render_file(filename, buf, bufsamples, stembuf);
+
+    pthread_mutex_lock(&queue.lock);
+    if(ok) queue.songs++; else queue.failed++;
+    pthread_mutex_unlock(&queue.lock);
+  }
+
+  delete [] buf;
+  delete [] stembuf;
+  return 0;
+}
+
+static double now()
+/* Returns wall clock time in seconds */
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+/***** Main program *****/
+
+int main(int argc, char *argv[])
+{
+  int		opt;
+  unsigned int	i;
+  unsigned long	bufsamples;
+  pthread_t	*threads;
+  double	start, elapsed;
+
+  // Init
+  program_name = strrchr(argv[0], '/') ? strrchr(argv[0], '/') + 1 : argv[0];
+
+  // Parse options
+  while((opt = getopt(argc, argv, "o:rf:l:se:j:m:R:dqvhV")) != -1)
+    switch(opt) {
+    case 'o': cfg.outdir = optarg; break;		// Output directory
+    case 'r': cfg.raw = true; break;			// Raw output
+    case 'f': cfg.freq = atol(optarg); break;		// Sample rate
+    case 'l': cfg.limit = atol(optarg); break;		// Song length limit
+    case 's': cfg.stems = true; break;			// Stems
+    case 'e':						// Emulator
+      for(i = 0; emus[i].name; i++)
+	if(!strcmp(emus[i].name, optarg)) {
+	  cfg.emu = i;
+	  break;
+	}
+
+      if(!emus[i].name) {
+	message(MSG_ERROR, "unknown emulator -- %s", optarg);
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 'j': cfg.workers = atoi(optarg); break;	// Number of workers
+    case 'm': cfg.budget = atol(optarg); break;		// Memory budget
+    case 'R':						// Resampling
+      for(i = 0; qualities[i].name; i++)
+	if(!strcmp(qualities[i].name, optarg)) {
+	  cfg.quality = i;
+	  break;
+	}
+
+      if(!qualities[i].name) {
+	message(MSG_ERROR, "unknown resampling quality -- %s", optarg);
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 'd': cfg.shadow = true; break;			// Register shadow
+    case 'q': if(cfg.message_level) cfg.message_level--; break;	// Be more quiet
+    case 'v': cfg.message_level++; break;		// Be more verbose
+    case 'h': usage(); exit(EXIT_SUCCESS); break;	// Display help
+    case 'V': copyright(); exit(EXIT_SUCCESS); break;	// Display version
+    case '?': exit(EXIT_FAILURE);
+    }
+
+  // Check for files
+  if(argc == optind) {
+    fprintf(stderr, "%s: need files to render\n", program_name);
+    fprintf(stderr, "Try '%s -h' for more information.\n", program_name);
+    exit(EXIT_FAILURE);
+  }
+
+  if(!cfg.freq) {
+    message(MSG_ERROR, "invalid sample rate -- 0");
+    exit(EXIT_FAILURE);
+  }
+
+  if(cfg.stems && (!emus[cfg.emu].stems || cfg.quality >= 0)) {
+    message(MSG_ERROR, "stems need the woody or nuked emulator, without -R");
+    exit(EXIT_FAILURE);
+  }
+
+  // Size the worker pool
+#ifdef _SC_NPROCESSORS_ONLN
+  if(!cfg.workers) cfg.workers = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  if(!cfg.workers) cfg.workers = 1;
+  if(cfg.workers > (unsigned int)(argc - optind))
+    cfg.workers = argc - optind;
+  if(cfg.workers > 1 && !emus[cfg.emu].threadsafe) {
+    message(MSG_WARN, "emulator can only render one file at once -- %s",
+	    emus[cfg.emu].name);
+    cfg.workers = 1;
+  }
+
+  // Split the memory budget among the workers, and the stems
+  bufsamples = cfg.budget * 1024 / cfg.workers / SAMPLESIZE /
+    (cfg.stems ? STEMS + 1 : 1);
+  if(bufsamples < 512) bufsamples = 512;
+  message(MSG_DEBUG, "%u workers, %lu samples buffer each", cfg.workers,
+	  bufsamples);
+
+  // Render
+  queue.files = argv + optind;
+  queue.count = argc - optind;
+  threads = new pthread_t[cfg.workers];
+  start = now();
+
+  for(i = 0; i < cfg.workers; i++)
+    if(pthread_create(&threads[i], 0, worker, &bufsamples)) {
+      message(MSG_PANIC, "can't start worker thread");
+      exit(EXIT_FAILURE);
+    }
+
+  for(i = 0; i < cfg.workers; i++)
+    pthread_join(threads[i], 0);
+
+  elapsed = now() - start;
+  delete [] threads;
+
+  // Report
+  if(cfg.message_level >= MSG_ERROR) {
+    printf("%lu songs rendered, %lu failed, %.1f s of audio in %.2f s\n",
+	   queue.songs, queue.failed, queue.seconds, elapsed);
+    if(elapsed > 0.0)
+      printf("%.2f songs/s, %.1fx realtime\n", queue.songs / elapsed,
+	     queue.seconds / elapsed);
+    if(cfg.shadow && queue.writes)
+      printf("%lu of %lu register writes dropped (%.1f%%)\n", queue.dropped,
+	     queue.writes, 100.0 * queue.dropped / queue.writes);
+  }
+
+  return queue.failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
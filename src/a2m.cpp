@@ -59,7 +59,19 @@ CPlayer *Ca2mLoader::factory(Copl *newopl)
   return new Ca2mLoader(newopl);
 }
 
-bool Ca2mLoader::load(const std::string &filename, const CFileProvider &fp)
+CPlayer::ProbeScore Ca2mLoader::probe(const std::string &filename,
+				      const unsigned char *head,
+				      unsigned long len,
+				      unsigned long filesize)
+{
+  if(len < 15 || memcmp(head, "_A2module_", 10) ||
+     (head[14] != 1 && head[14] != 5 && head[14] != 4 && head[14] != 8))
+    return PROBE_NO;
+
+  return PROBE_YES;
+}
+
+bool Ca2mLoader::loadfile(const std::string &filename, const CFileProvider &fp)
 {
   binistream *f = fp.open(filename); if(!f) return false;
   char id[10];
@@ -28,11 +28,14 @@ class Ca2mLoader: public CmodPlayer
 {
 public:
   static CPlayer *factory(Copl *newopl);
+  static ProbeScore probe(const std::string &filename,
+			  const unsigned char *head,
+			  unsigned long len, unsigned long filesize);
 
   Ca2mLoader(Copl *newopl): CmodPlayer(newopl)
     { }
 
-  bool load(const std::string &filename, const CFileProvider &fp);
+  bool loadfile(const std::string &filename, const CFileProvider &fp);
   float getrefresh();
 
   std::string gettype()
@@ -55,6 +55,7 @@
 #include <stdio.h>
 
 #include "adl.h"
+#include "snapshot.h"
 #include "debug.h"
 
 #ifdef ADL_DEBUG
@@ -105,12 +106,14 @@ static inline uint16 READ_BE_UINT16(const void *ptr) {
 
 class AdlibDriver {
 public:
-  AdlibDriver(Copl *opl);
+  AdlibDriver(Copl *&opl);
   ~AdlibDriver();
 
   int callback(int opcode, ...);
   void callback();
 
+  void snapshot(CSnapshot &s);
+
   // AudioStream API
   // 	int readBuffer(int16 *buffer, const int numSamples) {
   // 		int32 samplesLeft = numSamples;
@@ -277,8 +280,18 @@ public:
   // * One for programs, starting at offset 0.
   // * One for instruments, starting at offset depending on version.
 
+  // Returns NULL if the program's header lies outside the sound data or
+  // names a channel that doesn't exist.
+
   uint8 *getProgram(int progId) {
-    return _soundData + READ_LE_UINT16(_soundData + 2 * progId);
+    if ((uint32)(2 * progId + 1) >= _soundDataSize)
+      return 0;
+
+    uint32 offset = READ_LE_UINT16(_soundData + 2 * progId);
+    if (offset + 1 >= _soundDataSize || _soundData[offset] > 9)
+      return 0;
+
+    return _soundData + offset;
   }
 
   uint8 *getInstrument(int instrumentId) {
@@ -436,6 +449,7 @@ public:
   int _flags;
 
   uint8 *_soundData;
+  uint32 _soundDataSize;
 
   uint8 _soundIdTable[0x10];
   Channel _channels[10];
@@ -457,10 +471,11 @@ public:
   static const uint8 _unkTable2_3[];
   static const uint8 _unkTables[][32];
 
-  Copl *opl;
+  Copl *&opl;	// follows the player's OPL, which may be swapped
+  CWriteBatch batch;	// OPL writes of the current callback
 };
 
-AdlibDriver::AdlibDriver(Copl *newopl)
+AdlibDriver::AdlibDriver(Copl *&newopl)
   : opl(newopl)
 {
   setupOpcodeList();
@@ -475,6 +490,7 @@ AdlibDriver::AdlibDriver(Copl *newopl)
 
   memset(_channels, 0, sizeof(_channels));
   _soundData = 0;
+  _soundDataSize = 0;
 
   _vibratoAndAMDepthBits = _curRegOffset = 0;
 
@@ -520,6 +536,7 @@ int AdlibDriver::callback(int opcode, ...) {
   va_start(args, opcode);
   int returnValue = (this->*(_opcodeList[opcode].function))(args);
   va_end(args);
+  batch.flush(opl);
   // 	unlock();
   return returnValue;
 }
@@ -551,6 +568,7 @@ int AdlibDriver::snd_setSoundData(va_list &list) {
     _soundData = 0;
   }
   _soundData = va_arg(list, uint8*);
+  _soundDataSize = va_arg(list, int);
   return 0;
 }
 
@@ -565,6 +583,8 @@ int AdlibDriver::snd_startSong(va_list &list) {
   _flagTrigger = 1;
 
   uint8 *ptr = getProgram(songId);
+  if (!ptr)
+    return 0;
   uint8 chan = *ptr;
 
   if ((songId << 1) != 0) {
@@ -615,15 +635,20 @@ int AdlibDriver::snd_unkOpcode3(va_list &list) {
 int AdlibDriver::snd_readByte(va_list &list) {
   int a = va_arg(list, int);
   int b = va_arg(list, int);
-  uint8 *ptr = getProgram(a) + b;
-  return *ptr;
+  uint8 *ptr = getProgram(a);
+  if (!ptr || ptr + b >= _soundData + _soundDataSize)
+    return 0;
+  return ptr[b];
 }
 
 int AdlibDriver::snd_writeByte(va_list &list) {
   int a = va_arg(list, int);
   int b = va_arg(list, int);
   int c = va_arg(list, int);
-  uint8 *ptr = getProgram(a) + b;
+  uint8 *ptr = getProgram(a);
+  if (!ptr || ptr + b >= _soundData + _soundDataSize)
+    return 0;
+  ptr += b;
   uint8 oldValue = *ptr;
   *ptr = (uint8)c;
   return oldValue;
@@ -682,12 +707,57 @@ void AdlibDriver::callback() {
       ++_unkValue4;
     }
   }
+  batch.flush(opl);
   // 	unlock();
 }
 
+// replay state
+
+void AdlibDriver::snapshot(CSnapshot &s) {
+  s.io(_lastProcessed);
+  s.io(_flagTrigger);
+  s.io(_curChannel);
+  s.io(_soundTrigger);
+  s.io(_soundsPlaying);
+  s.io(_rnd);
+
+  s.io(_unkValue1); s.io(_unkValue2); s.io(_unkValue3); s.io(_unkValue4);
+  s.io(_unkValue5); s.io(_unkValue6); s.io(_unkValue7); s.io(_unkValue8);
+  s.io(_unkValue9); s.io(_unkValue10); s.io(_unkValue11); s.io(_unkValue12);
+  s.io(_unkValue13); s.io(_unkValue14); s.io(_unkValue15); s.io(_unkValue16);
+  s.io(_unkValue17); s.io(_unkValue18); s.io(_unkValue19); s.io(_unkValue20);
+
+  s.io(_flags);
+  s.io(_soundIdTable);
+
+  // The effect callbacks are stored as they are. The data pointers are
+  // stored once more as offsets into the sound data, which fixes them up
+  // on restore.
+  for (int i = 0; i < 10; ++i) {
+    Channel &channel = _channels[i];
+
+    s.io(channel);
+    s.ptr(channel.dataptr, _soundData);
+    for (int j = 0; j < 4; ++j)
+      s.ptr(channel.dataptrStack[j], _soundData);
+  }
+
+  s.io(_vibratoAndAMDepthBits);
+  s.io(_rhythmSectionBits);
+  s.io(_curRegOffset);
+  s.io(_tempo);
+  s.io(_tablePtr1);
+  s.io(_tablePtr2);
+}
+
 void AdlibDriver::setupPrograms() {
   while (_lastProcessed != _soundsPlaying) {
     uint8 *ptr = getProgram(_soundIdTable[_lastProcessed]);
+    if (!ptr) {
+      ++_lastProcessed;
+      _lastProcessed &= 0x0F;
+      continue;
+    }
     uint8 chan = *ptr++;
     uint8 priority = *ptr++;
 
@@ -851,7 +921,7 @@ void AdlibDriver::resetAdlibState() {
 // New calling style: writeOPL(0xAB, 0xCD)
 
 void AdlibDriver::writeOPL(byte reg, byte val) {
-  opl->write(reg, val);
+  batch.write(opl, reg, val);
 }
 
 void AdlibDriver::initChannel(Channel &channel) {
@@ -1297,6 +1367,8 @@ int AdlibDriver::update_setupProgram(uint8 *&dataptr, Channel &channel, uint8 va
     return 0;
 
   uint8 *ptr = getProgram(value);
+  if (!ptr)
+    return 0;
   uint8 chan = *ptr++;
   uint8 priority = *ptr++;
 
@@ -1399,6 +1471,8 @@ int AdlibDriver::update_stopOtherChannel(uint8 *&dataptr, Channel &channel, uint
 
 int AdlibDriver::update_waitForEndOfProgram(uint8 *&dataptr, Channel &channel, uint8 value) {
   uint8 *ptr = getProgram(value);
+  if (!ptr)
+    return 0;
   uint8 chan = *ptr;
 
   if (!_channels[chan].dataptr) {
@@ -2230,7 +2304,7 @@ CadlPlayer::CadlPlayer(Copl *newopl)
   _version = 0;
   memset(_trackEntries, 0, sizeof(_trackEntries));
   memset(_trackEntries16, 0, sizeof(_trackEntries16));
-  _driver = new AdlibDriver(newopl);
+  _driver = new AdlibDriver(opl);
   assert(_driver);
 
   _sfxPlayingSound = -1;
@@ -2354,7 +2428,19 @@ void CadlPlayer::play(uint16_t track) {
 // 	playSoundEffect(1);
 // }
 
-bool CadlPlayer::load(const std::string &filename, const CFileProvider &fp)
+CPlayer::ProbeScore CadlPlayer::probe(const std::string &filename,
+				      const unsigned char *head,
+				      unsigned long len,
+				      unsigned long filesize)
+{
+  // there is no signature
+  if(!CFileProvider::extension(filename, ".adl") || filesize < 720)
+    return PROBE_NO;
+
+  return PROBE_MAYBE;
+}
+
+bool CadlPlayer::loadfile(const std::string &filename, const CFileProvider &fp)
 {
   binistream	*f = fp.open(filename);
 
@@ -2376,7 +2462,7 @@ bool CadlPlayer::load(const std::string &filename, const CFileProvider &fp)
   // 		haltTrack();
   // 	}
 
-  uint8 *file_data = 0; uint32 file_size = 0;
+  uint32 file_size = 0;
 
   // 	char filename[25];
   // 	sprintf(filename, "%s.ADL", file);
@@ -2432,38 +2518,32 @@ bool CadlPlayer::load(const std::string &filename, const CFileProvider &fp)
 
   f->seek(0);
   file_size = fp.filesize(f);
-  file_data = new uint8 [file_size];
-  f->readString((char *)file_data, file_size);
 
   _driver->callback(8, int(-1));
   _soundDataPtr = 0;
 
-  uint8 *p = file_data;
+  // read straight into place, the driver changes its copy of the sound data
   uint16 _EntriesSize;
   if (_version < 3)
   {
     _EntriesSize = 120 * sizeof(uint8);
-    memcpy(_trackEntries, p, _EntriesSize);
+    f->readString((char *)_trackEntries, _EntriesSize);
   }
   else
   {
     _EntriesSize = 250 * sizeof(uint16);
-    memcpy(_trackEntries16, p, _EntriesSize);
+    f->readString((char *)_trackEntries16, _EntriesSize);
   }
-  p += _EntriesSize;
 
   int soundDataSize = file_size - _EntriesSize;
 
   _soundDataPtr = new uint8[soundDataSize];
   assert(_soundDataPtr);
 
-  memcpy(_soundDataPtr, p, soundDataSize*sizeof(uint8));
-
-  delete [] file_data;
-  file_data = p = 0;
+  f->readString((char *)_soundDataPtr, soundDataSize);
   file_size = 0;
 
-  _driver->callback(4, _soundDataPtr);
+  _driver->callback(4, _soundDataPtr, soundDataSize);
 
   // 	_soundFileLoaded = file;
 
@@ -2514,6 +2594,49 @@ void CadlPlayer::rewind(int subsong)
   update();
 }
 
+bool CadlPlayer::snapshot(CSnapshot &s)
+{
+  int sfx = _sfxPlayingSound;
+  uint8 priority = _sfxPriority, fourthByte = _sfxFourthByteOfSong;
+  uint8 patch[2] = { 0, 0 };
+
+  // play() patches the header of the sound effect it starts, so that patch
+  // is part of the state, too.
+  if (s.saving() && sfx != -1) {
+    patch[0] = _driver->callback(9, sfx, int(1));
+    patch[1] = _driver->callback(9, sfx, int(3));
+  }
+
+  s.io(cursubsong);
+  _driver->snapshot(s);
+  s.io(_sfxPlayingSound);
+  s.io(_sfxPriority);
+  s.io(_sfxFourthByteOfSong);
+  s.io(patch);
+
+  if (s.saving())
+    return true;
+
+  if (!s.good()) {
+    // keep our own patch consistent, the caller discards the rest
+    _sfxPlayingSound = sfx;
+    _sfxPriority = priority;
+    _sfxFourthByteOfSong = fourthByte;
+    return true;
+  }
+
+  if (sfx != -1) {	// take our own patch back...
+    _driver->callback(10, sfx, int(1), int(priority));
+    _driver->callback(10, sfx, int(3), int(fourthByte));
+  }
+  if (_sfxPlayingSound != -1) {	// ...and adopt the snapshot's
+    _driver->callback(10, _sfxPlayingSound, int(1), int(patch[0]));
+    _driver->callback(10, _sfxPlayingSound, int(3), int(patch[1]));
+  }
+
+  return true;
+}
+
 unsigned int CadlPlayer::getsubsongs()
 {
   return numsubsongs;
@@ -32,11 +32,14 @@ class CadlPlayer: public CPlayer
 {
  public:
   static CPlayer *factory(Copl *newopl);
+  static ProbeScore probe(const std::string &filename,
+			  const unsigned char *head,
+			  unsigned long len, unsigned long filesize);
 
   CadlPlayer(Copl *newopl);
   ~CadlPlayer();
 
-  bool load(const std::string &filename, const CFileProvider &fp);
+  bool loadfile(const std::string &filename, const CFileProvider &fp);
   bool update();
   void rewind(int subsong = -1);
 
@@ -51,6 +54,8 @@ class CadlPlayer: public CPlayer
   std::string gettype();
 
  private:
+  bool snapshot(CSnapshot &s);
+
   int numsubsongs, cursubsong;
 
   AdlibDriver *_driver;
@@ -49,6 +49,7 @@ I'm not sure about a few things in my code:
 
 #include <math.h>
 #include <string.h>
+#include "adlibemu.h"
 
 #if !defined(max) && !defined(__cplusplus)
 #define max(a,b)  (((a) > (b)) ? (a) : (b))
@@ -58,10 +59,9 @@ I'm not sure about a few things in my code:
 #endif
 
 #define PI 3.141592653589793
-#define MAXCELLS 18
 #define WAVPREC 2048
 
-static float AMPSCALE=(8192.0);
+#define AMPSCALE (8192.0)
 #define FRQSCALE (49716/512.0)
 
 //Constants for Ken's Awe32, on a PII-266 (Ken says: Use these for KSM's!)
@@ -74,39 +74,15 @@ static float AMPSCALE=(8192.0);
 //#define MFBFACTOR 0.5    //How much feedback goes back into modulator
 //#define ADJUSTSPEED 0.85 //0<=x<=1  Simulate finite rate of change of state
 
-typedef struct
-{
-    float val, t, tinc, vol, sustain, amp, mfb;
-    float a0, a1, a2, a3, decaymul, releasemul;
-    short *waveform;
-    long wavemask;
-    void (*cellfunc)(void *, float);
-    unsigned char flags, dum0, dum1, dum2;
-} celltype;
-
-static long numspeakers, bytespersample;
-static float recipsamp;
-static celltype cell[MAXCELLS];
+//Shared by all chips, only written by adlibinittables()
 static signed short wavtable[WAVPREC*3];
-static float kslmul[4] = {0.0,0.5,0.25,1.0};
-static float frqmul[16] = {.5,1,2,3,4,5,6,7,8,9,10,10,12,12,15,15}, nfrqmul[16];
-static unsigned char adlibreg[256], ksl[8][16];
-static unsigned char modulatorbase[9] = {0,1,2,8,9,10,16,17,18};
-static unsigned char odrumstat = 0;
-static unsigned char base2cell[22] = {0,1,2,0,1,2,0,0,3,4,5,3,4,5,0,0,6,7,8,6,7,8};
-
-float lvol[9] = {1,1,1,1,1,1,1,1,1};  //Volume multiplier on left speaker
-float rvol[9] = {1,1,1,1,1,1,1,1,1};  //Volume multiplier on right speaker
-long lplc[9] = {0,0,0,0,0,0,0,0,0};   //Samples to delay on left speaker
-long rplc[9] = {0,0,0,0,0,0,0,0,0};   //Samples to delay on right speaker
-
-long nlvol[9], nrvol[9];
-long nlplc[9], nrplc[9];
-long rend = 0;
-#define FIFOSIZ 256
-static float *rptr[9], *nrptr[9];
-static float rbuf[9][FIFOSIZ*2];
-static float snd[FIFOSIZ*2];
+static unsigned char ksl[8][16];
+static long initfirstime = 0;
+
+static const float kslmul[4] = {0.0,0.5,0.25,1.0};
+static const float frqmul[16] = {.5,1,2,3,4,5,6,7,8,9,10,10,12,12,15,15};
+static const unsigned char modulatorbase[9] = {0,1,2,8,9,10,16,17,18};
+static const unsigned char base2cell[22] = {0,1,2,0,1,2,0,0,3,4,5,3,4,5,0,0,6,7,8,6,7,8};
 
 #ifndef USING_ASM
 #define _inline
@@ -194,24 +170,25 @@ void docell0 (void *c, float modulator)
 }
 
 
-static long waveform[8] = {WAVPREC,WAVPREC>>1,WAVPREC,(WAVPREC*3)>>2,0,0,(WAVPREC*5)>>2,WAVPREC<<1};
-static long wavemask[8] = {WAVPREC-1,WAVPREC-1,(WAVPREC>>1)-1,(WAVPREC>>1)-1,WAVPREC-1,((WAVPREC*3)>>2)-1,WAVPREC>>1,WAVPREC-1};
-static long wavestart[8] = {0,WAVPREC>>1,0,WAVPREC>>2,0,0,0,WAVPREC>>3};
-static float attackconst[4] = {1/2.82624,1/2.25280,1/1.88416,1/1.59744};
-static float decrelconst[4] = {1/39.28064,1/31.41608,1/26.17344,1/22.44608};
-void cellon (long i, long j, celltype *c, unsigned char iscarrier)
+static const long waveform[8] = {WAVPREC,WAVPREC>>1,WAVPREC,(WAVPREC*3)>>2,0,0,(WAVPREC*5)>>2,WAVPREC<<1};
+static const long wavemask[8] = {WAVPREC-1,WAVPREC-1,(WAVPREC>>1)-1,(WAVPREC>>1)-1,WAVPREC-1,((WAVPREC*3)>>2)-1,WAVPREC>>1,WAVPREC-1};
+static const long wavestart[8] = {0,WAVPREC>>1,0,WAVPREC>>2,0,0,0,WAVPREC>>3};
+static const float attackconst[4] = {1/2.82624,1/2.25280,1/1.88416,1/1.59744};
+static const float decrelconst[4] = {1/39.28064,1/31.41608,1/26.17344,1/22.44608};
+static void cellon (adlibchip *chip, long i, long j, celltype *c, unsigned char iscarrier)
 {
     long frn, oct, toff;
     float f;
+    unsigned char *adlibreg = chip->adlibreg;
 
     frn = ((((long)adlibreg[i+0xb0])&3)<<8) + (long)adlibreg[i+0xa0];
     oct = ((((long)adlibreg[i+0xb0])>>2)&7);
     toff = (oct<<1) + ((frn>>9)&((frn>>8)|(((adlibreg[8]>>6)&1)^1)));
     if (!(adlibreg[j+0x20]&16)) toff >>= 2;
 
-    f = pow(2.0,(adlibreg[j+0x60]>>4)+(toff>>2)-1)*attackconst[toff&3]*recipsamp;
+    f = pow(2.0,(adlibreg[j+0x60]>>4)+(toff>>2)-1)*attackconst[toff&3]*chip->recipsamp;
     c->a0 = .0377*f; c->a1 = 10.73*f+1; c->a2 = -17.57*f; c->a3 = 7.42*f;
-    f = -7.4493*decrelconst[toff&3]*recipsamp;
+    f = -7.4493*decrelconst[toff&3]*chip->recipsamp;
     c->decaymul = pow(2.0,f*pow(2.0,(adlibreg[j+0x60]&15)+(toff>>2)));
     c->releasemul = pow(2.0,f*pow(2.0,(adlibreg[j+0x80]&15)+(toff>>2)));
     c->wavemask = wavemask[adlibreg[j+0xe0]&7];
@@ -220,7 +197,7 @@ void cellon (long i, long j, celltype *c, unsigned char iscarrier)
     c->t = wavestart[adlibreg[j+0xe0]&7];
     c->flags = adlibreg[j+0x20];
     c->cellfunc = docell0;
-    c->tinc = (float)(frn<<oct)*nfrqmul[adlibreg[j+0x20]&15];
+    c->tinc = (float)(frn<<oct)*chip->nfrqmul[adlibreg[j+0x20]&15];
     c->vol = pow(2.0,((float)(adlibreg[j+0x40]&63) +
 		      (float)kslmul[adlibreg[j+0x40]>>6]*ksl[oct][frn>>6]) * -.125 - 14);
     c->sustain = pow(2.0,(float)(adlibreg[j+0x80]>>4) * -.5);
@@ -231,27 +208,59 @@ void cellon (long i, long j, celltype *c, unsigned char iscarrier)
 }
 
 //This function (and bug fix) written by Chris Moeller
-void cellfreq (signed long i, signed long j, celltype *c)
+static void cellfreq (adlibchip *chip, signed long i, signed long j, celltype *c)
 {
     long frn, oct;
+    unsigned char *adlibreg = chip->adlibreg;
 
     frn = ((((long)adlibreg[i+0xb0])&3)<<8) + (long)adlibreg[i+0xa0];
     oct = ((((long)adlibreg[i+0xb0])>>2)&7);
 
-    c->tinc = (float)(frn<<oct)*nfrqmul[adlibreg[j+0x20]&15];
+    c->tinc = (float)(frn<<oct)*chip->nfrqmul[adlibreg[j+0x20]&15];
     c->vol = pow(2.0,((float)(adlibreg[j+0x40]&63) +
 		      (float)kslmul[adlibreg[j+0x40]>>6]*ksl[oct][frn>>6]) * -.125 - 14);
 }
 
-static long initfirstime = 0;
-void adlibinit (long dasamplerate, long danumspeakers, long dabytespersample)
+void adlibinittables (void)
 {
-    long i, j, frn, oct;
+    long i, j, oct;
+
+    if (initfirstime) return;
+
+    for(i=0;i<(WAVPREC>>1);i++)
+    {
+	wavtable[i] =
+	    wavtable[(i<<1)  +WAVPREC] = (signed short)(16384*sin((float)((i<<1)  )*PI*2/WAVPREC));
+	wavtable[(i<<1)+1+WAVPREC] = (signed short)(16384*sin((float)((i<<1)+1)*PI*2/WAVPREC));
+    }
+    for(i=0;i<(WAVPREC>>3);i++)
+    {
+	wavtable[i+(WAVPREC<<1)] = wavtable[i+(WAVPREC>>3)]-16384;
+	wavtable[i+((WAVPREC*17)>>3)] = wavtable[i+(WAVPREC>>2)]+16384;
+    }
 
-    memset((void *)adlibreg,0,sizeof(adlibreg));
-    memset((void *)cell,0,sizeof(celltype)*MAXCELLS);
-    memset((void *)rbuf,0,sizeof(rbuf));
-    rend = 0; odrumstat = 0;
+    //[table in book]*8/3
+    ksl[7][0] = 0; ksl[7][1] = 24; ksl[7][2] = 32; ksl[7][3] = 37;
+    ksl[7][4] = 40; ksl[7][5] = 43; ksl[7][6] = 45; ksl[7][7] = 47;
+    ksl[7][8] = 48; for(i=9;i<16;i++) ksl[7][i] = i+41;
+    for(j=6;j>=0;j--)
+	for(i=0;i<16;i++)
+	{
+	    oct = (long)ksl[j+1][i]-8; if (oct < 0) oct = 0;
+	    ksl[j][i] = (unsigned char)oct;
+	}
+
+    initfirstime = 1;
+}
+
+void adlibinit (adlibchip *chip, long dasamplerate, long danumspeakers, long dabytespersample)
+{
+    long i;
+    celltype *cell = chip->cell;
+
+    adlibinittables();
+
+    memset((void *)chip,0,sizeof(adlibchip));
 
     for(i=0;i<MAXCELLS;i++)
     {
@@ -264,78 +273,52 @@ void adlibinit (long dasamplerate, long danumspeakers, long dabytespersample)
 	cell[i].waveform = &wavtable[WAVPREC];
     }
 
-    numspeakers = danumspeakers;
-    bytespersample = dabytespersample;
-
-    recipsamp = 1.0 / (float)dasamplerate;
-    for(i=15;i>=0;i--) nfrqmul[i] = frqmul[i]*recipsamp*FRQSCALE*(WAVPREC/2048.0);
-
-    if (!initfirstime)
+    for(i=0;i<9;i++)
     {
-	initfirstime = 1;
+	chip->lvol[i] = chip->rvol[i] = 1;
+	chip->lplc[i] = chip->rplc[i] = 0;
+    }
+    chip->ampscale = AMPSCALE;
+    chip->chanmask = 0x1ff;
 
-	for(i=0;i<(WAVPREC>>1);i++)
-	{
-	    wavtable[i] =
-		wavtable[(i<<1)  +WAVPREC] = (signed short)(16384*sin((float)((i<<1)  )*PI*2/WAVPREC));
-	    wavtable[(i<<1)+1+WAVPREC] = (signed short)(16384*sin((float)((i<<1)+1)*PI*2/WAVPREC));
-	}
-	for(i=0;i<(WAVPREC>>3);i++)
-	{
-	    wavtable[i+(WAVPREC<<1)] = wavtable[i+(WAVPREC>>3)]-16384;
-	    wavtable[i+((WAVPREC*17)>>3)] = wavtable[i+(WAVPREC>>2)]+16384;
-	}
+    chip->numspeakers = danumspeakers;
+    chip->bytespersample = dabytespersample;
 
-	//[table in book]*8/3
-	ksl[7][0] = 0; ksl[7][1] = 24; ksl[7][2] = 32; ksl[7][3] = 37;
-	ksl[7][4] = 40; ksl[7][5] = 43; ksl[7][6] = 45; ksl[7][7] = 47;
-	ksl[7][8] = 48; for(i=9;i<16;i++) ksl[7][i] = i+41;
-	for(j=6;j>=0;j--)
-	    for(i=0;i<16;i++)
-	    {
-		oct = (long)ksl[j+1][i]-8; if (oct < 0) oct = 0;
-		ksl[j][i] = (unsigned char)oct;
-	    }
-    }
-    else
-    {
-	for(i=0;i<9;i++)
-	{
-	    frn = ((((long)adlibreg[i+0xb0])&3)<<8) + (long)adlibreg[i+0xa0];
-	    oct = ((((long)adlibreg[i+0xb0])>>2)&7);
-	    cell[i].tinc = (float)(frn<<oct)*nfrqmul[adlibreg[modulatorbase[i]+0x20]&15];
-	}
-    }
+    chip->recipsamp = 1.0 / (float)dasamplerate;
+    for(i=15;i>=0;i--) chip->nfrqmul[i] = frqmul[i]*chip->recipsamp*FRQSCALE*(WAVPREC/2048.0);
 }
 
-void adlib0 (long i, long v)
+void adlib0 (adlibchip *chip, long i, long v)
 {
+    unsigned char *adlibreg = chip->adlibreg;
+    celltype *cell = chip->cell;
+    float *nfrqmul = chip->nfrqmul;
     unsigned char tmp = adlibreg[i];
     adlibreg[i] = v;
 
     if (i == 0xbd)
     {
-	if ((v&16) > (odrumstat&16)) //BassDrum
+	if ((v&16) > (chip->odrumstat&16)) //BassDrum
 	{
-	    cellon(6,16,&cell[6],0);
-	    cellon(6,19,&cell[15],1);
+	    cellon(chip,6,16,&cell[6],0);
+	    cellon(chip,6,19,&cell[15],1);
 	    cell[15].vol *= 2;
 	}
-	if ((v&8) > (odrumstat&8)) //Snare
+	if ((v&8) > (chip->odrumstat&8)) //Snare
 	{
-	    cellon(16,20,&cell[16],0);
+	    cellon(chip,16,20,&cell[16],0);
 	    cell[16].tinc *= 2*(nfrqmul[adlibreg[17+0x20]&15] / nfrqmul[adlibreg[20+0x20]&15]);
 	    if (((adlibreg[20+0xe0]&7) >= 3) && ((adlibreg[20+0xe0]&7) <= 5)) cell[16].vol = 0;
 	    cell[16].vol *= 2;
 	}
-	if ((v&4) > (odrumstat&4)) //TomTom
+	if ((v&4) > (chip->odrumstat&4)) //TomTom
 	{
-	    cellon(8,18,&cell[8],0);
+	    cellon(chip,8,18,&cell[8],0);
 	    cell[8].vol *= 2;
 	}
-	if ((v&2) > (odrumstat&2)) //Cymbal
+	if ((v&2) > (chip->odrumstat&2)) //Cymbal
 	{
-	    cellon(17,21,&cell[17],0);
+	    cellon(chip,17,21,&cell[17],0);
 
 	    cell[17].wavemask = wavemask[5];
 	    cell[17].waveform = &wavtable[waveform[5]];
@@ -347,39 +330,39 @@ void adlib0 (long i, long v)
 	    //if (((adlibreg[21+0xe0]&7) == 2) || ((adlibreg[21+0xe0]&7) == 3))
 	    //   cell[17].waveform = &wavtable[(WAVPREC*5)>>2];
 	}
-	if ((v&1) > (odrumstat&1)) //Hihat
+	if ((v&1) > (chip->odrumstat&1)) //Hihat
 	{
-	    cellon(7,17,&cell[7],0);
+	    cellon(chip,7,17,&cell[7],0);
 	    if (((adlibreg[17+0xe0]&7) == 1) || ((adlibreg[17+0xe0]&7) == 4) ||
 		((adlibreg[17+0xe0]&7) == 5) || ((adlibreg[17+0xe0]&7) == 7)) cell[7].vol = 0;
 	    if ((adlibreg[17+0xe0]&7) == 6) { cell[7].wavemask = 0; cell[7].waveform = &wavtable[(WAVPREC*7)>>2]; }
 	}
 
-	odrumstat = v;
+	chip->odrumstat = v;
     }
     else if (((unsigned)(i-0x40) < (unsigned)22) && ((i&7) < 6))
     {
 	if ((i&7) < 3) // Modulator
-	    cellfreq(base2cell[i-0x40],i-0x40,&cell[base2cell[i-0x40]]);
+	    cellfreq(chip,base2cell[i-0x40],i-0x40,&cell[base2cell[i-0x40]]);
 	else          // Carrier
-	    cellfreq(base2cell[i-0x40],i-0x40,&cell[base2cell[i-0x40]+9]);
+	    cellfreq(chip,base2cell[i-0x40],i-0x40,&cell[base2cell[i-0x40]+9]);
     }
     else if ((unsigned)(i-0xa0) < (unsigned)9)
     {
-	cellfreq(i-0xa0,modulatorbase[i-0xa0],&cell[i-0xa0]);
-	cellfreq(i-0xa0,modulatorbase[i-0xa0]+3,&cell[i-0xa0+9]);
+	cellfreq(chip,i-0xa0,modulatorbase[i-0xa0],&cell[i-0xa0]);
+	cellfreq(chip,i-0xa0,modulatorbase[i-0xa0]+3,&cell[i-0xa0+9]);
     }
     else if ((unsigned)(i-0xb0) < (unsigned)9)
     {
 	if ((v&32) > (tmp&32))
 	{
-	    cellon(i-0xb0,modulatorbase[i-0xb0],&cell[i-0xb0],0);
-	    cellon(i-0xb0,modulatorbase[i-0xb0]+3,&cell[i-0xb0+9],1);
+	    cellon(chip,i-0xb0,modulatorbase[i-0xb0],&cell[i-0xb0],0);
+	    cellon(chip,i-0xb0,modulatorbase[i-0xb0]+3,&cell[i-0xb0+9],1);
 	}
 	else if ((v&32) < (tmp&32))
 	    cell[i-0xb0].cellfunc = cell[i-0xb0+9].cellfunc = docell2;
-	cellfreq(i-0xb0,modulatorbase[i-0xb0],&cell[i-0xb0]);
-	cellfreq(i-0xb0,modulatorbase[i-0xb0]+3,&cell[i-0xb0+9]);
+	cellfreq(chip,i-0xb0,modulatorbase[i-0xb0],&cell[i-0xb0]);
+	cellfreq(chip,i-0xb0,modulatorbase[i-0xb0]+3,&cell[i-0xb0+9]);
     }
 
     //outdata(i,v);
@@ -436,20 +419,77 @@ static void clipit16(float f,short *a) {
 }
 #endif
 
-void adlibsetvolume(int i) {
-    AMPSCALE=i;
+void adlibsetvolume(adlibchip *chip, int i) {
+    chip->ampscale=i;
+}
+
+//Returns a bitmask of the channels adlibgetsample works out, bit 0 for
+//channel 0. A channel is left out when the cells it hears are off, it stays
+//silent until the next key on then. The rhythm cells count for the channel
+//they belong to.
+long adlibactive (adlibchip *chip)
+{
+    unsigned char *adlibreg = chip->adlibreg;
+    celltype *cell = chip->cell;
+    long j, active = 0;
+
+    for(j=0;j<9;j++)
+    {
+	if ((adlibreg[0xbd]&0x20) && (j >= 6))
+	{
+	    if ((cell[j+9].cellfunc != docell4) ||
+		((j >= 7) && (cell[j].cellfunc != docell4))) active |= (1<<j);
+	}
+	else
+	{
+	    if ((cell[j+9].cellfunc != docell4) ||
+		((adlibreg[0xc0+j]&1) && (cell[j].cellfunc != docell4))) active |= (1<<j);
+	}
+    }
+    return active;
+}
+
+//Returns 1 if adlibgetsample would skip every channel. The output stays
+//silent until the next key on then.
+static long adlibidle (adlibchip *chip)
+{
+    long j;
+
+    for(j=0;j<9;j++)
+	if (chip->lplc[j] || chip->rplc[j]) return 0; //delayed output still to come
+    return !adlibactive(chip);
 }
 
-void adlibgetsample (unsigned char *sndptr, long numbytes)
+void adlibgetsample (adlibchip *chip, void *sndbuf, long numbytes)
 {
-    long i, j, k=0, ns, endsamples, rptrs, numsamples;
+    long i, j, k, ns, endsamples, rptrs, numsamples;
     celltype *cptr;
     float f;
-    short *sndptr2=(short *)sndptr;
+    unsigned char *sndptr=(unsigned char *)sndbuf;
+    short *sndptr2=(short *)sndbuf;
+    unsigned char *adlibreg = chip->adlibreg;
+    celltype *cell = chip->cell;
+    long numspeakers = chip->numspeakers, bytespersample = chip->bytespersample;
+    float *lvol = chip->lvol, *rvol = chip->rvol;
+    long *lplc = chip->lplc, *rplc = chip->rplc;
+    long *nlvol = chip->nlvol, *nrvol = chip->nrvol;
+    long *nlplc = chip->nlplc, *nrplc = chip->nrplc;
+    float **rptr = chip->rptr, **nrptr = chip->nrptr;
+    float (*rbuf)[FIFOSIZ*2] = chip->rbuf;
+    float *snd = chip->snd;
 
     numsamples = (numbytes>>(numspeakers+bytespersample-2));
 
-    if (bytespersample == 1) f = AMPSCALE/256.0; else f = AMPSCALE;
+    //Nothing sounds, so there is nothing to emulate. With 16 bit samples
+    //silence is all zeroes.
+    if ((bytespersample == 2) && adlibidle(chip))
+    {
+	memset(sndbuf,0,numsamples*numspeakers*sizeof(short));
+	chip->rend = ((chip->rend+numsamples)&(FIFOSIZ*2-1));
+	return;
+    }
+
+    if (bytespersample == 1) f = chip->ampscale/256.0; else f = chip->ampscale;
     if (numspeakers == 1)
     {
 	nlvol[0] = lvol[0]*f;
@@ -466,8 +506,8 @@ void adlibgetsample (unsigned char *sndptr, long numbytes)
 	    {
 		nlvol[rptrs] = lvol[i]*f;
 		nrvol[rptrs] = rvol[i]*f;
-		nlplc[rptrs] = rend-min(max(lplc[i],0),FIFOSIZ);
-		nrplc[rptrs] = rend-min(max(rplc[i],0),FIFOSIZ);
+		nlplc[rptrs] = chip->rend-min(max(lplc[i],0),FIFOSIZ);
+		nrplc[rptrs] = chip->rend-min(max(rplc[i],0),FIFOSIZ);
 		rptrs++;
 	    }
 	    rptr[i] = &rbuf[rptrs-1][0];
@@ -480,18 +520,18 @@ void adlibgetsample (unsigned char *sndptr, long numbytes)
 
     for(ns=0;ns<numsamples;ns+=endsamples)
     {
-	endsamples = min(FIFOSIZ*2-rend,FIFOSIZ);
+	endsamples = min(FIFOSIZ*2-chip->rend,FIFOSIZ);
 	endsamples = min(endsamples,numsamples-ns);
 
 	for(i=0;i<9;i++)
-	    nrptr[i] = &rptr[i][rend];
+	    nrptr[i] = &rptr[i][chip->rend];
 	for(i=0;i<rptrs;i++)
-	    memset((void *)&rbuf[i][rend],0,endsamples*sizeof(float));
+	    memset((void *)&rbuf[i][chip->rend],0,endsamples*sizeof(float));
 
 	if (adlibreg[0xbd]&0x20)
 	{
 				//BassDrum (j=6)
-	    if (cell[15].cellfunc != docell4)
+	    if ((cell[15].cellfunc != docell4) && (chip->chanmask&(1<<6)))
 	    {
 		if (adlibreg[0xc6]&1)
 		{
@@ -513,23 +553,25 @@ void adlibgetsample (unsigned char *sndptr, long numbytes)
 	    }
 
 				//Snare/Hihat (j=7), Cymbal/TomTom (j=8)
-	    if ((cell[7].cellfunc != docell4) || (cell[8].cellfunc != docell4) || (cell[16].cellfunc != docell4) || (cell[17].cellfunc != docell4))
+	    if (((cell[7].cellfunc != docell4) || (cell[8].cellfunc != docell4) || (cell[16].cellfunc != docell4) || (cell[17].cellfunc != docell4)) &&
+		(chip->chanmask&((1<<7)|(1<<8))))
 	    {
 		for(i=0;i<endsamples;i++)
 		{
-		    k = k*1664525+1013904223;
+		    k = chip->noise = chip->noise*1664525+1013904223;
 		    (cell[16].cellfunc)((void *)&cell[16],k&((WAVPREC>>1)-1)); //Snare
 		    (cell[7].cellfunc)((void *)&cell[7],k&(WAVPREC-1));       //Hihat
 		    (cell[17].cellfunc)((void *)&cell[17],k&((WAVPREC>>3)-1)); //Cymbal
 		    (cell[8].cellfunc)((void *)&cell[8],0.0);                 //TomTom
-		    nrptr[7][i] += cell[7].val + cell[16].val;
-		    nrptr[8][i] += cell[8].val + cell[17].val;
+		    if (chip->chanmask&(1<<7)) nrptr[7][i] += cell[7].val + cell[16].val;
+		    if (chip->chanmask&(1<<8)) nrptr[8][i] += cell[8].val + cell[17].val;
 		}
 	    }
 	}
 	for(j=9-1;j>=0;j--)
 	{
 	    if ((adlibreg[0xbd]&0x20) && (j >= 6) && (j < 9)) continue;
+	    if (!(chip->chanmask&(1<<j))) continue; //muted
 
 	    cptr = &cell[j]; k = j;
 	    if (adlibreg[0xc0+k]&1)
@@ -595,6 +637,6 @@ void adlibgetsample (unsigned char *sndptr, long numbytes)
 
 	sndptr = sndptr+(numspeakers*endsamples);
 	sndptr2 = sndptr2+(numspeakers*endsamples);
-	rend = ((rend+endsamples)&(FIFOSIZ*2-1));
+	chip->rend = ((chip->rend+endsamples)&(FIFOSIZ*2-1));
     }
 }
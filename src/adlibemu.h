@@ -18,9 +18,53 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
-void adlibinit(long dasamplerate,long danumspeakers,long dabytespersample);
-void adlib0(long i,long v);
-void adlibgetsample(void *sndptr,long numbytes);
-void adlibsetvolume(int i);
-void randoinsts();
-extern float lvol[9],rvol[9],lplc[9],rplc[9];
+#ifndef ADLIBEMU_H
+#define ADLIBEMU_H
+
+#define MAXCELLS 18
+#define FIFOSIZ 256
+
+typedef struct
+{
+    float val, t, tinc, vol, sustain, amp, mfb;
+    float a0, a1, a2, a3, decaymul, releasemul;
+    short *waveform;
+    long wavemask;
+    void (*cellfunc)(void *, float);
+    unsigned char flags, dum0, dum1, dum2;
+} celltype;
+
+//All state of one emulated chip. The wave and KSL tables are shared by all
+//chips, see adlibinittables().
+typedef struct
+{
+    celltype cell[MAXCELLS];
+    unsigned char adlibreg[256], odrumstat;
+    long numspeakers, bytespersample;
+    float recipsamp, nfrqmul[16], ampscale;
+
+    float lvol[9], rvol[9];  //Volume multiplier on left/right speaker
+    long lplc[9], rplc[9];   //Samples to delay on left/right speaker
+
+    long nlvol[9], nrvol[9];
+    long nlplc[9], nrplc[9];
+    long rend;
+    unsigned long noise;     //Drum noise generator, carried across calls
+    long chanmask;           //Channels to generate, the others stand still
+    float *rptr[9], *nrptr[9];
+    float rbuf[9][FIFOSIZ*2];
+    float snd[FIFOSIZ*2];
+} adlibchip;
+
+//Builds the tables all chips share, which are only read afterwards. This
+//isn't thread safe, so CKemuopl calls it from a static initializer, while
+//the library is loaded, before any thread can create a chip. adlibinit()
+//calls it too, for single threaded users.
+void adlibinittables(void);
+void adlibinit(adlibchip *chip,long dasamplerate,long danumspeakers,long dabytespersample);
+void adlib0(adlibchip *chip,long i,long v);
+void adlibgetsample(adlibchip *chip,void *sndptr,long numbytes);
+long adlibactive(adlibchip *chip);
+void adlibsetvolume(adlibchip *chip,int i);
+
+#endif
@@ -21,6 +21,7 @@
 
 #include <cstring>
 #include <string>
+#include <vector>
 #include <binfile.h>
 
 #include "adplug.h"
@@ -73,49 +74,53 @@
 
 /***** CAdPlug *****/
 
+// Bytes at the start of a file that the players get to probe, enough for
+// the signatures furthest into their files
+#define PROBE_SIZE	1088
+
 // List of all players that come with the standard AdPlug distribution
 const CPlayerDesc CAdPlug::allplayers[] = {
-  CPlayerDesc(ChscPlayer::factory, "HSC-Tracker", ".hsc\0"),
-  CPlayerDesc(CsngPlayer::factory, "SNGPlay", ".sng\0"),
-  CPlayerDesc(CimfPlayer::factory, "Apogee IMF", ".imf\0.wlf\0.adlib\0"),
-  CPlayerDesc(Ca2mLoader::factory, "Adlib Tracker 2", ".a2m\0"),
-  CPlayerDesc(CadtrackLoader::factory, "Adlib Tracker", ".sng\0"),
-  CPlayerDesc(CamdLoader::factory, "AMUSIC", ".amd\0"),
-  CPlayerDesc(CbamPlayer::factory, "Bob's Adlib Music", ".bam\0"),
-  CPlayerDesc(CcmfPlayer::factory, "Creative Music File", ".cmf\0"),
-  CPlayerDesc(Cd00Player::factory, "Packed EdLib", ".d00\0"),
-  CPlayerDesc(CdfmLoader::factory, "Digital-FM", ".dfm\0"),
-  CPlayerDesc(ChspLoader::factory, "HSC Packed", ".hsp\0"),
-  CPlayerDesc(CksmPlayer::factory, "Ken Silverman Music", ".ksm\0"),
-  CPlayerDesc(CmadLoader::factory, "Mlat Adlib Tracker", ".mad\0"),
-  CPlayerDesc(CmidPlayer::factory, "MIDI", ".mid\0.sci\0.laa\0"),
-  CPlayerDesc(CmkjPlayer::factory, "MKJamz", ".mkj\0"),
-  CPlayerDesc(CcffLoader::factory, "Boomtracker", ".cff\0"),
-  CPlayerDesc(CdmoLoader::factory, "TwinTeam", ".dmo\0"),
-  CPlayerDesc(Cs3mPlayer::factory, "Scream Tracker 3", ".s3m\0"),
-  CPlayerDesc(CdtmLoader::factory, "DeFy Adlib Tracker", ".dtm\0"),
-  CPlayerDesc(CfmcLoader::factory, "Faust Music Creator", ".sng\0"),
-  CPlayerDesc(CmtkLoader::factory, "MPU-401 Trakker", ".mtk\0"),
-  CPlayerDesc(CradLoader::factory, "Reality Adlib Tracker", ".rad\0"),
-  CPlayerDesc(CrawPlayer::factory, "RdosPlay RAW", ".raw\0"),
-  CPlayerDesc(Csa2Loader::factory, "Surprise! Adlib Tracker", ".sat\0.sa2\0"),
-  CPlayerDesc(CxadbmfPlayer::factory, "BMF Adlib Tracker", ".xad\0"),
-  CPlayerDesc(CxadflashPlayer::factory, "Flash", ".xad\0"),
-  CPlayerDesc(CxadhybridPlayer::factory, "Hybrid", ".xad\0"),
-  CPlayerDesc(CxadhypPlayer::factory, "Hypnosis", ".xad\0"),
-  CPlayerDesc(CxadpsiPlayer::factory, "PSI", ".xad\0"),
-  CPlayerDesc(CxadratPlayer::factory, "rat", ".xad\0"),
-  CPlayerDesc(CldsPlayer::factory, "LOUDNESS Sound System", ".lds\0"),
-  CPlayerDesc(Cu6mPlayer::factory, "Ultima 6 Music", ".m\0"),
-  CPlayerDesc(CrolPlayer::factory, "Adlib Visual Composer", ".rol\0"),
-  CPlayerDesc(CxsmPlayer::factory, "eXtra Simple Music", ".xsm\0"),
-  CPlayerDesc(CdroPlayer::factory, "DOSBox Raw OPL v0.1", ".dro\0"),
-  CPlayerDesc(Cdro2Player::factory, "DOSBox Raw OPL v2.0", ".dro\0"),
-  CPlayerDesc(CmscPlayer::factory, "Adlib MSC Player", ".msc\0"),
-  CPlayerDesc(CrixPlayer::factory, "Softstar RIX OPL Music", ".rix\0"),
-  CPlayerDesc(CadlPlayer::factory, "Westwood ADL", ".adl\0"),
-  CPlayerDesc(CjbmPlayer::factory, "JBM Adlib Music", ".jbm\0"),
-  CPlayerDesc(CgotPlayer::factory, "God of Thunder Music", ".got\0"),
+  CPlayerDesc(ChscPlayer::factory, "HSC-Tracker", ".hsc\0", ChscPlayer::probe),
+  CPlayerDesc(CsngPlayer::factory, "SNGPlay", ".sng\0", CsngPlayer::probe),
+  CPlayerDesc(CimfPlayer::factory, "Apogee IMF", ".imf\0.wlf\0.adlib\0", CimfPlayer::probe),
+  CPlayerDesc(Ca2mLoader::factory, "Adlib Tracker 2", ".a2m\0", Ca2mLoader::probe),
+  CPlayerDesc(CadtrackLoader::factory, "Adlib Tracker", ".sng\0", CadtrackLoader::probe),
+  CPlayerDesc(CamdLoader::factory, "AMUSIC", ".amd\0", CamdLoader::probe),
+  CPlayerDesc(CbamPlayer::factory, "Bob's Adlib Music", ".bam\0", CbamPlayer::probe),
+  CPlayerDesc(CcmfPlayer::factory, "Creative Music File", ".cmf\0", CcmfPlayer::probe),
+  CPlayerDesc(Cd00Player::factory, "Packed EdLib", ".d00\0", Cd00Player::probe),
+  CPlayerDesc(CdfmLoader::factory, "Digital-FM", ".dfm\0", CdfmLoader::probe),
+  CPlayerDesc(ChspLoader::factory, "HSC Packed", ".hsp\0", ChspLoader::probe),
+  CPlayerDesc(CksmPlayer::factory, "Ken Silverman Music", ".ksm\0", CksmPlayer::probe),
+  CPlayerDesc(CmadLoader::factory, "Mlat Adlib Tracker", ".mad\0", CmadLoader::probe),
+  CPlayerDesc(CmidPlayer::factory, "MIDI", ".mid\0.sci\0.laa\0", CmidPlayer::probe),
+  CPlayerDesc(CmkjPlayer::factory, "MKJamz", ".mkj\0", CmkjPlayer::probe),
+  CPlayerDesc(CcffLoader::factory, "Boomtracker", ".cff\0", CcffLoader::probe),
+  CPlayerDesc(CdmoLoader::factory, "TwinTeam", ".dmo\0", CdmoLoader::probe),
+  CPlayerDesc(Cs3mPlayer::factory, "Scream Tracker 3", ".s3m\0", Cs3mPlayer::probe),
+  CPlayerDesc(CdtmLoader::factory, "DeFy Adlib Tracker", ".dtm\0", CdtmLoader::probe),
+  CPlayerDesc(CfmcLoader::factory, "Faust Music Creator", ".sng\0", CfmcLoader::probe),
+  CPlayerDesc(CmtkLoader::factory, "MPU-401 Trakker", ".mtk\0", CmtkLoader::probe),
+  CPlayerDesc(CradLoader::factory, "Reality Adlib Tracker", ".rad\0", CradLoader::probe),
+  CPlayerDesc(CrawPlayer::factory, "RdosPlay RAW", ".raw\0", CrawPlayer::probe),
+  CPlayerDesc(Csa2Loader::factory, "Surprise! Adlib Tracker", ".sat\0.sa2\0", Csa2Loader::probe),
+  CPlayerDesc(CxadbmfPlayer::factory, "BMF Adlib Tracker", ".xad\0", CxadbmfPlayer::probe),
+  CPlayerDesc(CxadflashPlayer::factory, "Flash", ".xad\0", CxadflashPlayer::probe),
+  CPlayerDesc(CxadhybridPlayer::factory, "Hybrid", ".xad\0", CxadhybridPlayer::probe),
+  CPlayerDesc(CxadhypPlayer::factory, "Hypnosis", ".xad\0", CxadhypPlayer::probe),
+  CPlayerDesc(CxadpsiPlayer::factory, "PSI", ".xad\0", CxadpsiPlayer::probe),
+  CPlayerDesc(CxadratPlayer::factory, "rat", ".xad\0", CxadratPlayer::probe),
+  CPlayerDesc(CldsPlayer::factory, "LOUDNESS Sound System", ".lds\0", CldsPlayer::probe),
+  CPlayerDesc(Cu6mPlayer::factory, "Ultima 6 Music", ".m\0", Cu6mPlayer::probe),
+  CPlayerDesc(CrolPlayer::factory, "Adlib Visual Composer", ".rol\0", CrolPlayer::probe),
+  CPlayerDesc(CxsmPlayer::factory, "eXtra Simple Music", ".xsm\0", CxsmPlayer::probe),
+  CPlayerDesc(CdroPlayer::factory, "DOSBox Raw OPL v0.1", ".dro\0", CdroPlayer::probe),
+  CPlayerDesc(Cdro2Player::factory, "DOSBox Raw OPL v2.0", ".dro\0", Cdro2Player::probe),
+  CPlayerDesc(CmscPlayer::factory, "Adlib MSC Player", ".msc\0", CmscPlayer::probe),
+  CPlayerDesc(CrixPlayer::factory, "Softstar RIX OPL Music", ".rix\0", CrixPlayer::probe),
+  CPlayerDesc(CadlPlayer::factory, "Westwood ADL", ".adl\0", CadlPlayer::probe),
+  CPlayerDesc(CjbmPlayer::factory, "JBM Adlib Music", ".jbm\0", CjbmPlayer::probe),
+  CPlayerDesc(CgotPlayer::factory, "God of Thunder Music", ".got\0", CgotPlayer::probe),
   CPlayerDesc()
 };
 
@@ -138,18 +143,47 @@ CPlayer *CAdPlug::factory(const std::string &fn, Copl *opl, const CPlayers &pl,
 {
   CPlayer			*p;
   CPlayers::const_iterator	i;
-  unsigned int			j;
+  unsigned int			j, n, pass;
+  int				score;
+  binistream			*f;
+  unsigned char			head[PROBE_SIZE];
+  unsigned long			len, filesize;
+  std::vector<int>		scores(pl.size());
+  std::vector<bool>		hit(pl.size());
 
   AdPlug_LogWrite("*** CAdPlug::factory(\"%s\",opl,fp) ***\n", fn.c_str());
 
-  // Try a direct hit by file extension
-  for(i = pl.begin(); i != pl.end(); i++)
-    for(j = 0; (*i)->get_extension(j); j++)
-      if(fp.extension(fn, (*i)->get_extension(j))) {
-	AdPlug_LogWrite("Trying direct hit: %s\n", (*i)->filetype.c_str());
+  // Read the start of the file once, for all players to probe
+  if(!(f = fp.open(fn))) {
+    AdPlug_LogWrite("Can't open file!\n");
+    AdPlug_LogWrite("--- CAdPlug::factory ---\n");
+    return 0;
+  }
+  filesize = fp.filesize(f);
+  len = f->readString((char *)head, PROBE_SIZE);
+  fp.close(f);
+
+  for(i = pl.begin(), n = 0; i != pl.end(); i++, n++) {
+    scores[n] = (*i)->probe ? (*i)->probe(fn, head, len, filesize) :
+      CPlayer::PROBE_MAYBE;
+    for(j = 0; (*i)->get_extension(j) && !hit[n]; j++)
+      hit[n] = fp.extension(fn, (*i)->get_extension(j));
+  }
+
+  // Try the direct hits by file extension first, then all other players.
+  // Each time, the players that recognize the file go first, and those
+  // that rule it out aren't tried at all.
+  for(pass = 0; pass < 2; pass++)
+    for(score = CPlayer::PROBE_YES; score > CPlayer::PROBE_NO; score--)
+      for(i = pl.begin(), n = 0; i != pl.end(); i++, n++) {
+	if(hit[n] == (pass != 0) || scores[n] != score) continue;
+
+	AdPlug_LogWrite(pass ? "Trying: %s\n" : "Trying direct hit: %s\n",
+			(*i)->filetype.c_str());
 	if((p = (*i)->factory(opl))) {
 	  if(p->load(fn, fp)) {
 	    AdPlug_LogWrite("got it!\n");
+	    set_key(p, fn, fp);
 	    AdPlug_LogWrite("--- CAdPlug::factory ---\n");
 	    return p;
 	  } else
@@ -157,19 +191,6 @@ CPlayer *CAdPlug::factory(const std::string &fn, Copl *opl, const CPlayers &pl,
 	}
       }
 
-  // Try all players, one by one
-  for(i = pl.begin(); i != pl.end(); i++) {
-    AdPlug_LogWrite("Trying: %s\n", (*i)->filetype.c_str());
-    if((p = (*i)->factory(opl))) {
-      if(p->load(fn, fp)) {
-        AdPlug_LogWrite("got it!\n");
-        AdPlug_LogWrite("--- CAdPlug::factory ---\n");
-	return p;
-      } else
-	delete p;
-    }
-  }
-
   // Unknown file
   AdPlug_LogWrite("End of list!\n");
   AdPlug_LogWrite("--- CAdPlug::factory ---\n");
@@ -181,6 +202,22 @@ void CAdPlug::set_database(CAdPlugDatabase *db)
   database = db;
 }
 
+void CAdPlug::set_key(CPlayer *p, const std::string &fn,
+		      const CFileProvider &fp)
+  /*
+   * Tells player 'p' the database key of file 'fn', so it can find records
+   * about it. Does nothing if there is no database.
+   */
+{
+  binistream *f;
+
+  if(!database || !(f = fp.open(fn))) return;
+
+  p->dbkey = CAdPlugDatabase::CKey(*f);
+  p->keyed = true;
+  fp.close(f);
+}
+
 std::string CAdPlug::get_version()
 {
   return std::string(ADPLUG_VERSION);
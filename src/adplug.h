@@ -50,6 +50,8 @@ private:
   static const CPlayerDesc allplayers[];
 
   static const CPlayers &init_players(const CPlayerDesc pd[]);
+  static void set_key(CPlayer *p, const std::string &fn,
+		      const CFileProvider &fp);
 };
 
 #endif
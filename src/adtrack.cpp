@@ -33,6 +33,7 @@
 #include <string.h>
 
 #include "adtrack.h"
+#include "fcursor.h"
 #include "debug.h"
 
 /*** Public methods ***/
@@ -42,15 +43,26 @@ CPlayer *CadtrackLoader::factory(Copl *newopl)
   return new CadtrackLoader(newopl);
 }
 
-bool CadtrackLoader::load(const std::string &filename, const CFileProvider &fp)
+CPlayer::ProbeScore CadtrackLoader::probe(const std::string &filename,
+					  const unsigned char *head,
+					  unsigned long len,
+					  unsigned long filesize)
+{
+  // the instruments are in a file of their own
+  if(!CFileProvider::extension(filename, ".sng") || filesize != 36000)
+    return PROBE_NO;
+
+  return PROBE_MAYBE;
+}
+
+bool CadtrackLoader::loadfile(const std::string &filename, const CFileProvider &fp)
 {
   binistream *f = fp.open(filename); if(!f) return false;
-  binistream *instf;
+  const CInsts *insts;
   char note[2];
   unsigned short rwp;
   unsigned char chp, octave, pnote = 0;
-  int i,j;
-  AdTrackInst myinst;
+  int i;
 
   // file validation
   if(!fp.extension(filename, ".sng") || fp.filesize(f) != 36000)
@@ -59,10 +71,10 @@ bool CadtrackLoader::load(const std::string &filename, const CFileProvider &fp)
   // check for instruments file
   std::string instfilename(filename, 0, filename.find_last_of('.'));
   instfilename += ".ins";
-  AdPlug_LogWrite("CadtrackLoader::load(,\"%s\"): Checking for \"%s\"...\n",
+  AdPlug_LogWrite("CadtrackLoader::loadfile(,\"%s\"): Checking for \"%s\"...\n",
 		  filename.c_str(), instfilename.c_str());
-  instf = fp.open(instfilename);
-  if(!instf || fp.filesize(instf) != 468) { if(instf) { fp.close(instf); } fp.close(f); return false; }
+  insts = (const CInsts *)fp.resource(instfilename, loadinsts);
+  if(!insts) { fp.close(f); return false; }
 
   // give CmodPlayer a hint on what we're up to
   realloc_patterns(1,1000,9); realloc_instruments(9); realloc_order(1);
@@ -70,25 +82,9 @@ bool CadtrackLoader::load(const std::string &filename, const CFileProvider &fp)
   (*order) = 0; length = 1; restartpos = 0; bpm = 120; initspeed = 3;
 
   // load instruments from instruments file
-  for(i=0;i<9;i++) {
-    for(j=0;j<2;j++) {
-      myinst.op[j].appampmod = instf->readInt(2);
-      myinst.op[j].appvib = instf->readInt(2);
-      myinst.op[j].maintsuslvl = instf->readInt(2);
-      myinst.op[j].keybscale = instf->readInt(2);
-      myinst.op[j].octave = instf->readInt(2);
-      myinst.op[j].freqrisevollvldn = instf->readInt(2);
-      myinst.op[j].softness = instf->readInt(2);
-      myinst.op[j].attack = instf->readInt(2);
-      myinst.op[j].decay = instf->readInt(2);
-      myinst.op[j].release = instf->readInt(2);
-      myinst.op[j].sustain = instf->readInt(2);
-      myinst.op[j].feedback = instf->readInt(2);
-      myinst.op[j].waveform = instf->readInt(2);
-    }
-    convert_instrument(i, &myinst);
-  }
-  fp.close(instf);
+  for(i=0;i<9;i++)
+    convert_instrument(i, &insts->inst[i]);
+  fp.release(insts);
 
   // load file
   for(rwp=0;rwp<1000;rwp++)
@@ -131,7 +127,36 @@ float CadtrackLoader::getrefresh()
 
 /*** Private methods ***/
 
-void CadtrackLoader::convert_instrument(unsigned int n, AdTrackInst *i)
+CFileResource *CadtrackLoader::loadinsts(binistream *f, const CFileProvider &fp)
+{
+  CFileCursor	c(fp, f);
+  CInsts	*insts;
+  int		i, j;
+
+  if(c.filesize() != 468) return 0;
+
+  insts = new CInsts;
+  for(i=0;i<9;i++)
+    for(j=0;j<2;j++) {
+      insts->inst[i].op[j].appampmod = c.u16le();
+      insts->inst[i].op[j].appvib = c.u16le();
+      insts->inst[i].op[j].maintsuslvl = c.u16le();
+      insts->inst[i].op[j].keybscale = c.u16le();
+      insts->inst[i].op[j].octave = c.u16le();
+      insts->inst[i].op[j].freqrisevollvldn = c.u16le();
+      insts->inst[i].op[j].softness = c.u16le();
+      insts->inst[i].op[j].attack = c.u16le();
+      insts->inst[i].op[j].decay = c.u16le();
+      insts->inst[i].op[j].release = c.u16le();
+      insts->inst[i].op[j].sustain = c.u16le();
+      insts->inst[i].op[j].feedback = c.u16le();
+      insts->inst[i].op[j].waveform = c.u16le();
+    }
+
+  return insts;
+}
+
+void CadtrackLoader::convert_instrument(unsigned int n, const AdTrackInst *i)
 {
   // Carrier "Amp Mod / Vib / Env Type / KSR / Multiple" register
   inst[n].data[2] = i->op[Carrier].appampmod ? 1 << 7 : 0;
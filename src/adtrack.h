@@ -25,12 +25,15 @@ class CadtrackLoader: public CmodPlayer
 {
 public:
   static CPlayer *factory(Copl *newopl);
+  static ProbeScore probe(const std::string &filename,
+			  const unsigned char *head,
+			  unsigned long len, unsigned long filesize);
 
 	CadtrackLoader(Copl *newopl)
 		: CmodPlayer(newopl)
 	{ };
 
-	bool load(const std::string &filename, const CFileProvider &fp);
+	bool loadfile(const std::string &filename, const CFileProvider &fp);
 	float getrefresh();
 
 	std::string gettype()
@@ -49,5 +52,15 @@ private:
 	  } op[2];
 	} AdTrackInst;
 
-	void convert_instrument(unsigned int n, AdTrackInst *i);
+	// The instruments of an .ins file, shared by the songs using it
+	class CInsts: public CFileResource
+	{
+	public:
+	  AdTrackInst	inst[9];
+
+	  unsigned long memsize() const { return sizeof(*this); }
+	};
+
+	static CFileResource *loadinsts(binistream *f, const CFileProvider &fp);
+	void convert_instrument(unsigned int n, const AdTrackInst *i);
 };
@@ -22,6 +22,7 @@
 #include <string.h>
 
 #include "amd.h"
+#include "fcursor.h"
 #include "debug.h"
 
 CPlayer *CamdLoader::factory(Copl *newopl)
@@ -29,9 +30,23 @@ CPlayer *CamdLoader::factory(Copl *newopl)
   return new CamdLoader(newopl);
 }
 
-bool CamdLoader::load(const std::string &filename, const CFileProvider &fp)
+CPlayer::ProbeScore CamdLoader::probe(const std::string &filename,
+				      const unsigned char *head,
+				      unsigned long len,
+				      unsigned long filesize)
+{
+  if(filesize < 1072 || len < 1071 ||
+     (memcmp(head + 1062, "<o\xefQU\xeeRoR", 9) &&
+      memcmp(head + 1062, "MaDoKaN96", 9)))
+    return PROBE_NO;
+
+  return PROBE_YES;
+}
+
+bool CamdLoader::loadfile(const std::string &filename, const CFileProvider &fp)
 {
   binistream *f = fp.open(filename); if(!f) return false;
+  CFileCursor c(fp, f);
   struct {
     char id[9];
     unsigned char version;
@@ -48,39 +63,39 @@ bool CamdLoader::load(const std::string &filename, const CFileProvider &fp)
   };
 
   // file validation section
-  if(fp.filesize(f) < 1072) { fp.close(f); return false; }
-  f->seek(1062); f->readString(header.id, 9);
-  header.version = f->readInt(1);
+  if(c.filesize() < 1072) { fp.close(f); return false; }
+  c.seek(1062); c.bytes(header.id, 9);
+  header.version = c.u8();
   if(strncmp(header.id, "<o\xefQU\xeeRoR", 9) &&
      strncmp(header.id, "MaDoKaN96", 9)) { fp.close(f); return false; }
 
   // load section
   memset(inst, 0, sizeof(inst));
-  f->seek(0);
-  f->readString(songname, sizeof(songname));
-  f->readString(author, sizeof(author));
+  c.seek(0);
+  c.bytes(songname, sizeof(songname));
+  c.bytes(author, sizeof(author));
   for(i = 0; i < 26; i++) {
-    f->readString(instname[i], 23);
-    for(j = 0; j < 11; j++) inst[i].data[j] = f->readInt(1);
+    c.bytes(instname[i], 23);
+    for(j = 0; j < 11; j++) inst[i].data[j] = c.u8();
   }
-  length = f->readInt(1); nop = f->readInt(1) + 1;
-  for(i=0;i<128;i++) order[i] = f->readInt(1);
-  f->seek(10, binio::Add);
+  length = c.u8(); nop = c.u8() + 1;
+  for(i=0;i<128;i++) order[i] = c.u8();
+  c.skip(10);
   if(header.version == 0x10) {	// unpacked module
     maxi = nop * 9;
     for(i=0;i<64*9;i++)
       trackord[i/9][i%9] = i+1;
     t = 0;
-    while(!f->ateof()) {
+    while(c.left()) {
       for(j=0;j<64;j++)
 	for(i=t;i<t+9;i++) {
-	  buf = f->readInt(1);
+	  buf = c.u8();
 	  tracks[i][j].param2 = (buf&127) % 10;
 	  tracks[i][j].param1 = (buf&127) / 10;
-	  buf = f->readInt(1);
+	  buf = c.u8();
 	  tracks[i][j].inst = buf >> 4;
 	  tracks[i][j].command = buf & 0x0f;
-	  buf = f->readInt(1);
+	  buf = c.u8();
 	  if(buf >> 4)	// fix bug in AMD save routine
 	    tracks[i][j].note = ((buf & 14) >> 1) * 12 + (buf >> 4);
 	  else
@@ -92,15 +107,15 @@ bool CamdLoader::load(const std::string &filename, const CFileProvider &fp)
   } else {			// packed module
     for(i=0;i<nop;i++)
       for(j=0;j<9;j++)
-	trackord[i][j] = f->readInt(2) + 1;
-    numtrax = f->readInt(2);
+	trackord[i][j] = c.u16le() + 1;
+    numtrax = c.u16le();
     for(k=0;k<numtrax;k++) {
-      i = f->readInt(2);
+      i = c.u16le();
       if(i > 575) i = 575;	// fix corrupted modules
       maxi = (i + 1 > maxi ? i + 1 : maxi);
       j = 0;
       do {
-	buf = f->readInt(1);
+	buf = c.u8();
 	if(buf & 128) {
 	  for(t = j; t < j + (buf & 127) && t < 64; t++) {
 	    tracks[i][t].command = 0;
@@ -114,10 +129,10 @@ bool CamdLoader::load(const std::string &filename, const CFileProvider &fp)
 	}
 	tracks[i][j].param2 = buf % 10;
 	tracks[i][j].param1 = buf / 10;
-	buf = f->readInt(1);
+	buf = c.u8();
 	tracks[i][j].inst = buf >> 4;
 	tracks[i][j].command = buf & 0x0f;
-	buf = f->readInt(1);
+	buf = c.u8();
 	if(buf >> 4)	// fix bug in AMD save routine
 	  tracks[i][j].note = ((buf & 14) >> 1) * 12 + (buf >> 4);
 	else
@@ -25,12 +25,15 @@ class CamdLoader: public CmodPlayer
 {
 public:
   static CPlayer *factory(Copl *newopl);
+  static ProbeScore probe(const std::string &filename,
+			  const unsigned char *head,
+			  unsigned long len, unsigned long filesize);
 
 	CamdLoader(Copl *newopl)
 		: CmodPlayer(newopl)
 	{ };
 
-	bool load(const std::string &filename, const CFileProvider &fp);
+	bool loadfile(const std::string &filename, const CFileProvider &fp);
 	float getrefresh();
 
 	std::string gettype()
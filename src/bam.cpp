@@ -49,6 +49,7 @@
 
 #include <string.h>
 #include "bam.h"
+#include "snapshot.h"
 
 const unsigned short CbamPlayer::freq[] = {172,182,193,205,217,230,243,258,274,
 290,307,326,345,365,387,410,435,460,489,517,547,580,614,651,1369,1389,1411,
@@ -65,7 +66,15 @@ CPlayer *CbamPlayer::factory(Copl *newopl)
   return new CbamPlayer(newopl);
 }
 
-bool CbamPlayer::load(const std::string &filename, const CFileProvider &fp)
+CPlayer::ProbeScore CbamPlayer::probe(const std::string &filename,
+				      const unsigned char *head,
+				      unsigned long len,
+				      unsigned long filesize)
+{
+  return len >= 4 && !memcmp(head, "CBMF", 4) ? PROBE_YES : PROBE_NO;
+}
+
+bool CbamPlayer::loadfile(const std::string &filename, const CFileProvider &fp)
 {
         binistream *f = fp.open(filename); if(!f) return false;
 	char id[4];
@@ -201,3 +210,10 @@ void CbamPlayer::rewind(int subsong)
 	for(i = 0; i < 16; i++) label[i].count = 255;	// 255 = undefined
 	opl->init(); opl->write(1,32);
 }
+
+bool CbamPlayer::snapshot(CSnapshot &s)
+{
+	s.io(del); s.io(pos); s.io(gosub); s.io(songend); s.io(chorus);
+	s.io(label);
+	return true;
+}
@@ -25,6 +25,9 @@ class CbamPlayer: public CPlayer
 {
 public:
   static CPlayer *factory(Copl *newopl);
+  static ProbeScore probe(const std::string &filename,
+			  const unsigned char *head,
+			  unsigned long len, unsigned long filesize);
 
 	CbamPlayer(Copl *newopl)
 		: CPlayer(newopl), song(0)
@@ -32,7 +35,7 @@ public:
 	~CbamPlayer()
 	{ if(song) delete [] song; };
 
-	bool load(const std::string &filename, const CFileProvider &fp);
+	bool loadfile(const std::string &filename, const CFileProvider &fp);
 	bool update();
 	void rewind(int subsong);
 	float getrefresh()
@@ -42,6 +45,8 @@ public:
 	{ return std::string("Bob's Adlib Music"); };
 
 private:
+	bool snapshot(CSnapshot &s);
+
 	static const unsigned short freq[];
 
 	unsigned char	*song, del;
@@ -42,6 +42,7 @@
 
 #include <cstring>
 #include "bmf.h"
+#include "snapshot.h"
 #include "debug.h"
 
 const unsigned char CxadbmfPlayer::bmf_adlib_registers[117] =
@@ -78,6 +79,14 @@ CPlayer *CxadbmfPlayer::factory(Copl *newopl)
   return new CxadbmfPlayer(newopl);
 }
 
+CPlayer::ProbeScore CxadbmfPlayer::probe(const std::string &filename,
+					 const unsigned char *head,
+					 unsigned long len,
+					 unsigned long filesize)
+{
+  return probe_xad(head, len, BMF);
+}
+
 bool CxadbmfPlayer::xadplayer_load()
 {
   unsigned short ptr = 0;
@@ -378,6 +387,13 @@ void CxadbmfPlayer::xadplayer_update()
   }
 }
 
+bool CxadbmfPlayer::xadplayer_snapshot(CSnapshot &s)
+{
+  s.io(bmf.channel);
+  s.io(bmf.active_streams);
+  return true;
+}
+
 float CxadbmfPlayer::xadplayer_getrefresh()
 {
   return bmf.timer;
@@ -25,6 +25,9 @@ class CxadbmfPlayer: public CxadPlayer
 {
 public:
   static CPlayer *factory(Copl *newopl);
+  static ProbeScore probe(const std::string &filename,
+			  const unsigned char *head,
+			  unsigned long len, unsigned long filesize);
 
   CxadbmfPlayer(Copl *newopl): CxadPlayer(newopl)
     { };
@@ -74,6 +77,7 @@ protected:
   bool            xadplayer_load();
   void            xadplayer_rewind(int subsong);
   void            xadplayer_update();
+  bool            xadplayer_snapshot(CSnapshot &s);
   float           xadplayer_getrefresh();
   std::string     xadplayer_gettype();
   std::string     xadplayer_gettitle();
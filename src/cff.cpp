@@ -37,7 +37,18 @@ CPlayer *CcffLoader::factory(Copl *newopl)
   return new CcffLoader(newopl);
 }
 
-bool CcffLoader::load(const std::string &filename, const CFileProvider &fp)
+CPlayer::ProbeScore CcffLoader::probe(const std::string &filename,
+				      const unsigned char *head,
+				      unsigned long len,
+				      unsigned long filesize)
+{
+  if(len < 16 || memcmp(head, "<CUD-FM-File>""\x1A\xDE\xE0", 16))
+    return PROBE_NO;
+
+  return PROBE_YES;
+}
+
+bool CcffLoader::loadfile(const std::string &filename, const CFileProvider &fp)
 {
   binistream *f = fp.open(filename); if(!f) return false;
   const unsigned char conv_inst[11] = { 2,1,10,9,4,3,6,5,0,8,7 };
@@ -26,6 +26,8 @@
 #include <string.h> // for memset
 #include "debug.h"
 #include "cmf.h"
+#include "snapshot.h"
+#include "fcursor.h"
 
 // ------------------------------
 // OPTIONS
@@ -107,12 +109,25 @@ CcmfPlayer::~CcmfPlayer()
 	if (this->pInstruments) delete[] pInstruments;
 }
 
-bool CcmfPlayer::load(const std::string &filename, const CFileProvider &fp)
+CPlayer::ProbeScore CcmfPlayer::probe(const std::string &filename,
+				      const unsigned char *head,
+				      unsigned long len,
+				      unsigned long filesize)
+{
+	if(len < 6 || memcmp(head, "CTMF", 4) ||
+	   (head[4] != 0x00 && head[4] != 0x01) || head[5] != 0x01)
+		return PROBE_NO;
+
+	return PROBE_YES;
+}
+
+bool CcmfPlayer::loadfile(const std::string &filename, const CFileProvider &fp)
 {
   binistream *f = fp.open(filename); if(!f) return false;
+  CFileCursor c(fp, f);
 
 	char cSig[4];
-	f->readString(cSig, 4);
+	c.bytes(cSig, 4);
 	if (
 		(cSig[0] != 'C') ||
 		(cSig[1] != 'T') ||
@@ -123,20 +138,20 @@ bool CcmfPlayer::load(const std::string &filename, const CFileProvider &fp)
 		fp.close(f);
 		return false;
 	}
-	uint16_t iVer = f->readInt(2);
+	uint16_t iVer = c.u16le();
 	if ((iVer != 0x0101) && (iVer != 0x0100)) {
 		AdPlug_LogWrite("CMF file is not v1.0 or v1.1 (reports %d.%d)\n", iVer >> 8 , iVer & 0xFF);
 		fp.close(f);
 		return false;
 	}
 
-	this->cmfHeader.iInstrumentBlockOffset = f->readInt(2);
-	this->cmfHeader.iMusicOffset = f->readInt(2);
-	this->cmfHeader.iTicksPerQuarterNote = f->readInt(2);
-	this->cmfHeader.iTicksPerSecond = f->readInt(2);
-	this->cmfHeader.iTagOffsetTitle = f->readInt(2);
-	this->cmfHeader.iTagOffsetComposer = f->readInt(2);
-	this->cmfHeader.iTagOffsetRemarks = f->readInt(2);
+	this->cmfHeader.iInstrumentBlockOffset = c.u16le();
+	this->cmfHeader.iMusicOffset = c.u16le();
+	this->cmfHeader.iTicksPerQuarterNote = c.u16le();
+	this->cmfHeader.iTicksPerSecond = c.u16le();
+	this->cmfHeader.iTagOffsetTitle = c.u16le();
+	this->cmfHeader.iTagOffsetComposer = c.u16le();
+	this->cmfHeader.iTagOffsetRemarks = c.u16le();
 
 	// This checks will fix crash for a lot of broken files
 	// Title, Composer and Remarks blocks usually located before Instrument block
@@ -148,35 +163,35 @@ bool CcmfPlayer::load(const std::string &filename, const CFileProvider &fp)
 	if (this->cmfHeader.iTagOffsetRemarks >= this->cmfHeader.iInstrumentBlockOffset)
 		this->cmfHeader.iTagOffsetRemarks = 0;
 
-	f->readString((char *)this->cmfHeader.iChannelsInUse, 16);
+	c.bytes(this->cmfHeader.iChannelsInUse, 16);
 	if (iVer == 0x0100) {
-		this->cmfHeader.iNumInstruments = f->readInt(1);
+		this->cmfHeader.iNumInstruments = c.u8();
 		this->cmfHeader.iTempo = 0;
 	} else { // 0x0101
-		this->cmfHeader.iNumInstruments = f->readInt(2);
-		this->cmfHeader.iTempo = f->readInt(2);
+		this->cmfHeader.iNumInstruments = c.u16le();
+		this->cmfHeader.iTempo = c.u16le();
 	}
 
 	// Load the instruments
 
-	f->seek(this->cmfHeader.iInstrumentBlockOffset);
+	c.seek(this->cmfHeader.iInstrumentBlockOffset);
 	this->pInstruments = new SBI[
 		(this->cmfHeader.iNumInstruments < 128) ? 128 : this->cmfHeader.iNumInstruments
 	];  // Always at least 128 available for use
 
 	for (int i = 0; i < this->cmfHeader.iNumInstruments; i++) {
-		this->pInstruments[i].op[0].iCharMult = f->readInt(1);
-		this->pInstruments[i].op[1].iCharMult = f->readInt(1);
-		this->pInstruments[i].op[0].iScalingOutput = f->readInt(1);
-		this->pInstruments[i].op[1].iScalingOutput = f->readInt(1);
-		this->pInstruments[i].op[0].iAttackDecay = f->readInt(1);
-		this->pInstruments[i].op[1].iAttackDecay = f->readInt(1);
-		this->pInstruments[i].op[0].iSustainRelease = f->readInt(1);
-		this->pInstruments[i].op[1].iSustainRelease = f->readInt(1);
-		this->pInstruments[i].op[0].iWaveSel = f->readInt(1);
-		this->pInstruments[i].op[1].iWaveSel = f->readInt(1);
-		this->pInstruments[i].iConnection = f->readInt(1);
-		f->seek(5, binio::Add);  // skip over the padding bytes
+		this->pInstruments[i].op[0].iCharMult = c.u8();
+		this->pInstruments[i].op[1].iCharMult = c.u8();
+		this->pInstruments[i].op[0].iScalingOutput = c.u8();
+		this->pInstruments[i].op[1].iScalingOutput = c.u8();
+		this->pInstruments[i].op[0].iAttackDecay = c.u8();
+		this->pInstruments[i].op[1].iAttackDecay = c.u8();
+		this->pInstruments[i].op[0].iSustainRelease = c.u8();
+		this->pInstruments[i].op[1].iSustainRelease = c.u8();
+		this->pInstruments[i].op[0].iWaveSel = c.u8();
+		this->pInstruments[i].op[1].iWaveSel = c.u8();
+		this->pInstruments[i].iConnection = c.u8();
+		c.skip(5);  // skip over the padding bytes
 	}
 
 	// Set the rest of the instruments to the CMF defaults
@@ -195,23 +210,23 @@ bool CcmfPlayer::load(const std::string &filename, const CFileProvider &fp)
 	}
 
 	if (this->cmfHeader.iTagOffsetTitle) {
-		f->seek(this->cmfHeader.iTagOffsetTitle);
-		this->strTitle = f->readString('\0');
+		c.seek(this->cmfHeader.iTagOffsetTitle);
+		this->strTitle = c.str('\0');
 	}
 	if (this->cmfHeader.iTagOffsetComposer) {
-		f->seek(this->cmfHeader.iTagOffsetComposer);
-		this->strComposer = f->readString('\0');
+		c.seek(this->cmfHeader.iTagOffsetComposer);
+		this->strComposer = c.str('\0');
 	}
 	if (this->cmfHeader.iTagOffsetRemarks) {
-		f->seek(this->cmfHeader.iTagOffsetRemarks);
-		this->strRemarks = f->readString('\0');
+		c.seek(this->cmfHeader.iTagOffsetRemarks);
+		this->strRemarks = c.str('\0');
 	}
 
 	// Load the MIDI data into memory
-  f->seek(this->cmfHeader.iMusicOffset);
-  this->iSongLen = fp.filesize(f) - this->cmfHeader.iMusicOffset;
+  c.seek(this->cmfHeader.iMusicOffset);
+  this->iSongLen = c.filesize() - this->cmfHeader.iMusicOffset;
   this->data = new unsigned char[this->iSongLen];
-  f->readString((char *)data, this->iSongLen);
+  c.bytes(data, this->iSongLen);
 
   fp.close(f);
 	rewind(0);
@@ -403,6 +418,7 @@ void CcmfPlayer::rewind(int subsong)
 	this->bSongEnd = false;
 	this->iPlayPointer = 0;
 	this->iPrevCommand = 0; // just in case
+	this->iNoteCount = 0;
 
 	// Read in the number of ticks until the first event
 	this->iDelayRemaining = this->readMIDINumber();
@@ -432,6 +448,21 @@ void CcmfPlayer::rewind(int subsong)
 	return;
 }
 
+bool CcmfPlayer::snapshot(CSnapshot &s)
+{
+	s.io(this->iPlayPointer);
+	s.io(this->bPercussive);
+	s.io(this->iCurrentRegs);
+	s.io(this->iTranspose);
+	s.io(this->iPrevCommand);
+	s.io(this->iNoteCount);
+	s.io(this->chMIDI);
+	s.io(this->chOPL);
+	s.io(this->iDelayRemaining);
+	s.io(this->bSongEnd);
+	return true;
+}
+
 // Return value: 1 == 1 second, 2 == 0.5 seconds
 float CcmfPlayer::getrefresh()
 {
@@ -84,11 +84,15 @@ class CcmfPlayer: public CPlayer
 
 	public:
 		static CPlayer *factory(Copl *newopl);
+		static ProbeScore probe(const std::string &filename,
+					const unsigned char *head,
+					unsigned long len,
+					unsigned long filesize);
 
 		CcmfPlayer(Copl *newopl);
 		~CcmfPlayer();
 
-		bool load(const std::string &filename, const CFileProvider &fp);
+		bool loadfile(const std::string &filename, const CFileProvider &fp);
 		bool update();
 		void rewind(int subsong);
 		float getrefresh();
@@ -100,6 +104,8 @@ class CcmfPlayer: public CPlayer
 		std::string getdesc();
 
 	protected:
+		bool snapshot(CSnapshot &s);
+
 		uint32_t readMIDINumber();
 		void writeInstrumentSettings(uint8_t iChannel, uint8_t iOperatorSource, uint8_t iOperatorDest, uint8_t iInstrument);
 		void writeOPL(uint8_t iRegister, uint8_t iValue);
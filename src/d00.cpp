@@ -33,6 +33,8 @@
 
 #include "debug.h"
 #include "d00.h"
+#include "fixedopl.h"
+#include "snapshot.h"
 
 #define HIBYTE(val)	(val >> 8)
 #define LOBYTE(val)	(val & 0xff)
@@ -53,7 +55,25 @@ CPlayer *Cd00Player::factory(Copl *newopl)
   return new Cd00Player(newopl);
 }
 
-bool Cd00Player::load(const std::string &filename, const CFileProvider &fp)
+CPlayer::ProbeScore Cd00Player::probe(const std::string &filename,
+				      const unsigned char *head,
+				      unsigned long len,
+				      unsigned long filesize)
+{
+  // version 2-4 header
+  if(len >= 11 && !memcmp(head, "JCH\x26\x02\x66", 6) && !head[6] &&
+     head[9] && !head[10])
+    return PROBE_YES;
+
+  // version 0 or 1 header, only with the .d00 extension
+  if(!CFileProvider::extension(filename, ".d00") || len < 3 || head[0] > 1 ||
+     !head[2])
+    return PROBE_NO;
+
+  return PROBE_MAYBE;
+}
+
+bool Cd00Player::loadfile(const std::string &filename, const CFileProvider &fp)
 {
   binistream	*f = fp.open(filename); if(!f) return false;
   d00header	*checkhead;
@@ -81,7 +101,7 @@ bool Cd00Player::load(const std::string &filename, const CFileProvider &fp)
   } else
     delete checkhead;
 
-  AdPlug_LogWrite("Cd00Player::load(f,\"%s\"): %s format D00 file detected!\n",
+  AdPlug_LogWrite("Cd00Player::loadfile(f,\"%s\"): %s format D00 file detected!\n",
 		  filename.c_str(), ver1 ? "Old" : "New");
 
   // load section
@@ -202,7 +222,7 @@ bool Cd00Player::update()
       if(version == 4)	// v4: hard restart SR
 	if(channel[c].del == inst[channel[c].inst].timer)
 	  if(channel[c].nextnote)
-	    opl->write(0x83 + op_table[c], inst[channel[c].inst].sr);
+	    oplwrite(0x83 + op_table[c], inst[channel[c].inst].sr);
       if(version < 3)
 	channel[c].del--;
       else
@@ -444,10 +464,26 @@ void Cd00Player::rewind(int subsong)
     channel[i].vol = channel[i].cvol;			// initialize volume
   }
   songend = 0;
-  opl->init(); opl->write(1,32);	// reset OPL chip
+  opl->init(); oplwrite(1,32);	// reset OPL chip
   cursubsong = subsong;
 }
 
+bool Cd00Player::snapshot(CSnapshot &s)
+{
+  int i;
+
+  for(i=0;i<9;i++) {
+    unsigned short *order = channel[i].order;
+
+    channel[i].order = 0;	// stored separately as an offset
+    s.io(channel[i]);
+    channel[i].order = order;
+    s.ptr(channel[i].order, filedata);
+  }
+  s.io(songend); s.io(cursubsong);
+  return true;
+}
+
 std::string Cd00Player::gettype()
 {
   char	tmpstr[40];
@@ -479,13 +515,13 @@ void Cd00Player::setvolume(unsigned char chan)
   unsigned char	op = op_table[chan];
   unsigned short	insnr = channel[chan].inst;
 
-  opl->write(0x43 + op,(int)(63-((63-(inst[insnr].data[2] & 63))/63.0)*(63-channel[chan].vol)) +
+  oplwrite(0x43 + op,(int)(63-((63-(inst[insnr].data[2] & 63))/63.0)*(63-channel[chan].vol)) +
 	     (inst[insnr].data[2] & 192));
   if(inst[insnr].data[10] & 1)
-    opl->write(0x40 + op,(int)(63-((63-channel[chan].modvol)/63.0)*(63-channel[chan].vol)) +
+    oplwrite(0x40 + op,(int)(63-((63-channel[chan].modvol)/63.0)*(63-channel[chan].vol)) +
 	       (inst[insnr].data[7] & 192));
   else
-    opl->write(0x40 + op,channel[chan].modvol + (inst[insnr].data[7] & 192));
+    oplwrite(0x40 + op,channel[chan].modvol + (inst[insnr].data[7] & 192));
 }
 
 void Cd00Player::setfreq(unsigned char chan)
@@ -496,11 +532,11 @@ void Cd00Player::setfreq(unsigned char chan)
     freq += inst[channel[chan].inst].tunelev;
 
   freq += channel[chan].slideval;
-  opl->write(0xa0 + chan, freq & 255);
+  oplwrite(0xa0 + chan, freq & 255);
   if(channel[chan].key)
-    opl->write(0xb0 + chan, ((freq >> 8) & 31) | 32);
+    oplwrite(0xb0 + chan, ((freq >> 8) & 31) | 32);
   else
-    opl->write(0xb0 + chan, (freq >> 8) & 31);
+    oplwrite(0xb0 + chan, (freq >> 8) & 31);
 }
 
 void Cd00Player::setinst(unsigned char chan)
@@ -509,24 +545,24 @@ void Cd00Player::setinst(unsigned char chan)
   unsigned short	insnr = channel[chan].inst;
 
   // set instrument data
-  opl->write(0x63 + op, inst[insnr].data[0]);
-  opl->write(0x83 + op, inst[insnr].data[1]);
-  opl->write(0x23 + op, inst[insnr].data[3]);
-  opl->write(0xe3 + op, inst[insnr].data[4]);
-  opl->write(0x60 + op, inst[insnr].data[5]);
-  opl->write(0x80 + op, inst[insnr].data[6]);
-  opl->write(0x20 + op, inst[insnr].data[8]);
-  opl->write(0xe0 + op, inst[insnr].data[9]);
+  oplwrite(0x63 + op, inst[insnr].data[0]);
+  oplwrite(0x83 + op, inst[insnr].data[1]);
+  oplwrite(0x23 + op, inst[insnr].data[3]);
+  oplwrite(0xe3 + op, inst[insnr].data[4]);
+  oplwrite(0x60 + op, inst[insnr].data[5]);
+  oplwrite(0x80 + op, inst[insnr].data[6]);
+  oplwrite(0x20 + op, inst[insnr].data[8]);
+  oplwrite(0xe0 + op, inst[insnr].data[9]);
   if(version)
-    opl->write(0xc0 + chan, inst[insnr].data[10]);
+    oplwrite(0xc0 + chan, inst[insnr].data[10]);
   else
-    opl->write(0xc0 + chan, (inst[insnr].data[10] << 1) + (inst[insnr].tunelev & 1));
+    oplwrite(0xc0 + chan, (inst[insnr].data[10] << 1) + (inst[insnr].tunelev & 1));
 }
 
 void Cd00Player::playnote(unsigned char chan)
 {
   // set misc vars & play
-  opl->write(0xb0 + chan, 0);	// stop old note
+  oplwrite(0xb0 + chan, 0);	// stop old note
   setinst(chan);
   channel[chan].key = 1;
   setfreq(chan);
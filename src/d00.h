@@ -28,6 +28,9 @@ class Cd00Player: public CPlayer
 {
  public:
   static CPlayer *factory(Copl *newopl);
+  static ProbeScore probe(const std::string &filename,
+			  const unsigned char *head,
+			  unsigned long len, unsigned long filesize);
 
   Cd00Player(Copl *newopl)
     : CPlayer(newopl), filedata(0)
@@ -35,7 +38,7 @@ class Cd00Player: public CPlayer
   ~Cd00Player()
     { if(filedata) delete [] filedata; };
 
-  bool load(const std::string &filename, const CFileProvider &fp);
+  bool loadfile(const std::string &filename, const CFileProvider &fp);
   bool update();
   void rewind(int subsong);
   float getrefresh();
@@ -48,8 +51,12 @@ class Cd00Player: public CPlayer
   std::string getdesc()
     { if(*datainfo) return std::string(datainfo); else return std::string(); };
   unsigned int getsubsongs();
+  unsigned int getsubsong()
+    { return cursubsong; };
 
  protected:
+  bool snapshot(CSnapshot &s);
+
 #pragma pack(1)
   struct d00header {
     char id[6];
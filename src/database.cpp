@@ -250,6 +250,7 @@ CAdPlugDatabase::CRecord *CAdPlugDatabase::CRecord::factory(RecordType type)
   case Plain: return new CPlainRecord;
   case SongInfo: return new CInfoRecord;
   case ClockSpeed: return new CClockRecord;
+  case SongLength: return new CLengthRecord;
   default: return 0;
   }
 }
@@ -298,6 +299,7 @@ bool CAdPlugDatabase::CRecord::user_write(std::ostream &out)
   case Plain: out << "Plain"; break;
   case SongInfo: out << "SongInfo"; break;
   case ClockSpeed: out << "ClockSpeed"; break;
+  case SongLength: out << "SongLength"; break;
   default: out << "*** Unknown ***"; break;
   }
   out << std::endl;
@@ -425,3 +427,90 @@ bool CClockRecord::user_write_own(std::ostream &out)
   out << "Clock speed: " << clock << " Hz" << std::endl;
   return true;
 }
+
+/***** CLengthRecord *****/
+
+const unsigned long CLengthRecord::unknown = 0xffffffffUL;
+
+CLengthRecord::CLengthRecord()
+{
+  type = SongLength;
+}
+
+bool CLengthRecord::get(unsigned int subsong, Subsong &len)
+{
+  if(subsong >= subsongs.size() || subsongs[subsong].length == unknown)
+    return false;
+
+  len = subsongs[subsong];
+  return true;
+}
+
+void CLengthRecord::set(unsigned int subsong, const Subsong &len)
+{
+  if(subsong >= subsongs.size()) {
+    Subsong none = { unknown, unknown, unknown };
+
+    subsongs.resize(subsong + 1, none);
+  }
+
+  subsongs[subsong] = len;
+}
+
+void CLengthRecord::read_own(binistream &in)
+{
+  unsigned long n = in.readInt(2);
+
+  subsongs.resize(n);
+  for(unsigned long i = 0; i < n; i++) {
+    subsongs[i].length = in.readInt(4);
+    subsongs[i].loopstart = in.readInt(4);
+    subsongs[i].loopend = in.readInt(4);
+  }
+}
+
+void CLengthRecord::write_own(binostream &out)
+{
+  out.writeInt(subsongs.size(), 2);
+  for(unsigned long i = 0; i < subsongs.size(); i++) {
+    out.writeInt(subsongs[i].length, 4);
+    out.writeInt(subsongs[i].loopstart, 4);
+    out.writeInt(subsongs[i].loopend, 4);
+  }
+}
+
+unsigned long CLengthRecord::get_size()
+{
+  return 2 + subsongs.size() * 12;
+}
+
+bool CLengthRecord::user_read_own(std::istream &in, std::ostream &out)
+{
+  unsigned long n;
+
+  out << "Subsongs: "; in >> n;
+  subsongs.resize(n);
+  for(unsigned long i = 0; i < n; i++) {
+    out << "Subsong " << i << " length (ms): "; in >> subsongs[i].length;
+    out << "Subsong " << i << " loop start (ms): "; in >> subsongs[i].loopstart;
+    out << "Subsong " << i << " loop end (ms): "; in >> subsongs[i].loopend;
+  }
+  return !in.fail();
+}
+
+bool CLengthRecord::user_write_own(std::ostream &out)
+{
+  for(unsigned long i = 0; i < subsongs.size(); i++) {
+    out << "Subsong " << i << ": ";
+    if(subsongs[i].length == unknown) {
+      out << "unknown" << std::endl;
+      continue;
+    }
+    out << subsongs[i].length << " ms";
+    if(subsongs[i].loopstart != subsongs[i].loopend)
+      out << ", loops from " << subsongs[i].loopstart << " to "
+	  << subsongs[i].loopend << " ms";
+    out << std::endl;
+  }
+  return true;
+}
@@ -26,6 +26,7 @@
 
 #include <iostream>
 #include <string>
+#include <vector>
 #include <binio.h>
 
 class CAdPlugDatabase
@@ -49,7 +50,7 @@ public:
   class CRecord
   {
   public:
-    typedef enum { Plain, SongInfo, ClockSpeed } RecordType;
+    typedef enum { Plain, SongInfo, ClockSpeed, SongLength } RecordType;
 
     RecordType	type;
     CKey	key;
@@ -166,4 +167,28 @@ protected:
   virtual bool user_write_own(std::ostream &out);
 };
 
+class CLengthRecord: public CAdPlugDatabase::CRecord
+{
+public:
+  static const unsigned long unknown;	// length not measured yet
+
+  struct Subsong {
+    unsigned long	length, loopstart, loopend;	// in ms
+  };
+
+  std::vector<Subsong>	subsongs;
+
+  CLengthRecord();
+
+  bool get(unsigned int subsong, Subsong &len);
+  void set(unsigned int subsong, const Subsong &len);
+
+protected:
+  virtual void read_own(binistream &in);
+  virtual void write_own(binostream &out);
+  virtual unsigned long get_size();
+  virtual bool user_read_own(std::istream &in, std::ostream &out);
+  virtual bool user_write_own(std::ostream &out);
+};
+
 #endif
@@ -30,7 +30,18 @@ CPlayer *CdfmLoader::factory(Copl *newopl)
   return new CdfmLoader(newopl);
 }
 
-bool CdfmLoader::load(const std::string &filename, const CFileProvider &fp)
+CPlayer::ProbeScore CdfmLoader::probe(const std::string &filename,
+				      const unsigned char *head,
+				      unsigned long len,
+				      unsigned long filesize)
+{
+  if(len < 5 || memcmp(head, "DFM\x1a", 4) || head[4] > 1)
+    return PROBE_NO;
+
+  return PROBE_YES;
+}
+
+bool CdfmLoader::loadfile(const std::string &filename, const CFileProvider &fp)
 {
   binistream *f = fp.open(filename); if(!f) return false;
   unsigned char		npats,n,note,fx,c,r,param;
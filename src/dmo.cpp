@@ -49,7 +49,22 @@ CPlayer *CdmoLoader::factory(Copl *newopl)
   return new CdmoLoader(newopl);
 }
 
-bool CdmoLoader::load(const std::string &filename, const CFileProvider &fp)
+CPlayer::ProbeScore CdmoLoader::probe(const std::string &filename,
+				      const unsigned char *head,
+				      unsigned long len,
+				      unsigned long filesize)
+{
+  dmo_unpacker	unpacker;
+  unsigned char	chkhdr[16];
+
+  if(!CFileProvider::extension(filename, ".dmo") || len < 16)
+    return PROBE_NO;
+
+  memcpy(chkhdr, head, 16);
+  return unpacker.decrypt(chkhdr, 16) ? PROBE_YES : PROBE_NO;
+}
+
+bool CdmoLoader::loadfile(const std::string &filename, const CFileProvider &fp)
 {
   int i,j;
   binistream *f;
@@ -25,10 +25,13 @@ class CdmoLoader: public Cs3mPlayer
 {
  public:
   static CPlayer *factory(Copl *newopl);
+  static ProbeScore probe(const std::string &filename,
+			  const unsigned char *head,
+			  unsigned long len, unsigned long filesize);
 
   CdmoLoader(Copl *newopl) : Cs3mPlayer(newopl) { };
 
-  bool	load(const std::string &filename, const CFileProvider &fp);
+  bool	loadfile(const std::string &filename, const CFileProvider &fp);
 
   std::string	gettype();
   std::string	getauthor();
@@ -31,6 +31,8 @@
 #include <stdio.h>
 
 #include "dro.h"
+#include "snapshot.h"
+#include "fcursor.h"
 
 CPlayer *CdroPlayer::factory(Copl *newopl)
 {
@@ -48,25 +50,38 @@ CdroPlayer::~CdroPlayer()
 	if (this->data) delete[] this->data;
 }
 
-bool CdroPlayer::load(const std::string &filename, const CFileProvider &fp)
+CPlayer::ProbeScore CdroPlayer::probe(const std::string &filename,
+				      const unsigned char *head,
+				      unsigned long len,
+				      unsigned long filesize)
+{
+	if(len < 12 || memcmp(head, "DBRAWOPL", 8) || head[8] || head[9] ||
+	   head[10] != 1 || head[11])
+		return PROBE_NO;
+
+	return PROBE_YES;
+}
+
+bool CdroPlayer::loadfile(const std::string &filename, const CFileProvider &fp)
 {
 	binistream *f = fp.open(filename);
 	if (!f) return false;
+	CFileCursor c(fp, f);
 
 	char id[8];
-	f->readString(id, 8);
+	c.bytes(id, 8);
 	if (strncmp(id, "DBRAWOPL", 8)) {
 		fp.close(f);
 		return false;
 	}
-	int version = f->readInt(4);
+	int version = c.u32le();
 	if (version != 0x10000) {
 		fp.close(f);
 		return false;
 	}
 
-	f->ignore(4);	// Length in milliseconds
-	this->iLength = f->readInt(4); // stored in file as number of bytes
+	c.skip(4);	// Length in milliseconds
+	this->iLength = c.u32le(); // stored in file as number of bytes
 
 	this->data = new uint8_t[this->iLength];
 
@@ -74,9 +89,9 @@ bool CdroPlayer::load(const std::string &filename, const CFileProvider &fp)
 	// Some early .DRO files only used one byte for the hardware type, then
   	// later changed to four bytes with no version number change.
 	// OPL type (0 == OPL2, 1 == OPL3, 2 == Dual OPL2)
-	f->ignore(1);	// Type of opl data this can contain - ignored
+	c.skip(1);	// Type of opl data this can contain - ignored
 	for (i = 0; i < 3; i++) {
-  		data[i]=f->readInt(1);
+  		data[i]=c.u8();
 	}
 
 	if ((data[0] == 0) || (data[1] == 0) || (data[2] == 0)) {
@@ -86,9 +101,7 @@ bool CdroPlayer::load(const std::string &filename, const CFileProvider &fp)
 	}
 
 	// Read the OPL data.
-	for (; i < this->iLength; i++) {
-		data[i]=f->readInt(1);
-	}
+	if (i < this->iLength) c.bytes(data + i, this->iLength - i);
 
 	fp.close(f);
 	rewind(0);
@@ -158,6 +171,13 @@ void CdroPlayer::rewind(int subsong)
 	opl->setchip(0);
 }
 
+bool CdroPlayer::snapshot(CSnapshot &s)
+{
+	s.io(this->iPos);
+	s.io(this->iDelay);
+	return true;
+}
+
 float CdroPlayer::getrefresh()
 {
 	if (this->iDelay > 0) return 1000.0 / this->iDelay;
@@ -28,6 +28,8 @@
 class CdroPlayer: public CPlayer
 {
 	protected:
+		bool snapshot(CSnapshot &s);
+
 		static const uint8_t iCmdDelayS = 0x00; // Wraithverge: fixed this with "static".
 		static const uint8_t iCmdDelayL = 0x01; // Wraithverge: fixed this with "static".
 		int iConvTableLen;
@@ -41,11 +43,15 @@ class CdroPlayer: public CPlayer
 
 	public:
 		static CPlayer *factory(Copl *newopl);
+		static ProbeScore probe(const std::string &filename,
+					const unsigned char *head,
+					unsigned long len,
+					unsigned long filesize);
 
 		CdroPlayer(Copl *newopl);
 		~CdroPlayer();
 
-		bool load(const std::string &filename, const CFileProvider &fp);
+		bool loadfile(const std::string &filename, const CFileProvider &fp);
 		bool update();
 		void rewind(int subsong);
 		float getrefresh();
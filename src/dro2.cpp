@@ -23,6 +23,7 @@
 #include <stdio.h>
 
 #include "dro2.h"
+#include "snapshot.h"
 
 CPlayer *Cdro2Player::factory(Copl *newopl)
 {
@@ -32,17 +33,33 @@ CPlayer *Cdro2Player::factory(Copl *newopl)
 Cdro2Player::Cdro2Player(Copl *newopl) :
 	CPlayer(newopl),
 	piConvTable(NULL),
-	data(0)
+	data(0),
+	databuf(0),
+	datafp(0)
 {
 }
 
 Cdro2Player::~Cdro2Player()
 {
-	if (this->data) delete[] this->data;
+	delete[] this->databuf;
+	if (this->datafp) this->datafp->unview(this->data);
 	if (this->piConvTable) delete[] this->piConvTable;
 }
 
-bool Cdro2Player::load(const std::string &filename, const CFileProvider &fp)
+CPlayer::ProbeScore Cdro2Player::probe(const std::string &filename,
+				       const unsigned char *head,
+				       unsigned long len,
+				       unsigned long filesize)
+{
+	// version 2.0, uncompressed data in the only format there is
+	if(len < 23 || memcmp(head, "DBRAWOPL", 8) || head[8] != 2 || head[9] ||
+	   head[10] || head[11] || head[21] || head[22])
+		return PROBE_NO;
+
+	return PROBE_YES;
+}
+
+bool Cdro2Player::loadfile(const std::string &filename, const CFileProvider &fp)
 {
 	binistream *f = fp.open(filename);
 	if (!f) return false;
@@ -79,8 +96,12 @@ bool Cdro2Player::load(const std::string &filename, const CFileProvider &fp)
 	this->piConvTable = new uint8_t[this->iConvTableLen];
 	f->readString((char *)this->piConvTable, this->iConvTableLen);
 
-	this->data = new uint8_t[this->iLength];
-	f->readString((char *)this->data, this->iLength);
+	unsigned long size = this->iLength;
+	delete[] this->databuf;
+	if (this->datafp) this->datafp->unview(this->data);
+	this->data = fp.contents(f, size, this->databuf);
+	this->datafp = this->databuf ? 0 : &fp;
+	this->iLength = size;	// no further than the file goes
 
 	fp.close(f);
 	rewind(0);
@@ -135,6 +156,13 @@ void Cdro2Player::rewind(int subsong)
   opl->init(); 
 }
 
+bool Cdro2Player::snapshot(CSnapshot &s)
+{
+	s.io(this->iPos);
+	s.io(this->iDelay);
+	return true;
+}
+
 float Cdro2Player::getrefresh()
 {
 	if (this->iDelay > 0) return 1000.0 / this->iDelay;
@@ -25,11 +25,15 @@
 class Cdro2Player: public CPlayer
 {
 	protected:
+		bool snapshot(CSnapshot &s);
+
 		uint8_t iCmdDelayS, iCmdDelayL;
 		int iConvTableLen;
 		uint8_t *piConvTable;
 
-		uint8_t *data;
+		const uint8_t *data;
+		uint8_t *databuf;	// data, unless the file provider keeps it
+		const CFileProvider *datafp;	// keeps it, to unview() it
 		int iLength;
 		int iPos;
 		int iDelay;
@@ -37,11 +41,15 @@ class Cdro2Player: public CPlayer
 
 	public:
 		static CPlayer *factory(Copl *newopl);
+		static ProbeScore probe(const std::string &filename,
+					const unsigned char *head,
+					unsigned long len,
+					unsigned long filesize);
 
 		Cdro2Player(Copl *newopl);
 		~Cdro2Player();
 
-		bool load(const std::string &filename, const CFileProvider &fp);
+		bool loadfile(const std::string &filename, const CFileProvider &fp);
 		bool update();
 		void rewind(int subsong);
 		float getrefresh();
@@ -24,6 +24,7 @@
 
 #include <cstring>
 #include "dtm.h"
+#include "fcursor.h"
 
 /* -------- Public Methods -------------------------------- */
 
@@ -32,18 +33,30 @@ CPlayer *CdtmLoader::factory(Copl *newopl)
   return new CdtmLoader(newopl);
 }
 
-bool CdtmLoader::load(const std::string &filename, const CFileProvider &fp)
+CPlayer::ProbeScore CdtmLoader::probe(const std::string &filename,
+				      const unsigned char *head,
+				      unsigned long len,
+				      unsigned long filesize)
+{
+  if(len < 13 || memcmp(head, "DeFy DTM ", 9) || head[12] != 0x10)
+    return PROBE_NO;
+
+  return PROBE_YES;
+}
+
+bool CdtmLoader::loadfile(const std::string &filename, const CFileProvider &fp)
 {
   binistream *f = fp.open(filename); if(!f) return false;
+  CFileCursor c(fp, f);
   const unsigned char conv_inst[11] = { 2,1,10,9,4,3,6,5,0,8,7 };
   const unsigned short conv_note[12] = { 0x16B, 0x181, 0x198, 0x1B0, 0x1CA, 0x1E5, 0x202, 0x220, 0x241, 0x263, 0x287, 0x2AE };
   int i,j,k,t=0;
 
   // read header
-  f->readString(header.id, 12);
-  header.version = f->readInt(1);
-  f->readString(header.title, 20); f->readString(header.author, 20);
-  header.numpat = f->readInt(1); header.numinst = f->readInt(1);
+  c.bytes(header.id, 12);
+  header.version = c.u8();
+  c.bytes(header.title, 20); c.bytes(header.author, 20);
+  header.numpat = c.u8(); header.numinst = c.u8();
 
   // signature exists ? good version ?
   if(memcmp(header.id,"DeFy DTM ",9) || header.version != 0x10)
@@ -59,7 +72,7 @@ bool CdtmLoader::load(const std::string &filename, const CFileProvider &fp)
   for (i=0;i<16;i++)
     {
       // get line length
-      unsigned char bufstr_length = f->readInt(1);
+      unsigned char bufstr_length = c.u8();
 
       if(bufstr_length > 80) {
 	fp.close(f);
@@ -69,7 +82,7 @@ bool CdtmLoader::load(const std::string &filename, const CFileProvider &fp)
       // read line
       if (bufstr_length)
 	{
-	  f->readString(bufstr,bufstr_length);
+	  c.bytes(bufstr, bufstr_length);
 
 	  for (j=0;j<bufstr_length;j++)
 	    if (!bufstr[j])
@@ -93,22 +106,22 @@ bool CdtmLoader::load(const std::string &filename, const CFileProvider &fp)
   // load instruments
   for (i=0;i<header.numinst;i++)
     {
-      unsigned char name_length = f->readInt(1);
+      unsigned char name_length = c.u8();
 
       if (name_length)
-	f->readString(instruments[i].name, name_length);
+	c.bytes(instruments[i].name, name_length);
 
       instruments[i].name[name_length] = 0;
 
       for(j = 0; j < 12; j++)
-	instruments[i].data[j] = f->readInt(1);
+	instruments[i].data[j] = c.u8();
 
       for (j=0;j<11;j++)
 	inst[i].data[conv_inst[j]] = instruments[i].data[j];
     }
 
   // load order
-  for(i = 0; i < 100; i++) order[i] = f->readInt(1);
+  for(i = 0; i < 100; i++) order[i] = c.u8();
 
   nop = header.numpat;
 
@@ -119,12 +132,12 @@ bool CdtmLoader::load(const std::string &filename, const CFileProvider &fp)
     {
       unsigned short packed_length;
 
-      packed_length = f->readInt(2);
+      packed_length = c.u16le();
 
       unsigned char *packed_pattern = new unsigned char [packed_length];
 
       for(j = 0; j < packed_length; j++)
-	packed_pattern[j] = f->readInt(1);
+	packed_pattern[j] = c.u8();
 
       long unpacked_length = unpack_pattern(packed_pattern,packed_length,pattern,0x480);
 
@@ -25,10 +25,13 @@ class CdtmLoader: public CmodPlayer
 {
  public:
   static CPlayer *factory(Copl *newopl);
+  static ProbeScore probe(const std::string &filename,
+			  const unsigned char *head,
+			  unsigned long len, unsigned long filesize);
 
   CdtmLoader(Copl *newopl) : CmodPlayer(newopl) { };
 
-  bool	load(const std::string &filename, const CFileProvider &fp);
+  bool	loadfile(const std::string &filename, const CFileProvider &fp);
   void	rewind(int subsong);
   float	getrefresh();
 
@@ -19,10 +19,32 @@
  * emuopl.cpp - Emulated OPL, by Simon Peter <dn.tlp@gmx.net>
  */
 
+#include <cstring>
 #include "emuopl.h"
+#include "sampleconv.h"
+
+// Samples rendered in one go
+#define CHUNK	512
+
+// Builds fmopl's shared tables at load time, see OPLInitTable() in fmopl.h
+static struct CEmuoplTables {
+  CEmuoplTables() { OPLInitTable(); }
+} tables;
+
+// Size of one chip's state block, as allocated by OPLCreate()
+#define CHIP_STATE_SIZE(chip)	(sizeof(FM_OPL) + sizeof(OPL_CH) * (chip)->max_ch)
+
+// Moves a pointer into the chip state block at 'from' over to the block at 'to'
+template <class T> static void relocate(T *&p, const FM_OPL *from, FM_OPL *to)
+{
+  const char *cp = (const char *)p, *cfrom = (const char *)from;
+
+  if(cp >= cfrom && cp < cfrom + CHIP_STATE_SIZE(to))
+    p = (T *)((char *)to + (cp - cfrom));
+}
 
 CEmuopl::CEmuopl(int rate, bool bit16, bool usestereo)
-  : use16bit(bit16), stereo(usestereo), mixbufSamples(0)
+  : use16bit(bit16), stereo(usestereo)
 {
   opl[0] = OPLCreate(OPL_TYPE_YM3812, 3579545, rate);
   opl[1] = OPLCreate(OPL_TYPE_YM3812, 3579545, rate);
@@ -35,91 +57,53 @@ CEmuopl::CEmuopl(int rate, bool bit16, bool usestereo)
 CEmuopl::~CEmuopl()
 {
   OPLDestroy(opl[0]); OPLDestroy(opl[1]);
-
-  if(mixbufSamples) {
-    delete [] mixbuf0;
-    delete [] mixbuf1;
-  }
 }
 
 void CEmuopl::update(short *buf, int samples)
 {
-  int i;
-
-  //ensure that our mix buffers are adequately sized
-  if(mixbufSamples < samples) {
-    if(mixbufSamples) { delete[] mixbuf0; delete[] mixbuf1; }
-    mixbufSamples = samples;
-
-    //*2 = make room for stereo, if we need it
-    mixbuf0 = new short[samples*2]; 
-    mixbuf1 = new short[samples*2];
+  Format	fmt = { S16, stereo, false, false };
+  short		mixbuf[CHUNK * 2];
+  void		*bufs[1] = { buf };
+  char		*out = (char *)buf;
+  int		i, n;
+
+  //16bit output is rendered straight into "buf"
+  if(use16bit) {
+    updatefmt(bufs, samples, fmt);
+    return;
   }
 
-  //data should be rendered to outbuf
-  //tempbuf should be used as a temporary buffer
-  //if we are supposed to generate 16bit output,
-  //then outbuf may point directly to the actual waveform output "buf"
-  //if we are supposed to generate 8bit output,
-  //then outbuf cannot point to "buf" (because there will not be enough room)
-  //and so it must point to a mixbuf instead--
-  //it will be reduced to 8bit and put in "buf" later
-  short *outbuf;
-  short *tempbuf=mixbuf0;
-  short *tempbuf2=mixbuf1;
-  if(use16bit) outbuf = buf;
-  else outbuf = mixbuf1;
-  //...there is a potentially confusing situation where mixbuf1 can be aliased.
-  //beware. it is a little loony.
-
-  //all of the following rendering code produces 16bit output
-
-  switch(currType) {
-  case TYPE_OPL2:
-    //for opl2 mode:
-    //render chip0 to the output buffer
-    YM3812UpdateOne(opl[0],outbuf,samples);
-
-    //if we are supposed to output stereo,
-    //then we need to dup the mono channel
-    if(stereo)
-      for(i=samples-1;i>=0;i--) {
-	outbuf[i*2] = outbuf[i];
-	outbuf[i*2+1] = outbuf[i];
-      }
-    break;
-
-  case TYPE_OPL3:	// unsupported
-    break;
+  //8bit output goes through a 16bit buffer, one chunk at a time
+  bufs[0] = mixbuf;
+  for(; samples > 0; samples -= n) {
+    n = samples < CHUNK ? samples : CHUNK;
+    if(!updatefmt(bufs, n, fmt)) return;
+    for(i = 0; i < (stereo ? n * 2 : n); i++)
+      *out++ = (mixbuf[i] >> 8) ^ 0x80;
+  }
+}
 
-  case TYPE_DUAL_OPL2:
-    //for dual opl2 mode:
-    //render each chip to a different tempbuffer
-    YM3812UpdateOne(opl[0],tempbuf2,samples);
-    YM3812UpdateOne(opl[1],tempbuf,samples);
-
-    //output stereo:
-    //then we need to interleave the two buffers
-    if(stereo){
-      //first, spread tempbuf's samples across left channel
-      //left channel
-      for(i=0;i<samples;i++)
-	outbuf[i*2] = tempbuf2[i];
-      //next, insert the samples from tempbuf2 into right channel
-      for(i=0;i<samples;i++)
-	outbuf[i*2+1] = tempbuf[i];
+bool CEmuopl::updatefmt(void **bufs, int samples, const Format &fmt)
+{
+  short		left[CHUNK], right[CHUNK];
+  unsigned long	done, n;
+
+  if(currType == TYPE_OPL3)	// unsupported
+    return false;
+
+  //render each chip into a channel of its own, dual opl2 in stereo,
+  //opl2 on both channels
+  for(done = 0; done < (unsigned long)samples; done += n) {
+    n = dequeue(samples - done < CHUNK ? samples - done : CHUNK);
+    YM3812UpdateOne(opl[0], left, n);
+    if(currType == TYPE_DUAL_OPL2) {
+      YM3812UpdateOne(opl[1], right, n);
+      sampleconv(left, right, 1, bufs, done, n, fmt);
     } else
-      //output mono:
-      //then we need to mix the two buffers into buf
-      for(i=0;i<samples;i++)
-	outbuf[i] = (tempbuf[i]>>1) + (tempbuf2[i]>>1);
-    break;
+      sampleconv(left, left, 1, bufs, done, n, fmt);
   }
 
-  //now reduce to 8bit if we need to
-  if(!use16bit)
-    for(i=0;i<(stereo ? samples*2 : samples);i++)
-      ((char *)buf)[i] = (outbuf[i] >> 8) ^ 0x80;
+  return true;
 }
 
 void CEmuopl::write(int reg, int val)
@@ -135,13 +119,96 @@ void CEmuopl::write(int reg, int val)
   }
 }
 
+void CEmuopl::write_batch(const RegWrite *w, size_t n)
+{
+  if(currType == TYPE_OPL3)	// unsupported
+    return;
+
+  for(size_t i = 0; i < n; i++) {
+    OPLWrite(opl[w[i].chip], 0, w[i].reg);
+    OPLWrite(opl[w[i].chip], 1, w[i].val);
+  }
+}
+
+unsigned long CEmuopl::getactive()
+{
+  return OPLActiveChannels(opl[0]) | (unsigned long)OPLActiveChannels(opl[1]) << 9;
+}
+
+void CEmuopl::setchannelmask(unsigned long mask)
+{
+  Copl::setchannelmask(mask);
+  OPLSetChannelMask(opl[0], channelmask & 0x1ff);
+  OPLSetChannelMask(opl[1], channelmask >> 9);
+}
+
 void CEmuopl::init()
 {
   OPLResetChip(opl[0]); OPLResetChip(opl[1]);
   currChip = 0;
+  clearqueue();
 }
 
 void CEmuopl::settype(ChipType type)
 {
   currType = type;
 }
+
+bool CEmuopl::save_state(std::string &state)
+{
+  // Each chip is stored together with its address, so the pointers into its
+  // own state block can be relocated when it is restored.
+  state.assign((const char *)&currChip, sizeof(currChip));
+  state.append((const char *)&currType, sizeof(currType));
+  for(int i = 0; i < 2; i++) {
+    state.append((const char *)&opl[i], sizeof(opl[i]));
+    state.append((const char *)opl[i], CHIP_STATE_SIZE(opl[i]));
+  }
+
+  return true;
+}
+
+bool CEmuopl::load_state(const std::string &state)
+{
+  unsigned long	size = CHIP_STATE_SIZE(opl[0]), pos;
+  const FM_OPL	*from;
+  int		i, c, s;
+
+  if(state.size() != sizeof(currChip) + sizeof(currType) +
+     2 * (sizeof(from) + size))
+    return false;
+
+  // refuse states taken at a different sample rate
+  pos = sizeof(currChip) + sizeof(currType) + sizeof(from);
+  if(memcmp(&((const FM_OPL *)(state.data() + pos))->rate, &opl[0]->rate,
+	    sizeof(opl[0]->rate)))
+    return false;
+
+  memcpy(&currChip, state.data(), sizeof(currChip));
+  memcpy(&currType, state.data() + sizeof(currChip), sizeof(currType));
+  clearqueue();
+
+  pos = sizeof(currChip) + sizeof(currType);
+  for(i = 0; i < 2; i++) {
+    memcpy(&from, state.data() + pos, sizeof(from));
+    memcpy(opl[i], state.data() + pos + sizeof(from), size);
+    pos += sizeof(from) + size;
+
+    if(from == opl[i]) continue;
+
+    relocate(opl[i]->P_CH, from, opl[i]);
+    for(c = 0; c < opl[i]->max_ch; c++) {
+      relocate(opl[i]->P_CH[c].connect1, from, opl[i]);
+      relocate(opl[i]->P_CH[c].connect2, from, opl[i]);
+      for(s = 0; s < 2; s++) {
+	relocate(opl[i]->P_CH[c].SLOT[s].AR, from, opl[i]);
+	relocate(opl[i]->P_CH[c].SLOT[s].DR, from, opl[i]);
+	relocate(opl[i]->P_CH[c].SLOT[s].RR, from, opl[i]);
+      }
+    }
+  }
+
+  // the channel mask is a setting, it doesn't go with the state
+  setchannelmask(channelmask);
+  return true;
+}
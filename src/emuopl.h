@@ -34,16 +34,25 @@ class CEmuopl: public Copl
   virtual ~CEmuopl();
 
   void update(short *buf, int samples);			// fill buffer
+  bool updatefmt(void **bufs, int samples, const Format &fmt);
   void write(int reg, int val);
+  void write_at(unsigned long offset, int reg, int val)
+    {
+      enqueue(offset, reg, val);
+    }
+  void write_batch(const RegWrite *w, size_t n);
+  unsigned long getactive();
+  void setchannelmask(unsigned long mask);
 
   void init();
   void settype(ChipType type);
 
+  bool save_state(std::string &state);
+  bool load_state(const std::string &state);
+
  private:
   bool		use16bit, stereo;
   FM_OPL	*opl[2];				// OPL2 emulator data
-  short		*mixbuf0, *mixbuf1;
-  int		mixbufSamples;
 };
 
 #endif
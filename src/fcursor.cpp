@@ -0,0 +1,49 @@
+/*
+ * Adplug - Replayer for many OPL2/OPL3 audio file formats.
+ * Copyright (C) 1999 - 2008 Simon Peter, <dn.tlp@gmx.net>, et al.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * fcursor.cpp - Little endian reader over a whole file in memory
+ */
+
+#include "fcursor.h"
+
+CFileCursor::CFileCursor(const CFileProvider &fp, binistream *f)
+  : buf(0), spos(0), err(false)
+{
+  f->seek(0);
+  data = fp.view(f, size, false);
+  if(data) return;
+
+  size = fp.filesize(f);
+  data = buf = new unsigned char [size];
+  fp.read(f, buf, size);
+}
+
+unsigned long CFileCursor::past(unsigned int n)
+  /*
+   * Reads an 'n' byte integer that doesn't fit in before the end.
+   */
+{
+  unsigned long v = 0;
+
+  for(unsigned int i = 0; i < n; i++, spos++)
+    v |= (unsigned long)(spos < size ? data[spos] : 0xff) << (i * 8);
+
+  if(spos > size) spos = size;
+  err = true;
+  return v;
+}
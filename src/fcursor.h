@@ -0,0 +1,145 @@
+/*
+ * Adplug - Replayer for many OPL2/OPL3 audio file formats.
+ * Copyright (C) 1999 - 2008 Simon Peter, <dn.tlp@gmx.net>, et al.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * fcursor.h - Little endian reader over a whole file in memory
+ *
+ * NOTES:
+ * Loaders get the whole file in one go, from the file provider's memory
+ * where it keeps the file there, and then read it with inline calls
+ * instead of one virtual call per byte. The stream has to stay open while
+ * the cursor is used.
+ *
+ * Reads past the end set a sticky error flag. The missing bytes read as
+ * 0xff, like those of readInt() from a binistream over a file, so loaders
+ * ported from binistream play cut off files as before.
+ */
+
+#ifndef H_ADPLUG_FILECURSOR
+#define H_ADPLUG_FILECURSOR
+
+#include <string.h>
+#include <string>
+#include "fprovide.h"
+
+class CFileCursor
+{
+public:
+  CFileCursor(const unsigned char *newdata, unsigned long newsize)
+    : data(newdata), buf(0), size(newsize), spos(0), err(false)
+    {
+    }
+
+  // The whole file 'f' opened by 'fp', from its start
+  CFileCursor(const CFileProvider &fp, binistream *f);
+
+  ~CFileCursor()
+    {
+      delete [] buf;
+    }
+
+  unsigned char u8()
+    {
+      if(spos < size) return data[spos++];
+      return past(1);
+    }
+
+  unsigned short u16le()
+    {
+      if(spos < size && size - spos >= 2) {
+	unsigned short v = data[spos] | (data[spos + 1] << 8);
+
+	spos += 2;
+	return v;
+      }
+      return past(2);
+    }
+
+  unsigned long u32le()
+    {
+      if(spos < size && size - spos >= 4) {
+	unsigned long v = data[spos] | (data[spos + 1] << 8) |
+	  (data[spos + 2] << 16) | ((unsigned long)data[spos + 3] << 24);
+
+	spos += 4;
+	return v;
+      }
+      return past(4);
+    }
+
+  float f32le()			// IEEE single
+    {
+      unsigned long	v = u32le();
+      unsigned int	i = v;
+      float		f;
+
+      memcpy(&f, &i, sizeof(f));
+      return f;
+    }
+
+  // Copies the next 'n' bytes to 'dst', returns false if there weren't
+  bool bytes(void *dst, unsigned long n)
+    {
+      unsigned long have = spos < size ? size - spos : 0;
+
+      if(n <= have) {
+	memcpy(dst, data + spos, n);
+	spos += n;
+	return true;
+      }
+      memcpy(dst, data + spos, have);
+      memset((char *)dst + have, 0xff, n - have);
+      spos += have;
+      err = true;
+      return false;
+    }
+
+  // Reads up to and past the next 'delim', which isn't included
+  std::string str(char delim = '\0')
+    {
+      unsigned long start = spos;
+
+      while(spos < size && data[spos] != (unsigned char)delim) spos++;
+      std::string s((const char *)data + start, spos - start);
+      if(spos < size) spos++; else err = true;
+      return s;
+    }
+
+  void skip(unsigned long n) { spos += n; }
+  void seek(unsigned long pos) { spos = pos; }
+  unsigned long pos() const { return spos; }
+  unsigned long filesize() const { return size; }
+  unsigned long left() const { return spos < size ? size - spos : 0; }
+  bool error() const { return err; }	// a read went past the end
+
+  // The data from the current position on, left() bytes of it
+  const unsigned char *here() const { return data + (spos < size ? spos : size); }
+
+private:
+  const unsigned char	*data;
+  unsigned char		*buf;		// data, unless the file provider keeps it
+  unsigned long		size, spos;
+  bool			err;
+
+  unsigned long past(unsigned int n);
+
+  // not to be copied
+  CFileCursor(const CFileCursor &);
+  CFileCursor &operator=(const CFileCursor &);
+};
+
+#endif
@@ -0,0 +1,73 @@
+/*
+ * Adplug - Replayer for many OPL2/OPL3 audio file formats.
+ * Copyright (C) 1999 - 2008 Simon Peter, <dn.tlp@gmx.net>, et al.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * fixedopl.h - Register writes without virtual calls, for builds with a
+ *              fixed OPL class
+ *
+ * NOTES:
+ * configure --with-fixed-opl defines ADPLUG_FIXED_OPL to an emulator class
+ * and ADPLUG_FIXED_OPL_H to its header. Players writing through
+ * CPlayer::oplwrite() then call that class' write() directly, where the
+ * compiler can inline it, while they play on an instance of exactly that
+ * class. On anything else, like the image OPL used while seeking or a
+ * wrapper around the emulator, they write the usual way. Without the
+ * option, oplwrite() is just opl->write().
+ *
+ * This header is internal to the library. Only the player sources
+ * include it.
+ */
+
+#ifndef H_ADPLUG_FIXEDOPL
+#define H_ADPLUG_FIXEDOPL
+
+#include "player.h"
+
+#ifdef ADPLUG_FIXED_OPL
+
+#include <typeinfo>
+#include ADPLUG_FIXED_OPL_H
+
+// Returns 'opl' if it is of the fixed class itself, NULL otherwise
+inline Copl *fixed_opl(Copl *opl)
+{
+  return opl && typeid(*opl) == typeid(ADPLUG_FIXED_OPL) ? opl : 0;
+}
+
+inline void CPlayer::oplwrite(int reg, int val)
+{
+  if(opl == fixedopl)
+    static_cast<ADPLUG_FIXED_OPL *>(opl)->ADPLUG_FIXED_OPL::write(reg, val);
+  else
+    opl->write(reg, val);
+}
+
+#else
+
+inline Copl *fixed_opl(Copl *opl)
+{
+  return 0;
+}
+
+inline void CPlayer::oplwrite(int reg, int val)
+{
+  opl->write(reg, val);
+}
+
+#endif
+
+#endif
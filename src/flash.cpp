@@ -29,6 +29,7 @@
 */
 
 #include "flash.h"
+#include "snapshot.h"
 #include "debug.h"
 
 const unsigned char CxadflashPlayer::flash_adlib_registers[99] =
@@ -86,6 +87,14 @@ CPlayer *CxadflashPlayer::factory(Copl *newopl)
   return new CxadflashPlayer(newopl);
 }
 
+CPlayer::ProbeScore CxadflashPlayer::probe(const std::string &filename,
+					   const unsigned char *head,
+					   unsigned long len,
+					   unsigned long filesize)
+{
+  return probe_xad(head, len, FLASH);
+}
+
 void CxadflashPlayer::xadplayer_rewind(int subsong)
 {
   int i;
@@ -214,6 +223,12 @@ void CxadflashPlayer::xadplayer_update()
   }
 }
 
+bool CxadflashPlayer::xadplayer_snapshot(CSnapshot &s)
+{
+  s.io(flash);
+  return true;
+}
+
 float CxadflashPlayer::xadplayer_getrefresh()
 {
   return 17.5f;
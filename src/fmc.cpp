@@ -21,6 +21,7 @@
 
 #include <cstring>
 #include "fmc.h"
+#include "fcursor.h"
 
 /* -------- Public Methods -------------------------------- */
 
@@ -29,17 +30,26 @@ CPlayer *CfmcLoader::factory(Copl *newopl)
   return new CfmcLoader(newopl);
 }
 
-bool CfmcLoader::load(const std::string &filename, const CFileProvider &fp)
+CPlayer::ProbeScore CfmcLoader::probe(const std::string &filename,
+				      const unsigned char *head,
+				      unsigned long len,
+				      unsigned long filesize)
+{
+	return len >= 4 && !memcmp(head, "FMC!", 4) ? PROBE_YES : PROBE_NO;
+}
+
+bool CfmcLoader::loadfile(const std::string &filename, const CFileProvider &fp)
 {
   binistream *f = fp.open(filename); if(!f) return false;
+  CFileCursor c(fp, f);
   const unsigned char conv_fx[16] = {0,1,2,3,4,8,255,255,255,255,26,11,12,13,14,15};
 
   int i,j,k,t=0;
 
   // read header
-  f->readString(header.id, 4);
-  f->readString(header.title, 21);
-  header.numchan = f->readInt(1);
+  c.bytes(header.id, 4);
+  c.bytes(header.title, 21);
+  header.numchan = c.u8();
 
   // 'FMC!' - signed ?
   if (strncmp(header.id,"FMC!",4)) { fp.close(f); return false; }
@@ -51,50 +61,50 @@ bool CfmcLoader::load(const std::string &filename, const CFileProvider &fp)
   init_trackord();
 
   // load order
-  for(i = 0; i < 256; i++) order[i] = f->readInt(1);
+  for(i = 0; i < 256; i++) order[i] = c.u8();
 
-  f->ignore(2);
+  c.skip(2);
 
   // load instruments
   for(i = 0; i < 32; i++) {
-    instruments[i].synthesis = f->readInt(1);
-    instruments[i].feedback = f->readInt(1);
-
-    instruments[i].mod_attack = f->readInt(1);
-    instruments[i].mod_decay = f->readInt(1);
-    instruments[i].mod_sustain = f->readInt(1);
-    instruments[i].mod_release = f->readInt(1);
-    instruments[i].mod_volume = f->readInt(1);
-    instruments[i].mod_ksl = f->readInt(1);
-    instruments[i].mod_freq_multi = f->readInt(1);
-    instruments[i].mod_waveform = f->readInt(1);
-    instruments[i].mod_sustain_sound = f->readInt(1);
-    instruments[i].mod_ksr = f->readInt(1);
-    instruments[i].mod_vibrato = f->readInt(1);
-    instruments[i].mod_tremolo = f->readInt(1);
-
-    instruments[i].car_attack = f->readInt(1);
-    instruments[i].car_decay = f->readInt(1);
-    instruments[i].car_sustain = f->readInt(1);
-    instruments[i].car_release = f->readInt(1);
-    instruments[i].car_volume = f->readInt(1);
-    instruments[i].car_ksl = f->readInt(1);
-    instruments[i].car_freq_multi = f->readInt(1);
-    instruments[i].car_waveform = f->readInt(1);
-    instruments[i].car_sustain_sound = f->readInt(1);
-    instruments[i].car_ksr = f->readInt(1);
-    instruments[i].car_vibrato = f->readInt(1);
-    instruments[i].car_tremolo = f->readInt(1);
-
-    instruments[i].pitch_shift = f->readInt(1);
-
-    f->readString(instruments[i].name, 21);
+    instruments[i].synthesis = c.u8();
+    instruments[i].feedback = c.u8();
+
+    instruments[i].mod_attack = c.u8();
+    instruments[i].mod_decay = c.u8();
+    instruments[i].mod_sustain = c.u8();
+    instruments[i].mod_release = c.u8();
+    instruments[i].mod_volume = c.u8();
+    instruments[i].mod_ksl = c.u8();
+    instruments[i].mod_freq_multi = c.u8();
+    instruments[i].mod_waveform = c.u8();
+    instruments[i].mod_sustain_sound = c.u8();
+    instruments[i].mod_ksr = c.u8();
+    instruments[i].mod_vibrato = c.u8();
+    instruments[i].mod_tremolo = c.u8();
+
+    instruments[i].car_attack = c.u8();
+    instruments[i].car_decay = c.u8();
+    instruments[i].car_sustain = c.u8();
+    instruments[i].car_release = c.u8();
+    instruments[i].car_volume = c.u8();
+    instruments[i].car_ksl = c.u8();
+    instruments[i].car_freq_multi = c.u8();
+    instruments[i].car_waveform = c.u8();
+    instruments[i].car_sustain_sound = c.u8();
+    instruments[i].car_ksr = c.u8();
+    instruments[i].car_vibrato = c.u8();
+    instruments[i].car_tremolo = c.u8();
+
+    instruments[i].pitch_shift = c.u8();
+
+    c.bytes(instruments[i].name, 21);
   }
 
   // load tracks
   for (i=0;i<64;i++)
     {
-      if(f->ateof()) break;
+      if(!c.left()) break;
 
       for (j=0;j<header.numchan;j++)
 	{
@@ -103,9 +113,9 @@ bool CfmcLoader::load(const std::string &filename, const CFileProvider &fp)
 	      fmc_event event;
 
 	      // read event
-	      event.byte0 = f->readInt(1);
-	      event.byte1 = f->readInt(1);
-	      event.byte2 = f->readInt(1);
+	      event.byte0 = c.u8();
+	      event.byte1 = c.u8();
+	      event.byte2 = c.u8();
 
 	      // convert event
 	      tracks[t][k].note = event.byte0 & 0x7F;
@@ -25,10 +25,14 @@ class CfmcLoader: public CmodPlayer
 {
 	public:
 		static CPlayer *factory(Copl *newopl);
+		static ProbeScore probe(const std::string &filename,
+					const unsigned char *head,
+					unsigned long len,
+					unsigned long filesize);
 
 		CfmcLoader(Copl *newopl) : CmodPlayer(newopl) { };
 
-		bool	load(const std::string &filename, const CFileProvider &fp);
+		bool	loadfile(const std::string &filename, const CFileProvider &fp);
 		float	getrefresh();
 
 		std::string	gettype();
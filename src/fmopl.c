@@ -189,14 +189,14 @@ static const INT32 SL_TABLE[16]={
 /* TotalLevel : 48 24 12  6  3 1.5 0.75 (dB) */
 /* TL_TABLE[ 0      to TL_MAX          ] : plus  section */
 /* TL_TABLE[ TL_MAX to TL_MAX+TL_MAX-1 ] : minus section */
-static INT32 *TL_TABLE;
+static INT32 TL_TABLE[TL_MAX*2];
 
 /* pointers to TL_TABLE with sinwave output offset */
-static INT32 **SIN_TABLE;
+static INT32 *SIN_TABLE[SIN_ENT*4];
 
 /* LFO table */
-static INT32 *AMS_TABLE;
-static INT32 *VIB_TABLE;
+static INT32 AMS_TABLE[AMS_ENT*2];
+static INT32 VIB_TABLE[VIB_ENT*2];
 
 /* envelope output curve table */
 /* attack + decay + OFF */
@@ -217,25 +217,8 @@ static INT32 RATE_0[16]=
 
 /* -------------------- static state --------------------- */
 
-/* lock level of common table */
-static int num_lock = 0;
-
-/* work table */
-static void *cur_chip = NULL;	/* current chip point */
-/* currenct chip state */
-/* static OPLSAMPLE  *bufL,*bufR; */
-static OPL_CH *S_CH;
-static OPL_CH *E_CH;
-OPL_SLOT *SLOT7_1,*SLOT7_2,*SLOT8_1,*SLOT8_2;
-
-static INT32 outd[1];
-static INT32 ams;
-static INT32 vib;
-INT32  *ams_table;
-INT32  *vib_table;
-static INT32 amsIncr;
-static INT32 vibIncr;
-static INT32 feedback2;		/* connect for SLOT 2 */
+/* common tables are built (once) */
+static int table_ready = 0;
 
 /* log output level */
 #define LOG_ERR  3      /* ERROR       */
@@ -328,7 +311,7 @@ INLINE void OPL_KEYOFF(OPL_SLOT *SLOT)
 
 /* ---------- calcrate Envelope Generator & Phase Generator ---------- */
 /* return : envelope output */
-INLINE UINT32 OPL_CALC_SLOT( OPL_SLOT *SLOT )
+INLINE UINT32 OPL_CALC_SLOT( FM_OPL *OPL, OPL_SLOT *SLOT )
 {
 	/* calcrate envelope generator */
 	if( (SLOT->evc+=SLOT->evs) >= SLOT->eve )
@@ -362,14 +345,14 @@ INLINE UINT32 OPL_CALC_SLOT( OPL_SLOT *SLOT )
 		}
 	}
 	/* calcrate envelope */
-	return SLOT->TLL+ENV_CURVE[SLOT->evc>>ENV_BITS]+(SLOT->ams ? ams : 0);
+	return SLOT->TLL+ENV_CURVE[SLOT->evc>>ENV_BITS]+(SLOT->ams ? OPL->ams : 0);
 }
 
 /* set algorythm connection */
-static void set_algorythm( OPL_CH *CH)
+static void set_algorythm( FM_OPL *OPL, OPL_CH *CH)
 {
-	INT32 *carrier = &outd[0];
-	CH->connect1 = CH->CON ? carrier : &feedback2;
+	INT32 *carrier = &OPL->outd[0];
+	CH->connect1 = CH->CON ? carrier : &OPL->feedback2;
 	CH->connect2 = carrier;
 }
 
@@ -458,19 +441,19 @@ INLINE void set_sl_rr(FM_OPL *OPL,int slot,int v)
 /* operator output calcrator */
 #define OP_OUT(slot,env,con)   slot->wavetable[((slot->Cnt+con)/(0x1000000/SIN_ENT))&(SIN_ENT-1)][env]
 /* ---------- calcrate one of channel ---------- */
-INLINE void OPL_CALC_CH( OPL_CH *CH )
+INLINE void OPL_CALC_CH( FM_OPL *OPL, OPL_CH *CH )
 {
 	UINT32 env_out;
 	OPL_SLOT *SLOT;
 
-	feedback2 = 0;
+	OPL->feedback2 = 0;
 	/* SLOT 1 */
 	SLOT = &CH->SLOT[SLOT1];
-	env_out=OPL_CALC_SLOT(SLOT);
+	env_out=OPL_CALC_SLOT(OPL,SLOT);
 	if( env_out < EG_ENT-1 )
 	{
 		/* PG */
-		if(SLOT->vib) SLOT->Cnt += (SLOT->Incr*vib/VIB_RATE);
+		if(SLOT->vib) SLOT->Cnt += (SLOT->Incr*OPL->vib/VIB_RATE);
 		else          SLOT->Cnt += SLOT->Incr;
 		/* connectoion */
 		if(CH->FB)
@@ -490,100 +473,120 @@ INLINE void OPL_CALC_CH( OPL_CH *CH )
 	}
 	/* SLOT 2 */
 	SLOT = &CH->SLOT[SLOT2];
-	env_out=OPL_CALC_SLOT(SLOT);
+	env_out=OPL_CALC_SLOT(OPL,SLOT);
 	if( env_out < EG_ENT-1 )
 	{
 		/* PG */
-		if(SLOT->vib) SLOT->Cnt += (SLOT->Incr*vib/VIB_RATE);
+		if(SLOT->vib) SLOT->Cnt += (SLOT->Incr*OPL->vib/VIB_RATE);
 		else          SLOT->Cnt += SLOT->Incr;
 		/* connectoion */
-		outd[0] += OP_OUT(SLOT,env_out, feedback2);
+		OPL->outd[0] += OP_OUT(SLOT,env_out, OPL->feedback2);
 	}
 }
 
 /* ---------- calcrate rythm block ---------- */
 #define WHITE_NOISE_db 6.0
-INLINE void OPL_CALC_RH( OPL_CH *CH )
+/* phase counters of SD, TAM, TOP and HH, these run even when not keyed on */
+INLINE void OPL_CALC_RH_PG( FM_OPL *OPL, OPL_CH *CH )
+{
+	OPL_SLOT *SLOT7_1 = &CH[7].SLOT[SLOT1];
+	OPL_SLOT *SLOT7_2 = &CH[7].SLOT[SLOT2];
+	OPL_SLOT *SLOT8_1 = &CH[8].SLOT[SLOT1];
+	OPL_SLOT *SLOT8_2 = &CH[8].SLOT[SLOT2];
+
+	if(SLOT7_1->vib) SLOT7_1->Cnt += (2*SLOT7_1->Incr*OPL->vib/VIB_RATE);
+	else             SLOT7_1->Cnt += 2*SLOT7_1->Incr;
+	if(SLOT7_2->vib) SLOT7_2->Cnt += ((CH[7].fc*8)*OPL->vib/VIB_RATE);
+	else             SLOT7_2->Cnt += (CH[7].fc*8);
+	if(SLOT8_1->vib) SLOT8_1->Cnt += (SLOT8_1->Incr*OPL->vib/VIB_RATE);
+	else             SLOT8_1->Cnt += SLOT8_1->Incr;
+	if(SLOT8_2->vib) SLOT8_2->Cnt += ((CH[8].fc*48)*OPL->vib/VIB_RATE);
+	else             SLOT8_2->Cnt += (CH[8].fc*48);
+}
+
+INLINE void OPL_CALC_RH( FM_OPL *OPL, OPL_CH *CH )
 {
 	UINT32 env_tam,env_sd,env_top,env_hh;
-	int whitenoise = (rand()&1)*(WHITE_NOISE_db/EG_STEP);
+	int whitenoise;
 	INT32 tone8;
+	OPL_SLOT *SLOT7_1 = &CH[7].SLOT[SLOT1];
+	OPL_SLOT *SLOT7_2 = &CH[7].SLOT[SLOT2];
+	OPL_SLOT *SLOT8_1 = &CH[8].SLOT[SLOT1];
+	OPL_SLOT *SLOT8_2 = &CH[8].SLOT[SLOT2];
 
 	OPL_SLOT *SLOT;
 	int env_out;
 
+	/* per chip noise, so the output doesn't depend on other chips */
+	OPL->noise = OPL->noise*1103515245+12345;
+	whitenoise = ((OPL->noise>>16)&1)*(WHITE_NOISE_db/EG_STEP);
+
 	/* BD : same as FM serial mode and output level is large */
-	feedback2 = 0;
+	OPL->feedback2 = 0;
 	/* SLOT 1 */
 	SLOT = &CH[6].SLOT[SLOT1];
-	env_out=OPL_CALC_SLOT(SLOT);
+	env_out=OPL_CALC_SLOT(OPL,SLOT);
 	if( env_out < EG_ENT-1 )
 	{
 		/* PG */
-		if(SLOT->vib) SLOT->Cnt += (SLOT->Incr*vib/VIB_RATE);
+		if(SLOT->vib) SLOT->Cnt += (SLOT->Incr*OPL->vib/VIB_RATE);
 		else          SLOT->Cnt += SLOT->Incr;
 		/* connectoion */
 		if(CH[6].FB)
 		{
 			int feedback1 = (CH[6].op1_out[0]+CH[6].op1_out[1])>>CH[6].FB;
 			CH[6].op1_out[1] = CH[6].op1_out[0];
-			feedback2 = CH[6].op1_out[0] = OP_OUT(SLOT,env_out,feedback1);
+			OPL->feedback2 = CH[6].op1_out[0] = OP_OUT(SLOT,env_out,feedback1);
 		}
 		else
 		{
-			feedback2 = OP_OUT(SLOT,env_out,0);
+			OPL->feedback2 = OP_OUT(SLOT,env_out,0);
 		}
 	}else
 	{
-		feedback2 = 0;
+		OPL->feedback2 = 0;
 		CH[6].op1_out[1] = CH[6].op1_out[0];
 		CH[6].op1_out[0] = 0;
 	}
 	/* SLOT 2 */
 	SLOT = &CH[6].SLOT[SLOT2];
-	env_out=OPL_CALC_SLOT(SLOT);
+	env_out=OPL_CALC_SLOT(OPL,SLOT);
 	if( env_out < EG_ENT-1 )
 	{
 		/* PG */
-		if(SLOT->vib) SLOT->Cnt += (SLOT->Incr*vib/VIB_RATE);
+		if(SLOT->vib) SLOT->Cnt += (SLOT->Incr*OPL->vib/VIB_RATE);
 		else          SLOT->Cnt += SLOT->Incr;
 		/* connectoion */
-		outd[0] += OP_OUT(SLOT,env_out, feedback2)*2;
+		if(OPL->chmask & (1<<6))
+			OPL->outd[0] += OP_OUT(SLOT,env_out, OPL->feedback2)*2;
 	}
 
 	// SD  (17) = mul14[fnum7] + white noise
 	// TAM (15) = mul15[fnum8]
 	// TOP (18) = fnum6(mul18[fnum8]+whitenoise)
 	// HH  (14) = fnum7(mul18[fnum8]+whitenoise) + white noise
-	env_sd =OPL_CALC_SLOT(SLOT7_2) + whitenoise;
-	env_tam=OPL_CALC_SLOT(SLOT8_1);
-	env_top=OPL_CALC_SLOT(SLOT8_2);
-	env_hh =OPL_CALC_SLOT(SLOT7_1) + whitenoise;
+	env_sd =OPL_CALC_SLOT(OPL,SLOT7_2) + whitenoise;
+	env_tam=OPL_CALC_SLOT(OPL,SLOT8_1);
+	env_top=OPL_CALC_SLOT(OPL,SLOT8_2);
+	env_hh =OPL_CALC_SLOT(OPL,SLOT7_1) + whitenoise;
 
 	/* PG */
-	if(SLOT7_1->vib) SLOT7_1->Cnt += (2*SLOT7_1->Incr*vib/VIB_RATE);
-	else             SLOT7_1->Cnt += 2*SLOT7_1->Incr;
-	if(SLOT7_2->vib) SLOT7_2->Cnt += ((CH[7].fc*8)*vib/VIB_RATE);
-	else             SLOT7_2->Cnt += (CH[7].fc*8);
-	if(SLOT8_1->vib) SLOT8_1->Cnt += (SLOT8_1->Incr*vib/VIB_RATE);
-	else             SLOT8_1->Cnt += SLOT8_1->Incr;
-	if(SLOT8_2->vib) SLOT8_2->Cnt += ((CH[8].fc*48)*vib/VIB_RATE);
-	else             SLOT8_2->Cnt += (CH[8].fc*48);
+	OPL_CALC_RH_PG(OPL,CH);
 
 	tone8 = OP_OUT(SLOT8_2,whitenoise,0 );
 
 	/* SD */
-	if( env_sd < EG_ENT-1 )
-		outd[0] += OP_OUT(SLOT7_1,env_sd, 0)*8;
+	if( env_sd < EG_ENT-1 && (OPL->chmask & (1<<7)) )
+		OPL->outd[0] += OP_OUT(SLOT7_1,env_sd, 0)*8;
 	/* TAM */
-	if( env_tam < EG_ENT-1 )
-		outd[0] += OP_OUT(SLOT8_1,env_tam, 0)*2;
+	if( env_tam < EG_ENT-1 && (OPL->chmask & (1<<8)) )
+		OPL->outd[0] += OP_OUT(SLOT8_1,env_tam, 0)*2;
 	/* TOP-CY */
-	if( env_top < EG_ENT-1 )
-		outd[0] += OP_OUT(SLOT7_2,env_top,tone8)*2;
+	if( env_top < EG_ENT-1 && (OPL->chmask & (1<<8)) )
+		OPL->outd[0] += OP_OUT(SLOT7_2,env_top,tone8)*2;
 	/* HH */
-	if( env_hh  < EG_ENT-1 )
-		outd[0] += OP_OUT(SLOT7_2,env_hh,tone8)*2;
+	if( env_hh  < EG_ENT-1 && (OPL->chmask & (1<<7)) )
+		OPL->outd[0] += OP_OUT(SLOT7_2,env_hh,tone8)*2;
 }
 
 /* ----------- initialize time tabls ----------- */
@@ -617,34 +620,16 @@ static void init_timetables( FM_OPL *OPL , int ARRATE , int DRRATE )
 }
 
 /* ---------- generic table initialize ---------- */
-static int OPLOpenTable( void )
+/* see fmopl.h on threads */
+void OPLInitTable( void )
 {
 	int s,t;
 	double rate;
 	int i,j;
 	double pom;
 
-	/* allocate dynamic tables */
-	if( (TL_TABLE = malloc(TL_MAX*2*sizeof(INT32))) == NULL)
-		return 0;
-	if( (SIN_TABLE = malloc(SIN_ENT*4 *sizeof(INT32 *))) == NULL)
-	{
-		free(TL_TABLE);
-		return 0;
-	}
-	if( (AMS_TABLE = malloc(AMS_ENT*2 *sizeof(INT32))) == NULL)
-	{
-		free(TL_TABLE);
-		free(SIN_TABLE);
-		return 0;
-	}
-	if( (VIB_TABLE = malloc(VIB_ENT*2 *sizeof(INT32))) == NULL)
-	{
-		free(TL_TABLE);
-		free(SIN_TABLE);
-		free(AMS_TABLE);
-		return 0;
-	}
+	if( table_ready ) return;
+
 	/* make total level table */
 	for (t = 0;t < EG_ENT-1 ;t++){
 		rate = ((1<<TL_BITS)-1)/pow(10,EG_STEP*t/20);	/* dB -> voltage */
@@ -706,16 +691,7 @@ static int OPLOpenTable( void )
 		VIB_TABLE[VIB_ENT+i] = VIB_RATE + (pom*0.14); /* +-14cent */
 		/* LOG(LOG_INF,("vib %d=%d\n",i,VIB_TABLE[VIB_ENT+i])); */
 	}
-	return 1;
-}
-
-
-static void OPLCloseTable( void )
-{
-	free(TL_TABLE);
-	free(SIN_TABLE);
-	free(AMS_TABLE);
-	free(VIB_TABLE);
+	table_ready = 1;
 }
 
 /* CSM Key Controll */
@@ -998,7 +974,7 @@ static void OPLWriteReg(FM_OPL *OPL, int r, int v)
 		int feedback = (v>>1)&7;
 		CH->FB   = feedback ? (8+1) - feedback : 0;
 		CH->CON = v&1;
-		set_algorythm(CH);
+		set_algorythm(OPL,CH);
 		}
 		return;
 	case 0xe0: /* wave type */
@@ -1014,29 +990,35 @@ static void OPLWriteReg(FM_OPL *OPL, int r, int v)
 	}
 }
 
-/* lock/unlock for common table */
-static int OPL_LockTable(void)
+/* ---------- active channels ---------- */
+/* a slot that is off stays silent until the next key on, unless a rate  */
+/* written after a reset in attack or decay sets its envelope going      */
+#define OPL_SLOT_OFF(SLOT) \
+	((SLOT)->evc == EG_OFF && (!(SLOT)->evs || (SLOT)->evm == ENV_MOD_RR))
+
+/* bitmask of the channels with a slot that sounds, bit 0 for channel 0 */
+INLINE int OPL_ACTIVE( FM_OPL *OPL )
 {
-	num_lock++;
-	if(num_lock>1) return 0;
-	/* first time */
-	cur_chip = NULL;
-	/* allocate total level table (128kb space) */
-	if( !OPLOpenTable() )
-	{
-		num_lock--;
-		return -1;
-	}
-	return 0;
+	int active = 0;
+	int c;
+
+	for(c = 0 ; c < 9 ; c++)
+		if( !OPL_SLOT_OFF(&OPL->P_CH[c].SLOT[SLOT1]) ||
+			!OPL_SLOT_OFF(&OPL->P_CH[c].SLOT[SLOT2]) )
+			active |= 1<<c;
+	return active;
 }
 
-static void OPL_UnLockTable(void)
+/* ---------- settle a silent channel ---------- */
+/* moves a channel that is off on by 'length' samples, the same way      */
+/* OPL_CALC_CH() would: the envelopes settle at the first sample,        */
+/* feedback dies away                                                    */
+INLINE void OPL_SETTLE_CH( FM_OPL *OPL, OPL_CH *CH, int length )
 {
-	if(num_lock) num_lock--;
-	if(num_lock) return;
-	/* last time */
-	cur_chip = NULL;
-	OPLCloseTable();
+	OPL_CALC_SLOT(OPL,&CH->SLOT[SLOT1]);
+	OPL_CALC_SLOT(OPL,&CH->SLOT[SLOT2]);
+	CH->op1_out[1] = length > 1 ? 0 : CH->op1_out[0];
+	CH->op1_out[0] = 0;
 }
 
 #if (BUILD_YM3812 || BUILD_YM3526)
@@ -1044,6 +1026,51 @@ static void OPL_UnLockTable(void)
 /*		YM3812 local section                                                   */
 /*******************************************************************************/
 
+/* ---------- skip silence ---------- */
+/* moves the chip on by 'length' samples of silence, the same way     */
+/* YM3812UpdateOne() would, without working out the output            */
+static void OPL_SKIP( FM_OPL *OPL, int length )
+{
+	UINT32 amsCnt = OPL->amsCnt + (UINT32)OPL->amsIncr*length;
+	UINT32 vibCnt = OPL->vibCnt;
+	UINT8 rythm = OPL->rythm&0x20;
+	OPL_CH *CH;
+	int i;
+
+	/* LFO */
+	OPL->ams = OPL->ams_table[amsCnt>>AMS_SHIFT];
+	if(rythm)
+	{
+		/* the rythm phase counters run on, with the vibrato */
+		for( i=0; i < length ; i++ )
+		{
+			OPL->vib = OPL->vib_table[(vibCnt+=OPL->vibIncr)>>VIB_SHIFT];
+			OPL->noise = OPL->noise*1103515245+12345;
+			OPL_CALC_RH_PG(OPL,OPL->P_CH);
+		}
+	}
+	else
+	{
+		vibCnt += (UINT32)OPL->vibIncr*length;
+		OPL->vib = OPL->vib_table[vibCnt>>VIB_SHIFT];
+	}
+	OPL->amsCnt = amsCnt;
+	OPL->vibCnt = vibCnt;
+	/* envelopes settle at the first sample, feedback dies away */
+	for(CH = OPL->P_CH ; CH < &OPL->P_CH[9] ; CH++)
+	{
+		if( !rythm || CH < &OPL->P_CH[7] )
+			OPL_SETTLE_CH(OPL,CH,length);
+		else
+		{
+			OPL_CALC_SLOT(OPL,&CH->SLOT[SLOT1]);
+			OPL_CALC_SLOT(OPL,&CH->SLOT[SLOT2]);
+		}
+	}
+	OPL->outd[0] = 0;
+	OPL->feedback2 = 0;
+}
+
 /* ---------- update one of chip ----------- */
 void YM3812UpdateOne(FM_OPL *OPL, INT16 *buffer, int length)
 {
@@ -1052,47 +1079,59 @@ void YM3812UpdateOne(FM_OPL *OPL, INT16 *buffer, int length)
 	OPLSAMPLE *buf = buffer;
 	UINT32 amsCnt  = OPL->amsCnt;
 	UINT32 vibCnt  = OPL->vibCnt;
+	UINT32 amsIncr = OPL->amsIncr;
+	UINT32 vibIncr = OPL->vibIncr;
+	INT32 *ams_table = OPL->ams_table;
+	INT32 *vib_table = OPL->vib_table;
 	UINT8 rythm = OPL->rythm&0x20;
+	OPL_CH *S_CH = OPL->P_CH;
+	OPL_CH *E_CH = &S_CH[9];
 	OPL_CH *CH,*R_CH;
+	int active = OPL_ACTIVE(OPL);
+	int run = active & OPL->chmask;
 
-	if( (void *)OPL != cur_chip ){
-		cur_chip = (void *)OPL;
-		/* channel pointers */
-		S_CH = OPL->P_CH;
-		E_CH = &S_CH[9];
-		/* rythm slot */
-		SLOT7_1 = &S_CH[7].SLOT[SLOT1];
-		SLOT7_2 = &S_CH[7].SLOT[SLOT2];
-		SLOT8_1 = &S_CH[8].SLOT[SLOT1];
-		SLOT8_2 = &S_CH[8].SLOT[SLOT2];
-		/* LFO state */
-		amsIncr = OPL->amsIncr;
-		vibIncr = OPL->vibIncr;
-		ams_table = OPL->ams_table;
-		vib_table = OPL->vib_table;
-	}
-	R_CH = rythm ? &S_CH[6] : E_CH;
-    for( i=0; i < length ; i++ )
+	if( length > 0 && !active )
 	{
-		/*            channel A         channel B         channel C      */
-		/* LFO */
-		ams = ams_table[(amsCnt+=amsIncr)>>AMS_SHIFT];
-		vib = vib_table[(vibCnt+=vibIncr)>>VIB_SHIFT];
-		outd[0] = 0;
-		/* FM part */
-		for(CH=S_CH ; CH < R_CH ; CH++)
-			OPL_CALC_CH(CH);
-		/* Rythn part */
-		if(rythm)
-			OPL_CALC_RH(S_CH);
-		/* limit check */
-		data = Limit( outd[0] , OPL_MAXOUT, OPL_MINOUT );
-		/* store to sound buffer */
-		buf[i] = data >> OPL_OUTSB;
+		/* silent until the next key on */
+		memset(buffer,0,length*sizeof(OPLSAMPLE));
+		OPL_SKIP(OPL,length);
 	}
+	else
+	{
+		R_CH = rythm ? &S_CH[6] : E_CH;
+		for( i=0; i < length ; i++ )
+		{
+			/*            channel A         channel B         channel C      */
+			/* LFO */
+			OPL->ams = ams_table[(amsCnt+=amsIncr)>>AMS_SHIFT];
+			OPL->vib = vib_table[(vibCnt+=vibIncr)>>VIB_SHIFT];
+			OPL->outd[0] = 0;
+			/* FM part, channels that are off or muted are left out */
+			for(CH=S_CH ; CH < R_CH ; CH++)
+				if( run & (1<<(CH-S_CH)) )
+					OPL_CALC_CH(OPL,CH);
+			/* Rythn part */
+			if(rythm && (OPL->chmask & 0x1c0))
+				OPL_CALC_RH(OPL,S_CH);
+			/* limit check */
+			data = Limit( OPL->outd[0] , OPL_MAXOUT, OPL_MINOUT );
+			/* store to sound buffer */
+			buf[i] = data >> OPL_OUTSB;
+		}
 
-	OPL->amsCnt = amsCnt;
-	OPL->vibCnt = vibCnt;
+		/* catch up with the channels that are off, muted ones stand still */
+		if( length > 0 )
+		{
+			for(CH=S_CH ; CH < R_CH ; CH++)
+				if( !(active & (1<<(CH-S_CH))) )
+					OPL_SETTLE_CH(OPL,CH,length);
+			if( !rythm && !(active & (1<<8)) )
+				OPL->feedback2 = 0;
+		}
+
+		OPL->amsCnt = amsCnt;
+		OPL->vibCnt = vibCnt;
+	}
 #ifdef OPL_OUTPUT_LOG
 	if(opl_dbg_fp)
 	{
@@ -1113,48 +1152,38 @@ void Y8950UpdateOne(FM_OPL *OPL, INT16 *buffer, int length)
 	OPLSAMPLE *buf = buffer;
 	UINT32 amsCnt  = OPL->amsCnt;
 	UINT32 vibCnt  = OPL->vibCnt;
+	UINT32 amsIncr = OPL->amsIncr;
+	UINT32 vibIncr = OPL->vibIncr;
+	INT32 *ams_table = OPL->ams_table;
+	INT32 *vib_table = OPL->vib_table;
 	UINT8 rythm = OPL->rythm&0x20;
+	OPL_CH *S_CH = OPL->P_CH;
+	OPL_CH *E_CH = &S_CH[9];
 	OPL_CH *CH,*R_CH;
 	YM_DELTAT *DELTAT = OPL->deltat;
 
 	/* setup DELTA-T unit */
 	YM_DELTAT_DECODE_PRESET(DELTAT);
 
-	if( (void *)OPL != cur_chip ){
-		cur_chip = (void *)OPL;
-		/* channel pointers */
-		S_CH = OPL->P_CH;
-		E_CH = &S_CH[9];
-		/* rythm slot */
-		SLOT7_1 = &S_CH[7].SLOT[SLOT1];
-		SLOT7_2 = &S_CH[7].SLOT[SLOT2];
-		SLOT8_1 = &S_CH[8].SLOT[SLOT1];
-		SLOT8_2 = &S_CH[8].SLOT[SLOT2];
-		/* LFO state */
-		amsIncr = OPL->amsIncr;
-		vibIncr = OPL->vibIncr;
-		ams_table = OPL->ams_table;
-		vib_table = OPL->vib_table;
-	}
 	R_CH = rythm ? &S_CH[6] : E_CH;
     for( i=0; i < length ; i++ )
 	{
 		/*            channel A         channel B         channel C      */
 		/* LFO */
-		ams = ams_table[(amsCnt+=amsIncr)>>AMS_SHIFT];
-		vib = vib_table[(vibCnt+=vibIncr)>>VIB_SHIFT];
-		outd[0] = 0;
+		OPL->ams = ams_table[(amsCnt+=amsIncr)>>AMS_SHIFT];
+		OPL->vib = vib_table[(vibCnt+=vibIncr)>>VIB_SHIFT];
+		OPL->outd[0] = 0;
 		/* deltaT ADPCM */
 		if( DELTAT->portstate )
 			YM_DELTAT_ADPCM_CALC(DELTAT);
 		/* FM part */
 		for(CH=S_CH ; CH < R_CH ; CH++)
-			OPL_CALC_CH(CH);
+			OPL_CALC_CH(OPL,CH);
 		/* Rythn part */
 		if(rythm)
-			OPL_CALC_RH(S_CH);
+			OPL_CALC_RH(OPL,S_CH);
 		/* limit check */
-		data = Limit( outd[0] , OPL_MAXOUT, OPL_MINOUT );
+		data = Limit( OPL->outd[0] , OPL_MAXOUT, OPL_MINOUT );
 		/* store to sound buffer */
 		buf[i] = data >> OPL_OUTSB;
 	}
@@ -1202,7 +1231,7 @@ void OPLResetChip(FM_OPL *OPL)
 		YM_DELTAT *DELTAT = OPL->deltat;
 
 		DELTAT->freqbase = OPL->freqbase;
-		DELTAT->output_pointer = outd;
+		DELTAT->output_pointer = OPL->outd;
 		DELTAT->portshift = 5;
 		DELTAT->output_range = DELTAT_MIXING_LEVEL<<TL_BITS;
 		YM_DELTAT_ADPCM_Reset(DELTAT,0);
@@ -1219,7 +1248,7 @@ FM_OPL *OPLCreate(int type, int clock, int rate)
 	int state_size;
 	int max_ch = 9; /* normaly 9 channels */
 
-	if( OPL_LockTable() ==-1) return NULL;
+	OPLInitTable();
 	/* allocate OPL state space */
 	state_size  = sizeof(FM_OPL);
 	state_size += sizeof(OPL_CH)*max_ch;
@@ -1241,6 +1270,7 @@ FM_OPL *OPLCreate(int type, int clock, int rate)
 	OPL->clock = clock;
 	OPL->rate  = rate;
 	OPL->max_ch = max_ch;
+	OPL->chmask = 0x1ff;
 	/* init grobal tables */
 	OPL_initalize(OPL);
 	/* reset chip */
@@ -1276,7 +1306,6 @@ void OPLDestroy(FM_OPL *OPL)
 		opl_dbg_fp = NULL;
 	}
 #endif
-	OPL_UnLockTable();
 	free(OPL);
 }
 
@@ -1372,6 +1401,17 @@ unsigned char OPLRead(FM_OPL *OPL,int a)
 	return 0;
 }
 
+int OPLActiveChannels(FM_OPL *OPL)
+{
+	return OPL_ACTIVE(OPL);
+}
+
+/* muted channels are left alone, they stand still until unmuted */
+void OPLSetChannelMask(FM_OPL *OPL,int mask)
+{
+	OPL->chmask = mask & 0x1ff;
+}
+
 int OPLTimerOver(FM_OPL *OPL,int c)
 {
 	if( c )
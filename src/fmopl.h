@@ -112,6 +112,7 @@ typedef struct fm_opl_f {
 	int	max_ch;			/* maximum channel                   */
 	/* Rythm sention */
 	UINT8 rythm;		/* Rythm mode , key flag */
+	int chmask;			/* channels that are generated       */
 #if BUILD_Y8950
 	/* Delta-T ADPCM unit (Y8950) */
 	YM_DELTAT *deltat;			/* DELTA-T ADPCM       */
@@ -136,6 +137,12 @@ typedef struct fm_opl_f {
 	INT32 amsIncr;
 	INT32 vibCnt;
 	INT32 vibIncr;
+	INT32 ams;			/* LFO output of the current sample  */
+	INT32 vib;
+	/* output of the current sample */
+	INT32 outd[1];		/* chip output                       */
+	INT32 feedback2;	/* connect for SLOT 2                */
+	UINT32 noise;		/* white noise generator (rythm)     */
 	/* wave selector enable flag */
 	UINT8 wavesel;
 	/* external event callback handler */
@@ -152,6 +159,11 @@ typedef struct fm_opl_f {
 #define OPL_TYPE_YM3812 (OPL_TYPE_WAVESEL)
 #define OPL_TYPE_Y8950  (OPL_TYPE_ADPCM|OPL_TYPE_KEYBOARD|OPL_TYPE_IO)
 
+/* Builds the tables all chips share, which never change afterwards. This */
+/* isn't thread safe, so AdPlug's CEmuopl and CTemuopl call it from static */
+/* initializers, while the library is loaded, before any thread can create */
+/* a chip. OPLCreate() calls it too, for single threaded users.           */
+void OPLInitTable(void);
 FM_OPL *OPLCreate(int type, int clock, int rate);
 void OPLDestroy(FM_OPL *OPL);
 void OPLSetTimerHandler(FM_OPL *OPL,OPL_TIMERHANDLER TimerHandler,int channelOffset);
@@ -165,6 +177,10 @@ void OPLResetChip(FM_OPL *OPL);
 int OPLWrite(FM_OPL *OPL,int a,int v);
 unsigned char OPLRead(FM_OPL *OPL,int a);
 int OPLTimerOver(FM_OPL *OPL,int c);
+/* bitmask of the channels that sound, bit 0 for channel 0 */
+int OPLActiveChannels(FM_OPL *OPL);
+/* only generate the channels in 'mask', bit 0 for channel 0 */
+void OPLSetChannelMask(FM_OPL *OPL,int mask);
 
 /* YM3626/YM3812 local section */
 void YM3812UpdateOne(FM_OPL *OPL, INT16 *buffer, int length);
@@ -19,12 +19,87 @@
  * fprovide.cpp - File provider class framework, by Simon Peter <dn.tlp@gmx.net>
  */
 
+#include <stdio.h>
 #include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 #include <binio.h>
 #include <binfile.h>
 
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(HAVE_PTHREAD)
+#include <pthread.h>
+#endif
+
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 #include "fprovide.h"
 
+/***** CMemStream *****/
+
+// Stream over 'size' bytes at 'data', opened like CProvider_Filesystem opens
+// files. Unlike libbinio's binisstream, it can seek up to the end of the
+// data, so that filesize() gives the right size, and reads 0xff beyond it
+// like a file does, which players and database keys depend on.
+class CMemStream: public binistream
+{
+public:
+  CMemStream(const unsigned char *newdata, unsigned long newsize)
+    : data(newdata), size(newsize), spos(0)
+  {
+    setFlag(BigEndian, false); setFlag(FloatIEEE);
+  }
+
+  void seek(long p, Offset offs = Set)
+  {
+    long to = offs == Set ? p : (offs == Add ? (long)spos + p : (long)size + p);
+
+    if(to < 0) { err |= Eof; to = 0; }
+    if((unsigned long)to > size) { err |= Eof; to = size; }
+    spos = to;
+  }
+
+  long pos() { return spos; }
+
+  const unsigned char	*data;
+  unsigned long		size;
+
+protected:
+  Byte getByte()
+  {
+    if(spos >= size) { err |= Eof; return 0xff; }
+    return data[spos++];
+  }
+
+private:
+  unsigned long	spos;
+};
+
+/***** CFileStream *****/
+
+// The files of CProvider_Filesystem, which can be read in one go
+class CFileStream: public binifstream
+{
+public:
+  CFileStream(const std::string &filename)
+    : binifstream(filename)
+  {
+  }
+
+  unsigned long read(void *buf, unsigned long size)
+  {
+    unsigned long n = f ? fread(buf, 1, size, f) : 0;
+
+    if(n < size) err |= Eof;
+    return n;
+  }
+};
+
 /***** CFileProvider *****/
 
 bool CFileProvider::extension(const std::string &filename,
@@ -39,6 +114,47 @@ bool CFileProvider::extension(const std::string &filename,
     return true;
 }
 
+const unsigned char *CFileProvider::contents(binistream *f,
+					     unsigned long &size,
+					     unsigned char *&buf) const
+{
+  unsigned long		pos = f->pos(), len;
+  const unsigned char	*data = view(f, len);
+
+  if(!data) len = filesize(f);
+  if(pos > len) pos = len;
+  if(size > len - pos) size = len - pos;
+
+  buf = 0;
+  if(data) {
+    // nothing at the end points to the start, so that it can be handed
+    // back like the rest
+    f->seek(pos + size);
+    return size ? data + pos : data;
+  }
+
+  buf = new unsigned char [size];
+  read(f, buf, size);
+  return buf;
+}
+
+const CFileResource *CFileProvider::resource(const std::string &filename,
+					     ResourceMaker make) const
+{
+  binistream	*f = open(filename);
+  CFileResource	*r;
+
+  if(!f) return 0;
+  r = make(f, *this);
+  close(f);
+  return r;
+}
+
+void CFileProvider::release(const CFileResource *r) const
+{
+  delete r;
+}
+
 unsigned long CFileProvider::filesize(binistream *f)
 {
   unsigned long oldpos = f->pos(), size;
@@ -54,7 +170,7 @@ unsigned long CFileProvider::filesize(binistream *f)
 
 binistream *CProvider_Filesystem::open(std::string filename) const
 {
-  binifstream *f = new binifstream(filename);
+  CFileStream *f = new CFileStream(filename);
 
   if(!f) return 0;
   if(f->error()) { delete f; return 0; }
@@ -74,3 +190,406 @@ void CProvider_Filesystem::close(binistream *f) const
     delete ff;
   }
 }
+
+unsigned long CProvider_Filesystem::read(binistream *f, void *buf,
+					 unsigned long size) const
+{
+  CFileStream *ff = dynamic_cast<CFileStream *>(f);
+
+  // streams of derived providers' own open() are read as usual
+  if(!ff) return CFileProvider::read(f, buf, size);
+  return ff->read(buf, size);
+}
+
+/***** CProvider_Memory *****/
+
+void CProvider_Memory::add(const std::string &filename, const void *data,
+			   unsigned long size)
+{
+  File &file = files[filename];
+
+  file.data = data;
+  file.size = size;
+}
+
+void CProvider_Memory::remove(const std::string &filename)
+{
+  files.erase(filename);
+}
+
+binistream *CProvider_Memory::open(std::string filename) const
+{
+  std::map<std::string, File>::const_iterator i = files.find(filename);
+
+  if(i == files.end()) return 0;
+  return new CMemStream((const unsigned char *)i->second.data,
+			i->second.size);
+}
+
+void CProvider_Memory::close(binistream *f) const
+{
+  if(f) delete (CMemStream *)f;
+}
+
+const unsigned char *CProvider_Memory::view(binistream *f,
+					    unsigned long &size,
+					    bool keep) const
+{
+  size = ((CMemStream *)f)->size;
+  return ((CMemStream *)f)->data;
+}
+
+/***** CProvider_Mmap *****/
+
+CProvider_Mmap::~CProvider_Mmap()
+{
+  Mappings::iterator i;
+
+  for(i = maps.begin(); i != maps.end(); i++)
+    unmap(i->first, i->second.size);
+}
+
+binistream *CProvider_Mmap::open(std::string filename) const
+{
+  static unsigned char	empty;
+  unsigned char		*data;
+  unsigned long		size;
+
+#ifdef HAVE_SYS_MMAN_H
+  struct stat	st;
+  int		fd = ::open(filename.c_str(), O_RDONLY);
+  void		*p;
+
+  if(fd < 0) return 0;
+  if(fstat(fd, &st) || !S_ISREG(st.st_mode)) { ::close(fd); return 0; }
+
+  size = st.st_size;
+  p = size ? mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0) : 0;
+  ::close(fd);
+  if(p == MAP_FAILED) return 0;
+  data = (unsigned char *)p;
+#else
+  binifstream	f(filename);
+
+  if(f.error()) return 0;
+  size = filesize(&f);
+  data = size ? new unsigned char [size] : 0;
+  if(size) f.readString((char *)data, size);
+#endif
+
+  // an empty file has nothing to map
+  if(!data) return new CMemStream(&empty, 0);
+
+  Mapping &m = maps[data];
+  m.size = size;
+  m.refs = 1;
+  return new CMemStream(data, size);
+}
+
+void CProvider_Mmap::close(binistream *f) const
+{
+  if(!f) return;
+
+  unsigned char *data = (unsigned char *)((CMemStream *)f)->data;
+  Mappings::iterator i = maps.find(data);
+
+  delete (CMemStream *)f;
+  if(i != maps.end()) unref(i);
+}
+
+const unsigned char *CProvider_Mmap::view(binistream *f,
+					  unsigned long &size,
+					  bool keep) const
+{
+  unsigned char *data = (unsigned char *)((CMemStream *)f)->data;
+  Mappings::iterator i = maps.find(data);
+
+  if(keep && i != maps.end()) i->second.refs++;
+  size = ((CMemStream *)f)->size;
+  return data;
+}
+
+void CProvider_Mmap::unview(const unsigned char *data) const
+{
+  // the mapping starting last at or before 'data'
+  Mappings::iterator i = maps.upper_bound((unsigned char *)data);
+
+  if(i == maps.begin()) return;
+  i--;
+  if(data < i->first + i->second.size) unref(i);
+}
+
+void CProvider_Mmap::unref(Mappings::iterator i) const
+  /*
+   * Unmaps mapping 'i' when it is neither open nor viewed any more.
+   */
+{
+  if(--i->second.refs) return;
+
+  unmap(i->first, i->second.size);
+  maps.erase(i);
+}
+
+void CProvider_Mmap::unmap(unsigned char *data, unsigned long size)
+{
+#ifdef HAVE_SYS_MMAN_H
+  munmap(data, size);
+#else
+  delete [] data;
+#endif
+}
+
+/***** CProvider_Cache *****/
+
+// Holds the cache's mutex while in scope. Without threads to guard
+// against, there is nothing to hold.
+class CCacheLock
+{
+public:
+  CCacheLock(void *newlock)
+    : lock(newlock)
+  {
+    acquire();
+  }
+
+  ~CCacheLock()
+  {
+    release();
+  }
+
+  void acquire()
+  {
+#if defined(_WIN32)
+    EnterCriticalSection((CRITICAL_SECTION *)lock);
+#elif defined(HAVE_PTHREAD)
+    pthread_mutex_lock((pthread_mutex_t *)lock);
+#endif
+  }
+
+  void release()
+  {
+#if defined(_WIN32)
+    LeaveCriticalSection((CRITICAL_SECTION *)lock);
+#elif defined(HAVE_PTHREAD)
+    pthread_mutex_unlock((pthread_mutex_t *)lock);
+#endif
+  }
+
+  // Lets go of the mutex until condition 'cond' is signalled
+  void wait(void *cond)
+  {
+#if defined(_WIN32)
+    SleepConditionVariableCS((CONDITION_VARIABLE *)cond,
+			     (CRITICAL_SECTION *)lock, INFINITE);
+#elif defined(HAVE_PTHREAD)
+    pthread_cond_wait((pthread_cond_t *)cond, (pthread_mutex_t *)lock);
+#endif
+  }
+
+  // Wakes all threads waiting for condition 'cond'
+  static void signal(void *cond)
+  {
+#if defined(_WIN32)
+    WakeAllConditionVariable((CONDITION_VARIABLE *)cond);
+#elif defined(HAVE_PTHREAD)
+    pthread_cond_broadcast((pthread_cond_t *)cond);
+#endif
+  }
+
+private:
+  void	*lock;
+};
+
+CProvider_Cache::CProvider_Cache(const CFileProvider &newfp,
+				 unsigned long newmaxsize)
+  : fp(newfp), maxsize(newmaxsize), lock(0), ready(0), memsize(0), made(0),
+    hits(0)
+{
+#if defined(_WIN32)
+  lock = new CRITICAL_SECTION;
+  InitializeCriticalSection((CRITICAL_SECTION *)lock);
+  ready = new CONDITION_VARIABLE;
+  InitializeConditionVariable((CONDITION_VARIABLE *)ready);
+#elif defined(HAVE_PTHREAD)
+  lock = new pthread_mutex_t;
+  pthread_mutex_init((pthread_mutex_t *)lock, 0);
+  ready = new pthread_cond_t;
+  pthread_cond_init((pthread_cond_t *)ready, 0);
+#endif
+}
+
+CProvider_Cache::~CProvider_Cache()
+{
+  std::map<const CFileResource *, Entry *>::iterator i;
+
+  for(i = given.begin(); i != given.end(); i++) {
+    CFileProvider::release(i->second->res);
+    delete i->second;
+  }
+
+#if defined(_WIN32)
+  DeleteCriticalSection((CRITICAL_SECTION *)lock);
+  delete (CRITICAL_SECTION *)lock;
+  delete (CONDITION_VARIABLE *)ready;
+#elif defined(HAVE_PTHREAD)
+  pthread_mutex_destroy((pthread_mutex_t *)lock);
+  delete (pthread_mutex_t *)lock;
+  pthread_cond_destroy((pthread_cond_t *)ready);
+  delete (pthread_cond_t *)ready;
+#endif
+}
+
+binistream *CProvider_Cache::open(std::string filename) const
+{
+  return fp.open(filename);
+}
+
+void CProvider_Cache::close(binistream *f) const
+{
+  fp.close(f);
+}
+
+const unsigned char *CProvider_Cache::view(binistream *f, unsigned long &size,
+					   bool keep) const
+{
+  return fp.view(f, size, keep);
+}
+
+void CProvider_Cache::unview(const unsigned char *data) const
+{
+  fp.unview(data);
+}
+
+unsigned long CProvider_Cache::read(binistream *f, void *buf,
+				    unsigned long size) const
+{
+  return fp.read(f, buf, size);
+}
+
+const CFileResource *CProvider_Cache::resource(const std::string &filename,
+					       ResourceMaker make) const
+{
+  CCacheLock	locked(lock);
+  Key		key(filename, make);
+  struct stat	st;
+  long		mtimens = 0;
+  Entry		*e;
+
+  if(stat(filename.c_str(), &st)) return fp.resource(filename, make);
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+  mtimens = st.st_mtim.tv_nsec;
+#endif
+
+  // another thread is making it, take what it made
+  std::map<Key, Entry *>::iterator i;
+  while((i = entries.find(key)) != entries.end() && i->second->making)
+    locked.wait(ready);
+
+  if(i != entries.end()) {
+    e = i->second;
+    if(e->size == (unsigned long)st.st_size && e->mtime == (long)st.st_mtime &&
+       e->mtimens == mtimens) {
+      lru.splice(lru.begin(), lru, e->lru);
+      e->refs++; hits++;
+      return e->res;
+    }
+    uncache(e);		// the file has changed
+  }
+
+  /*
+   * Made without the lock, so that other threads go on with other files
+   * meanwhile. The entry tells those asking for the same file to wait, so
+   * that it is made only once.
+   */
+  e = new Entry;
+  e->key = key;
+  e->size = st.st_size;
+  e->mtime = st.st_mtime;
+  e->mtimens = mtimens;
+  e->res = 0;
+  e->refs = 1;
+  e->cached = true;
+  e->making = true;
+  entries[key] = e;
+
+  CFileResource *r = 0;
+  locked.release();
+  binistream *f = fp.open(filename);
+  if(f) {
+    r = make(f, *this);
+    fp.close(f);
+  }
+  locked.acquire();
+
+  e->making = false;
+  CCacheLock::signal(ready);
+  if(!r) {
+    entries.erase(key);
+    delete e;
+    return 0;
+  }
+  made++;
+
+  e->res = r;
+  e->lru = lru.insert(lru.begin(), e);
+  given[r] = e;
+  memsize += r->memsize();
+
+  trim();
+  return r;
+}
+
+void CProvider_Cache::release(const CFileResource *r) const
+{
+  CCacheLock locked(lock);
+  std::map<const CFileResource *, Entry *>::iterator i = given.find(r);
+
+  if(i == given.end()) {	// not cached
+    fp.release(r);
+    return;
+  }
+
+  Entry *e = i->second;
+  if(--e->refs || e->cached) {
+    trim();
+    return;
+  }
+
+  given.erase(i);
+  CFileProvider::release(e->res);
+  delete e;
+}
+
+void CProvider_Cache::uncache(Entry *e) const
+  /*
+   * Takes entry 'e' out of the cache. It is gone as soon as no player uses
+   * it any more. Called with the lock held.
+   */
+{
+  entries.erase(e->key);
+  lru.erase(e->lru);
+  memsize -= e->res->memsize();
+  e->cached = false;
+
+  if(e->refs) return;
+  given.erase(e->res);
+  CFileProvider::release(e->res);
+  delete e;
+}
+
+void CProvider_Cache::trim() const
+  /*
+   * Drops the least recently used resources that no player uses, until all
+   * of them fit into 'maxsize' bytes. Called with the lock held.
+   */
+{
+  std::list<Entry *>::iterator i = lru.end();
+
+  while(memsize > maxsize && i != lru.begin()) {
+    Entry *e = *--i;
+
+    if(e->refs) continue;
+    i = e->lru; i++;	// uncache() erases 'e' from the list
+    uncache(e);
+  }
+}
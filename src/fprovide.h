@@ -23,11 +23,32 @@
 #define H_ADPLUG_FILEPROVIDER
 
 #include <string>
+#include <map>
+#include <list>
 #include <binio.h>
 
+class CFileProvider;
+
+// What a player makes of a companion file, one that many songs load besides
+// their own, like an instrument bank. It isn't changed once it is made, so
+// that players and threads can share it, see CProvider_Cache.
+class CFileResource
+{
+public:
+  virtual ~CFileResource()
+    {
+    }
+
+  virtual unsigned long memsize() const = 0;	// bytes it takes up
+};
+
 class CFileProvider
 {
 public:
+  // Makes a resource of the open file 'f', or returns 0 if it can't
+  typedef CFileResource *(*ResourceMaker)(binistream *f,
+					  const CFileProvider &fp);
+
   virtual ~CFileProvider()
     {
     }
@@ -35,6 +56,44 @@ public:
   virtual binistream *open(std::string) const = 0;
   virtual void close(binistream *) const = 0;
 
+  // The whole file 'f', opened by this provider, if the provider keeps it
+  // in memory, or 0. Sets 'size' to its size. Players may keep pointers
+  // into it after close(), until they hand it back with unview(). Without
+  // 'keep', it is only used until close() and not handed back.
+  virtual const unsigned char *view(binistream *f, unsigned long &size,
+				    bool keep = true) const
+    {
+      return 0;
+    }
+
+  // Hands back a view kept from view() or contents(), given by any
+  // pointer into it, once it is no longer used.
+  virtual void unview(const unsigned char *data) const
+    {
+    }
+
+  // Reads the next 'size' bytes of 'f' into 'buf' and returns how many
+  // there were, like readString() does, in one go where the provider can.
+  virtual unsigned long read(binistream *f, void *buf,
+			     unsigned long size) const
+    {
+      return f->readString((char *)buf, size);
+    }
+
+  // The next 'size' bytes of 'f', or as many as are left, setting 'size'
+  // to how many. Points into view() where there is one, to be handed back
+  // with unview(), else reads them into a new[] buffer, which is also put
+  // into 'buf' to delete[] later.
+  const unsigned char *contents(binistream *f, unsigned long &size,
+				unsigned char *&buf) const;
+
+  // What 'make' makes of the file 'filename', or 0 if it can't be opened
+  // or made. To be handed back with release() when no longer used. Makes
+  // it anew for every call, CProvider_Cache shares it instead.
+  virtual const CFileResource *resource(const std::string &filename,
+					ResourceMaker make) const;
+  virtual void release(const CFileResource *r) const;
+
   static bool extension(const std::string &filename,
 			const std::string &extension);
   static unsigned long filesize(binistream *f);
@@ -45,6 +104,130 @@ class CProvider_Filesystem: public CFileProvider
 public:
   virtual binistream *open(std::string filename) const;
   virtual void close(binistream *f) const;
+  virtual unsigned long read(binistream *f, void *buf,
+			     unsigned long size) const;
+};
+
+// Opens files from buffers of the caller, by the names they were added
+// with. The buffers have to stay valid, and unchanged, as long as the
+// provider and the players loaded through it are used.
+class CProvider_Memory: public CFileProvider
+{
+public:
+  void add(const std::string &filename, const void *data, unsigned long size);
+  void remove(const std::string &filename);
+
+  virtual binistream *open(std::string filename) const;
+  virtual void close(binistream *f) const;
+  virtual const unsigned char *view(binistream *f, unsigned long &size,
+				    bool keep = true) const;
+
+private:
+  struct File {
+    const void		*data;
+    unsigned long	size;
+  };
+
+  std::map<std::string, File>	files;
+};
+
+// Opens files from the filesystem by mapping them into memory, or reading
+// them into it where there is no mmap(). Files that were given to view()
+// stay mapped until every view is handed back with unview(), or the
+// provider is destroyed, so it has to outlive the players loaded through
+// it. Not to be used from several threads at once.
+class CProvider_Mmap: public CFileProvider
+{
+public:
+  ~CProvider_Mmap();
+
+  virtual binistream *open(std::string filename) const;
+  virtual void close(binistream *f) const;
+  virtual const unsigned char *view(binistream *f, unsigned long &size,
+				    bool keep = true) const;
+  virtual void unview(const unsigned char *data) const;
+
+  // Files mapped at the moment
+  unsigned long getmapped() const { return maps.size(); }
+
+private:
+  struct Mapping {
+    unsigned long	size;
+    unsigned int	refs;		// open streams and kept views
+  };
+
+  typedef std::map<unsigned char *, Mapping> Mappings;
+
+  mutable Mappings	maps;
+
+  void unref(Mappings::iterator i) const;
+  static void unmap(unsigned char *data, unsigned long size);
+};
+
+// Opens files through another provider, and keeps what players make of
+// their companion files with resource() for the next ones that ask for it.
+// Files are told apart by name, size and modification time from stat(),
+// to the nanosecond where the system keeps it. Elsewhere, a file rewritten
+// with the same size within the second it was cached in is taken for the
+// cached one. Files that stat() doesn't know, like those of
+// CProvider_Memory, are made anew every time. Resources no player uses are
+// dropped, least recently used first, while all of them take up more than
+// 'maxsize' bytes. May be used from several threads at once, if the
+// provider it opens files through may. A resource is made without holding
+// up the other threads, except those asking for the same one, which wait
+// for it. Has to outlive the players loaded through it.
+class CProvider_Cache: public CFileProvider
+{
+public:
+  CProvider_Cache(const CFileProvider &newfp,
+		  unsigned long newmaxsize = 1048576);
+  ~CProvider_Cache();
+
+  virtual binistream *open(std::string filename) const;
+  virtual void close(binistream *f) const;
+  virtual const unsigned char *view(binistream *f, unsigned long &size,
+				    bool keep = true) const;
+  virtual void unview(const unsigned char *data) const;
+  virtual unsigned long read(binistream *f, void *buf,
+			     unsigned long size) const;
+  virtual const CFileResource *resource(const std::string &filename,
+					ResourceMaker make) const;
+  virtual void release(const CFileResource *r) const;
+
+  // Resources made and found in the cache so far
+  unsigned long getmade() const { return made; }
+  unsigned long gethits() const { return hits; }
+
+private:
+  typedef std::pair<std::string, ResourceMaker> Key;
+
+  struct Entry {
+    Key			key;
+    unsigned long	size;		// of the file
+    long		mtime, mtimens;
+    const CFileResource	*res;
+    unsigned int	refs;		// players using it
+    bool		cached;		// else dropped when no longer used
+    bool		making;		// res is being made, without the lock
+    std::list<Entry *>::iterator lru;
+  };
+
+  const CFileProvider	&fp;
+  unsigned long		maxsize;
+  void			*lock;		// the platform's mutex
+  void			*ready;		// signalled when a resource is made
+
+  mutable std::map<Key, Entry *>			entries;
+  mutable std::map<const CFileResource *, Entry *>	given;
+  mutable std::list<Entry *>				lru;	// most recent first
+  mutable unsigned long	memsize, made, hits;
+
+  void uncache(Entry *e) const;
+  void trim() const;
+
+  // not to be copied
+  CProvider_Cache(const CProvider_Cache &);
+  CProvider_Cache &operator=(const CProvider_Cache &);
 };
 
 #endif
@@ -27,6 +27,7 @@
 #include <string.h>
 
 #include "got.h"
+#include "snapshot.h"
 #include "database.h"
 
 /*** public methods *************************************/
@@ -36,7 +37,20 @@ CPlayer *CgotPlayer::factory(Copl *newopl)
 	return new CgotPlayer(newopl);
 }
 
-bool CgotPlayer::load(const std::string &filename, const CFileProvider &fp)
+CPlayer::ProbeScore CgotPlayer::probe(const std::string &filename,
+				      const unsigned char *head,
+				      unsigned long len,
+				      unsigned long filesize)
+{
+	// there is no signature
+	if(!CFileProvider::extension(filename, ".got") || filesize % 3 ||
+	   filesize < 9 || len < 2 || head[0] != 1 || head[1])
+		return PROBE_NO;
+
+	return PROBE_MAYBE;
+}
+
+bool CgotPlayer::loadfile(const std::string &filename, const CFileProvider &fp)
 {
 	binistream *f = fp.open(filename); if(!f) return false;
 
@@ -113,3 +127,9 @@ void CgotPlayer::rewind(int subsong)
 	pos = 0; del = 0; timer = rate; songend = false;
 	opl->init(); opl->write(1,32); // go to OPL2 mode
 }
+
+bool CgotPlayer::snapshot(CSnapshot &s)
+{
+	s.io(pos); s.io(del); s.io(songend); s.io(timer);
+	return true;
+}
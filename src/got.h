@@ -33,6 +33,9 @@ class CgotPlayer: public CPlayer
 {
 public:
 	static CPlayer *factory(Copl *newopl);
+	static ProbeScore probe(const std::string &filename,
+				const unsigned char *head,
+				unsigned long len, unsigned long filesize);
 
 	CgotPlayer(Copl *newopl)
 		: CPlayer(newopl), data(0)
@@ -42,7 +45,7 @@ public:
 		if(data) delete [] data;
 	};
 
-	bool load(const std::string &filename, const CFileProvider &fp);
+	bool loadfile(const std::string &filename, const CFileProvider &fp);
 	bool update();
 	void rewind(int subsong);
 
@@ -57,6 +60,8 @@ public:
 	}
 
 protected:
+	bool snapshot(CSnapshot &s);
+
 	unsigned long	pos, size;
 	unsigned short	del;
 	bool		songend;
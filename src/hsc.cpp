@@ -22,7 +22,9 @@
 #include <string.h>
 
 #include "hsc.h"
+#include "snapshot.h"
 #include "debug.h"
+#include "fcursor.h"
 
 /*** public methods **************************************/
 
@@ -31,7 +33,19 @@ CPlayer *ChscPlayer::factory(Copl *newopl)
   return new ChscPlayer(newopl);
 }
 
-bool ChscPlayer::load(const std::string &filename, const CFileProvider &fp)
+CPlayer::ProbeScore ChscPlayer::probe(const std::string &filename,
+				      const unsigned char *head,
+				      unsigned long len,
+				      unsigned long filesize)
+{
+  if(!CFileProvider::extension(filename, ".hsc") || filesize > 59187 + 1 ||
+     filesize < 1587 + 1152)
+    return PROBE_NO;
+
+  return PROBE_MAYBE;
+}
+
+bool ChscPlayer::loadfile(const std::string &filename, const CFileProvider &fp)
 {
   binistream	*f = fp.open(filename);
   int		i;
@@ -43,31 +57,30 @@ bool ChscPlayer::load(const std::string &filename, const CFileProvider &fp)
     || fp.filesize(f) > (59187 + 1)  // +1 is for some files that have a trailing 0x00 on the end
     || fp.filesize(f) < (1587 + 1152) // no 0x00 byte here as this is the smallest possible size
   ) {
-    AdPlug_LogWrite("ChscPlayer::load(\"%s\"): Not a HSC file!\n", filename.c_str());
+    AdPlug_LogWrite("ChscPlayer::loadfile(\"%s\"): Not a HSC file!\n", filename.c_str());
     fp.close(f);
     return false;
   }
 
-  int total_patterns_in_hsc = (fp.filesize(f) - 1587) / 1152;
+  CFileCursor c(fp, f);
+  int total_patterns_in_hsc = (c.filesize() - 1587) / 1152;
 
   // load section
-  for(i=0;i<128*12;i++)		// load instruments
-    *((unsigned char *)instr + i) = f->readInt(1);
+  c.bytes(instr, 128*12);		// load instruments
   for (i=0;i<128;i++) {			// correct instruments
     instr[i][2] ^= (instr[i][2] & 0x40) << 1;
     instr[i][3] ^= (instr[i][3] & 0x40) << 1;
     instr[i][11] >>= 4;			// slide
   }
   for(i=0;i<51;i++) {	// load tracklist
-    song[i] = f->readInt(1);
+    song[i] = c.u8();
     // if out of range, song ends here
     if (
       ((song[i] & 0x7F) > 0x31)
       || ((song[i] & 0x7F) >= total_patterns_in_hsc)
     ) song[i] = 0xFF;
   }
-  for(i=0;i<50*64*9;i++)			// load patterns
-    *((char *)patterns + i) = f->readInt(1);
+  c.bytes(patterns, 50*64*9);		// load patterns
 
   fp.close(f);
   rewind(0);					// rewind module
@@ -247,6 +260,15 @@ void ChscPlayer::rewind(int subsong)
     setinstr((char) i,(char) i);	// init channels
 }
 
+bool ChscPlayer::snapshot(CSnapshot &s)
+{
+  s.io(channel);
+  s.io(pattpos); s.io(songpos); s.io(pattbreak); s.io(songend);
+  s.io(mode6); s.io(bd); s.io(fadein); s.io(speed); s.io(del);
+  s.io(adl_freq);
+  return true;
+}
+
 unsigned int ChscPlayer::getpatterns()
 {
   unsigned char	poscnt,pattcnt=0;
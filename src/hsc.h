@@ -28,10 +28,13 @@ class ChscPlayer: public CPlayer
 {
  public:
   static CPlayer *factory(Copl *newopl);
+  static ProbeScore probe(const std::string &filename,
+			  const unsigned char *head,
+			  unsigned long len, unsigned long filesize);
 
   ChscPlayer(Copl *newopl): CPlayer(newopl), mtkmode(0) {}
 
-  bool load(const std::string &filename, const CFileProvider &fp);
+  bool loadfile(const std::string &filename, const CFileProvider &fp);
   bool update();
   void rewind(int subsong);
   float getrefresh() { return 18.2f; };	// refresh rate is fixed at 18.2Hz
@@ -46,6 +49,8 @@ class ChscPlayer: public CPlayer
   unsigned int getinstruments();
 
  protected:
+  bool snapshot(CSnapshot &s);
+
   struct hscnote {
     unsigned char note, effect;
   };	// note type in HSC pattern
@@ -28,7 +28,19 @@ CPlayer *ChspLoader::factory(Copl *newopl)
   return new ChspLoader(newopl);
 }
 
-bool ChspLoader::load(const std::string &filename, const CFileProvider &fp)
+CPlayer::ProbeScore ChspLoader::probe(const std::string &filename,
+				      const unsigned char *head,
+				      unsigned long len,
+				      unsigned long filesize)
+{
+  if(!CFileProvider::extension(filename, ".hsp") || len < 2 ||
+     (head[0] | head[1] << 8) > 59187)
+    return PROBE_NO;
+
+  return PROBE_MAYBE;
+}
+
+bool ChspLoader::loadfile(const std::string &filename, const CFileProvider &fp)
 {
   binistream	*f = fp.open(filename); if(!f) return false;
   unsigned long	i, j, orgsize, filesize;
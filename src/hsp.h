@@ -28,12 +28,15 @@ class ChspLoader: public ChscPlayer
 {
 public:
   static CPlayer *factory(Copl *newopl);
+  static ProbeScore probe(const std::string &filename,
+			  const unsigned char *head,
+			  unsigned long len, unsigned long filesize);
 
 	ChspLoader(Copl *newopl)
 		: ChscPlayer(newopl)
 	{};
 
-	bool load(const std::string &filename, const CFileProvider &fp);
+	bool loadfile(const std::string &filename, const CFileProvider &fp);
 };
 
 #endif
@@ -29,6 +29,7 @@
 */
 
 #include "hybrid.h"
+#include "snapshot.h"
 #include "debug.h"
 
 const unsigned char CxadhybridPlayer::hyb_adlib_registers[99] = 
@@ -67,6 +68,14 @@ CPlayer *CxadhybridPlayer::factory(Copl *newopl)
   return new CxadhybridPlayer(newopl);
 }
 
+CPlayer::ProbeScore CxadhybridPlayer::probe(const std::string &filename,
+					    const unsigned char *head,
+					    unsigned long len,
+					    unsigned long filesize)
+{
+  return probe_xad(head, len, HYBRID);
+}
+
 bool CxadhybridPlayer::xadplayer_load()
 {
   if(xad.fmt != HYBRID)
@@ -227,6 +236,16 @@ update_slides:
     }
 }
 
+bool CxadhybridPlayer::xadplayer_snapshot(CSnapshot &s)
+{
+  s.io(hyb.order_pos);
+  s.io(hyb.pattern_pos);
+  s.io(hyb.channel);
+  s.io(hyb.speed);
+  s.io(hyb.speed_counter);
+  return true;
+}
+
 float CxadhybridPlayer::xadplayer_getrefresh()
 {
   return 50.0f;
@@ -25,6 +25,9 @@ class CxadhybridPlayer: public CxadPlayer
 {
 public:
   static CPlayer *factory(Copl *newopl);
+  static ProbeScore probe(const std::string &filename,
+			  const unsigned char *head,
+			  unsigned long len, unsigned long filesize);
 
   CxadhybridPlayer(Copl *newopl): CxadPlayer(newopl)
     { }
@@ -68,6 +71,7 @@ protected:
   bool            xadplayer_load();
   void            xadplayer_rewind(int subsong);
   void            xadplayer_update();
+  bool            xadplayer_snapshot(CSnapshot &s);
   float           xadplayer_getrefresh();
   std::string     xadplayer_gettype();
   std::string     xadplayer_getinstrument(unsigned int i);
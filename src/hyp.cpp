@@ -29,6 +29,7 @@
 */
 
 #include "hyp.h"
+#include "snapshot.h"
 #include "debug.h"
 
 const unsigned char CxadhypPlayer::hyp_adlib_registers[99] =
@@ -62,6 +63,14 @@ CPlayer *CxadhypPlayer::factory(Copl *newopl)
   return new CxadhypPlayer(newopl);
 }
 
+CPlayer::ProbeScore CxadhypPlayer::probe(const std::string &filename,
+					 const unsigned char *head,
+					 unsigned long len,
+					 unsigned long filesize)
+{
+  return probe_xad(head, len, HYP);
+}
+
 void CxadhypPlayer::xadplayer_rewind(int subsong)
 {
   int i;
@@ -114,6 +123,12 @@ void CxadhypPlayer::xadplayer_update()
   }
 }
 
+bool CxadhypPlayer::xadplayer_snapshot(CSnapshot &s)
+{
+  s.io(hyp);
+  return true;
+}
+
 float CxadhypPlayer::xadplayer_getrefresh()
 {
   return 60.0f;
@@ -25,6 +25,9 @@ class CxadhypPlayer: public CxadPlayer
 {
 public:
   static CPlayer *factory(Copl *newopl);
+  static ProbeScore probe(const std::string &filename,
+			  const unsigned char *head,
+			  unsigned long len, unsigned long filesize);
 
   CxadhypPlayer(Copl *newopl): CxadPlayer(newopl)
     { }
@@ -44,6 +47,7 @@ protected:
     }
   void 		    xadplayer_rewind(int subsong);
   void 		    xadplayer_update();
+  bool		    xadplayer_snapshot(CSnapshot &s);
   float 	    xadplayer_getrefresh();
   std::string	    xadplayer_gettype();
 
@@ -44,7 +44,9 @@
 #include <string.h>
 
 #include "imf.h"
+#include "snapshot.h"
 #include "database.h"
+#include "fcursor.h"
 
 /*** public methods *************************************/
 
@@ -53,9 +55,26 @@ CPlayer *CimfPlayer::factory(Copl *newopl)
   return new CimfPlayer(newopl);
 }
 
-bool CimfPlayer::load(const std::string &filename, const CFileProvider &fp)
+CPlayer::ProbeScore CimfPlayer::probe(const std::string &filename,
+				      const unsigned char *head,
+				      unsigned long len,
+				      unsigned long filesize)
+{
+  if(len >= 6 && !memcmp(head, "ADLIB", 5) && head[5] == 1)
+    return PROBE_YES;
+
+  // plain files have no header
+  if(CFileProvider::extension(filename, ".imf") ||
+     CFileProvider::extension(filename, ".wlf"))
+    return PROBE_MAYBE;
+
+  return PROBE_NO;
+}
+
+bool CimfPlayer::loadfile(const std::string &filename, const CFileProvider &fp)
 {
   binistream *f = fp.open(filename); if(!f) return false;
+  CFileCursor c(fp, f);
   unsigned long fsize, flsize, mfsize = 0;
   unsigned int i;
 
@@ -64,8 +83,8 @@ bool CimfPlayer::load(const std::string &filename, const CFileProvider &fp)
     char	header[5];
     int		version;
 
-    f->readString(header, 5);
-    version = f->readInt(1);
+    c.bytes(header, 5);
+    version = c.u8();
 
     if(strncmp(header, "ADLIB", 5) || version != 1) {
       if(!fp.extension(filename, ".imf") && !fp.extension(filename, ".wlf")) {
@@ -73,50 +92,50 @@ bool CimfPlayer::load(const std::string &filename, const CFileProvider &fp)
 	fp.close(f);
 	return false;
       } else
-	f->seek(0);	// It's a normal IMF file
+	c.seek(0);	// It's a normal IMF file
     } else {
       // It's a IMF file with header
-      track_name = f->readString('\0');
-      game_name = f->readString('\0');
-      f->ignore(1);
-      mfsize = f->pos() + 2;
+      track_name = c.str('\0');
+      game_name = c.str('\0');
+      c.skip(1);
+      mfsize = c.pos() + 2;
     }
   }
 
   // load section
   if(mfsize)
-    fsize = f->readInt(4);
+    fsize = c.u32le();
   else
-    fsize = f->readInt(2);
-  flsize = fp.filesize(f);
+    fsize = c.u16le();
+  flsize = c.filesize();
   if(!fsize) {		// footerless file (raw music data)
     if(mfsize)
-      f->seek(-4, binio::Add);
+      c.seek(c.pos() - 4);
     else
-      f->seek(-2, binio::Add);
+      c.seek(c.pos() - 2);
     size = (flsize - mfsize) / 4;
   } else		// file has got a footer
     size = fsize / 4;
 
   data = new Sdata[size];
   for(i = 0; i < size; i++) {
-    data[i].reg = f->readInt(1); data[i].val = f->readInt(1);
-    data[i].time = f->readInt(2);
+    data[i].reg = c.u8(); data[i].val = c.u8();
+    data[i].time = c.u16le();
   }
 
   // read footer, if any
   if(fsize && (fsize < flsize - 2 - mfsize)) {
-    if(f->readInt(1) == 0x1a) {
+    if(c.u8() == 0x1a) {
       // Adam Nielsen's footer format
-      track_name = f->readString();
-      author_name = f->readString();
-      remarks = f->readString();
+      track_name = c.str();
+      author_name = c.str();
+      remarks = c.str();
     } else {
       // Generic footer
       unsigned long footerlen = flsize - fsize - 2 - mfsize;
 
       footer = new char[footerlen + 1];
-      f->readString(footer, footerlen);
+      c.bytes(footer, footerlen);
       footer[footerlen] = '\0';	// Make ASCIIZ string
     }
   }
@@ -150,6 +169,12 @@ void CimfPlayer::rewind(int subsong)
 	opl->init(); opl->write(1,32);	// go to OPL2 mode
 }
 
+bool CimfPlayer::snapshot(CSnapshot &s)
+{
+  s.io(pos); s.io(del); s.io(songend); s.io(timer);
+  return true;
+}
+
 std::string CimfPlayer::gettitle()
 {
   std::string	title;
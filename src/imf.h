@@ -28,6 +28,9 @@ class CimfPlayer: public CPlayer
 {
 public:
   static CPlayer *factory(Copl *newopl);
+  static ProbeScore probe(const std::string &filename,
+			  const unsigned char *head,
+			  unsigned long len, unsigned long filesize);
 
 	CimfPlayer(Copl *newopl)
 	  : CPlayer(newopl), footer(0), data(0)
@@ -35,7 +38,7 @@ public:
 	~CimfPlayer()
 	  { if(data) delete [] data; if(footer) delete [] footer; };
 
-	bool load(const std::string &filename, const CFileProvider &fp);
+	bool loadfile(const std::string &filename, const CFileProvider &fp);
 	bool update();
 	void rewind(int subsong);
 	float getrefresh()
@@ -49,6 +52,8 @@ public:
 	std::string getdesc();
 
 protected:
+	bool snapshot(CSnapshot &s);
+
 	unsigned long	pos, size;
 	unsigned short	del;
 	bool		songend;
@@ -30,6 +30,7 @@
  */
 
 #include "jbm.h"
+#include "snapshot.h"
 
 static const unsigned short notetable[96] = {
   0x0158, 0x016d, 0x0183, 0x019a, 0x01b2, 0x01cc, 0x01e7, 0x0204,
@@ -63,7 +64,19 @@ CPlayer *CjbmPlayer::factory(Copl *newopl)
   return new CjbmPlayer(newopl);
 }
 
-bool CjbmPlayer::load(const std::string &filename, const CFileProvider &fp)
+CPlayer::ProbeScore CjbmPlayer::probe(const std::string &filename,
+				      const unsigned char *head,
+				      unsigned long len,
+				      unsigned long filesize)
+{
+  if(!filesize || !CFileProvider::extension(filename, ".jbm") || len < 2 ||
+     head[0] != 0x02 || head[1])
+    return PROBE_NO;
+
+  return PROBE_YES;
+}
+
+bool CjbmPlayer::loadfile(const std::string &filename, const CFileProvider &fp)
 {
   binistream	*f = fp.open(filename); if(!f) return false;
   int		filelen = fp.filesize(f);
@@ -228,6 +241,12 @@ void CjbmPlayer::rewind(int subsong)
   return;
 }
 
+bool CjbmPlayer::snapshot(CSnapshot &s)
+{
+  s.io(voicemask); s.io(bdreg); s.io(voice);
+  return true;
+}
+
 /*** private methods ************************************/
 
 void CjbmPlayer::opl_noteonoff(int channel, JBMVoice *v, bool state)
@@ -28,13 +28,16 @@ class CjbmPlayer: public CPlayer
 {
  public:
   static CPlayer *factory(Copl *newopl);
+  static ProbeScore probe(const std::string &filename,
+			  const unsigned char *head,
+			  unsigned long len, unsigned long filesize);
 
   CjbmPlayer(Copl *newopl) : CPlayer(newopl), m(0)
     { }
   ~CjbmPlayer()
     { if(m != NULL) delete [] m; }
 
-  bool load(const std::string &filename, const CFileProvider &fp);
+  bool loadfile(const std::string &filename, const CFileProvider &fp);
   bool update();
   void rewind(int subsong);
 
@@ -50,6 +53,8 @@ class CjbmPlayer: public CPlayer
     { return std::string("Johannes Bjerregaard"); }
 
  protected:
+  bool snapshot(CSnapshot &s);
+
 
   unsigned char *m;
   float timer;
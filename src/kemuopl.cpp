@@ -0,0 +1,91 @@
+/*
+ * Adplug - Replayer for many OPL2/OPL3 audio file formats.
+ * Copyright (C) 1999 - 2005 Simon Peter, <dn.tlp@gmx.net>, et al.
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * kemuopl.cpp - Emulated OPL using Ken Silverman's emulator, by Simon Peter
+ *               <dn.tlp@gmx.net>
+ */
+
+#include "kemuopl.h"
+#include "sampleconv.h"
+
+// Samples rendered in one go by updatefmt()
+#define CHUNK	512
+
+// Builds the emulator's shared tables at load time, see adlibinittables()
+// in adlibemu.h
+static struct CKemuoplTables {
+  CKemuoplTables() { adlibinittables(); }
+} tables;
+
+CKemuopl::CKemuopl(int rate, bool bit16, bool usestereo)
+  : use16bit(bit16), stereo(usestereo)
+{
+  chip = new adlibchip;
+  adlibinit(chip, rate, usestereo ? 2 : 1, bit16 ? 2 : 1);
+  currType = TYPE_OPL2;
+}
+
+CKemuopl::~CKemuopl()
+{
+  delete chip;
+}
+
+void CKemuopl::update(short *buf, int samples)
+{
+  int size = (use16bit ? 2 : 1) * (stereo ? 2 : 1), n;
+
+  for(; samples > 0; samples -= n) {
+    n = dequeue(samples);
+    adlibgetsample(chip, buf, n * size);
+    buf = (short *)((char *)buf + n * size);
+  }
+}
+
+bool CKemuopl::updatefmt(void **bufs, int samples, const Format &fmt)
+{
+  short		buf[CHUNK * 2];
+  long		bytes = chip->bytespersample;
+  unsigned long	done, n;
+
+  // converted from 16 bit samples, whatever the emulator was set up with
+  chip->bytespersample = 2;
+  for(done = 0; done < (unsigned long)samples; done += n) {
+    n = dequeue(samples - done < CHUNK ? samples - done : CHUNK);
+    adlibgetsample(chip, buf, n * (stereo ? 4 : 2));
+    if(stereo)
+      sampleconv(buf, buf + 1, 2, bufs, done, n, fmt);
+    else
+      sampleconv(buf, buf, 1, bufs, done, n, fmt);
+  }
+  chip->bytespersample = bytes;
+
+  return true;
+}
+
+void CKemuopl::write(int reg, int val)
+{
+  if(currChip == 0)
+    adlib0(chip, reg, val);
+}
+
+void CKemuopl::write_batch(const RegWrite *w, size_t n)
+{
+  for(size_t i = 0; i < n; i++)
+    if(w[i].chip == 0)
+      adlib0(chip, w[i].reg, w[i].val);
+}
@@ -31,31 +31,38 @@ extern "C" {
 class CKemuopl: public Copl
 {
 public:
-  CKemuopl(int rate, bool bit16, bool usestereo)
-    : use16bit(bit16), stereo(usestereo)
+  CKemuopl(int rate, bool bit16, bool usestereo);	// rate = sample rate
+  virtual ~CKemuopl();
+
+  void update(short *buf, int samples);			// fill buffer
+  bool updatefmt(void **bufs, int samples, const Format &fmt);
+  unsigned long getactive()
     {
-      adlibinit(rate, usestereo ? 2 : 1, bit16 ? 2 : 1);
-      currType = TYPE_OPL2;
-    };
+      return adlibactive(chip);
+    }
 
-  void update(short *buf, int samples)
+  void setchannelmask(unsigned long mask)
     {
-      if(use16bit) samples *= 2;
-      if(stereo) samples *= 2;
-      adlibgetsample(buf, samples);
+      Copl::setchannelmask(mask);
+      chip->chanmask = channelmask;
     }
 
   // template methods
-  void write(int reg, int val)
+  void write(int reg, int val);
+  void write_at(unsigned long offset, int reg, int val)
     {
-      if(currChip == 0)
-	adlib0(reg, val);
-    };
+      enqueue(offset, reg, val);
+    }
+  void write_batch(const RegWrite *w, size_t n);
 
-  void init() {};
+  void init()
+    {
+      clearqueue();
+    }
 
 private:
-  bool	use16bit,stereo;
+  bool		use16bit,stereo;
+  adlibchip	*chip;					// emulator state
 };
 
 #endif
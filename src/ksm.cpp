@@ -22,8 +22,20 @@
 #include <string.h>
 
 #include "ksm.h"
+#include "fcursor.h"
+#include "snapshot.h"
 #include "debug.h"
 
+// The instruments of an insts.dat, shared by the songs next to it
+class CksmInsts: public CFileResource
+{
+public:
+  char		name[256][20];
+  unsigned char	data[256][11];
+
+  unsigned long memsize() const { return sizeof(*this); }
+};
+
 const unsigned int CksmPlayer::adlibfreq[63] = {
   0,
   2390,2411,2434,2456,2480,2506,2533,2562,2592,2625,2659,2695,
@@ -40,7 +52,16 @@ CPlayer *CksmPlayer::factory(Copl *newopl)
   return new CksmPlayer(newopl);
 }
 
-bool CksmPlayer::load(const std::string &filename, const CFileProvider &fp)
+CPlayer::ProbeScore CksmPlayer::probe(const std::string &filename,
+				      const unsigned char *head,
+				      unsigned long len,
+				      unsigned long filesize)
+{
+  // there is no signature, the instruments are in a file of their own
+  return CFileProvider::extension(filename, ".ksm") ? PROBE_MAYBE : PROBE_NO;
+}
+
+bool CksmPlayer::loadfile(const std::string &filename, const CFileProvider &fp)
 {
   binistream	*f;
   int		i;
@@ -48,12 +69,12 @@ bool CksmPlayer::load(const std::string &filename, const CFileProvider &fp)
 
   // file validation section
   if(!fp.extension(filename, ".ksm")) {
-    AdPlug_LogWrite("CksmPlayer::load(,\"%s\"): File doesn't have '.ksm' "
+    AdPlug_LogWrite("CksmPlayer::loadfile(,\"%s\"): File doesn't have '.ksm' "
 		    "extension! Rejected!\n", filename.c_str());
     delete [] fn;
     return false;
   }
-  AdPlug_LogWrite("*** CksmPlayer::load(,\"%s\") ***\n", filename.c_str());
+  AdPlug_LogWrite("*** CksmPlayer::loadfile(,\"%s\") ***\n", filename.c_str());
 
   // Load instruments from 'insts.dat'
   strcpy(fn, filename.c_str());
@@ -62,15 +83,16 @@ bool CksmPlayer::load(const std::string &filename, const CFileProvider &fp)
       break;
   strcpy(fn + i + 1, "insts.dat");
   AdPlug_LogWrite("Instruments file: \"%s\"\n", fn);
-  f = fp.open(fn);
+  const CksmInsts *insts = (const CksmInsts *)fp.resource(fn, loadinsts);
   delete [] fn;
-  if(!f) {
+  if(!insts) {
     AdPlug_LogWrite("Couldn't open instruments file! Aborting!\n");
     AdPlug_LogWrite("--- CksmPlayer::load ---\n");
     return false;
   }
-  loadinsts(f);
-  fp.close(f);
+  memcpy(instname, insts->name, sizeof(instname));
+  memcpy(inst, insts->data, sizeof(inst));
+  fp.release(insts);
 
   f = fp.open(filename); if(!f) return false;
   for(i = 0; i < 16; i++) trinst[i] = f->readInt(1);
@@ -290,6 +312,13 @@ void CksmPlayer::rewind(int subsong)
   nownote = 0;
 }
 
+bool CksmPlayer::snapshot(CSnapshot &s)
+{
+  s.io(count); s.io(countstop); s.io(chanage); s.io(nownote);
+  s.io(drumstat); s.io(chanfreq); s.io(chantrack); s.io(songend);
+  return true;
+}
+
 std::string CksmPlayer::getinstrument(unsigned int n)
 {
   if(trchan[n])
@@ -300,15 +329,18 @@ std::string CksmPlayer::getinstrument(unsigned int n)
 
 /*** private methods *************************************/
 
-void CksmPlayer::loadinsts(binistream *f)
+CFileResource *CksmPlayer::loadinsts(binistream *f, const CFileProvider &fp)
 {
-  int i, j;
+  CFileCursor	c(fp, f);
+  CksmInsts	*insts = new CksmInsts;
 
-  for(i = 0; i < 256; i++) {
-    f->readString(instname[i], 20);
-    for(j = 0; j < 11; j++) inst[i][j] = f->readInt(1);
-    f->ignore(2);
+  for(int i = 0; i < 256; i++) {
+    c.bytes(insts->name[i], 20);
+    c.bytes(insts->data[i], 11);
+    c.skip(2);
   }
+
+  return insts;
 }
 
 void CksmPlayer::setinst(int chan,
@@ -25,6 +25,9 @@ class CksmPlayer: public CPlayer
 {
 public:
   static CPlayer *factory(Copl *newopl);
+  static ProbeScore probe(const std::string &filename,
+			  const unsigned char *head,
+			  unsigned long len, unsigned long filesize);
 
 	CksmPlayer(Copl *newopl)
 		: CPlayer(newopl), note(0)
@@ -32,7 +35,7 @@ public:
 	~CksmPlayer()
 	{ if(note) delete [] note; };
 
-	bool load(const std::string &filename, const CFileProvider &fp);
+	bool loadfile(const std::string &filename, const CFileProvider &fp);
 	bool update();
 	void rewind(int subsong);
 	float getrefresh()
@@ -45,6 +48,8 @@ public:
 	std::string getinstrument(unsigned int n);
 
 private:
+	bool snapshot(CSnapshot &s);
+
 	static const unsigned int adlibfreq[63];
 
 	unsigned long count,countstop,chanage[18],*note;
@@ -55,7 +60,7 @@ private:
 
 	bool songend;
 
-	void loadinsts(binistream *f);
+	static CFileResource *loadinsts(binistream *f, const CFileProvider &fp);
 	void setinst(int chan,unsigned char v0,unsigned char v1,unsigned char v2,unsigned char v3,
 				 unsigned char v4,unsigned char v5,unsigned char v6,unsigned char v7,
 				 unsigned char v8,unsigned char v9,unsigned char v10);
@@ -22,6 +22,7 @@
 #include <string.h>
 
 #include "lds.h"
+#include "snapshot.h"
 #include "debug.h"
 
 // Note frequency table (16 notes / octave)
@@ -83,7 +84,19 @@ CldsPlayer::~CldsPlayer()
   if(patterns) delete [] patterns;
 }
 
-bool CldsPlayer::load(const std::string &filename, const CFileProvider &fp)
+CPlayer::ProbeScore CldsPlayer::probe(const std::string &filename,
+				      const unsigned char *head,
+				      unsigned long len,
+				      unsigned long filesize)
+{
+  // there is no signature
+  if(!CFileProvider::extension(filename, ".lds") || len < 1 || head[0] > 2)
+    return PROBE_NO;
+
+  return PROBE_MAYBE;
+}
+
+bool CldsPlayer::loadfile(const std::string &filename, const CFileProvider &fp)
 {
   binistream	*f;
   unsigned int	i, j;
@@ -140,7 +153,7 @@ bool CldsPlayer::load(const std::string &filename, const CFileProvider &fp)
       positions[i * 9 + j].transpose = f->readInt(1);
     }
 
-  AdPlug_LogWrite("CldsPlayer::load(\"%s\",fp): loading LOUDNESS file: mode = "
+  AdPlug_LogWrite("CldsPlayer::loadfile(\"%s\",fp): loading LOUDNESS file: mode = "
 		  "%d, pattlen = %d, numpatch = %d, numposi = %d\n",
 		  filename.c_str(), mode, pattlen, numpatch, numposi);
 
@@ -544,6 +557,15 @@ void CldsPlayer::rewind(int subsong)
   }
 }
 
+bool CldsPlayer::snapshot(CSnapshot &s)
+{
+  s.io(channel); s.io(fmchip);
+  s.io(jumping); s.io(fadeonoff); s.io(allvolume); s.io(hardfade);
+  s.io(tempo_now); s.io(pattplay); s.io(tempo); s.io(posplay); s.io(jumppos);
+  s.io(playing); s.io(songlooped); s.io(mainvolume);
+  return true;
+}
+
 /*** private methods *************************************/
 
 void CldsPlayer::playsound(int inst_number, int channel_number, int tunehigh)
@@ -25,11 +25,14 @@ class CldsPlayer: public CPlayer
 {
  public:
   static CPlayer *factory(Copl *newopl) { return new CldsPlayer(newopl); }
+  static ProbeScore probe(const std::string &filename,
+			  const unsigned char *head,
+			  unsigned long len, unsigned long filesize);
 
   CldsPlayer(Copl *newopl);
   virtual ~CldsPlayer();
 
-  bool load(const std::string &filename, const CFileProvider &fp);
+  bool loadfile(const std::string &filename, const CFileProvider &fp);
   virtual bool update();
   virtual void rewind(int subsong = -1);
   float getrefresh() { return 1193182.0f / speed; }
@@ -42,6 +45,8 @@ class CldsPlayer: public CPlayer
   unsigned int getinstruments() { return numpatch; }
 
  private:
+  bool snapshot(CSnapshot &s);
+
   typedef struct {
     unsigned char	mod_misc, mod_vol, mod_ad, mod_sr, mod_wave,
       car_misc, car_vol, car_ad, car_sr, car_wave, feedback, keyoff,
@@ -21,6 +21,7 @@
 
 #include <cstring>
 #include "mad.h"
+#include "fcursor.h"
 
 /* -------- Public Methods -------------------------------- */
 
@@ -29,26 +30,35 @@ CPlayer *CmadLoader::factory(Copl *newopl)
   return new CmadLoader(newopl);
 }
 
-bool CmadLoader::load(const std::string &filename, const CFileProvider &fp)
+CPlayer::ProbeScore CmadLoader::probe(const std::string &filename,
+				      const unsigned char *head,
+				      unsigned long len,
+				      unsigned long filesize)
+{
+	return len >= 4 && !memcmp(head, "MAD+", 4) ? PROBE_YES : PROBE_NO;
+}
+
+bool CmadLoader::loadfile(const std::string &filename, const CFileProvider &fp)
 {
   binistream *f = fp.open(filename); if(!f) return false;
+  CFileCursor c(fp, f);
   const unsigned char conv_inst[10] = { 2,1,10,9,4,3,6,5,8,7 };
   unsigned int i, j, k, t = 0;
 
   // 'MAD+' - signed ?
-  char id[4]; f->readString(id, 4);
+  char id[4]; c.bytes(id, 4);
   if (strncmp(id,"MAD+",4)) { fp.close(f); return false; }
 
   // load instruments
   for(i = 0; i < 9; i++) {
-    f->readString(instruments[i].name, 8);
-    for(j = 0; j < 12; j++) instruments[i].data[j] = f->readInt(1);
+    c.bytes(instruments[i].name, 8);
+    for(j = 0; j < 12; j++) instruments[i].data[j] = c.u8();
   }
 
-  f->ignore(1);
+  c.skip(1);
 
   // data for Protracker
-  length = f->readInt(1); nop = f->readInt(1); timer = f->readInt(1);
+  length = c.u8(); nop = c.u8(); timer = c.u8();
 
   // init CmodPlayer
   realloc_instruments(9);
@@ -63,7 +73,7 @@ bool CmadLoader::load(const std::string &filename, const CFileProvider &fp)
 	t = i * 9 + j;
 
 	// read event
-	unsigned char event = f->readInt(1);
+	unsigned char event = c.u8();
 
 	// convert event
 	if (event < 0x61)
@@ -75,7 +85,7 @@ bool CmadLoader::load(const std::string &filename, const CFileProvider &fp)
       }
 
   // load order
-  for(i = 0; i < length; i++) order[i] = f->readInt(1) - 1;
+  for(i = 0; i < length; i++) order[i] = c.u8() - 1;
 
   fp.close(f);
 
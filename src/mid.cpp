@@ -81,6 +81,8 @@
 #include <string.h>
 #include "mid.h"
 #include "mididata.h"
+#include "fcursor.h"
+#include "snapshot.h"
 
 /*#define TESTING*/
 #ifdef TESTING
@@ -128,7 +130,7 @@ CPlayer *CmidPlayer::factory(Copl *newopl)
 
 CmidPlayer::CmidPlayer(Copl *newopl)
   : CPlayer(newopl), author(&emptystr), title(&emptystr), remarks(&emptystr),
-    emptystr('\0'), flen(0), data(0)
+    emptystr('\0'), flen(0), cursubsong(0), data(0), databuf(0), datafp(0)
 {
 }
 
@@ -178,69 +180,90 @@ unsigned long CmidPlayer::getval()
 	return(v);
 }
 
-bool CmidPlayer::load_sierra_ins(const std::string &fname, const CFileProvider &fp)
+// The instruments of a Sierra patch.003, shared by the songs next to it
+class CmidSierraBank: public CFileResource
 {
-    long i,j,k,l;
-    unsigned char ins[28];
-    char *pfilename;
-    binistream *f;
+public:
+    unsigned char ins[96][11];
 
-    pfilename = (char *)malloc(fname.length()+9);
-    strcpy(pfilename,fname.c_str());
-    j=0;
-    for(i=strlen(pfilename)-1; i >= 0; i--)
-      if(pfilename[i] == '/' || pfilename[i] == '\\') {
-	j = i+1;
-	break;
-      }
-    sprintf(pfilename+j+3,"patch.003");
+    unsigned long memsize() const { return sizeof(*this); }
+};
 
-    f = fp.open(pfilename);
-    free(pfilename);
-    if(!f) return false;
+CFileResource *CmidPlayer::load_sierra_bank(binistream *f, const CFileProvider &fp)
+{
+    long i,k,l;
+    unsigned char ins[28];
+    CFileCursor c(fp, f);
+    CmidSierraBank *bank = new CmidSierraBank;
 
-    f->ignore(2);
-    stins = 0;
+    c.skip(2);
     for (i=0; i<2; i++)
         {
         for (k=0; k<48; k++)
             {
             l=i*48+k;
-            midiprintf ("\n%2ld: ",l);
-            for (j=0; j<28; j++)
-                ins[j] = f->readInt(1);
+            c.bytes(ins, 28);
 
-            myinsbank[l][0]=
+            bank->ins[l][0]=
                 (ins[9]*0x80) + (ins[10]*0x40) +
                 (ins[5]*0x20) + (ins[11]*0x10) +
                 ins[1];   //1=ins5
-            myinsbank[l][1]=
+            bank->ins[l][1]=
                 (ins[22]*0x80) + (ins[23]*0x40) +
                 (ins[18]*0x20) + (ins[24]*0x10) +
                 ins[14];  //1=ins18
 
-            myinsbank[l][2]=(ins[0]<<6)+ins[8];
-            myinsbank[l][3]=(ins[13]<<6)+ins[21];
+            bank->ins[l][2]=(ins[0]<<6)+ins[8];
+            bank->ins[l][3]=(ins[13]<<6)+ins[21];
 
-            myinsbank[l][4]=(ins[3]<<4)+ins[6];
-            myinsbank[l][5]=(ins[16]<<4)+ins[19];
-            myinsbank[l][6]=(ins[4]<<4)+ins[7];
-            myinsbank[l][7]=(ins[17]<<4)+ins[20];
+            bank->ins[l][4]=(ins[3]<<4)+ins[6];
+            bank->ins[l][5]=(ins[16]<<4)+ins[19];
+            bank->ins[l][6]=(ins[4]<<4)+ins[7];
+            bank->ins[l][7]=(ins[17]<<4)+ins[20];
 
-            myinsbank[l][8]=ins[26];
-            myinsbank[l][9]=ins[27];
+            bank->ins[l][8]=ins[26];
+            bank->ins[l][9]=ins[27];
 
-            myinsbank[l][10]=((ins[2]<<1))+(1-(ins[12]&1));
+            bank->ins[l][10]=((ins[2]<<1))+(1-(ins[12]&1));
             //(ins[12] ? 0:1)+((ins[2]<<1));
-
-            for (j=0; j<11; j++)
-                midiprintf ("%02X ",myinsbank[l][j]);
-			stins++;
             }
-		f->ignore(2);
+		c.skip(2);
         }
 
-    fp.close(f);
+    return bank;
+}
+
+bool CmidPlayer::load_sierra_ins(const std::string &fname, const CFileProvider &fp)
+{
+    long i,j,l;
+    char *pfilename;
+    const CmidSierraBank *bank;
+
+    pfilename = (char *)malloc(fname.length()+9);
+    strcpy(pfilename,fname.c_str());
+    j=0;
+    for(i=strlen(pfilename)-1; i >= 0; i--)
+      if(pfilename[i] == '/' || pfilename[i] == '\\') {
+	j = i+1;
+	break;
+      }
+    sprintf(pfilename+j+3,"patch.003");
+
+    bank = (const CmidSierraBank *)fp.resource(pfilename, load_sierra_bank);
+    free(pfilename);
+    if(!bank) return false;
+
+    stins = 0;
+    for (l=0; l<96; l++)
+        {
+        midiprintf ("\n%2ld: ",l);
+        memcpy(myinsbank[l], bank->ins[l], 11);
+        for (j=0; j<11; j++)
+            midiprintf ("%02X ",myinsbank[l][j]);
+        stins++;
+        }
+
+    fp.release(bank);
     memcpy(smyinsbank, myinsbank, 128 * 16);
     return true;
 }
@@ -281,7 +304,23 @@ void CmidPlayer::sierra_next_section()
     doing=1;
 }
 
-bool CmidPlayer::load(const std::string &filename, const CFileProvider &fp)
+CPlayer::ProbeScore CmidPlayer::probe(const std::string &filename,
+				      const unsigned char *head,
+				      unsigned long len,
+				      unsigned long filesize)
+{
+    if(len < 6) return PROBE_NO;
+
+    switch(head[0]) {
+    case 'A': return !memcmp(head, "ADL", 3) ? PROBE_YES : PROBE_NO;
+    case 'M': return !memcmp(head, "MThd", 4) ? PROBE_YES : PROBE_NO;
+    case 'C': return !memcmp(head, "CTMF", 4) ? PROBE_YES : PROBE_NO;
+    case 0x84: return !head[1] ? PROBE_MAYBE : PROBE_NO;	// needs its patches
+    default: return head[4] == 'A' && head[5] == 'D' ? PROBE_YES : PROBE_NO;
+    }
+}
+
+bool CmidPlayer::loadfile(const std::string &filename, const CFileProvider &fp)
 {
     binistream *f = fp.open(filename); if(!f) return false;
     int good;
@@ -323,9 +362,12 @@ bool CmidPlayer::load(const std::string &filename, const CFileProvider &fp)
 
     type=good;
     f->seek(0);
-    flen = fp.filesize(f);
-    data = new unsigned char [flen];
-    f->readString((char *)data, flen);
+    unsigned long size = fp.filesize(f);
+    delete [] databuf;
+    if(datafp) datafp->unview(data);
+    data = fp.contents(f, size, databuf);
+    datafp = databuf ? 0 : &fp;
+    flen = size;
 
     fp.close(f);
     rewind(0);
@@ -334,7 +376,7 @@ bool CmidPlayer::load(const std::string &filename, const CFileProvider &fp)
 
 void CmidPlayer::midi_write_adlib(unsigned int r, unsigned char v)
 {
-  opl->write(r,v);
+  batch.write(opl,r,v);
   adlib_data[r]=v;
 }
 
@@ -443,6 +485,7 @@ void CmidPlayer::midi_fm_reset()
 {
     int i;
 
+    batch.flush(opl);
     opl->init();
 
     for (i=0; i<256; i++)
@@ -848,12 +891,22 @@ fwait=1.0f/(((float)iwait/(float)deltas)*((float)msqtr/(float)1000000));
             }
     */
 
+	batch.flush(opl);
 	if(ret)
 		return true;
 	else
 		return false;
 }
 
+bool CmidPlayer::snapshot(CSnapshot &s)
+{
+    s.io(pos); s.io(sierra_pos); s.io(cursubsong);
+    s.io(adlib_data); s.io(adlib_style); s.io(adlib_mode);
+    s.io(ch); s.io(chp); s.io(deltas); s.io(msqtr);
+    s.io(track); s.io(curtrack); s.io(fwait); s.io(iwait); s.io(doing);
+    return true;
+}
+
 float CmidPlayer::getrefresh()
 {
     return (fwait > 0.01f ? fwait : 0.01f);
@@ -894,6 +947,7 @@ void CmidPlayer::rewind(int subsong)
     iwait=0;
 
     subsongs=1;
+    cursubsong=0;
 
     for (i=0; i<16; i++)
         {
@@ -1037,6 +1091,7 @@ void CmidPlayer::rewind(int subsong)
                     }
 
                 if (subsong < 0 || subsong >= subsongs) subsong=0;
+                cursubsong=subsong;
 
                 sierra_pos=o_sierra_pos;
                 sierra_next_section();
@@ -1087,6 +1142,7 @@ void CmidPlayer::rewind(int subsong)
 
     doing=1;
     midi_fm_reset();
+    batch.flush(opl);
 }
 
 std::string CmidPlayer::gettype()
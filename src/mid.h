@@ -25,12 +25,15 @@ class CmidPlayer: public CPlayer
 {
 public:
   static CPlayer *factory(Copl *newopl);
+  static ProbeScore probe(const std::string &filename,
+			  const unsigned char *head,
+			  unsigned long len, unsigned long filesize);
 
   CmidPlayer(Copl *newopl);
   ~CmidPlayer()
-    { if(data) delete [] data; }
+    { delete [] databuf; if(datafp) datafp->unview(data); }
 
-  bool load(const std::string &filename, const CFileProvider &fp);
+  bool loadfile(const std::string &filename, const CFileProvider &fp);
   bool update();
   void rewind(int subsong);
   float getrefresh();
@@ -46,6 +49,8 @@ public:
     { return tins; }
   unsigned int getsubsongs()
     { return subsongs; }
+  unsigned int getsubsong()
+    { return cursubsong; }
 
  protected:
   static const unsigned char adlib_opadd[];
@@ -72,10 +77,13 @@ public:
   long flen;
   unsigned long pos;
   unsigned long sierra_pos; //sierras gotta be special.. :>
-  int subsongs;
-  unsigned char *data;
+  int subsongs, cursubsong;
+  const unsigned char *data;
+  unsigned char *databuf;	// data, unless the file provider keeps it
+  const CFileProvider *datafp;	// keeps it, to unview() it
 
   unsigned char adlib_data[256];
+  CWriteBatch batch;	// OPL writes of the current call
   int adlib_style;
   int adlib_mode;
   unsigned char myinsbank[128][16], smyinsbank[128][16];
@@ -94,8 +102,11 @@ public:
 
   int type,tins,stins;
 
+  bool snapshot(CSnapshot &s);
+
  private:
   bool load_sierra_ins(const std::string &fname, const CFileProvider &fp);
+  static CFileResource *load_sierra_bank(binistream *f, const CFileProvider &fp);
   void midiprintf(const char *format, ...);
   unsigned char datalook(long pos);
   unsigned long getnexti(unsigned long num);
@@ -23,6 +23,7 @@
 #include <assert.h>
 
 #include "mkj.h"
+#include "snapshot.h"
 #include "debug.h"
 
 CPlayer *CmkjPlayer::factory(Copl *newopl)
@@ -30,7 +31,15 @@ CPlayer *CmkjPlayer::factory(Copl *newopl)
   return new CmkjPlayer(newopl);
 }
 
-bool CmkjPlayer::load(const std::string &filename, const CFileProvider &fp)
+CPlayer::ProbeScore CmkjPlayer::probe(const std::string &filename,
+				      const unsigned char *head,
+				      unsigned long len,
+				      unsigned long filesize)
+{
+  return len >= 6 && !memcmp(head, "MKJamz", 6) ? PROBE_YES : PROBE_NO;
+}
+
+bool CmkjPlayer::loadfile(const std::string &filename, const CFileProvider &fp)
 {
   binistream *f = fp.open(filename); if(!f) return false;
   char	id[6];
@@ -64,7 +73,7 @@ bool CmkjPlayer::load(const std::string &filename, const CFileProvider &fp)
   for(i = 0; i < (maxchannel + 1) * maxnotes; i++)
     songbuf[i] = f->readInt(2);
 
-  AdPlug_LogWrite("CmkjPlayer::load(\"%s\"): loaded file ver %.2f, %d channels,"
+  AdPlug_LogWrite("CmkjPlayer::loadfile(\"%s\"): loaded file ver %.2f, %d channels,"
 		  " %d notes/channel.\n", filename.c_str(), ver, maxchannel,
 		  maxnotes);
   fp.close(f);
@@ -158,6 +167,12 @@ void CmkjPlayer::rewind(int subsong)
   songend = false;
 }
 
+bool CmkjPlayer::snapshot(CSnapshot &s)
+{
+  s.io(channel); s.io(songend);
+  return true;
+}
+
 float CmkjPlayer::getrefresh()
 {
   return 100.0f;
@@ -25,6 +25,9 @@ class CmkjPlayer: public CPlayer
 {
 public:
   static CPlayer *factory(Copl *newopl);
+  static ProbeScore probe(const std::string &filename,
+			  const unsigned char *head,
+			  unsigned long len, unsigned long filesize);
 
 	CmkjPlayer(Copl *newopl)
 		: CPlayer(newopl), songbuf(0)
@@ -32,7 +35,7 @@ public:
 	~CmkjPlayer()
 	{ if(songbuf) delete [] songbuf; }
 
-	bool load(const std::string &filename, const CFileProvider &fp);
+	bool loadfile(const std::string &filename, const CFileProvider &fp);
 	bool update();
 	void rewind(int subsong);
 	float getrefresh();
@@ -41,6 +44,8 @@ public:
 	{ return std::string("MKJamz Audio File"); }
 
 private:
+	bool snapshot(CSnapshot &s);
+
 	short maxchannel,maxnotes,*songbuf;
 	bool songend;
 
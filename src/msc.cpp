@@ -23,6 +23,7 @@
 #include <stdio.h>
 
 #include "msc.h"
+#include "snapshot.h"
 #include "debug.h"
 
 const unsigned char CmscPlayer::msc_signature [MSC_SIGN_LEN] = {
@@ -63,7 +64,19 @@ CmscPlayer::~CmscPlayer()
     delete [] desc;
 }
 
-bool CmscPlayer::load(const std::string & filename, const CFileProvider & fp)
+CPlayer::ProbeScore CmscPlayer::probe(const std::string &filename,
+				      const unsigned char *head,
+				      unsigned long len,
+				      unsigned long filesize)
+{
+  if(len < MSC_SIGN_LEN + 2 || memcmp(head, msc_signature, MSC_SIGN_LEN) ||
+     head[MSC_SIGN_LEN] || head[MSC_SIGN_LEN + 1])
+    return PROBE_NO;
+
+  return PROBE_YES;
+}
+
+bool CmscPlayer::loadfile(const std::string & filename, const CFileProvider & fp)
 {
   binistream * 	bf;
   msc_header	hdr;
@@ -166,6 +179,18 @@ void CmscPlayer::rewind(int subsong)
   opl->write(1, 32);
 }
 
+bool CmscPlayer::snapshot(CSnapshot &s)
+{
+  // decoder state, including the decompression history
+  s.io(block_num); s.io(block_pos); s.io(raw_pos);
+  s.io(raw_data, block_len);
+  s.io(dec_prefix); s.io(dec_dist); s.io(dec_len);
+
+  // player state
+  s.io(delay); s.io(play_pos);
+  return true;
+}
+
 float CmscPlayer::getrefresh()
 {
   // PC timer oscillator frequency / wait register
@@ -28,11 +28,14 @@ class CmscPlayer: public CPlayer
 {
  public:
   static CPlayer * factory(Copl * newopl);
+  static ProbeScore probe(const std::string &filename,
+			  const unsigned char *head,
+			  unsigned long len, unsigned long filesize);
 
   CmscPlayer(Copl * newopl);
   ~CmscPlayer();
 	
-  bool load(const std::string &filename, const CFileProvider &fp);
+  bool loadfile(const std::string &filename, const CFileProvider &fp);
   bool update();
   void rewind(int subsong);
   float getrefresh();
@@ -40,6 +43,8 @@ class CmscPlayer: public CPlayer
   std::string gettype ();
 
  protected:
+  bool snapshot(CSnapshot &s);
+
   typedef unsigned char		u8;
   typedef unsigned short	u16;
 
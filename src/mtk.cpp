@@ -21,6 +21,7 @@
 
 #include <cstring>
 #include "mtk.h"
+#include "fcursor.h"
 
 /*** public methods **************************************/
 
@@ -29,9 +30,21 @@ CPlayer *CmtkLoader::factory(Copl *newopl)
   return new CmtkLoader(newopl);
 }
 
-bool CmtkLoader::load(const std::string &filename, const CFileProvider &fp)
+CPlayer::ProbeScore CmtkLoader::probe(const std::string &filename,
+				      const unsigned char *head,
+				      unsigned long len,
+				      unsigned long filesize)
+{
+  if(len < 18 || memcmp(head, "mpu401tr\x92kk\xeer@data", 18))
+    return PROBE_NO;
+
+  return PROBE_YES;
+}
+
+bool CmtkLoader::loadfile(const std::string &filename, const CFileProvider &fp)
 {
   binistream *f = fp.open(filename); if(!f) return false;
+  CFileCursor c(fp, f);
   struct {
     char id[18];
     unsigned short crc,size;
@@ -46,19 +59,19 @@ bool CmtkLoader::load(const std::string &filename, const CFileProvider &fp)
   unsigned short ctrlbits=0,ctrlmask=0,cmd,cnt,offs;
 
   // read header
-  f->readString(header.id, 18);
-  header.crc = f->readInt(2);
-  header.size = f->readInt(2);
+  c.bytes(header.id, 18);
+  header.crc = c.u16le();
+  header.size = c.u16le();
 
   // file validation section
   if(strncmp(header.id,"mpu401tr\x92kk\xeer@data",18))
     { fp.close(f); return false; }
 
   // load section
-  cmpsize = fp.filesize(f) - 22;
+  cmpsize = c.filesize() - 22;
   cmp = new unsigned char[cmpsize];
   org = new unsigned char[header.size];
-  for(i = 0; i < cmpsize; i++) cmp[i] = f->readInt(1);
+  c.bytes(cmp, cmpsize);
   fp.close(f);
 
   while(cmpptr < cmpsize) {	// decompress
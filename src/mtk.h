@@ -25,6 +25,9 @@ class CmtkLoader: public ChscPlayer
 {
  public:
   static CPlayer *factory(Copl *newopl);
+  static ProbeScore probe(const std::string &filename,
+			  const unsigned char *head,
+			  unsigned long len, unsigned long filesize);
 
   CmtkLoader(Copl *newopl)
     : ChscPlayer(newopl)
@@ -32,7 +35,7 @@ class CmtkLoader: public ChscPlayer
       mtkmode = 1;
     };
 
-  bool load(const std::string &filename, const CFileProvider &fp);
+  bool loadfile(const std::string &filename, const CFileProvider &fp);
 
   std::string gettype()
     { return std::string("MPU-401 Trakker"); };
@@ -19,12 +19,29 @@
  * nemuopl.cpp - Emulated OPL using the Nuked OPL3 emulator
  */
 
+#include <cstring>
 #include "nemuopl.h"
+#include "sampleconv.h"
 
 extern "C" {
 #include "nukedopl.h"
 }
 
+// Picks the emulator's operator evaluation for this CPU while the library is
+// loaded, before any thread can create a chip.
+static struct CNemuoplInit {
+  CNemuoplInit() { OPL3_Init(); }
+} init;
+
+// Moves a pointer into the chip state at 'from' over to the chip at 'to'
+template <class T> static void relocate(T *&p, const opl3_chip *from, opl3_chip *to)
+{
+  const char *cp = (const char *)p, *cfrom = (const char *)from;
+
+  if(cp >= cfrom && cp < cfrom + sizeof(opl3_chip))
+    p = (T *)((char *)to + (cp - cfrom));
+}
+
 CNemuopl::CNemuopl(int rate)
 {
   opl = new opl3_chip();
@@ -39,12 +56,110 @@ CNemuopl::~CNemuopl()
 
 void CNemuopl::update(short *buf, int samples)
 {
-  OPL3_GenerateStream(opl, buf, samples);
+  for(int n; samples > 0; samples -= n, buf += n * 2) {
+    n = dequeue(samples);
+    OPL3_GenerateStream(opl, buf, n);
+  }
+}
+
+bool CNemuopl::updatefmt(void **bufs, int samples, const Format &fmt)
+{
+  return sampleconv_update(this, true, bufs, samples, fmt);
+}
+
+bool CNemuopl::updatestems(short *buf, short **stems, int samples)
+{
+  short	*part[18];
+  int	n, c;
+
+  for(c = 0; c < 18; c++)
+    part[c] = stems[c];
+  for(; samples > 0; samples -= n, buf += n * 2) {
+    n = dequeue(samples);
+    OPL3_GenerateStreamStems(opl, buf, part, n);
+    for(c = 0; c < 18; c++)
+      if(part[c]) part[c] += n * 2;
+  }
+
+  return true;
+}
+
+void CNemuopl::write_at(unsigned long offset, int reg, int val)
+{
+  enqueue(offset, reg, val);
+}
+
+void CNemuopl::write_batch(const RegWrite *w, size_t n)
+{
+  for(size_t i = 0; i < n; i++)
+    OPL3_WriteRegBuffered(opl, (w[i].chip << 8) | w[i].reg, w[i].val);
 }
 
-void CNemuopl::write(int reg, int val)
+unsigned long CNemuopl::getactive()
 {
-  OPL3_WriteRegBuffered(opl, (currChip << 8) | reg, val);
+  return OPL3_ActiveChannels(opl);
 }
 
-void CNemuopl::init() {}
+void CNemuopl::setchannelmask(unsigned long mask)
+{
+  Copl::setchannelmask(mask);
+  OPL3_SetChannelMask(opl, channelmask);
+}
+
+void CNemuopl::init()
+{
+  clearqueue();
+}
+
+bool CNemuopl::save_state(std::string &state)
+{
+  // The chip is stored together with its address, so all the internal
+  // slot/channel pointers can be relocated when it is restored.
+  state.assign((const char *)&opl, sizeof(opl));
+  state.append((const char *)opl, sizeof(opl3_chip));
+  state.append((const char *)&currChip, sizeof(currChip));
+  return true;
+}
+
+bool CNemuopl::load_state(const std::string &state)
+{
+  const opl3_chip *from;
+  int i, j;
+
+  if(state.size() != sizeof(from) + sizeof(opl3_chip) + sizeof(currChip))
+    return false;
+
+  // refuse states taken at a different sample rate
+  const opl3_chip *chip = (const opl3_chip *)(state.data() + sizeof(from));
+  if(memcmp(&chip->rateratio, &opl->rateratio, sizeof(opl->rateratio)))
+    return false;
+
+  memcpy(&from, state.data(), sizeof(from));
+  memcpy(opl, chip, sizeof(opl3_chip));
+  memcpy(&currChip, state.data() + sizeof(from) + sizeof(opl3_chip),
+	 sizeof(currChip));
+  clearqueue();
+
+  // the channel mask is a setting, it doesn't go with the state
+  OPL3_SetChannelMask(opl, channelmask);
+
+  if(from == opl) return true;
+
+  for(i = 0; i < 36; i++) {
+    relocate(opl->slot[i].channel, from, opl);
+    relocate(opl->slot[i].chip, from, opl);
+    relocate(opl->slot[i].mod, from, opl);
+    relocate(opl->slot[i].trem, from, opl);
+  }
+
+  for(i = 0; i < 18; i++) {
+    relocate(opl->channel[i].slots[0], from, opl);
+    relocate(opl->channel[i].slots[1], from, opl);
+    relocate(opl->channel[i].pair, from, opl);
+    relocate(opl->channel[i].chip, from, opl);
+    for(j = 0; j < 4; j++)
+      relocate(opl->channel[i].out[j], from, opl);
+  }
+
+  return true;
+}
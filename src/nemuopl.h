@@ -22,10 +22,13 @@
 #ifndef H_ADPLUG_NEMUOPL
 #define H_ADPLUG_NEMUOPL
 
+#include <stdint.h>
 #include "opl.h"
 
 typedef struct _opl3_chip opl3_chip;
 
+extern "C" void OPL3_WriteRegBuffered(opl3_chip *chip, uint16_t reg, uint8_t v);
+
 class CNemuopl: public Copl
 {
 public:
@@ -33,11 +36,23 @@ public:
   ~CNemuopl();
 
   void update(short *buf, int samples);
-
-  void write(int reg, int val);
+  bool updatefmt(void **bufs, int samples, const Format &fmt);
+  bool updatestems(short *buf, short **stems, int samples);
+  unsigned long getactive();
+  void setchannelmask(unsigned long mask);
+
+  void write(int reg, int val)
+    {
+      OPL3_WriteRegBuffered(opl, (currChip << 8) | reg, val);
+    }
+  void write_at(unsigned long offset, int reg, int val);
+  void write_batch(const RegWrite *w, size_t n);
 
   void init();
 
+  bool save_state(std::string &state);
+  bool load_state(const std::string &state);
+
 private:
   opl3_chip*	opl;
 };
@@ -32,7 +32,23 @@
 #include <string.h>
 #include "nukedopl.h"
 
+// AVX2 operator evaluation, picked at run time if the CPU supports it
+#if !defined(NUKEDOPL_NO_SIMD) && (defined(__x86_64__) || defined(__i386__)) \
+ && ((defined(__GNUC__) && __GNUC__ >= 5) || defined(__clang__))
+#define OPL_AVX2
+#define OPL_TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#elif !defined(NUKEDOPL_NO_SIMD) && (defined(_M_X64) || defined(_M_IX86)) \
+   && defined(_MSC_VER) && _MSC_VER >= 1800
+#define OPL_AVX2
+#define OPL_TARGET_AVX2
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
 #define RSM_FRAC    10
+#define OPL_BLOCK_MIN 4
+#define OPL_SILENT_EG 0x180
 
 // Channel types
 
@@ -54,8 +70,11 @@ enum {
 //
 // logsin table
 //
+// This and the exp table have a spare entry at the end, so the last entry
+// can be fetched by a 32-bit gather.
+//
 
-static const Bit16u logsinrom[256] = {
+static const Bit16u logsinrom[256 + 1] = {
     0x859, 0x6c3, 0x607, 0x58b, 0x52e, 0x4e4, 0x4a6, 0x471,
     0x443, 0x41a, 0x3f5, 0x3d3, 0x3b5, 0x398, 0x37e, 0x365,
     0x34e, 0x339, 0x324, 0x311, 0x2ff, 0x2ed, 0x2dc, 0x2cd,
@@ -94,7 +113,7 @@ static const Bit16u logsinrom[256] = {
 // exp table
 //
 
-static const Bit16u exprom[256] = {
+static const Bit16u exprom[256 + 1] = {
     0x000, 0x003, 0x006, 0x008, 0x00b, 0x00e, 0x011, 0x014,
     0x016, 0x019, 0x01c, 0x01f, 0x022, 0x025, 0x028, 0x02a,
     0x02d, 0x030, 0x033, 0x036, 0x039, 0x03c, 0x03f, 0x042,
@@ -1090,16 +1109,144 @@ static void OPL3_GenerateRhythm2(opl3_chip *chip)
     OPL3_SlotGeneratePhase(channel8->slots[1], phase);
 }
 
-void OPL3_Generate(opl3_chip *chip, Bit16s *buf)
+//
+// Generation
+//
+
+//
+// Channel mask
+//
+// Muted channels aren't generated at all. A 4-op voice is played or muted
+// along with its first channel, even though its output goes through the
+// second one. The rhythm slots depend on each other, they are generated
+// together while any of the rhythm channels is heard.
+//
+
+static Bit8u OPL3_ChannelMuted(opl3_chip *chip, opl3_channel *channel)
+{
+    if (chip->newm && channel->chtype == ch_4op2)
+    {
+        channel = channel->pair;
+    }
+    return !((chip->chmask >> (channel - chip->channel)) & 0x01);
+}
+
+static void OPL3_SlotsMuted(opl3_chip *chip, Bit8u *muted)
+{
+    Bit8u ii;
+
+    if (chip->chmask == OPL_ALLCHANNELS)
+    {
+        memset(muted, 0, 36);
+        return;
+    }
+    for (ii = 0; ii < 36; ii++)
+    {
+        if ((chip->rhy & 0x20) && ii >= 12 && ii < 18)
+        {
+            muted[ii] = !(chip->chmask & 0x1c0);
+        }
+        else
+        {
+            muted[ii] = OPL3_ChannelMuted(chip, chip->slot[ii].channel);
+        }
+    }
+}
+
+//
+// Stems
+//
+// Every channel's part of the output can be put out separately, next to the
+// mix. A 4-op voice sounds through its second channel, but like with the
+// channel mask it goes with the first one. The right output lags one sample
+// behind the left one, as it does in the mix, so the last right part of
+// every channel is kept in 'stemmix'.
+//
+
+//
+// Moves the part of every 4-op voice over to its first channel. 'chout'
+// holds 'n' samples of every channel, one channel after the other.
+//
+static void OPL3_StemsFold(opl3_chip *chip, Bit16s *chout, Bit32u n)
+{
+    opl3_channel *channel;
+    Bit16s *from, *to;
+    Bit8u ii;
+    Bit32u t;
+
+    if (!chip->newm)
+    {
+        return;
+    }
+    for (ii = 0; ii < 18; ii++)
+    {
+        channel = &chip->channel[ii];
+        if (channel->chtype != ch_4op2)
+        {
+            continue;
+        }
+        from = &chout[ii * n];
+        to = &chout[(channel->pair - chip->channel) * n];
+        for (t = 0; t < n; t++)
+        {
+            to[t] += from[t];
+            from[t] = 0;
+        }
+    }
+}
+
+//
+// Puts the channels' parts 'chout' of one sample into 'stems', on the left
+// for 'side' 0 and on the right for 'side' 1.
+//
+static void OPL3_StemsSample(opl3_chip *chip, Bit16s **stems, Bit16s *chout,
+                             Bit8u side)
+{
+    Bit8u ii;
+
+    OPL3_StemsFold(chip, chout, 1);
+    for (ii = 0; ii < 18; ii++)
+    {
+        if (side == 0)
+        {
+            if (stems[ii])
+            {
+                stems[ii][0] = OPL3_ClipSample(chout[ii]);
+            }
+        }
+        else
+        {
+            if (stems[ii])
+            {
+                stems[ii][1] = OPL3_ClipSample(chip->stemmix[ii]);
+            }
+            chip->stemmix[ii] = chout[ii];
+        }
+    }
+}
+
+//
+// Generates one sample into 'buf'. If 'stems' isn't NULL, every channel
+// with a buffer in it gets its own part of the sample there, too.
+//
+static void OPL3_GenerateOne(opl3_chip *chip, Bit16s *buf, Bit16s **stems)
 {
     Bit8u ii;
     Bit8u jj;
     Bit16s accm;
+    Bit8u muted[36];
+    Bit16s chout[18];
+
+    OPL3_SlotsMuted(chip, muted);
 
     buf[1] = OPL3_ClipSample(chip->mixbuff[1]);
 
     for (ii = 0; ii < 12; ii++)
     {
+        if (muted[ii])
+        {
+            continue;
+        }
         OPL3_SlotCalcFB(&chip->slot[ii]);
         OPL3_PhaseGenerate(&chip->slot[ii]);
         OPL3_EnvelopeCalc(&chip->slot[ii]);
@@ -1108,6 +1255,10 @@ void OPL3_Generate(opl3_chip *chip, Bit16s *buf)
 
     for (ii = 12; ii < 15; ii++)
     {
+        if (muted[ii])
+        {
+            continue;
+        }
         OPL3_SlotCalcFB(&chip->slot[ii]);
         OPL3_PhaseGenerate(&chip->slot[ii]);
         OPL3_EnvelopeCalc(&chip->slot[ii]);
@@ -1115,28 +1266,47 @@ void OPL3_Generate(opl3_chip *chip, Bit16s *buf)
 
     if (chip->rhy & 0x20)
     {
-        OPL3_GenerateRhythm1(chip);
+        if (!muted[12])
+        {
+            OPL3_GenerateRhythm1(chip);
+        }
     }
     else
     {
-        OPL3_SlotGenerate(&chip->slot[12]);
-        OPL3_SlotGenerate(&chip->slot[13]);
-        OPL3_SlotGenerate(&chip->slot[14]);
+        for (ii = 12; ii < 15; ii++)
+        {
+            if (!muted[ii])
+            {
+                OPL3_SlotGenerate(&chip->slot[ii]);
+            }
+        }
     }
 
     chip->mixbuff[0] = 0;
     for (ii = 0; ii < 18; ii++)
     {
         accm = 0;
-        for (jj = 0; jj < 4; jj++)
+        if (!OPL3_ChannelMuted(chip, &chip->channel[ii]))
         {
-            accm += *chip->channel[ii].out[jj];
+            for (jj = 0; jj < 4; jj++)
+            {
+                accm += *chip->channel[ii].out[jj];
+            }
+            chip->mixbuff[0] += (Bit16s)(accm & chip->channel[ii].cha);
         }
-        chip->mixbuff[0] += (Bit16s)(accm & chip->channel[ii].cha);
+        chout[ii] = (Bit16s)(accm & chip->channel[ii].cha);
+    }
+    if (stems)
+    {
+        OPL3_StemsSample(chip, stems, chout, 0);
     }
 
     for (ii = 15; ii < 18; ii++)
     {
+        if (muted[ii])
+        {
+            continue;
+        }
         OPL3_SlotCalcFB(&chip->slot[ii]);
         OPL3_PhaseGenerate(&chip->slot[ii]);
         OPL3_EnvelopeCalc(&chip->slot[ii]);
@@ -1144,19 +1314,30 @@ void OPL3_Generate(opl3_chip *chip, Bit16s *buf)
 
     if (chip->rhy & 0x20)
     {
-        OPL3_GenerateRhythm2(chip);
+        if (!muted[15])
+        {
+            OPL3_GenerateRhythm2(chip);
+        }
     }
     else
     {
-        OPL3_SlotGenerate(&chip->slot[15]);
-        OPL3_SlotGenerate(&chip->slot[16]);
-        OPL3_SlotGenerate(&chip->slot[17]);
+        for (ii = 15; ii < 18; ii++)
+        {
+            if (!muted[ii])
+            {
+                OPL3_SlotGenerate(&chip->slot[ii]);
+            }
+        }
     }
 
     buf[0] = OPL3_ClipSample(chip->mixbuff[0]);
 
     for (ii = 18; ii < 33; ii++)
     {
+        if (muted[ii])
+        {
+            continue;
+        }
         OPL3_SlotCalcFB(&chip->slot[ii]);
         OPL3_PhaseGenerate(&chip->slot[ii]);
         OPL3_EnvelopeCalc(&chip->slot[ii]);
@@ -1167,15 +1348,27 @@ void OPL3_Generate(opl3_chip *chip, Bit16s *buf)
     for (ii = 0; ii < 18; ii++)
     {
         accm = 0;
-        for (jj = 0; jj < 4; jj++)
+        if (!OPL3_ChannelMuted(chip, &chip->channel[ii]))
         {
-            accm += *chip->channel[ii].out[jj];
+            for (jj = 0; jj < 4; jj++)
+            {
+                accm += *chip->channel[ii].out[jj];
+            }
+            chip->mixbuff[1] += (Bit16s)(accm & chip->channel[ii].chb);
         }
-        chip->mixbuff[1] += (Bit16s)(accm & chip->channel[ii].chb);
+        chout[ii] = (Bit16s)(accm & chip->channel[ii].chb);
+    }
+    if (stems)
+    {
+        OPL3_StemsSample(chip, stems, chout, 1);
     }
 
     for (ii = 33; ii < 36; ii++)
     {
+        if (muted[ii])
+        {
+            continue;
+        }
         OPL3_SlotCalcFB(&chip->slot[ii]);
         OPL3_PhaseGenerate(&chip->slot[ii]);
         OPL3_EnvelopeCalc(&chip->slot[ii]);
@@ -1203,153 +1396,1083 @@ void OPL3_Generate(opl3_chip *chip, Bit16s *buf)
     }
 
     chip->timer++;
+}
 
-    while (chip->writebuf[chip->writebuf_cur].time <= chip->writebuf_samplecnt)
+//
+// Block generation
+//
+// Between two register writes, a slot only depends on its own state, the
+// chip's timer, tremolo and vibrato position, and on the output of the slot
+// modulating it. So a run of samples is generated one slot at a time, from
+// the lowest slot number up, keeping the slot's state in locals, and the
+// channels are mixed afterwards from the recorded slot outputs. The rhythm
+// slots depend on each other sample by sample, they are generated together.
+//
+
+typedef struct _opl3_block {
+    Bit16u timer[OPL_BLOCK_SIZE];
+    Bit8u vibpos[OPL_BLOCK_SIZE];
+    Bit8u tremolo[OPL_BLOCK_SIZE];
+    Bit32u noise[OPL_BLOCK_SIZE];
+    Bit16s out[36][OPL_BLOCK_SIZE + 1];  // [0] is the output before the run
+    Bit16u phase[OPL_BLOCK_SIZE];
+    Bit16u envelope[OPL_BLOCK_SIZE];
+    Bit32s mix[2][OPL_BLOCK_SIZE];
+    Bit8u quiet[36];  // the slot put out 0 for the whole run
+} opl3_block;
+
+static const Bit16s opl3_zeroblock[OPL_BLOCK_SIZE] = { 0 };
+static const Bit8u opl3_zerotrem[OPL_BLOCK_SIZE] = { 0 };
+
+//
+// Envelope increment for the given rate at timer value 'timer', as
+// OPL3_EnvelopeCalc() works it out.
+//
+static Bit8u OPL3_EnvelopeIncrement(const Bit8u *incstep, Bit8s incsh,
+                                    Bit16u timer)
+{
+    if (incsh > 0)
     {
-        if (!(chip->writebuf[chip->writebuf_cur].reg & 0x200))
+        if ((timer & ((1 << incsh) - 1)) == 0)
         {
-            break;
+            return incstep[(timer >> incsh) & 0x07];
         }
-        chip->writebuf[chip->writebuf_cur].reg &= 0x1ff;
-        OPL3_WriteReg(chip, chip->writebuf[chip->writebuf_cur].reg,
-                      chip->writebuf[chip->writebuf_cur].data);
-        chip->writebuf_cur = (chip->writebuf_cur + 1) % OPL_WRITEBUF_SIZE;
+        return 0;
     }
-    chip->writebuf_samplecnt++;
+    return incstep[timer & 0x07] << (-incsh);
 }
 
-void OPL3_GenerateResampled(opl3_chip *chip, Bit16s *buf)
+//
+// Operator output for a run of phases and envelopes, as given by
+// envelope_sin[wf].
+//
+
+typedef void(*opl3_wavefunc)(Bit8u wf, const Bit16u *phase,
+                             const Bit16u *envelope, Bit16s *out, Bit32u n);
+
+static void OPL3_WaveBlock(Bit8u wf, const Bit16u *phase,
+                           const Bit16u *envelope, Bit16s *out, Bit32u n)
 {
-    while (chip->samplecnt >= chip->rateratio)
+    envelope_sinfunc sinfunc = envelope_sin[wf];
+    Bit32u t;
+
+    for (t = 0; t < n; t++)
     {
-        chip->oldsamples[0] = chip->samples[0];
-        chip->oldsamples[1] = chip->samples[1];
-        OPL3_Generate(chip, chip->samples);
-        chip->samplecnt -= chip->rateratio;
+        out[t] = sinfunc(phase[t], envelope[t]);
     }
-    buf[0] = (Bit16s)((chip->oldsamples[0] * (chip->rateratio - chip->samplecnt)
-                     + chip->samples[0] * chip->samplecnt) / chip->rateratio);
-    buf[1] = (Bit16s)((chip->oldsamples[1] * (chip->rateratio - chip->samplecnt)
-                     + chip->samples[1] * chip->samplecnt) / chip->rateratio);
-    chip->samplecnt += 1 << RSM_FRAC;
 }
 
-void OPL3_Reset(opl3_chip *chip, Bit32u samplerate)
+//
+// Operator output at an envelope of OPL_SILENT_EG or more. The exp table
+// lookup always yields 0 then, only the sign of the waveform is left, so a
+// released operator puts out 0 or -1.
+//
+static Bit16s OPL3_SilentOut(Bit8u wf, Bit16u phase)
 {
-    Bit8u slotnum;
-    Bit8u channum;
-
-    memset(chip, 0, sizeof(opl3_chip));
-    for (slotnum = 0; slotnum < 36; slotnum++)
+    switch (wf)
     {
-        chip->slot[slotnum].chip = chip;
-        chip->slot[slotnum].mod = &chip->zeromod;
-        chip->slot[slotnum].eg_rout = 0x1ff;
-        chip->slot[slotnum].eg_out = 0x1ff;
-        chip->slot[slotnum].eg_gen = envelope_gen_num_off;
-        chip->slot[slotnum].trem = (Bit8u*)&chip->zeromod;
+    case 0:
+    case 6:
+    case 7:
+        return -(Bit16s)((phase >> 9) & 0x01);
+    case 4:
+        return (phase & 0x300) == 0x100 ? -1 : 0;
+    default:
+        return 0;
     }
-    for (channum = 0; channum < 18; channum++)
+}
+
+static void OPL3_SilentBlock(Bit8u wf, const Bit16u *phase, Bit16s *out,
+                             Bit32u n)
+{
+    Bit32u t;
+
+    switch (wf)
     {
-        chip->channel[channum].slots[0] = &chip->slot[ch_slot[channum]];
-        chip->channel[channum].slots[1] = &chip->slot[ch_slot[channum] + 3];
-        chip->slot[ch_slot[channum]].channel = &chip->channel[channum];
-        chip->slot[ch_slot[channum] + 3].channel = &chip->channel[channum];
-        if ((channum % 9) < 3)
+    case 0:
+    case 6:
+    case 7:
+        for (t = 0; t < n; t++)
         {
-            chip->channel[channum].pair = &chip->channel[channum + 3];
+            out[t] = -(Bit16s)((phase[t] >> 9) & 0x01);
         }
-        else if ((channum % 9) < 6)
+        break;
+    case 4:
+        for (t = 0; t < n; t++)
         {
-            chip->channel[channum].pair = &chip->channel[channum - 3];
+            out[t] = (phase[t] & 0x300) == 0x100 ? -1 : 0;
         }
-        chip->channel[channum].chip = chip;
-        chip->channel[channum].out[0] = &chip->zeromod;
-        chip->channel[channum].out[1] = &chip->zeromod;
-        chip->channel[channum].out[2] = &chip->zeromod;
-        chip->channel[channum].out[3] = &chip->zeromod;
-        chip->channel[channum].chtype = ch_2op;
-        chip->channel[channum].cha = ~0;
-        chip->channel[channum].chb = ~0;
-        OPL3_ChannelSetupAlg(&chip->channel[channum]);
+        break;
+    default:
+        memset(out, 0, n * sizeof(Bit16s));
+        break;
     }
-    chip->noise = 0x306600;
-    chip->rateratio = (samplerate << RSM_FRAC) / 49716;
-    chip->tremoloshift = 4;
-    chip->vibshift = 1;
 }
 
-void OPL3_WriteReg(opl3_chip *chip, Bit16u reg, Bit8u v)
+#ifdef OPL_AVX2
+OPL_TARGET_AVX2
+static __m256i OPL3_LogSin8(__m256i index)
 {
-    Bit8u high = (reg >> 8) & 0x01;
-    Bit8u regm = reg & 0xff;
-    switch (regm & 0xf0)
-    {
-    case 0x00:
-        if (high)
+    return _mm256_and_si256(_mm256_i32gather_epi32((const int *)logsinrom,
+                                                   index, 2),
+                            _mm256_set1_epi32(0xffff));
+}
+
+OPL_TARGET_AVX2
+static void OPL3_WaveBlockAVX2(Bit8u wf, const Bit16u *phase,
+                               const Bit16u *envelope, Bit16s *out, Bit32u n)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i c80 = _mm256_set1_epi32(0x80);
+    const __m256i cff = _mm256_set1_epi32(0xff);
+    const __m256i c100 = _mm256_set1_epi32(0x100);
+    const __m256i c1ff = _mm256_set1_epi32(0x1ff);
+    const __m256i c200 = _mm256_set1_epi32(0x200);
+    const __m256i c300 = _mm256_set1_epi32(0x300);
+    const __m256i c3ff = _mm256_set1_epi32(0x3ff);
+    const __m256i c400 = _mm256_set1_epi32(0x400);
+    const __m256i c1000 = _mm256_set1_epi32(0x1000);
+    const __m256i c1fff = _mm256_set1_epi32(0x1fff);
+    __m256i p, level, neg, m80, m100, m200, index, value;
+    Bit32u t;
+
+    for (t = 0; t + 8 <= n; t += 8)
+    {
+        p = _mm256_and_si256(_mm256_cvtepu16_epi32(
+                _mm_loadu_si128((const __m128i *)(phase + t))), c3ff);
+        m80 = _mm256_cmpeq_epi32(_mm256_and_si256(p, c80), c80);
+        m100 = _mm256_cmpeq_epi32(_mm256_and_si256(p, c100), c100);
+        m200 = _mm256_cmpeq_epi32(_mm256_and_si256(p, c200), c200);
+        neg = zero;
+
+        switch (wf)
         {
-            switch (regm & 0x0f)
+        case 0:
+        case 1:
+        case 2:
+            index = _mm256_xor_si256(_mm256_and_si256(p, cff),
+                                     _mm256_and_si256(m100, cff));
+            value = OPL3_LogSin8(index);
+            if (wf == 0)
             {
-            case 0x04:
-                OPL3_ChannelSet4Op(chip, v);
-                break;
-            case 0x05:
-                chip->newm = v & 0x01;
-                break;
+                neg = m200;
             }
-        }
-        else
-        {
-            switch (regm & 0x0f)
+            else if (wf == 1)
             {
-            case 0x08:
-                chip->nts = (v >> 6) & 0x01;
-                break;
+                value = _mm256_blendv_epi8(value, c1000, m200);
             }
+            break;
+        case 3:
+            value = _mm256_blendv_epi8(OPL3_LogSin8(_mm256_and_si256(p, cff)),
+                                       c1000, m100);
+            break;
+        case 4:
+        case 5:
+            index = _mm256_xor_si256(p, _mm256_and_si256(m80, cff));
+            index = _mm256_and_si256(_mm256_slli_epi32(index, 1), cff);
+            value = _mm256_blendv_epi8(OPL3_LogSin8(index), c1000, m200);
+            if (wf == 4)
+            {
+                neg = _mm256_cmpeq_epi32(_mm256_and_si256(p, c300), c100);
+            }
+            break;
+        case 6:
+            value = zero;
+            neg = m200;
+            break;
+        default:
+            p = _mm256_blendv_epi8(p, _mm256_xor_si256(
+                    _mm256_and_si256(p, c1ff), c1ff), m200);
+            value = _mm256_slli_epi32(p, 3);
+            neg = m200;
+            break;
         }
-        break;
-    case 0x20:
-    case 0x30:
-        if (ad_slot[regm & 0x1f] >= 0)
-        {
-            OPL3_SlotWrite20(&chip->slot[18 * high + ad_slot[regm & 0x1f]], v);
-        }
-        break;
-    case 0x40:
-    case 0x50:
-        if (ad_slot[regm & 0x1f] >= 0)
-        {
-            OPL3_SlotWrite40(&chip->slot[18 * high + ad_slot[regm & 0x1f]], v);
-        }
-        break;
-    case 0x60:
-    case 0x70:
-        if (ad_slot[regm & 0x1f] >= 0)
-        {
-            OPL3_SlotWrite60(&chip->slot[18 * high + ad_slot[regm & 0x1f]], v);
-        }
-        break;
-    case 0x80:
-    case 0x90:
-        if (ad_slot[regm & 0x1f] >= 0)
-        {
-            OPL3_SlotWrite80(&chip->slot[18 * high + ad_slot[regm & 0x1f]], v);
-        }
-        break;
-    case 0xe0:
-    case 0xf0:
-        if (ad_slot[regm & 0x1f] >= 0)
-        {
-            OPL3_SlotWriteE0(&chip->slot[18 * high + ad_slot[regm & 0x1f]], v);
-        }
-        break;
-    case 0xa0:
-        if ((regm & 0x0f) < 9)
-        {
-            OPL3_ChannelWriteA0(&chip->channel[9 * high + (regm & 0x0f)], v);
-        }
-        break;
-    case 0xb0:
+
+        // OPL3_EnvelopeCalcExp()
+        level = _mm256_add_epi32(value, _mm256_slli_epi32(_mm256_cvtepu16_epi32(
+                    _mm_loadu_si128((const __m128i *)(envelope + t))), 3));
+        level = _mm256_min_epu32(level, c1fff);
+        index = _mm256_xor_si256(_mm256_and_si256(level, cff), cff);
+        value = _mm256_and_si256(_mm256_i32gather_epi32((const int *)exprom,
+                                                        index, 2),
+                                 _mm256_set1_epi32(0xffff));
+        value = _mm256_slli_epi32(_mm256_or_si256(value, c400), 1);
+        value = _mm256_srlv_epi32(value, _mm256_srli_epi32(level, 8));
+        value = _mm256_xor_si256(value, neg);
+
+        value = _mm256_permute4x64_epi64(_mm256_packs_epi32(value, zero), 0xd8);
+        _mm_storeu_si128((__m128i *)(out + t), _mm256_castsi256_si128(value));
+    }
+
+    OPL3_WaveBlock(wf, phase + t, envelope + t, out + t, n - t);
+}
+
+#if defined(_MSC_VER)
+static int OPL3_HaveAVX2(void)
+{
+    int info[4];
+
+    __cpuid(info, 0);
+    if (info[0] < 7)
+    {
+        return 0;
+    }
+    // the OS must save the AVX registers as well
+    __cpuid(info, 1);
+    if ((info[2] & 0x18000000) != 0x18000000 || (_xgetbv(0) & 0x06) != 0x06)
+    {
+        return 0;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & 0x20) != 0;
+}
+#else
+static int OPL3_HaveAVX2(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+#endif
+
+static opl3_wavefunc opl3_wave = OPL3_WaveBlock;
+static int opl3_ready = 0;
+
+//
+// Picks the operator evaluation for this CPU. Must be called once before
+// chips are generated on several threads, OPL3_Reset() calls it as well.
+//
+void OPL3_Init(void)
+{
+    if (opl3_ready)
+    {
+        return;
+    }
+#ifdef OPL_AVX2
+    if (OPL3_HaveAVX2())
+    {
+        opl3_wave = OPL3_WaveBlockAVX2;
+    }
+#endif
+    opl3_ready = 1;
+}
+
+//
+// Returns the slot whose output 'out' points to, -1 for the zero modulator,
+// or -2 if it points elsewhere.
+//
+static Bits OPL3_BlockSource(opl3_chip *chip, Bit16s *out)
+{
+    Bits offset;
+
+    if (out == &chip->zeromod)
+    {
+        return -1;
+    }
+    offset = (char *)out - (char *)&chip->slot[0].out;
+    if (offset < 0 || offset % sizeof(opl3_slot) != 0
+     || offset / sizeof(opl3_slot) >= 36)
+    {
+        return -2;
+    }
+    return offset / sizeof(opl3_slot);
+}
+
+static void OPL3_BlockGlobals(opl3_chip *chip, opl3_block *block, Bit32u n)
+{
+    Bit32u t;
+
+    for (t = 0; t < n; t++)
+    {
+        block->timer[t] = chip->timer;
+        block->vibpos[t] = chip->vibpos;
+        block->tremolo[t] = chip->tremolo;
+        block->noise[t] = chip->noise;
+
+        OPL3_NoiseGenerate(chip);
+        if ((chip->timer & 0x3f) == 0x3f)
+        {
+            chip->tremolopos = (chip->tremolopos + 1) % 210;
+        }
+        if (chip->tremolopos < 105)
+        {
+            chip->tremolo = chip->tremolopos >> chip->tremoloshift;
+        }
+        else
+        {
+            chip->tremolo = (210 - chip->tremolopos) >> chip->tremoloshift;
+        }
+        if ((chip->timer & 0x3ff) == 0x3ff)
+        {
+            chip->vibpos = (chip->vibpos + 1) & 7;
+        }
+        chip->timer++;
+    }
+}
+
+//
+// Generates 'n' samples of one slot, the same way OPL3_SlotCalcFB(),
+// OPL3_PhaseGenerate(), OPL3_EnvelopeCalc() and OPL3_SlotGenerate() do.
+// 'mod' holds the modulator for every sample, NULL means the slot's own
+// feedback. The phases and envelopes of the whole run are worked out first,
+// then the output is evaluated. Unless the slot feeds back on itself, that
+// is done for the whole run at once.
+// Returns 1 if the slot is quiet: silent, standing still at a phase where
+// its waveform is 0 and not modulated. It puts out 0 for the whole run then,
+// and 'out' is left alone.
+//
+static int OPL3_SlotGenerateBlock(opl3_slot *slot, opl3_block *block,
+                                  const Bit16s *mod, Bit16s *out, Bit32u n)
+{
+    opl3_channel *channel = slot->channel;
+    const Bit8u *trem = slot->trem == &slot->chip->tremolo ? block->tremolo
+                                                           : opl3_zerotrem;
+    Bit16u *phase = block->phase;
+    Bit16u *envelope = block->envelope;
+    const Bit8u *incstep;
+    Bit8s incsh;
+    Bit16s eg_base = (slot->reg_tl << 2)
+                   + (slot->eg_ksl >> kslshift[slot->reg_ksl]);
+    Bit16s eg_rout = slot->eg_rout;
+    Bit8u eg_inc = 0;
+    Bit8u eg_gen = slot->eg_gen;
+    Bit8u eg_rate = slot->eg_rate;
+    Bit32u pg_phase = slot->pg_phase;
+    Bit32u pg_inc;
+    Bit32u basefreq;
+    Bit16s prout = slot->prout;
+    Bit16s sout = slot->out;
+    Bit16s fbmod = slot->fbmod;
+    Bit8u fb = channel->fb;
+    envelope_sinfunc sinfunc = envelope_sin[slot->reg_wf];
+    Bit16u f_num;
+    Bit8s range;
+    Bit8u vibpos;
+    Bit8u silent = 0;
+    Bit32u t;
+
+    incstep = eg_incstep[eg_incdesc[eg_rate >> 2]][eg_rate & 3];
+    incsh = eg_incsh[eg_rate >> 2];
+
+    // a quiet slot only has its envelope kept going, this covers every slot
+    // of a channel that was never played
+    if (!slot->reg_vib && !prout && !sout
+     && (mod == opl3_zeroblock || (!mod && fb == 0x00))
+     && (eg_gen == envelope_gen_num_off
+      || (eg_gen == envelope_gen_num_sustain && slot->reg_type))
+     && eg_rout + eg_base >= OPL_SILENT_EG
+     && (eg_gen != envelope_gen_num_off || 0x1ff + eg_base >= OPL_SILENT_EG)
+     && !(((channel->f_num << channel->block) >> 1) * mt[slot->reg_mult] >> 1)
+     && !OPL3_SilentOut(slot->reg_wf, (Bit16u)(pg_phase >> 9)))
+    {
+        slot->eg_out = eg_rout + eg_base + trem[n - 1];
+        if (eg_gen == envelope_gen_num_off)
+        {
+            slot->eg_rout = 0x1ff;
+            if (n > 1)
+            {
+                slot->eg_out = 0x1ff + eg_base + trem[n - 1];
+            }
+        }
+        slot->eg_inc = OPL3_EnvelopeIncrement(incstep, incsh,
+                                              block->timer[n - 1]);
+        slot->fbmod = 0;
+        return 1;
+    }
+
+    // phase
+    if (slot->reg_vib)
+    {
+        // the vibrato position only moves on every 1024 samples
+        for (t = 0; t < n; )
+        {
+            vibpos = block->vibpos[t];
+            f_num = channel->f_num;
+            range = (f_num >> 7) & 7;
+            if (!(vibpos & 3))
+            {
+                range = 0;
+            }
+            else if (vibpos & 1)
+            {
+                range >>= 1;
+            }
+            range >>= slot->chip->vibshift;
+            if (vibpos & 4)
+            {
+                range = -range;
+            }
+            f_num += range;
+            basefreq = (f_num << channel->block) >> 1;
+            pg_inc = (basefreq * mt[slot->reg_mult]) >> 1;
+            do
+            {
+                pg_phase += pg_inc;
+                phase[t] = (Bit16u)(pg_phase >> 9);
+            } while (++t < n && block->vibpos[t] == vibpos);
+        }
+    }
+    else
+    {
+        basefreq = (channel->f_num << channel->block) >> 1;
+        pg_inc = (basefreq * mt[slot->reg_mult]) >> 1;
+        for (t = 0; t < n; t++)
+        {
+            pg_phase += pg_inc;
+            phase[t] = (Bit16u)(pg_phase >> 9);
+        }
+    }
+
+    // envelope
+    if (eg_gen == envelope_gen_num_off
+     || (eg_gen == envelope_gen_num_sustain && slot->reg_type))
+    {
+        // the envelope stays where it is for the whole run
+        envelope[0] = eg_rout + eg_base + trem[0];
+        if (eg_gen == envelope_gen_num_off)
+        {
+            eg_rout = 0x1ff;
+        }
+        // no matter the tremolo, a silent slot's output doesn't depend on
+        // its envelope, only the last one is kept then
+        silent = envelope[0] >= OPL_SILENT_EG
+              && eg_rout + eg_base >= OPL_SILENT_EG;
+        for (t = silent && n > 1 ? n - 1 : 1; t < n; t++)
+        {
+            envelope[t] = eg_rout + eg_base + trem[t];
+        }
+        eg_inc = OPL3_EnvelopeIncrement(incstep, incsh, block->timer[n - 1]);
+    }
+    else
+    {
+        for (t = 0; t < n; t++)
+        {
+            eg_inc = OPL3_EnvelopeIncrement(incstep, incsh, block->timer[t]);
+            envelope[t] = eg_rout + eg_base + trem[t];
+            switch (eg_gen)
+            {
+            case envelope_gen_num_off:
+                eg_rout = 0x1ff;
+                break;
+            case envelope_gen_num_attack:
+                if (eg_rout == 0x00)
+                {
+                    eg_gen = envelope_gen_num_decay;
+                    eg_rate = OPL3_EnvelopeCalcRate(slot, slot->reg_dr);
+                    break;
+                }
+                eg_rout += ((~eg_rout) * eg_inc) >> 3;
+                if (eg_rout < 0x00)
+                {
+                    eg_rout = 0x00;
+                }
+                break;
+            case envelope_gen_num_decay:
+                if (eg_rout >= slot->reg_sl << 4)
+                {
+                    eg_gen = envelope_gen_num_sustain;
+                    eg_rate = OPL3_EnvelopeCalcRate(slot, slot->reg_rr);
+                    break;
+                }
+                eg_rout += eg_inc;
+                break;
+            case envelope_gen_num_sustain:
+                if (slot->reg_type)
+                {
+                    break;
+                }
+                // no sustain, go on releasing
+                // fall through
+            case envelope_gen_num_release:
+                if (eg_rout >= 0x1ff)
+                {
+                    eg_gen = envelope_gen_num_off;
+                    eg_rout = 0x1ff;
+                    eg_rate = OPL3_EnvelopeCalcRate(slot, slot->reg_ar);
+                    break;
+                }
+                eg_rout += eg_inc;
+                break;
+            }
+            incstep = eg_incstep[eg_incdesc[eg_rate >> 2]][eg_rate & 3];
+            incsh = eg_incsh[eg_rate >> 2];
+        }
+    }
+
+    // output
+    if (!mod && fb != 0x00)
+    {
+        for (t = 0; t < n; t++)
+        {
+            fbmod = (prout + sout) >> (0x09 - fb);
+            prout = sout;
+            sout = silent ? OPL3_SilentOut(slot->reg_wf, phase[t] + fbmod)
+                          : sinfunc(phase[t] + fbmod, envelope[t]);
+            out[t + 1] = sout;
+        }
+    }
+    else
+    {
+        if (mod)
+        {
+            for (t = 0; t < n; t++)
+            {
+                phase[t] += mod[t];
+            }
+        }
+        if (silent)
+        {
+            OPL3_SilentBlock(slot->reg_wf, phase, out + 1, n);
+        }
+        else
+        {
+            opl3_wave(slot->reg_wf, phase, envelope, out + 1, n);
+        }
+        prout = out[n - 1];
+        sout = out[n];
+        fbmod = 0;
+        if (fb != 0x00)
+        {
+            fbmod = ((n > 1 ? out[n - 2] : slot->prout) + prout) >> (0x09 - fb);
+        }
+    }
+
+    slot->prout = prout;
+    slot->out = sout;
+    slot->fbmod = fbmod;
+    slot->eg_rout = eg_rout;
+    slot->eg_out = envelope[n - 1];
+    slot->eg_inc = eg_inc;
+    slot->eg_gen = eg_gen;
+    slot->eg_rate = eg_rate;
+    slot->pg_phase = pg_phase;
+    return 0;
+}
+
+static void OPL3_RhythmGenerateBlock(opl3_chip *chip, opl3_block *block,
+                                     Bit32u n)
+{
+    Bit16u timer = chip->timer;
+    Bit8u vibpos = chip->vibpos;
+    Bit8u tremolo = chip->tremolo;
+    Bit32u noise = chip->noise;
+    Bit8u ii;
+    Bit32u t;
+
+    for (t = 0; t < n; t++)
+    {
+        chip->timer = block->timer[t];
+        chip->vibpos = block->vibpos[t];
+        chip->tremolo = block->tremolo[t];
+        chip->noise = block->noise[t];
+
+        for (ii = 12; ii < 15; ii++)
+        {
+            OPL3_SlotCalcFB(&chip->slot[ii]);
+            OPL3_PhaseGenerate(&chip->slot[ii]);
+            OPL3_EnvelopeCalc(&chip->slot[ii]);
+        }
+        OPL3_GenerateRhythm1(chip);
+        for (ii = 15; ii < 18; ii++)
+        {
+            OPL3_SlotCalcFB(&chip->slot[ii]);
+            OPL3_PhaseGenerate(&chip->slot[ii]);
+            OPL3_EnvelopeCalc(&chip->slot[ii]);
+        }
+        OPL3_GenerateRhythm2(chip);
+
+        for (ii = 12; ii < 18; ii++)
+        {
+            block->out[ii][t + 1] = chip->slot[ii].out;
+        }
+    }
+
+    chip->timer = timer;
+    chip->vibpos = vibpos;
+    chip->tremolo = tremolo;
+    chip->noise = noise;
+}
+
+//
+// Collects the outputs of 'channel' that go to the left ('right' 0) or the
+// right side into 'src' and returns their number. Quiet slots are left out.
+//
+static Bits OPL3_BlockSources(opl3_chip *chip, opl3_block *block,
+                              opl3_channel *channel, Bits right,
+                              const Bit16s **src)
+{
+    Bits jj, s, nsrc = 0;
+
+    for (jj = 0; jj < 4; jj++)
+    {
+        s = OPL3_BlockSource(chip, channel->out[jj]);
+        if (s >= 0 && !block->quiet[s])
+        {
+            src[nsrc++] = &block->out[s][s < (right ? 33 : 15) ? 1 : 0];
+        }
+    }
+    return nsrc;
+}
+
+//
+// Puts every channel's part of the run into its buffer in 'stems', the same
+// way the run was mixed.
+//
+static void OPL3_BlockStems(opl3_chip *chip, opl3_block *block,
+                           Bit16s **stems, Bit32u n)
+{
+    Bit16s chout[2][18 * OPL_BLOCK_SIZE];
+    opl3_channel *channel;
+    const Bit16s *src[4];
+    Bit16s *out, accm;
+    Bits ii, jj, kk, nsrc;
+    Bit32u t, sounds = 0;
+
+    // a channel without sources puts out nothing, unless its last right
+    // sample is still due
+    for (ii = 0; ii < 18; ii++)
+    {
+        channel = &chip->channel[ii];
+        if (chip->stemmix[ii])
+        {
+            sounds |= 1 << ii;
+        }
+        for (kk = 0; kk < 2; kk++)
+        {
+            out = &chout[kk][ii * n];
+            nsrc = 0;
+            if ((kk ? channel->chb : channel->cha)
+             && !OPL3_ChannelMuted(chip, channel))
+            {
+                nsrc = OPL3_BlockSources(chip, block, channel, kk, src);
+            }
+            switch (nsrc)
+            {
+            case 0:
+                memset(out, 0, n * sizeof(Bit16s));
+                break;
+            case 1:
+                memcpy(out, src[0], n * sizeof(Bit16s));
+                sounds |= 1 << ii;
+                break;
+            default:
+                for (t = 0; t < n; t++)
+                {
+                    accm = src[0][t];
+                    for (jj = 1; jj < nsrc; jj++)
+                    {
+                        accm += src[jj][t];
+                    }
+                    out[t] = accm;
+                }
+                sounds |= 1 << ii;
+                break;
+            }
+        }
+    }
+    OPL3_StemsFold(chip, chout[0], n);
+    OPL3_StemsFold(chip, chout[1], n);
+    for (ii = 0; ii < 18; ii++)
+    {
+        channel = &chip->channel[ii];
+        if (chip->newm && channel->chtype == ch_4op2 && (sounds & (1 << ii)))
+        {
+            sounds |= 1 << (channel->pair - chip->channel);
+        }
+    }
+
+    for (ii = 0; ii < 18; ii++)
+    {
+        out = stems[ii];
+        if (out && (sounds & (1 << ii)))
+        {
+            for (t = 0; t < n; t++)
+            {
+                out[t * 2] = OPL3_ClipSample(chout[0][ii * n + t]);
+                out[t * 2 + 1] = OPL3_ClipSample(t ? chout[1][ii * n + t - 1]
+                                                   : chip->stemmix[ii]);
+            }
+        }
+        else if (out)
+        {
+            memset(out, 0, n * 2 * sizeof(Bit16s));
+        }
+        chip->stemmix[ii] = chout[1][ii * n + n - 1];
+    }
+}
+
+//
+// Generates 'n' samples, at most OPL_BLOCK_SIZE, with no register writes in
+// between. Returns 0 if the slots aren't connected in a way the block
+// generation can handle, nothing is generated then.
+// If 'stems' isn't NULL, the channels' parts go into its buffers, too.
+//
+static int OPL3_GenerateRun(opl3_chip *chip, opl3_block *block, Bit16s *buf,
+                            Bit16s **stems, Bit32u n)
+{
+    opl3_slot *slot;
+    opl3_channel *channel;
+    const Bit16s *mod[36];
+    Bits modsrc[36];
+    Bit8u muted[36];
+    const Bit16s *src[4];
+    Bit32s *mix;
+    Bit16s accm;
+    Bits ii, jj, kk, nsrc;
+    Bit32u t;
+    Bit8u rhythm = chip->rhy & 0x20;
+
+    // every slot must be modulated by itself or by a slot generated earlier
+    for (ii = 0; ii < 36; ii++)
+    {
+        slot = &chip->slot[ii];
+        modsrc[ii] = -1;
+        if (slot->mod == &slot->fbmod)
+        {
+            mod[ii] = NULL;
+            continue;
+        }
+        kk = OPL3_BlockSource(chip, slot->mod);
+        if (kk == -1)
+        {
+            mod[ii] = opl3_zeroblock;
+        }
+        else if (kk >= 0 && kk < ii)
+        {
+            mod[ii] = &block->out[kk][1];
+            modsrc[ii] = kk;
+        }
+        else
+        {
+            return 0;
+        }
+    }
+    for (ii = 0; ii < 18; ii++)
+    {
+        for (jj = 0; jj < 4; jj++)
+        {
+            if (OPL3_BlockSource(chip, chip->channel[ii].out[jj]) == -2)
+            {
+                return 0;
+            }
+        }
+    }
+
+    OPL3_BlockGlobals(chip, block, n);
+
+    for (ii = 0; ii < 36; ii++)
+    {
+        block->out[ii][0] = chip->slot[ii].out;
+    }
+    memset(block->quiet, 0, sizeof(block->quiet));
+    OPL3_SlotsMuted(chip, muted);
+    for (ii = 0; ii < 36; ii++)
+    {
+        // a muted slot stands still and puts out nothing
+        if (muted[ii])
+        {
+            block->quiet[ii] = 1;
+            continue;
+        }
+        if (rhythm && ii >= 12 && ii < 18)
+        {
+            if (ii == 12)
+            {
+                OPL3_RhythmGenerateBlock(chip, block, n);
+            }
+            continue;
+        }
+        // a quiet modulator doesn't modulate
+        if (modsrc[ii] >= 0 && block->quiet[modsrc[ii]])
+        {
+            mod[ii] = opl3_zeroblock;
+        }
+        block->quiet[ii] = (Bit8u)OPL3_SlotGenerateBlock(&chip->slot[ii],
+                                                        block, mod[ii],
+                                                        block->out[ii], n);
+    }
+
+    // the left channels are mixed before slots 15-35 are generated, the
+    // right ones before slots 33-35, these still contribute the previous
+    // sample then
+    memset(block->mix, 0, sizeof(block->mix));
+    for (ii = 0; ii < 18; ii++)
+    {
+        channel = &chip->channel[ii];
+        if ((!channel->cha && !channel->chb)
+         || OPL3_ChannelMuted(chip, channel))
+        {
+            continue;
+        }
+        for (kk = 0; kk < 2; kk++)
+        {
+            if (!(kk ? channel->chb : channel->cha))
+            {
+                continue;
+            }
+            nsrc = OPL3_BlockSources(chip, block, channel, kk, src);
+            mix = block->mix[kk];
+            switch (nsrc)
+            {
+            case 0:
+                break;
+            case 1:
+                for (t = 0; t < n; t++)
+                {
+                    mix[t] += src[0][t];
+                }
+                break;
+            case 2:
+                for (t = 0; t < n; t++)
+                {
+                    mix[t] += (Bit16s)(src[0][t] + src[1][t]);
+                }
+                break;
+            default:
+                for (t = 0; t < n; t++)
+                {
+                    accm = src[0][t];
+                    for (jj = 1; jj < nsrc; jj++)
+                    {
+                        accm += src[jj][t];
+                    }
+                    mix[t] += accm;
+                }
+                break;
+            }
+        }
+    }
+
+    for (t = 0; t < n; t++)
+    {
+        buf[t * 2] = OPL3_ClipSample(block->mix[0][t]);
+        buf[t * 2 + 1] = OPL3_ClipSample(t ? block->mix[1][t - 1]
+                                           : chip->mixbuff[1]);
+    }
+    chip->mixbuff[0] = block->mix[0][n - 1];
+    chip->mixbuff[1] = block->mix[1][n - 1];
+    if (stems)
+    {
+        OPL3_BlockStems(chip, block, stems, n);
+    }
+    return 1;
+}
+
+static void OPL3_ProcessWrites(opl3_chip *chip)
+{
+    while (chip->writebuf[chip->writebuf_cur].time <= chip->writebuf_samplecnt)
+    {
+        if (!(chip->writebuf[chip->writebuf_cur].reg & 0x200))
+        {
+            break;
+        }
+        chip->writebuf[chip->writebuf_cur].reg &= 0x1ff;
+        OPL3_WriteReg(chip, chip->writebuf[chip->writebuf_cur].reg,
+                      chip->writebuf[chip->writebuf_cur].data);
+        chip->writebuf_cur = (chip->writebuf_cur + 1) % OPL_WRITEBUF_SIZE;
+    }
+}
+
+//
+// Generates 'numsamples' stereo samples at the chip's native rate. Buffered
+// register writes are only looked at when the next one is due, so runs of
+// samples in between are generated without interruption. With 'stems', the
+// channels' parts go into the buffers in it, too.
+//
+static void OPL3_GenerateBlockStems(opl3_chip *chip, Bit16s *buf,
+                                    Bit16s **stems, Bit32u numsamples)
+{
+    opl3_block block;
+    opl3_writebuf *next;
+    Bit16s *stem[18];
+    Bit32u run, n, i, c;
+
+    if (stems)
+    {
+        memcpy(stem, stems, sizeof(stem));
+    }
+
+    while (numsamples > 0)
+    {
+        run = numsamples;
+        next = &chip->writebuf[chip->writebuf_cur];
+        if ((next->reg & 0x200) && next->time < chip->writebuf_samplecnt + run)
+        {
+            run = next->time <= chip->writebuf_samplecnt ? 1
+                : (Bit32u)(next->time - chip->writebuf_samplecnt) + 1;
+        }
+
+        for (i = 0; i < run; i += n)
+        {
+            n = run - i < OPL_BLOCK_SIZE ? run - i : OPL_BLOCK_SIZE;
+            if (n < OPL_BLOCK_MIN
+             || !OPL3_GenerateRun(chip, &block, buf, stems ? stem : NULL, n))
+            {
+                n = 1;
+                OPL3_GenerateOne(chip, buf, stems ? stem : NULL);
+            }
+            buf += n * 2;
+            for (c = 0; stems && c < 18; c++)
+            {
+                if (stem[c])
+                {
+                    stem[c] += n * 2;
+                }
+            }
+        }
+
+        // the last sample of the run is the one the next write is due at
+        chip->writebuf_samplecnt += run - 1;
+        OPL3_ProcessWrites(chip);
+        chip->writebuf_samplecnt++;
+        numsamples -= run;
+    }
+}
+
+void OPL3_GenerateBlock(opl3_chip *chip, Bit16s *buf, Bit32u numsamples)
+{
+    OPL3_GenerateBlockStems(chip, buf, NULL, numsamples);
+}
+
+void OPL3_Generate(opl3_chip *chip, Bit16s *buf)
+{
+    OPL3_GenerateBlock(chip, buf, 1);
+}
+
+void OPL3_GenerateResampled(opl3_chip *chip, Bit16s *buf)
+{
+    while (chip->samplecnt >= chip->rateratio)
+    {
+        chip->oldsamples[0] = chip->samples[0];
+        chip->oldsamples[1] = chip->samples[1];
+        OPL3_Generate(chip, chip->samples);
+        chip->samplecnt -= chip->rateratio;
+    }
+    buf[0] = (Bit16s)((chip->oldsamples[0] * (chip->rateratio - chip->samplecnt)
+                     + chip->samples[0] * chip->samplecnt) / chip->rateratio);
+    buf[1] = (Bit16s)((chip->oldsamples[1] * (chip->rateratio - chip->samplecnt)
+                     + chip->samples[1] * chip->samplecnt) / chip->rateratio);
+    chip->samplecnt += 1 << RSM_FRAC;
+}
+
+void OPL3_Reset(opl3_chip *chip, Bit32u samplerate)
+{
+    Bit8u slotnum;
+    Bit8u channum;
+
+    OPL3_Init();
+    memset(chip, 0, sizeof(opl3_chip));
+    for (slotnum = 0; slotnum < 36; slotnum++)
+    {
+        chip->slot[slotnum].chip = chip;
+        chip->slot[slotnum].mod = &chip->zeromod;
+        chip->slot[slotnum].eg_rout = 0x1ff;
+        chip->slot[slotnum].eg_out = 0x1ff;
+        chip->slot[slotnum].eg_gen = envelope_gen_num_off;
+        chip->slot[slotnum].trem = (Bit8u*)&chip->zeromod;
+    }
+    for (channum = 0; channum < 18; channum++)
+    {
+        chip->channel[channum].slots[0] = &chip->slot[ch_slot[channum]];
+        chip->channel[channum].slots[1] = &chip->slot[ch_slot[channum] + 3];
+        chip->slot[ch_slot[channum]].channel = &chip->channel[channum];
+        chip->slot[ch_slot[channum] + 3].channel = &chip->channel[channum];
+        if ((channum % 9) < 3)
+        {
+            chip->channel[channum].pair = &chip->channel[channum + 3];
+        }
+        else if ((channum % 9) < 6)
+        {
+            chip->channel[channum].pair = &chip->channel[channum - 3];
+        }
+        chip->channel[channum].chip = chip;
+        chip->channel[channum].out[0] = &chip->zeromod;
+        chip->channel[channum].out[1] = &chip->zeromod;
+        chip->channel[channum].out[2] = &chip->zeromod;
+        chip->channel[channum].out[3] = &chip->zeromod;
+        chip->channel[channum].chtype = ch_2op;
+        chip->channel[channum].cha = ~0;
+        chip->channel[channum].chb = ~0;
+        OPL3_ChannelSetupAlg(&chip->channel[channum]);
+    }
+    chip->noise = 0x306600;
+    chip->chmask = OPL_ALLCHANNELS;
+    chip->rateratio = (samplerate << RSM_FRAC) / 49716;
+    chip->tremoloshift = 4;
+    chip->vibshift = 1;
+}
+
+void OPL3_WriteReg(opl3_chip *chip, Bit16u reg, Bit8u v)
+{
+    Bit8u high = (reg >> 8) & 0x01;
+    Bit8u regm = reg & 0xff;
+    switch (regm & 0xf0)
+    {
+    case 0x00:
+        if (high)
+        {
+            switch (regm & 0x0f)
+            {
+            case 0x04:
+                OPL3_ChannelSet4Op(chip, v);
+                break;
+            case 0x05:
+                chip->newm = v & 0x01;
+                break;
+            }
+        }
+        else
+        {
+            switch (regm & 0x0f)
+            {
+            case 0x08:
+                chip->nts = (v >> 6) & 0x01;
+                break;
+            }
+        }
+        break;
+    case 0x20:
+    case 0x30:
+        if (ad_slot[regm & 0x1f] >= 0)
+        {
+            OPL3_SlotWrite20(&chip->slot[18 * high + ad_slot[regm & 0x1f]], v);
+        }
+        break;
+    case 0x40:
+    case 0x50:
+        if (ad_slot[regm & 0x1f] >= 0)
+        {
+            OPL3_SlotWrite40(&chip->slot[18 * high + ad_slot[regm & 0x1f]], v);
+        }
+        break;
+    case 0x60:
+    case 0x70:
+        if (ad_slot[regm & 0x1f] >= 0)
+        {
+            OPL3_SlotWrite60(&chip->slot[18 * high + ad_slot[regm & 0x1f]], v);
+        }
+        break;
+    case 0x80:
+    case 0x90:
+        if (ad_slot[regm & 0x1f] >= 0)
+        {
+            OPL3_SlotWrite80(&chip->slot[18 * high + ad_slot[regm & 0x1f]], v);
+        }
+        break;
+    case 0xe0:
+    case 0xf0:
+        if (ad_slot[regm & 0x1f] >= 0)
+        {
+            OPL3_SlotWriteE0(&chip->slot[18 * high + ad_slot[regm & 0x1f]], v);
+        }
+        break;
+    case 0xa0:
+        if ((regm & 0x0f) < 9)
+        {
+            OPL3_ChannelWriteA0(&chip->channel[9 * high + (regm & 0x0f)], v);
+        }
+        break;
+    case 0xb0:
         if (regm == 0xbd && !high)
         {
             chip->tremoloshift = (((v >> 7) ^ 1) << 1) + 2;
@@ -1406,13 +2529,208 @@ void OPL3_WriteRegBuffered(opl3_chip *chip, Bit16u reg, Bit8u v)
     chip->writebuf_last = (chip->writebuf_last + 1) % OPL_WRITEBUF_SIZE;
 }
 
+//
+// Moves the resampler on to the next native sample, number 't' in 'native'
+// and, if given, in the native stems 'nstems'.
+//
+static void OPL3_StreamNext(opl3_chip *chip, const Bit16s *native,
+                            Bit16s **nstems, Bit32u t)
+{
+    Bit8u c;
+
+    chip->oldsamples[0] = chip->samples[0];
+    chip->oldsamples[1] = chip->samples[1];
+    chip->samples[0] = native[t * 2];
+    chip->samples[1] = native[t * 2 + 1];
+    for (c = 0; nstems && c < 18; c++)
+    {
+        if (nstems[c])
+        {
+            chip->oldstemsamples[c][0] = chip->stemsamples[c][0];
+            chip->oldstemsamples[c][1] = chip->stemsamples[c][1];
+            chip->stemsamples[c][0] = nstems[c][t * 2];
+            chip->stemsamples[c][1] = nstems[c][t * 2 + 1];
+        }
+    }
+    chip->samplecnt -= chip->rateratio;
+}
+
+static Bit16s OPL3_StreamLerp(opl3_chip *chip, Bit16s old, Bit16s sample)
+{
+    return (Bit16s)((old * (chip->rateratio - chip->samplecnt)
+                   + sample * chip->samplecnt) / chip->rateratio);
+}
+
+//
+// Puts out sample number 'i' into 'sndptr' and the 'stems', interpolated
+// between the last two native samples.
+//
+static void OPL3_StreamOut(opl3_chip *chip, Bit16s *sndptr, Bit16s **stems,
+                           Bit32u i)
+{
+    Bit8u c;
+
+    sndptr[i * 2] = OPL3_StreamLerp(chip, chip->oldsamples[0],
+                                    chip->samples[0]);
+    sndptr[i * 2 + 1] = OPL3_StreamLerp(chip, chip->oldsamples[1],
+                                        chip->samples[1]);
+    for (c = 0; stems && c < 18; c++)
+    {
+        if (stems[c])
+        {
+            stems[c][i * 2] = OPL3_StreamLerp(chip, chip->oldstemsamples[c][0],
+                                              chip->stemsamples[c][0]);
+            stems[c][i * 2 + 1] = OPL3_StreamLerp(chip,
+                                                  chip->oldstemsamples[c][1],
+                                                  chip->stemsamples[c][1]);
+        }
+    }
+    chip->samplecnt += 1 << RSM_FRAC;
+}
+
+//
+// Same as calling OPL3_GenerateResampled() 'numsamples' times, but the
+// native samples are generated in blocks of up to OPL_BLOCK_SIZE. If 'stems'
+// isn't NULL, it holds a buffer for every channel that is to be put out
+// separately, NULL for the others, see "Stems" above.
+//
+void OPL3_GenerateStreamStems(opl3_chip *chip, Bit16s *sndptr, Bit16s **stems,
+                              Bit32u numsamples)
+{
+    Bit16s block[OPL_BLOCK_SIZE * 2];
+    Bit16s stemblock[18][OPL_BLOCK_SIZE * 2];
+    Bit16s *nstem[18], *stem[18], **nstems = NULL;
+    Bit16s *runnstem[18], *runstem[18], **runnstems, **runstems;
+    Bit32u outsamples, nativesamples, n, i, t, c;
+    Bit32s cnt, sounds;
+
+    if (stems)
+    {
+        for (c = 0; c < 18; c++)
+        {
+            nstem[c] = stems[c] ? stemblock[c] : NULL;
+        }
+        nstems = nstem;
+        memcpy(stem, stems, sizeof(stem));
+    }
+
+    while (numsamples > 0)
+    {
+        // count how many output samples the next block will cover
+        cnt = chip->samplecnt;
+        outsamples = nativesamples = 0;
+        while (outsamples < numsamples)
+        {
+            for (n = 0; cnt >= chip->rateratio; n++)
+            {
+                cnt -= chip->rateratio;
+            }
+            if (nativesamples + n > OPL_BLOCK_SIZE)
+            {
+                break;
+            }
+            nativesamples += n;
+            cnt += 1 << RSM_FRAC;
+            outsamples++;
+        }
+
+        runnstems = nstems;
+        runstems = stems ? stem : NULL;
+        if (outsamples == 0)
+        {
+            // very low output rate, more native samples than fit in a block
+            while (chip->samplecnt >= chip->rateratio)
+            {
+                OPL3_GenerateBlockStems(chip, block, nstems, 1);
+                OPL3_StreamNext(chip, block, nstems, 0);
+            }
+            outsamples = 1;
+        }
+        else
+        {
+            OPL3_GenerateBlockStems(chip, block, nstems, nativesamples);
+            if (stems)
+            {
+                // stems that stay silent are only cleared
+                for (c = 0; c < 18; c++)
+                {
+                    runnstem[c] = runstem[c] = NULL;
+                    if (!stem[c])
+                    {
+                        continue;
+                    }
+                    sounds = chip->oldstemsamples[c][0]
+                           | chip->oldstemsamples[c][1]
+                           | chip->stemsamples[c][0] | chip->stemsamples[c][1];
+                    for (t = 0; !sounds && t < nativesamples * 2; t++)
+                    {
+                        sounds = nstem[c][t];
+                    }
+                    if (sounds)
+                    {
+                        runnstem[c] = nstem[c];
+                        runstem[c] = stem[c];
+                    }
+                    else
+                    {
+                        memset(stem[c], 0, outsamples * 2 * sizeof(Bit16s));
+                    }
+                }
+                runnstems = runnstem;
+                runstems = runstem;
+            }
+        }
+
+        for (i = t = 0; i < outsamples; i++)
+        {
+            while (chip->samplecnt >= chip->rateratio)
+            {
+                OPL3_StreamNext(chip, block, runnstems, t++);
+            }
+            OPL3_StreamOut(chip, sndptr, runstems, i);
+        }
+        sndptr += outsamples * 2;
+        for (c = 0; stems && c < 18; c++)
+        {
+            if (stem[c])
+            {
+                stem[c] += outsamples * 2;
+            }
+        }
+        numsamples -= outsamples;
+    }
+}
+
 void OPL3_GenerateStream(opl3_chip *chip, Bit16s *sndptr, Bit32u numsamples)
 {
-    Bit32u i;
+    OPL3_GenerateStreamStems(chip, sndptr, NULL, numsamples);
+}
+
+//
+// Returns a bitmask of the channels with a slot whose envelope isn't off,
+// bit n for channel n.
+//
+Bit32u OPL3_ActiveChannels(opl3_chip *chip)
+{
+    Bit32u mask = 0;
+    Bit8u ii;
 
-    for(i = 0; i < numsamples; i++)
+    for (ii = 0; ii < 18; ii++)
     {
-        OPL3_GenerateResampled(chip, sndptr);
-        sndptr += 2;
+        if (chip->channel[ii].slots[0]->eg_gen != envelope_gen_num_off
+         || chip->channel[ii].slots[1]->eg_gen != envelope_gen_num_off)
+        {
+            mask |= 1UL << ii;
+        }
     }
+    return mask;
+}
+
+//
+// Only the channels in 'mask' are generated, bit n for channel n. The others
+// stand still until they are unmuted.
+//
+void OPL3_SetChannelMask(opl3_chip *chip, Bit32u mask)
+{
+    chip->chmask = mask & OPL_ALLCHANNELS;
 }
@@ -34,6 +34,8 @@
 
 #define OPL_WRITEBUF_SIZE   1024
 #define OPL_WRITEBUF_DELAY  2
+#define OPL_BLOCK_SIZE      256
+#define OPL_ALLCHANNELS     0x3ffff
 
 typedef uintptr_t       Bitu;
 typedef intptr_t        Bits;
@@ -114,13 +116,17 @@ struct _opl3_chip {
     Bit8u tremolopos;
     Bit8u tremoloshift;
     Bit32u noise;
+    Bit32u chmask;
     Bit16s zeromod;
     Bit32s mixbuff[2];
+    Bit16s stemmix[18];
     //OPL3L
     Bit32s rateratio;
     Bit32s samplecnt;
     Bit16s oldsamples[2];
     Bit16s samples[2];
+    Bit16s oldstemsamples[18][2];
+    Bit16s stemsamples[18][2];
 
     Bit64u writebuf_samplecnt;
     Bit32u writebuf_cur;
@@ -129,10 +135,16 @@ struct _opl3_chip {
     opl3_writebuf writebuf[OPL_WRITEBUF_SIZE];
 };
 
+void OPL3_Init(void);
 void OPL3_Generate(opl3_chip *chip, Bit16s *buf);
+void OPL3_GenerateBlock(opl3_chip *chip, Bit16s *buf, Bit32u numsamples);
 void OPL3_GenerateResampled(opl3_chip *chip, Bit16s *buf);
 void OPL3_Reset(opl3_chip *chip, Bit32u samplerate);
 void OPL3_WriteReg(opl3_chip *chip, Bit16u reg, Bit8u v);
 void OPL3_WriteRegBuffered(opl3_chip *chip, Bit16u reg, Bit8u v);
 void OPL3_GenerateStream(opl3_chip *chip, Bit16s *sndptr, Bit32u numsamples);
+void OPL3_GenerateStreamStems(opl3_chip *chip, Bit16s *sndptr, Bit16s **stems,
+                              Bit32u numsamples);
+Bit32u OPL3_ActiveChannels(opl3_chip *chip);
+void OPL3_SetChannelMask(opl3_chip *chip, Bit32u mask);
 #endif
@@ -22,6 +22,10 @@
 #ifndef H_ADPLUG_OPL
 #define H_ADPLUG_OPL
 
+#include <stddef.h>
+#include <string>
+#include <deque>
+
 class Copl
 {
  public:
@@ -29,8 +33,29 @@ class Copl
     TYPE_OPL2, TYPE_OPL3, TYPE_DUAL_OPL2
   } ChipType;
 
+  enum { ALL_CHANNELS = (1 << 18) - 1 };	// channel mask with all 18 bits
+
+  // Sample types for updatefmt()
+  typedef enum {
+    S16, S32, F32
+  } SampleType;
+
+  // Output format for updatefmt()
+  struct Format {
+    SampleType	type;
+    bool	stereo;		// two channels instead of one
+    bool	planar;		// stereo channels in buffers of their own
+    bool	add;		// add into the buffers instead of overwriting
+  };
+
+  // A register write for write_batch()
+  struct RegWrite {
+    unsigned char	chip, reg, val;		// chip is 0 or 1
+  };
+
   Copl()
-    : currChip(0), currType(TYPE_OPL2)
+    : currChip(0), currType(TYPE_OPL2), channelmask(ALL_CHANNELS),
+      queuetime(0)
     {
     }
 
@@ -39,6 +64,30 @@ class Copl
     }
 
   virtual void write(int reg, int val) = 0;	// combined register select + data write
+
+  // Emulation only: write() into the current chip 'offset' samples into
+  // the output of the next update(), updatefmt() or updatestems() call.
+  // Writes due after that call's end stay queued for the following ones.
+  // Without emulation, the write is done straight away.
+  virtual void write_at(unsigned long offset, int reg, int val)
+    {
+      write(reg, val);
+    }
+
+  // Does 'n' writes in one call, each into the chip that comes with it.
+  // The current chip stays selected. Emulators and wrappers do these
+  // without a virtual call per write.
+  virtual void write_batch(const RegWrite *w, size_t n)
+    {
+      int chip = currChip;
+
+      for(size_t i = 0; i < n; i++) {
+	if(w[i].chip != currChip) setchip(w[i].chip);
+	write(w[i].reg, w[i].val);
+      }
+      if(currChip != chip) setchip(chip);
+    }
+
   virtual void setchip(int n)			// select OPL chip
     {
       if(n < 2)
@@ -61,9 +110,144 @@ class Copl
   // Emulation only: fill buffer
   virtual void update(short *buf, int samples) {}
 
+  // Emulation only: fill buffers like update(), in the format asked for
+  // instead of the one the emulator was set up with. 'bufs' holds one
+  // buffer, or the left and right channel's for planar stereo. S16 and S32
+  // samples have 16 bit range, F32 samples go from -1.0 to 1.0. Only S16
+  // samples are clipped, after adding. The others can go beyond the range
+  // with emulators that mix without clipping. Returns false, without
+  // generating anything, if the emulator can't.
+  virtual bool updatefmt(void **bufs, int samples, const Format &fmt)
+    {
+      return false;
+    }
+
+  // Emulation only: fill buffer like update(), and put every channel's part
+  // of the output into its own buffer at the same time. 'stems' holds 18
+  // buffers in the format of 'buf', numbered as with getactive(), NULL for
+  // the channels that aren't needed. A 4-op voice goes to its first channel.
+  // Returns false, without generating anything, if the emulator can't.
+  virtual bool updatestems(short *buf, short **stems, int samples)
+    {
+      return false;
+    }
+
+  // Emulation only: bitmask of the channels that sound, bit n for channel n.
+  // Channels 9-17 are on the second chip, or the OPL3's second register set.
+  // A channel whose operators are all off stays silent until the next key
+  // on. Without emulation, every channel counts as sounding.
+  virtual unsigned long getactive() { return ALL_CHANNELS; }
+
+  // Emulation only: mute/solo channels. Channel n is heard while bit n of
+  // the mask is set, numbered as with getactive(). A muted channel isn't
+  // emulated at all, its notes stand still until it is unmuted. A 4-op
+  // voice goes with its first channel, the rhythm section is emulated while
+  // any of its channels is heard.
+  virtual void setchannelmask(unsigned long mask)
+    {
+      channelmask = mask & ALL_CHANNELS;
+    }
+
+  unsigned long getchannelmask()
+    {
+      return channelmask;
+    }
+
+  // Emulation only: save/restore complete emulator state. A state may only
+  // be restored into an emulator of the same class and sample rate.
+  virtual bool save_state(std::string &state) { return false; }
+  virtual bool load_state(const std::string &state) { return false; }
+
  protected:
+  struct QueuedWrite {
+    unsigned long	time;		// sample the write is due at
+    int			chip, reg, val;
+  };
+
   int		currChip;		// currently selected OPL chip number
   ChipType	currType;		// this OPL chip's type
+  unsigned long	channelmask;		// channels that are heard
+  std::deque<QueuedWrite> queue;	// writes from write_at(), by time
+  unsigned long	queuetime;		// samples generated since it was empty
+
+  // Emulators' write_at(): queues the write, after those for the same time
+  void enqueue(unsigned long offset, int reg, int val)
+    {
+      QueuedWrite w = { queuetime + offset, currChip, reg, val };
+      std::deque<QueuedWrite>::iterator i = queue.end();
+
+      while(i != queue.begin() && (i - 1)->time > w.time) i--;
+      queue.insert(i, w);
+    }
+
+  // Does the queued writes that are due and returns how many samples, at
+  // most 'samples', to generate before the next one is. Emulators call this
+  // for every part of their output, generating exactly that many samples.
+  int dequeue(int samples)
+    {
+      int chip = currChip;
+
+      if(queue.empty()) {
+	queuetime = 0;
+	return samples;
+      }
+
+      for(; !queue.empty() && queue.front().time <= queuetime; queue.pop_front()) {
+	setchip(queue.front().chip);
+	write(queue.front().reg, queue.front().val);
+      }
+      setchip(chip);
+
+      if(!queue.empty() && queue.front().time - queuetime < (unsigned long)samples)
+	samples = queue.front().time - queuetime;
+      queuetime += samples;
+      return samples;
+    }
+
+  // Drops the writes still queued, so none reach a chip that init() or
+  // load_state() has put into another state. Both call this.
+  void clearqueue()
+    {
+      queue.clear();
+      queuetime = 0;
+    }
+};
+
+// Write-combining buffer for players: collects register writes and hands
+// them to the OPL in one write_batch() call. Players flush it before
+// returning to their caller, so nothing stays behind across calls.
+class CWriteBatch
+{
+ public:
+  CWriteBatch()
+    : n(0), chip(0)
+    {
+    }
+
+  void setchip(int c)			// chip for the following writes
+    {
+      chip = c;
+    }
+
+  void write(Copl *opl, int reg, int val)
+    {
+      if(n == SIZE) flush(opl);
+      buf[n].chip = chip; buf[n].reg = reg; buf[n].val = val;
+      n++;
+    }
+
+  void flush(Copl *opl)
+    {
+      if(n) opl->write_batch(buf, n);
+      n = 0;
+    }
+
+ private:
+  enum { SIZE = 256 };
+
+  Copl::RegWrite	buf[SIZE];
+  size_t		n;
+  int			chip;
 };
 
 #endif
@@ -19,9 +19,107 @@
  * player.cpp - Replayer base class, by Simon Peter <dn.tlp@gmx.net>
  */
 
+#include <cstring>
+#include <algorithm>
+
 #include "player.h"
 #include "adplug.h"
 #include "silentopl.h"
+#include "snapshot.h"
+#include "fixedopl.h"
+#include "debug.h"
+
+/***** CPlayer::CImageopl *****/
+
+// Passes all OPL access on to another chip (if any), while keeping an image
+// of the registers written since the last init(), for use in keyframes.
+class CPlayer::CImageopl: public Copl
+{
+public:
+  short	regs[2][256];
+
+  CImageopl(Copl *newtarget)
+    : target(newtarget)
+  {
+    if(target) {
+      currType = target->gettype();
+      currChip = target->getchip();
+    }
+    clear();
+  }
+
+  void write(int reg, int val)
+  {
+    if(target) target->write(reg, val);
+    regs[(currChip | reg >> 8) & 1][reg & 0xff] = val & 0xff;
+  }
+
+  void setchip(int n)
+  {
+    Copl::setchip(n);
+    if(target) target->setchip(n);
+  }
+
+  void init()
+  {
+    if(target) {
+      target->init();
+      currChip = target->getchip();
+    }
+    clear();
+  }
+
+  void update(short *buf, int samples)
+  {
+    if(target) target->update(buf, samples);
+  }
+
+  // writes the register image back to the target chip
+  void apply(int chip)
+  {
+    int c, r;
+
+    if(!target) return;
+
+    // OPL3 mode and 4-op setup come first, key-on registers last
+    for(c = 0; c < 2; c++)
+      if(regs[c][5] >= 0 || regs[c][4] >= 0) {
+	target->setchip(c);
+	if(regs[c][5] >= 0) target->write(5, regs[c][5]);
+	if(regs[c][4] >= 0) target->write(4, regs[c][4]);
+      }
+
+    for(c = 0; c < 2; c++) {
+      target->setchip(c);
+      for(r = 0; r < 256; r++)
+	if(regs[c][r] >= 0 && r != 4 && r != 5 && !is_keyreg(r))
+	  target->write(r, regs[c][r]);
+      for(r = 0; r < 256; r++)
+	if(regs[c][r] >= 0 && is_keyreg(r))
+	  target->write(r, regs[c][r]);
+    }
+
+    target->setchip(chip);
+    currChip = chip;
+  }
+
+private:
+  Copl	*target;
+
+  void clear()
+  {
+    int c, r;
+
+    for(c = 0; c < 2; c++)
+      for(r = 0; r < 256; r++)
+	regs[c][r] = -1;
+  }
+
+  static bool is_keyreg(int r)
+  {
+    return (r >= 0xb0 && r <= 0xb8) || r == 0xbd;
+  }
+};
 
 /***** CPlayer *****/
 
@@ -32,7 +130,8 @@ const unsigned char CPlayer::op_table[9] =
   {0x00, 0x01, 0x02, 0x08, 0x09, 0x0a, 0x10, 0x11, 0x12};
 
 CPlayer::CPlayer(Copl *newopl)
-  : opl(newopl), db(CAdPlug::database)
+  : opl(newopl), fixedopl(fixed_opl(newopl)), db(CAdPlug::database),
+    keyed(false), kf_interval(10000), kf_supported(true)
 {
 }
 
@@ -41,30 +140,275 @@ CPlayer::~CPlayer()
 }
 
 unsigned long CPlayer::songlength(int subsong)
+{
+  unsigned long	loopstart, loopend;
+
+  return songlength(subsong, loopstart, loopend);
+}
+
+unsigned long CPlayer::songlength(int subsong, unsigned long &loopstart,
+				  unsigned long &loopend)
+  /*
+   * Returns the length of subsong 'subsong' in ms, along with its loop
+   * bounds. The result is taken from the database's length record for the
+   * loaded file, if there is one. Otherwise, the subsong is measured and the
+   * result is stored there.
+   */
+{
+  CLengthRecord		*record = length_record();
+  CLengthRecord::Subsong	len;
+  unsigned int		n = subsong < 0 ? getsubsong() : subsong;
+
+  if(record && record->get(n, len))
+    rewind(subsong);		// same side effect as measuring
+  else {
+    measure(subsong, len);
+    if(record) record->set(n, len);
+  }
+
+  loopstart = len.loopstart;
+  loopend = len.loopend;
+  return len.length;
+}
+
+bool CPlayer::load(const std::string &filename, const CFileProvider &fp)
+  /*
+   * Loads file 'filename'. The keyframes and the database key of the song
+   * loaded before are dropped first, as they don't fit the new one.
+   */
+{
+  keyframes.clear();
+  kf_supported = true;
+  keyed = false;
+  return loadfile(filename, fp);
+}
+
+void CPlayer::seek(unsigned long ms)
+{
+  CImageopl	image(opl);
+  Copl		*saveopl = opl;
+  const Keyframe *kf;
+  float		pos = 0.0f;
+
+  // watch all register writes, so keyframes can be taken on the way
+  opl = &image;
+
+  rewind();
+  if((kf = find_keyframe(ms)) && restore_keyframe(*kf, image, saveopl))
+    pos = kf->pos;	// continue from the nearest keyframe
+
+  while(pos < ms && update()) {		// seek to new position
+    pos += 1000/getrefresh();
+    add_keyframe(pos, image, saveopl);
+  }
+
+  opl = saveopl;
+}
+
+bool CPlayer::save_state(std::string &state)
+{
+  std::string	type = gettype();
+  CSnapshot	s(&state);
+
+  state.clear();
+  s.io(type);
+  return snapshot(s);
+}
+
+bool CPlayer::load_state(const std::string &state)
+  /*
+   * Restores the replay state from 'state'. If the state doesn't fit this
+   * replayer, the current state is kept and false is returned.
+   */
+{
+  std::string	backup, type;
+  CSnapshot	s(state);
+
+  if(!save_state(backup)) return false;
+
+  s.io(type);
+  if(type == gettype() && snapshot(s) && s.good())
+    return true;
+
+  AdPlug_LogWrite("CPlayer::load_state(): state doesn't fit this replayer\n");
+  CSnapshot undo(backup);
+  undo.io(type);
+  snapshot(undo);
+  return false;
+}
+
+CLengthRecord *CPlayer::length_record()
+  /*
+   * Returns the database's length record for the loaded file, adding a new
+   * one if there is none yet. Returns NULL if the file's key is unknown, or
+   * the database holds a different kind of record for it.
+   */
+{
+  CAdPlugDatabase::CRecord	*record;
+
+  if(!db || !keyed) return 0;
+
+  if((record = db->search(dbkey)))
+    return record->type == CAdPlugDatabase::CRecord::SongLength ?
+      (CLengthRecord *)record : 0;
+
+  CLengthRecord *newrecord = new CLengthRecord;
+  newrecord->key = dbkey;
+  newrecord->filetype = gettype();
+  if(db->insert(newrecord)) return newrecord;
+
+  delete newrecord;
+  return 0;
+}
+
+void CPlayer::measure(int subsong, CLengthRecord::Subsong &len)
+  /*
+   * Measures the length of subsong 'subsong' in ms. The replayer's state is
+   * hashed before every tick, so a song that loops without ever signalling
+   * its end is stopped as soon as a state repeats. The loop runs from
+   * 'loopstart' to 'loopend' then. If no loop is found, both are set to the
+   * song length.
+   */
 {
   CSilentopl	tempopl;
+  CImageopl	image(&tempopl);
   Copl		*saveopl = opl;
-  float		slength = 0.0f;
+  float		slength = 0.0f, lstart = -1.0f;
+  std::map<StateHash, float>	seen;	// state hash -> position in ms
+  std::string	state;
+  bool		hashing = true;
 
   // save original OPL from being overwritten
-  opl = &tempopl;
+  opl = &image;
 
-  // get song length
+  // get song length, building the seek index on the way
   rewind(subsong);
-  while(update() && slength < 600000)	// song length limit: 10 minutes
+  for(;;) {
+    if(hashing) {
+      CSnapshot s(&state);
+
+      state.clear();
+      if(snapshot(s)) {
+	std::pair<std::map<StateHash, float>::iterator, bool> i =
+	  seen.insert(std::make_pair(hash_state(state), slength));
+
+	if(!i.second) {		// been here before, the song loops
+	  lstart = i.first->second;
+	  break;
+	}
+      } else
+	hashing = false;	// no state support, play until the end
+    }
+
+    if(!update() || slength >= 600000)	// song length limit: 10 minutes
+      break;
     slength += 1000.0f / getrefresh();
+    add_keyframe(slength, image, 0);
+  }
   rewind(subsong);
 
-  // restore original OPL and return
+  len.length = len.loopend = (unsigned long)slength;
+  len.loopstart = lstart < 0.0f ? len.length : (unsigned long)lstart;
+
+  // restore original OPL
   opl = saveopl;
-  return (unsigned long)slength;
 }
 
-void CPlayer::seek(unsigned long ms)
+CPlayer::StateHash CPlayer::hash_state(const std::string &state)
+  /*
+   * Returns a 64-bit hash of 'state', made up of two independent 32-bit
+   * hashes (FNV-1a and SDBM), so collisions are practically impossible.
+   */
 {
-  float pos = 0.0f;
+  unsigned long	h1 = 2166136261UL, h2 = 0;
 
-  rewind();
-  while(pos < ms && update())		// seek to new position
-    pos += 1000/getrefresh();
+  for(std::string::size_type i = 0; i < state.size(); i++) {
+    unsigned char c = state[i];
+
+    h1 = ((h1 ^ c) * 16777619UL) & 0xffffffffUL;
+    h2 = (c + (h2 << 6) + (h2 << 16) - h2) & 0xffffffffUL;
+  }
+
+  return StateHash(h1, h2);
+}
+
+bool CPlayer::keyframe_before(float ms, const Keyframe &kf)
+{
+  return ms < kf.pos;
+}
+
+const CPlayer::Keyframe *CPlayer::find_keyframe(float ms)
+  /*
+   * Returns the last keyframe of the current subsong at or before 'ms', or
+   * NULL if there is none.
+   */
+{
+  std::map<unsigned int, Keyframes>::const_iterator i =
+    keyframes.find(getsubsong());
+
+  if(i == keyframes.end()) return 0;
+
+  Keyframes::const_iterator kf =
+    std::upper_bound(i->second.begin(), i->second.end(), ms, keyframe_before);
+
+  if(kf == i->second.begin()) return 0;
+  return &*(kf - 1);
+}
+
+bool CPlayer::restore_keyframe(const Keyframe &kf, CImageopl &image, Copl *emu)
+  /*
+   * Restores replayer and OPL state from keyframe 'kf'. Expects the replayer
+   * to be rewound, and leaves it rewound if the keyframe can't be used.
+   */
+{
+  CSnapshot s(kf.player);
+
+  if(!snapshot(s) || !s.good()) {
+    AdPlug_LogWrite("CPlayer::restore_keyframe(): bad keyframe at %.0f ms\n",
+		    kf.pos);
+    rewind();
+    return false;
+  }
+
+  memcpy(image.regs, kf.regs, sizeof(kf.regs));
+  if(kf.emu && kf.emu == emu && emu->load_state(kf.emustate))
+    image.setchip(kf.chip);
+  else
+    image.apply(kf.chip);
+
+  return true;
+}
+
+void CPlayer::add_keyframe(float pos, CImageopl &image, Copl *emu)
+  /*
+   * Takes a keyframe at replay position 'pos', if the last one of the current
+   * subsong is at least one keyframe interval behind. The state of emulator
+   * 'emu' is stored along, if it can be saved.
+   */
+{
+  if(!kf_interval || !kf_supported) return;
+
+  Keyframes	&list = keyframes[getsubsong()];
+  float		last = list.empty() ? 0.0f : list.back().pos;
+
+  if(pos < last + kf_interval) return;
+
+  list.push_back(Keyframe());
+  Keyframe &kf = list.back();
+  CSnapshot s(&kf.player);
+
+  if(!snapshot(s)) {		// replayer has no snapshot support
+    list.pop_back();
+    kf_supported = false;
+    return;
+  }
+
+  kf.pos = pos;
+  memcpy(kf.regs, image.regs, sizeof(kf.regs));
+  kf.chip = image.getchip();
+  kf.emu = emu;
+  if(!emu || !emu->save_state(kf.emustate)) {
+    kf.emu = 0;
+    kf.emustate.clear();
+  }
 }
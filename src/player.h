@@ -23,28 +23,50 @@
 #define H_ADPLUG_PLAYER
 
 #include <string>
+#include <vector>
+#include <map>
 
 #include "fprovide.h"
 #include "opl.h"
 #include "database.h"
 
+class CSnapshot;
+
 class CPlayer
 {
+  friend class CAdPlug;
+
 public:
+	// How likely a file can be loaded, as told by the static probe()
+	// functions of the player classes from its first bytes. PROBE_NO is
+	// only given for files that load() rejects for sure.
+	enum ProbeScore { PROBE_NO, PROBE_MAYBE, PROBE_YES };
+
         CPlayer(Copl *newopl);
 	virtual ~CPlayer();
 
 /***** Operational methods *****/
 	void seek(unsigned long ms);
+	void set_keyframe_interval(unsigned long ms)	// 0 disables keyframes
+	  { kf_interval = ms; }
+
+	// Loads file 'filename', instead of the song loaded before, if any
+	bool load(const std::string &filename,
+		  const CFileProvider &fp = CProvider_Filesystem());
 
-	virtual bool load(const std::string &filename,	// loads file
-			  const CFileProvider &fp = CProvider_Filesystem()) = 0;
 	virtual bool update() = 0;			// executes replay code for 1 tick
 	virtual void rewind(int subsong = -1) = 0;	// rewinds to specified subsong
 	virtual float getrefresh() = 0;			// returns needed timer refresh rate
 
+	// Replay state snapshots. A state can be restored into any replayer of
+	// the same type that has loaded the same file. The OPL is left alone.
+	virtual bool save_state(std::string &state);
+	virtual bool load_state(const std::string &state);
+
 /***** Informational methods *****/
 	unsigned long songlength(int subsong = -1);
+	unsigned long songlength(int subsong, unsigned long &loopstart,
+				 unsigned long &loopend);
 
 	virtual std::string gettype() = 0;	// returns file type
 	virtual std::string gettitle()		// returns song title
@@ -76,10 +98,54 @@ public:
 
 protected:
 	Copl		*opl;	// our OPL chip
+	Copl		*fixedopl;	// 'opl' if of the fixed OPL class
 	CAdPlugDatabase	*db;	// AdPlug Database
 
 	static const unsigned short	note_table[12];	// standard adlib note table
 	static const unsigned char	op_table[9];	// the 9 operators as expected by the OPL
+
+	// Loads the file for load(), which has dropped everything CPlayer kept
+	// about the song loaded before
+	virtual bool loadfile(const std::string &filename,
+			      const CFileProvider &fp) = 0;
+
+	// opl->write(), without a virtual call in builds with a fixed OPL
+	// class. Defined in fixedopl.h, for the players with many writes.
+	inline void oplwrite(int reg, int val);
+
+	// Stores or restores all replay state that changes during playback.
+	// Returns false if the replayer doesn't support snapshots.
+	virtual bool snapshot(CSnapshot &s)
+	  { return false; }
+
+private:
+	class CImageopl;
+
+	struct Keyframe {
+	  float		pos;		// replay position in ms
+	  std::string	player;		// replayer state
+	  short		regs[2][256];	// OPL register image (-1 = untouched)
+	  int		chip;		// selected OPL chip
+	  Copl		*emu;		// emulator that 'emustate' belongs to
+	  std::string	emustate;	// emulator state, if supported
+	};
+	typedef std::vector<Keyframe> Keyframes;
+	typedef std::pair<unsigned long, unsigned long> StateHash;
+
+	CAdPlugDatabase::CKey	dbkey;	// key of the loaded file
+	bool		keyed;		// true if 'dbkey' is set
+
+	std::map<unsigned int, Keyframes>	keyframes;	// per subsong, sorted by pos
+	unsigned long	kf_interval;	// keyframe distance in ms
+	bool		kf_supported;	// false once snapshot() refused
+
+	CLengthRecord *length_record();
+	void measure(int subsong, CLengthRecord::Subsong &len);
+	static StateHash hash_state(const std::string &state);
+	static bool keyframe_before(float ms, const Keyframe &kf);
+	const Keyframe *find_keyframe(float ms);
+	bool restore_keyframe(const Keyframe &kf, CImageopl &image, Copl *emu);
+	void add_keyframe(float pos, CImageopl &image, Copl *emu);
 };
 
 #endif
@@ -32,13 +32,19 @@ class CPlayerDesc
 {
 public:
   typedef CPlayer *(*Factory)(Copl *);
+  typedef CPlayer::ProbeScore (*Probe)(const std::string &filename,
+				       const unsigned char *head,
+				       unsigned long len,
+				       unsigned long filesize);
 
   Factory	factory;
+  Probe		probe;		// the player's probe(), or 0
   std::string	filetype;
 
   CPlayerDesc();
   CPlayerDesc(const CPlayerDesc &pd);
-  CPlayerDesc(Factory f, const std::string &type, const char *ext);
+  CPlayerDesc(Factory f, const std::string &type, const char *ext,
+	      Probe p = 0);
 
   ~CPlayerDesc();
 
@@ -27,6 +27,8 @@
 
 #include <cstring>
 #include "protrack.h"
+#include "fixedopl.h"
+#include "snapshot.h"
 #include "debug.h"
 
 #define SPECIALARPLEN	256	// Standard length of special arpeggio lists
@@ -88,11 +90,11 @@ bool CmodPlayer::update()
 	  case 254: channel[chan].arppos = arplist[channel[chan].arppos]; break; // arpeggio loop
 	  default: if(arpcmd[channel[chan].arppos]) {
 	    if(arpcmd[channel[chan].arppos] / 10)
-	      opl->write(0xe3 + op_table[oplchan], arpcmd[channel[chan].arppos] / 10 - 1);
+	      oplwrite(0xe3 + op_table[oplchan], arpcmd[channel[chan].arppos] / 10 - 1);
 	    if(arpcmd[channel[chan].arppos] % 10)
-	      opl->write(0xe0 + op_table[oplchan], (arpcmd[channel[chan].arppos] % 10) - 1);
+	      oplwrite(0xe0 + op_table[oplchan], (arpcmd[channel[chan].arppos] % 10) - 1);
 	    if(arpcmd[channel[chan].arppos] < 10)	// ?????
-	      opl->write(0xe0 + op_table[oplchan], arpcmd[channel[chan].arppos] - 1);
+	      oplwrite(0xe0 + op_table[oplchan], arpcmd[channel[chan].arppos] - 1);
 	  }
 	  }
 	  if(arpcmd[channel[chan].arppos] != 252) {
@@ -312,7 +314,7 @@ bool CmodPlayer::update()
 	  regbd |= 128;
 	else
 	  regbd &= 127;
-	opl->write(0xbd,regbd);
+	oplwrite(0xbd,regbd);
 	break;
 
       case 1: // define cell-vibrato
@@ -320,7 +322,7 @@ bool CmodPlayer::update()
 	  regbd |= 64;
 	else
 	  regbd &= 191;
-	opl->write(0xbd,regbd);
+	oplwrite(0xbd,regbd);
 	break;
 
       case 4: // increase volume fine
@@ -410,9 +412,9 @@ bool CmodPlayer::update()
 
     case 25: // set carrier/modulator waveform
       if(info1 != 0x0f)
-	opl->write(0xe3 + op_table[oplchan],info1);
+	oplwrite(0xe3 + op_table[oplchan],info1);
       if(info2 != 0x0f)
-	opl->write(0xe0 + op_table[oplchan],info2);
+	oplwrite(0xe0 + op_table[oplchan],info2);
       break;
 
     case 27: // set chip tremolo/vibrato
@@ -424,7 +426,7 @@ bool CmodPlayer::update()
 	regbd |= 64;
       else
 	regbd &= 191;
-      opl->write(0xbd,regbd);
+      oplwrite(0xbd,regbd);
       break;
 
     case 29: // pattern delay (frames)
@@ -507,20 +509,20 @@ void CmodPlayer::rewind(int subsong)
       nop = (order[i] > nop ? order[i] : nop);
 
   opl->init();		// Reset OPL chip
-  opl->write(1, 32);	// Go to ym3812 mode
+  oplwrite(1, 32);	// Go to ym3812 mode
 
   // Enable OPL3 extensions if flagged
   if(flags & Opl3) {
     opl->setchip(1);
-    opl->write(1, 32);
-    opl->write(5, 1);
+    oplwrite(1, 32);
+    oplwrite(5, 1);
     opl->setchip(0);
   }
 
   // Enable tremolo/vibrato depth if flagged
   if(flags & Tremolo) regbd |= 128;
   if(flags & Vibrato) regbd |= 64;
-  if(regbd) opl->write(0xbd, regbd);
+  if(regbd) oplwrite(0xbd, regbd);
 }
 
 float CmodPlayer::getrefresh()
@@ -528,6 +530,14 @@ float CmodPlayer::getrefresh()
   return (float) (tempo / 2.5);
 }
 
+bool CmodPlayer::snapshot(CSnapshot &s)
+{
+  s.io(speed); s.io(del); s.io(songend); s.io(regbd);
+  s.io(tempo); s.io(rw); s.io(ord); s.io(curchip);
+  s.io(channel, sizeof(Channel) * nchans);
+  return true;
+}
+
 void CmodPlayer::init_trackord()
 {
   unsigned long i;
@@ -621,8 +631,8 @@ void CmodPlayer::setvolume(unsigned char chan)
   if(flags & Faust)
     setvolume_alt(chan);
   else {
-    opl->write(0x40 + op_table[oplchan], 63-channel[chan].vol2 + (inst[channel[chan].inst].data[9] & 192));
-    opl->write(0x43 + op_table[oplchan], 63-channel[chan].vol1 + (inst[channel[chan].inst].data[10] & 192));
+    oplwrite(0x40 + op_table[oplchan], 63-channel[chan].vol2 + (inst[channel[chan].inst].data[9] & 192));
+    oplwrite(0x43 + op_table[oplchan], 63-channel[chan].vol1 + (inst[channel[chan].inst].data[10] & 192));
   }
 }
 
@@ -632,19 +642,19 @@ void CmodPlayer::setvolume_alt(unsigned char chan)
   unsigned char ivol2 = inst[channel[chan].inst].data[9] & 63;
   unsigned char ivol1 = inst[channel[chan].inst].data[10] & 63;
 
-  opl->write(0x40 + op_table[oplchan], (((63 - (channel[chan].vol2 & 63)) + ivol2) >> 1) + (inst[channel[chan].inst].data[9] & 192));
-  opl->write(0x43 + op_table[oplchan], (((63 - (channel[chan].vol1 & 63)) + ivol1) >> 1) + (inst[channel[chan].inst].data[10] & 192));
+  oplwrite(0x40 + op_table[oplchan], (((63 - (channel[chan].vol2 & 63)) + ivol2) >> 1) + (inst[channel[chan].inst].data[9] & 192));
+  oplwrite(0x43 + op_table[oplchan], (((63 - (channel[chan].vol1 & 63)) + ivol1) >> 1) + (inst[channel[chan].inst].data[10] & 192));
 }
 
 void CmodPlayer::setfreq(unsigned char chan)
 {
   unsigned char oplchan = set_opl_chip(chan);
 
-  opl->write(0xa0 + oplchan, channel[chan].freq & 255);
+  oplwrite(0xa0 + oplchan, channel[chan].freq & 255);
   if(channel[chan].key)
-    opl->write(0xb0 + oplchan, ((channel[chan].freq & 768) >> 8) + (channel[chan].oct << 2) | 32);
+    oplwrite(0xb0 + oplchan, ((channel[chan].freq & 768) >> 8) + (channel[chan].oct << 2) | 32);
   else
-    opl->write(0xb0 + oplchan, ((channel[chan].freq & 768) >> 8) + (channel[chan].oct << 2));
+    oplwrite(0xb0 + oplchan, ((channel[chan].freq & 768) >> 8) + (channel[chan].oct << 2));
 }
 
 void CmodPlayer::playnote(unsigned char chan)
@@ -653,19 +663,19 @@ void CmodPlayer::playnote(unsigned char chan)
   unsigned char op = op_table[oplchan], insnr = channel[chan].inst;
 
   if(!(flags & NoKeyOn))
-    opl->write(0xb0 + oplchan, 0);	// stop old note
+    oplwrite(0xb0 + oplchan, 0);	// stop old note
 
   // set instrument data
-  opl->write(0x20 + op, inst[insnr].data[1]);
-  opl->write(0x23 + op, inst[insnr].data[2]);
-  opl->write(0x60 + op, inst[insnr].data[3]);
-  opl->write(0x63 + op, inst[insnr].data[4]);
-  opl->write(0x80 + op, inst[insnr].data[5]);
-  opl->write(0x83 + op, inst[insnr].data[6]);
-  opl->write(0xe0 + op, inst[insnr].data[7]);
-  opl->write(0xe3 + op, inst[insnr].data[8]);
-  opl->write(0xc0 + oplchan, inst[insnr].data[0]);
-  opl->write(0xbd, inst[insnr].misc);	// set misc. register
+  oplwrite(0x20 + op, inst[insnr].data[1]);
+  oplwrite(0x23 + op, inst[insnr].data[2]);
+  oplwrite(0x60 + op, inst[insnr].data[3]);
+  oplwrite(0x63 + op, inst[insnr].data[4]);
+  oplwrite(0x80 + op, inst[insnr].data[5]);
+  oplwrite(0x83 + op, inst[insnr].data[6]);
+  oplwrite(0xe0 + op, inst[insnr].data[7]);
+  oplwrite(0xe3 + op, inst[insnr].data[8]);
+  oplwrite(0xc0 + oplchan, inst[insnr].data[0]);
+  oplwrite(0xbd, inst[insnr].misc);	// set misc. register
 
   // set frequency, volume & play
   channel[chan].key = 1;
@@ -89,6 +89,8 @@ public:
 
   void dealloc();
 
+  bool snapshot(CSnapshot &s);
+
  private:
   static const unsigned short sa2_notetable[12];
   static const unsigned char vibratotab[32];
@@ -36,6 +36,7 @@
 */
 
 #include "psi.h"
+#include "snapshot.h"
 #include "debug.h"
 
 const unsigned char CxadpsiPlayer::psi_adlib_registers[99] =
@@ -63,6 +64,14 @@ CPlayer *CxadpsiPlayer::factory(Copl *newopl)
   return new CxadpsiPlayer(newopl);
 }
 
+CPlayer::ProbeScore CxadpsiPlayer::probe(const std::string &filename,
+					 const unsigned char *head,
+					 unsigned long len,
+					 unsigned long filesize)
+{
+  return probe_xad(head, len, PSI);
+}
+
 void CxadpsiPlayer::xadplayer_rewind(int subsong)
 {
   opl_write(0x01, 0x20);
@@ -161,6 +170,19 @@ void CxadpsiPlayer::xadplayer_update()
   }
 }
 
+bool CxadpsiPlayer::xadplayer_snapshot(CSnapshot &s)
+{
+  s.io(psi.note_delay);
+  s.io(psi.note_curdelay);
+  s.io(psi.looping);
+
+  // sequence positions are kept in the tune itself
+  for(int i=0; i<8; i++)
+    s.io(&psi.seq_table[(i<<1) * 2], 2);
+
+  return true;
+}
+
 float CxadpsiPlayer::xadplayer_getrefresh()
 {
   return 70.0f;
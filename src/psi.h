@@ -25,6 +25,9 @@ class CxadpsiPlayer: public CxadPlayer
 {
 public:
   static CPlayer *factory(Copl *newopl);
+  static ProbeScore probe(const std::string &filename,
+			  const unsigned char *head,
+			  unsigned long len, unsigned long filesize);
 
   CxadpsiPlayer(Copl *newopl): CxadPlayer(newopl)
     { }
@@ -54,6 +57,7 @@ protected:
     }
   void            xadplayer_rewind(int subsong);
   void            xadplayer_update();
+  bool            xadplayer_snapshot(CSnapshot &s);
   float           xadplayer_getrefresh();
   std::string     xadplayer_gettype();
   unsigned int    xadplayer_getinstruments();
@@ -24,15 +24,28 @@
 
 #include <cstring>
 #include "rad.h"
+#include "fcursor.h"
 
 CPlayer *CradLoader::factory(Copl *newopl)
 {
   return new CradLoader(newopl);
 }
 
-bool CradLoader::load(const std::string &filename, const CFileProvider &fp)
+CPlayer::ProbeScore CradLoader::probe(const std::string &filename,
+				      const unsigned char *head,
+				      unsigned long len,
+				      unsigned long filesize)
+{
+  if(len < 17 || memcmp(head, "RAD by REALiTY!!", 16) || head[16] != 0x10)
+    return PROBE_NO;
+
+  return PROBE_YES;
+}
+
+bool CradLoader::loadfile(const std::string &filename, const CFileProvider &fp)
 {
   binistream *f = fp.open(filename); if(!f) return false;
+  CFileCursor cur(fp, f);
   char id[16];
   unsigned char buf,ch,c,b,inp;
   char bufstr[2] = "\0";
@@ -41,15 +54,15 @@ bool CradLoader::load(const std::string &filename, const CFileProvider &fp)
   const unsigned char convfx[16] = {255,1,2,3,255,5,255,255,255,255,20,255,17,0xd,255,19};
 
   // file validation section
-  f->readString(id, 16); version = f->readInt(1);
+  cur.bytes(id, 16); version = cur.u8();
   if(strncmp(id,"RAD by REALiTY!!",16) || version != 0x10)
     { fp.close(f); return false; }
 
   // load section
-  radflags = f->readInt(1);
+  radflags = cur.u8();
   if(radflags & 128) {	// description
     memset(desc,0,80*22);
-    while((buf = f->readInt(1)))
+    while((buf = cur.u8()))
       if(buf == 1)
 	strcat(desc,"\n");
       else
@@ -61,34 +74,34 @@ bool CradLoader::load(const std::string &filename, const CFileProvider &fp)
 	  strcat(desc,bufstr);
 	}
   }
-  while((buf = f->readInt(1))) {	// instruments
+  while((buf = cur.u8())) {	// instruments
     buf--;
-    inst[buf].data[2] = f->readInt(1); inst[buf].data[1] = f->readInt(1);
-    inst[buf].data[10] = f->readInt(1); inst[buf].data[9] = f->readInt(1);
-    inst[buf].data[4] = f->readInt(1); inst[buf].data[3] = f->readInt(1);
-    inst[buf].data[6] = f->readInt(1); inst[buf].data[5] = f->readInt(1);
-    inst[buf].data[0] = f->readInt(1);
-    inst[buf].data[8] = f->readInt(1); inst[buf].data[7] = f->readInt(1);
+    inst[buf].data[2] = cur.u8(); inst[buf].data[1] = cur.u8();
+    inst[buf].data[10] = cur.u8(); inst[buf].data[9] = cur.u8();
+    inst[buf].data[4] = cur.u8(); inst[buf].data[3] = cur.u8();
+    inst[buf].data[6] = cur.u8(); inst[buf].data[5] = cur.u8();
+    inst[buf].data[0] = cur.u8();
+    inst[buf].data[8] = cur.u8(); inst[buf].data[7] = cur.u8();
   }
-  length = f->readInt(1);
-  for(i = 0; i < length; i++) order[i] = f->readInt(1);	// orderlist
-  for(i = 0; i < 32; i++) patofs[i] = f->readInt(2);	// pattern offset table
+  length = cur.u8();
+  for(i = 0; i < length; i++) order[i] = cur.u8();	// orderlist
+  for(i = 0; i < 32; i++) patofs[i] = cur.u16le();	// pattern offset table
   init_trackord();		// patterns
   for(i=0;i<32;i++)
     if(patofs[i]) {
-      f->seek(patofs[i]);
+      cur.seek(patofs[i]);
       do {
-	buf = f->readInt(1); b = buf & 127;
+	buf = cur.u8(); b = buf & 127;
 	do {
-	  ch = f->readInt(1); c = ch & 127;
-	  inp = f->readInt(1);
+	  ch = cur.u8(); c = ch & 127;
+	  inp = cur.u8();
 	  tracks[i*9+c][b].note = inp & 127;
 	  tracks[i*9+c][b].inst = (inp & 128) >> 3;
-	  inp = f->readInt(1);
+	  inp = cur.u8();
 	  tracks[i*9+c][b].inst += inp >> 4;
 	  tracks[i*9+c][b].command = inp & 15;
 	  if(inp & 15) {
-	    inp = f->readInt(1);
+	    inp = cur.u8();
 	    tracks[i*9+c][b].param1 = inp / 10;
 	    tracks[i*9+c][b].param2 = inp % 10;
 	  }
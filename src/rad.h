@@ -25,12 +25,15 @@ class CradLoader: public CmodPlayer
 {
 public:
   static CPlayer *factory(Copl *newopl);
+  static ProbeScore probe(const std::string &filename,
+			  const unsigned char *head,
+			  unsigned long len, unsigned long filesize);
 
 	CradLoader(Copl *newopl)
 		: CmodPlayer(newopl)
 	{ *desc = '\0'; };
 
-	bool load(const std::string &filename, const CFileProvider &fp);
+	bool loadfile(const std::string &filename, const CFileProvider &fp);
 	float getrefresh();
 
 	std::string gettype()
@@ -31,6 +31,7 @@
 
 #include <cstring>
 #include "rat.h"
+#include "snapshot.h"
 #include "debug.h"
 
 const unsigned char CxadratPlayer::rat_adlib_bases[18] =
@@ -50,6 +51,14 @@ CPlayer *CxadratPlayer::factory(Copl *newopl)
   return new CxadratPlayer(newopl);
 }
 
+CPlayer::ProbeScore CxadratPlayer::probe(const std::string &filename,
+					 const unsigned char *head,
+					 unsigned long len,
+					 unsigned long filesize)
+{
+  return probe_xad(head, len, RAT);
+}
+
 bool CxadratPlayer::xadplayer_load()
 {
   if(xad.fmt != RAT)
@@ -249,6 +258,15 @@ void CxadratPlayer::xadplayer_update()
   }
 }
 
+bool CxadratPlayer::xadplayer_snapshot(CSnapshot &s)
+{
+  s.io(rat.volume);
+  s.io(rat.order_pos);
+  s.io(rat.pattern_pos);
+  s.io(rat.channel);
+  return true;
+}
+
 float CxadratPlayer::xadplayer_getrefresh()
 {
   return 60.0f;
@@ -21,6 +21,8 @@
 
 #include <cstring>
 #include "raw.h"
+#include "snapshot.h"
+#include "fcursor.h"
 
 /*** public methods *************************************/
 
@@ -29,23 +31,32 @@ CPlayer *CrawPlayer::factory(Copl *newopl)
   return new CrawPlayer(newopl);
 }
 
-bool CrawPlayer::load(const std::string &filename, const CFileProvider &fp)
+CPlayer::ProbeScore CrawPlayer::probe(const std::string &filename,
+				      const unsigned char *head,
+				      unsigned long len,
+				      unsigned long filesize)
+{
+  return len >= 8 && !memcmp(head, "RAWADATA", 8) ? PROBE_YES : PROBE_NO;
+}
+
+bool CrawPlayer::loadfile(const std::string &filename, const CFileProvider &fp)
 {
   binistream *f = fp.open(filename); if(!f) return false;
+  CFileCursor c(fp, f);
   char id[8];
   unsigned long i;
 
   // file validation section
-  f->readString(id, 8);
+  c.bytes(id, 8);
   if(strncmp(id,"RAWADATA",8)) { fp.close (f); return false; }
 
   // load section
-  clock = f->readInt(2);	// clock speed
-  length = (fp.filesize(f) - 10) / 2;
+  clock = c.u16le();	// clock speed
+  length = (c.filesize() - 10) / 2;
   data = new Tdata [length];
   for(i = 0; i < length; i++) {
-    data[i].param = f->readInt(1);
-    data[i].command = f->readInt(1);
+    data[i].param = c.u8();
+    data[i].command = c.u8();
   }
 
   fp.close(f);
@@ -98,6 +109,12 @@ void CrawPlayer::rewind(int subsong)
   opl->init(); opl->write(1, 32);	// go to 9 channel mode
 }
 
+bool CrawPlayer::snapshot(CSnapshot &s)
+{
+  s.io(pos); s.io(speed); s.io(del); s.io(songend);
+  return true;
+}
+
 float CrawPlayer::getrefresh()
 {
   return 1193180.0 / (speed ? speed : 0xffff);	// timer oscillator speed / wait register = clock frequency
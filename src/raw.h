@@ -25,6 +25,9 @@ class CrawPlayer: public CPlayer
 {
 public:
   static CPlayer *factory(Copl *newopl);
+  static ProbeScore probe(const std::string &filename,
+			  const unsigned char *head,
+			  unsigned long len, unsigned long filesize);
 
 	CrawPlayer(Copl *newopl)
 		: CPlayer(newopl), data(0)
@@ -32,7 +35,7 @@ public:
 	~CrawPlayer()
 	{ if(data) delete [] data; };
 
-	bool load(const std::string &filename, const CFileProvider &fp);
+	bool loadfile(const std::string &filename, const CFileProvider &fp);
 	bool update();
 	void rewind(int subsong);
 	float getrefresh();
@@ -41,6 +44,8 @@ public:
 	{ return std::string("RdosPlay RAW"); };
 
 protected:
+	bool snapshot(CSnapshot &s);
+
 	struct Tdata {
 		unsigned char param, command;
 	} *data;
@@ -0,0 +1,79 @@
+/*
+ * Adplug - Replayer for many OPL2/OPL3 audio file formats.
+ * Copyright (C) 1999 - 2008 Simon Peter, <dn.tlp@gmx.net>, et al.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * renderer.cpp - Offline renderer, drives a player and an emulated OPL
+ */
+
+#include "renderer.h"
+
+CRenderer::CRenderer(CPlayer *p, Copl *newopl, unsigned long newfreq,
+		     bool bit16, bool stereo)
+  : player(p), opl(newopl), freq(newfreq),
+    samplesize((bit16 ? 2 : 1) * (stereo ? 2 : 1)), limit(0), rendered(0),
+    pos(0.0f), due(0.0f), ended(false)
+{
+}
+
+void CRenderer::rewind(int subsong)
+{
+  player->rewind(subsong);
+  rendered = 0;
+  pos = due = 0.0f;
+  ended = false;
+}
+
+unsigned long CRenderer::render(short *buf, unsigned long samples,
+			       short **stems)
+{
+  char		*out = (char *)buf;
+  short		*stem[18];
+  unsigned long	done = 0, n;
+  int		i;
+
+  for(i = 0; stems && i < 18; i++)
+    stem[i] = stems[i];
+
+  while(done < samples) {
+    // run replay ticks until there is something to render
+    while(due < 1.0f && !ended) {
+      if((limit && pos >= limit) || !player->update())
+	ended = true;
+      else {
+	due += freq / player->getrefresh();
+	pos += 1000.0f / player->getrefresh();
+      }
+    }
+    if(ended) break;
+
+    n = samples - done;
+    if(n > (unsigned long)due) n = (unsigned long)due;
+
+    if(stems) {
+      opl->updatestems((short *)out, stem, n);
+      for(i = 0; i < 18; i++)
+	if(stem[i]) stem[i] = (short *)((char *)stem[i] + n * samplesize);
+    } else
+      opl->update((short *)out, n);
+    out += n * samplesize;
+    done += n;
+    due -= n;
+  }
+
+  rendered += done;
+  return done;
+}
@@ -0,0 +1,69 @@
+/*
+ * Adplug - Replayer for many OPL2/OPL3 audio file formats.
+ * Copyright (C) 1999 - 2008 Simon Peter, <dn.tlp@gmx.net>, et al.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * renderer.h - Offline renderer, drives a player and an emulated OPL
+ *
+ * NOTES:
+ * A CRenderer owns the usual replay loop: it calls the player's update()
+ * whenever a tick is due and fills the time in between from the OPL
+ * emulator, carrying the fractional number of samples per tick along, so
+ * the output doesn't drift from the player's refresh rate. Neither the
+ * player nor the OPL are owned by the renderer.
+ */
+
+#ifndef H_ADPLUG_RENDERER
+#define H_ADPLUG_RENDERER
+
+#include "player.h"
+#include "opl.h"
+
+class CRenderer
+{
+public:
+  // 'opl' must be the emulator that 'p' plays on, set up for sample rate
+  // 'freq' and the given sample format.
+  CRenderer(CPlayer *p, Copl *opl, unsigned long freq, bool bit16,
+	    bool stereo);
+
+  void rewind(int subsong = -1);		// rewinds to specified subsong
+  void setlimit(unsigned long ms)		// 0 = render until song end
+    { limit = ms; }
+
+  // Renders up to 'samples' samples into 'buf' and returns the number of
+  // samples rendered. Less than requested means the song has ended. With
+  // 'stems', every channel is rendered into its own buffer there at the same
+  // time, see Copl::updatestems().
+  unsigned long render(short *buf, unsigned long samples, short **stems = 0);
+
+  bool songend()			// true once the song has ended
+    { return ended; }
+  unsigned long getrendered()		// samples rendered since rewind
+    { return rendered; }
+  unsigned long getsamplesize()		// size of one sample in bytes
+    { return samplesize; }
+
+private:
+  CPlayer	*player;
+  Copl		*opl;
+  unsigned long	freq, samplesize, limit, rendered;
+  float		pos;		// replay position in ms
+  float		due;		// samples left until the next tick
+  bool		ended;
+};
+
+#endif
@@ -0,0 +1,145 @@
+/*
+ * Adplug - Replayer for many OPL2/OPL3 audio file formats.
+ * Copyright (C) 1999 - 2008 Simon Peter, <dn.tlp@gmx.net>, et al.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * resampleopl.cpp - Runs an emulator at the chip's native sample rate and
+ *                   resamples its output
+ */
+
+#include "resampleopl.h"
+#include "snapshot.h"
+#include "sampleconv.h"
+
+// Output samples resampled in one go
+#define CHUNK	512
+
+CResampleopl::CResampleopl(Copl *newopl, unsigned long rate, bool stereo,
+			   CResampler::Quality quality)
+  : opl(newopl), resampler(NATIVE_RATE, rate, stereo, quality),
+    channels(stereo ? 2 : 1)
+{
+  currType = opl->gettype();
+  currChip = opl->getchip();
+}
+
+CResampleopl::~CResampleopl()
+{
+  delete opl;
+}
+
+void CResampleopl::update(short *buf, int samples)
+{
+  unsigned long n, in;
+
+  while(samples > 0) {
+    n = dequeue(samples < CHUNK ? samples : CHUNK);
+    in = resampler.needed(n);
+
+    if(native.size() < in * channels) native.resize(in * channels);
+    if(in) opl->update(&native[0], in);
+    resampler.process(in ? &native[0] : 0, buf, n);
+
+    buf += n * channels;
+    samples -= n;
+  }
+}
+
+bool CResampleopl::updatefmt(void **bufs, int samples, const Format &fmt)
+{
+  return sampleconv_update(this, channels > 1, bufs, samples, fmt);
+}
+
+void CResampleopl::write(int reg, int val)
+{
+  opl->write(reg, val);
+}
+
+void CResampleopl::write_at(unsigned long offset, int reg, int val)
+{
+  // queued here, where the offset counts output samples
+  enqueue(offset, reg, val);
+}
+
+void CResampleopl::write_batch(const RegWrite *w, size_t n)
+{
+  opl->write_batch(w, n);
+}
+
+unsigned long CResampleopl::getactive()
+{
+  return opl->getactive();
+}
+
+void CResampleopl::setchannelmask(unsigned long mask)
+{
+  Copl::setchannelmask(mask);
+  opl->setchannelmask(mask);
+}
+
+void CResampleopl::setchip(int n)
+{
+  Copl::setchip(n);
+  opl->setchip(n);
+}
+
+int CResampleopl::getchip()
+{
+  return opl->getchip();
+}
+
+void CResampleopl::init()
+{
+  opl->init();
+  resampler.reset();
+  clearqueue();
+}
+
+bool CResampleopl::save_state(std::string &state)
+{
+  CSnapshot	s(&state);
+  std::string	emu, pos;
+
+  if(!opl->save_state(emu)) return false;
+  resampler.save_state(pos);
+
+  state.clear();
+  s.io(emu);
+  s.io(pos);
+  return true;
+}
+
+bool CResampleopl::load_state(const std::string &state)
+{
+  CSnapshot	s(state);
+  std::string	emu, pos, backup;
+
+  s.io(emu);
+  s.io(pos);
+  if(!s.good()) return false;
+
+  // keep the emulator and the stream position in step
+  resampler.save_state(backup);
+  if(!resampler.load_state(pos)) return false;
+  if(!opl->load_state(emu)) {
+    resampler.load_state(backup);
+    return false;
+  }
+
+  currChip = opl->getchip();
+  clearqueue();
+  return true;
+}
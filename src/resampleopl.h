@@ -0,0 +1,65 @@
+/*
+ * Adplug - Replayer for many OPL2/OPL3 audio file formats.
+ * Copyright (C) 1999 - 2008 Simon Peter, <dn.tlp@gmx.net>, et al.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * resampleopl.h - Runs an emulator at the chip's native sample rate and
+ *                 resamples its output
+ *
+ * NOTES:
+ * The wrapped emulator must be set up for NATIVE_RATE and 16 bit samples,
+ * mono or stereo as given to the constructor. It is owned by the
+ * CResampleopl from then on. All OPL access is passed on to it.
+ */
+
+#ifndef H_ADPLUG_RESAMPLEOPL
+#define H_ADPLUG_RESAMPLEOPL
+
+#include <vector>
+#include "opl.h"
+#include "resampler.h"
+
+class CResampleopl: public Copl
+{
+public:
+  enum { NATIVE_RATE = 49716 };		// 14.31818 MHz / 288
+
+  CResampleopl(Copl *native, unsigned long rate, bool stereo,
+	       CResampler::Quality quality = CResampler::SINC8);
+  ~CResampleopl();
+
+  void update(short *buf, int samples);
+  bool updatefmt(void **bufs, int samples, const Format &fmt);
+  void write(int reg, int val);
+  void write_at(unsigned long offset, int reg, int val);
+  void write_batch(const RegWrite *w, size_t n);
+  unsigned long getactive();
+  void setchannelmask(unsigned long mask);
+  void setchip(int n);
+  int getchip();
+  void init();
+
+  bool save_state(std::string &state);
+  bool load_state(const std::string &state);
+
+private:
+  Copl			*opl;
+  CResampler		resampler;
+  unsigned int		channels;
+  std::vector<short>	native;		// buffer for the emulator's output
+};
+
+#endif
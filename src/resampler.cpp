@@ -0,0 +1,288 @@
+/*
+ * Adplug - Replayer for many OPL2/OPL3 audio file formats.
+ * Copyright (C) 1999 - 2008 Simon Peter, <dn.tlp@gmx.net>, et al.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * resampler.cpp - Polyphase sample rate converter for 16 bit audio
+ */
+
+#include <math.h>
+#include "resampler.h"
+#include "snapshot.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+  (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RESAMPLER_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifndef PI
+#define PI 3.14159265358979323846
+#endif
+
+// Kernel gain, 1.0 in fixed point
+#define UNITY	32768
+
+/***** Local functions *****/
+
+static double bessel_i0(double x)
+  /*
+   * Modified Bessel function of the first kind, order 0, for the Kaiser
+   * window.
+   */
+{
+  double sum = 1.0, term = 1.0;
+
+  for(int k = 1; k < 32; k++) {
+    term *= (x / (2 * k)) * (x / (2 * k));
+    sum += term;
+  }
+
+  return sum;
+}
+
+/***** CKaiserWindow *****/
+
+// The Kaiser window over the kernels of one quality, for every tap of every
+// phase. It doesn't depend on the rates, so each is worked out only once, by
+// the first resampler that needs it, and only read afterwards.
+class CKaiserWindow
+{
+public:
+  CKaiserWindow(unsigned int phases, unsigned int taps, double beta);
+
+  double get(unsigned int phase, unsigned int tap) const
+    { return v[phase * taps + tap]; }
+
+private:
+  unsigned int		taps;
+  std::vector<double>	v;
+};
+
+CKaiserWindow::CKaiserWindow(unsigned int phases, unsigned int newtaps,
+			     double beta)
+  : taps(newtaps), v(phases * newtaps)
+{
+  for(unsigned int p = 0; p < phases; p++)
+    for(unsigned int k = 0; k < taps; k++) {
+      double x = (double)k - (taps / 2 - 1) - (double)p / phases;
+      double w = x / (taps / 2);
+
+      v[p * taps + k] = w * w < 1.0 ?
+	bessel_i0(beta * sqrt(1.0 - w * w)) / bessel_i0(beta) : 0.0;
+    }
+}
+
+/***** CResampler *****/
+
+CResampler::CResampler(unsigned long newinrate, unsigned long newoutrate,
+		       bool stereo, Quality newquality)
+  : quality(newquality), inrate(newinrate), outrate(newoutrate),
+    channels(stereo ? 2 : 1)
+{
+  switch(quality) {
+  case LINEAR: taps = 2; break;
+  case SINC8: taps = 8; break;
+  default: taps = 32; break;
+  }
+
+  make_kernels();
+  reset();
+}
+
+void CResampler::reset()
+{
+  // the first output sample sits on the first input sample, there is
+  // silence before it
+  for(unsigned int c = 0; c < channels; c++)
+    hist[c].assign(taps / 2 - 1, 0);
+  pos = taps / 2 - 1;
+  frac = 0;
+}
+
+unsigned long CResampler::needed(unsigned long samples) const
+{
+  unsigned long	p = pos, f = frac, last;
+
+  if(!samples) return 0;
+
+  // position of the last output sample, with the fraction summed up in
+  // parts that cannot overflow
+  samples--;
+  p += samples * (inrate / outrate) + samples / outrate * (inrate % outrate);
+  f += samples % outrate * (inrate % outrate);
+  p += f / outrate;
+
+  last = p + taps / 2 + 1;
+  return last > hist[0].size() ? last - hist[0].size() : 0;
+}
+
+void CResampler::process(const short *in, short *out, unsigned long samples)
+{
+  unsigned long	n = needed(samples), i, first;
+  unsigned int	c;
+
+  // append the new input, one channel after the other
+  for(c = 0; c < channels; c++) {
+    std::vector<short> &h = hist[c];
+    unsigned long size = h.size();
+
+    h.resize(size + n);
+    for(i = 0; i < n; i++)
+      h[size + i] = in[i * channels + c];
+  }
+
+  const short *h0 = &hist[0][0], *h1 = channels > 1 ? &hist[1][0] : 0;
+  const unsigned long istep = inrate / outrate, fstep = inrate % outrate;
+  const unsigned int back = taps / 2 - 1;
+
+  for(i = 0; i < samples; i++) {
+    const short *kernel = &coef[(frac * PHASES / outrate) * taps];
+
+    *out++ = dot(kernel, h0 + pos - back, taps);
+    if(h1) *out++ = dot(kernel, h1 + pos - back, taps);
+
+    pos += istep;
+    if((frac += fstep) >= outrate) {
+      frac -= outrate;
+      pos++;
+    }
+  }
+
+  // drop the input that no future output sample reaches back to
+  first = pos - (taps / 2 - 1);
+  for(c = 0; c < channels; c++)
+    hist[c].erase(hist[c].begin(), hist[c].begin() + first);
+  pos -= first;
+}
+
+void CResampler::save_state(std::string &state) const
+{
+  CSnapshot	s(&state);
+  unsigned long	p = pos, f = frac;
+  std::vector<short> h0 = hist[0], h1 = hist[1];
+
+  state.clear();
+  s.io(p); s.io(f); s.io(h0); s.io(h1);
+}
+
+bool CResampler::load_state(const std::string &state)
+{
+  CSnapshot	s(state);
+  unsigned long	p = 0, f = 0;
+  std::vector<short> h0, h1;
+
+  s.io(p); s.io(f); s.io(h0); s.io(h1);
+  if(!s.good() || p != taps / 2 - 1 || f >= outrate || h0.size() < p ||
+     (channels > 1 && h1.size() != h0.size()))
+    return false;
+
+  pos = p; frac = f;
+  hist[0].swap(h0);
+  hist[1].swap(h1);
+  return true;
+}
+
+void CResampler::make_kernels()
+  /*
+   * Fills 'coef' with one kernel for each of the PHASES positions between
+   * two input samples. The sinc kernels low-pass the input below the lower
+   * of both Nyquist frequencies, with the roll-off starting early enough for
+   * the short kernels to reach it. Every kernel sums up to exactly UNITY,
+   * so silence and DC pass through unchanged.
+   */
+{
+  const CKaiserWindow	*window = NULL;
+  double		cutoff = inrate > outrate ? (double)outrate / inrate : 1.0;
+  double		x, sum, v[32];
+  unsigned int		p, k, peak;
+  long			total;
+
+  switch(quality) {
+  case SINC8: {
+    static const CKaiserWindow sinc8(PHASES, 8, 5.0);
+
+    cutoff *= 0.80; window = &sinc8;
+    break;
+  }
+
+  case SINC32: {
+    static const CKaiserWindow sinc32(PHASES, 32, 8.0);
+
+    cutoff *= 0.92; window = &sinc32;
+    break;
+  }
+
+  default: break;
+  }
+
+  coef.resize(PHASES * taps);
+  for(p = 0; p < PHASES; p++) {
+    double f = (double)p / PHASES;
+    short *kernel = &coef[p * taps];
+
+    // distance of every tap from the output position, in input samples
+    sum = 0.0;
+    for(k = 0; k < taps; k++) {
+      x = (double)k - (taps / 2 - 1) - f;
+      if(quality == LINEAR)
+	v[k] = 1.0 - fabs(x);
+      else {
+	v[k] = cutoff * (x == 0.0 ? 1.0 : sin(PI * cutoff * x) / (PI * cutoff * x));
+	v[k] *= window->get(p, k);
+      }
+      sum += v[k];
+    }
+
+    // fixed point, with the rounding error going to the largest tap
+    total = 0; peak = 0;
+    for(k = 0; k < taps; k++) {
+      long c = (long)floor(v[k] / sum * UNITY + 0.5);
+      if(c > 32767) c = 32767;
+      kernel[k] = (short)c;
+      total += c;
+      if(kernel[k] > kernel[peak]) peak = k;
+    }
+    if(kernel[peak] + (UNITY - total) <= 32767)
+      kernel[peak] += (short)(UNITY - total);
+  }
+}
+
+short CResampler::dot(const short *kernel, const short *x, unsigned int taps)
+{
+  long		acc = 0;
+  unsigned int	k = 0;
+
+#ifdef RESAMPLER_SSE2
+  __m128i sum = _mm_setzero_si128();
+
+  for(; k + 8 <= taps; k += 8)
+    sum = _mm_add_epi32(sum, _mm_madd_epi16(
+	    _mm_loadu_si128((const __m128i *)(kernel + k)),
+	    _mm_loadu_si128((const __m128i *)(x + k))));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+  acc = _mm_cvtsi128_si32(sum);
+#endif
+
+  for(; k < taps; k++)
+    acc += (long)kernel[k] * x[k];
+
+  acc = (acc + UNITY / 2) >> 15;
+  if(acc > 32767) return 32767;
+  if(acc < -32768) return -32768;
+  return (short)acc;
+}
@@ -0,0 +1,80 @@
+/*
+ * Adplug - Replayer for many OPL2/OPL3 audio file formats.
+ * Copyright (C) 1999 - 2008 Simon Peter, <dn.tlp@gmx.net>, et al.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * resampler.h - Polyphase sample rate converter for 16 bit audio
+ *
+ * NOTES:
+ * A CResampler converts a stream of 16 bit mono or interleaved stereo
+ * samples from one rate to another. Every output sample is the dot product
+ * of 'taps' input samples around its position with one of PHASES filter
+ * kernels, picked by the position's fraction. The kernels are worked out
+ * once, when the resampler is created: linear interpolation for LINEAR,
+ * Kaiser windowed sinc low-pass filters for the others. The windows are
+ * shared by all resamplers of a quality. The step between output samples
+ * is kept as an exact fraction, so there is no drift.
+ */
+
+#ifndef H_ADPLUG_RESAMPLER
+#define H_ADPLUG_RESAMPLER
+
+#include <string>
+#include <vector>
+
+class CResampler
+{
+public:
+  enum Quality { LINEAR, SINC8, SINC32 };
+
+  CResampler(unsigned long inrate, unsigned long outrate, bool stereo,
+	     Quality quality = SINC8);
+
+  void reset();				// forget all input so far
+
+  // Returns the number of input samples process() needs to produce
+  // 'samples' output samples.
+  unsigned long needed(unsigned long samples) const;
+
+  // Produces 'samples' output samples into 'out' from the needed(samples)
+  // input samples in 'in'.
+  void process(const short *in, short *out, unsigned long samples);
+
+  // Save/restore the stream position. A state may only be restored into a
+  // resampler set up the same way.
+  void save_state(std::string &state) const;
+  bool load_state(const std::string &state);
+
+  Quality getquality() const
+    { return quality; }
+  unsigned int gettaps() const		// input samples per output sample
+    { return taps; }
+
+private:
+  static const unsigned int PHASES = 256;	// kernels per input sample
+
+  Quality		quality;
+  unsigned long		inrate, outrate;
+  unsigned int		channels, taps;
+  std::vector<short>	coef;		// PHASES kernels of 'taps' samples
+  std::vector<short>	hist[2];	// unused input, per channel
+  unsigned long		pos, frac;	// next output at hist[pos + frac/outrate]
+
+  void make_kernels();
+  static short dot(const short *kernel, const short *x, unsigned int taps);
+};
+
+#endif
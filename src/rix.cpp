@@ -23,6 +23,7 @@
 #include <cstring>
 #include <stdint.h>
 #include "rix.h"
+#include "snapshot.h"
 #include "debug.h"
 
 #if defined(__hppa__) || \
@@ -55,8 +56,6 @@ const uint8_t CrixPlayer::bd_reg_data[] = {
   0x0F,0x0B,0x00,0x05,0x05,0x00,0x00,0x00,0x00,0x00,0x00,
   0x00,0x01,0x00,0x0F,0x0B,0x00,0x07,0x05,0x00,0x00,0x00,
   0x00,0x00,0x00};
-uint8_t CrixPlayer::for40reg[] = {0x7F,0x7F,0x7F,0x7F,0x7F,0x7F,0x7F,0x7F,0x7F,
-					0x7F,0x7F,0x7F,0x7F,0x7F,0x7F,0x7F,0x7F,0x7F};
 const uint16_t CrixPlayer::mus_time = 0x4268;
 
 /*** public methods *************************************/
@@ -67,20 +66,33 @@ CPlayer *CrixPlayer::factory(Copl *newopl)
 }
 
 CrixPlayer::CrixPlayer(Copl *newopl)
-  : CPlayer(newopl), flag_mkf(0), file_buffer(0), rix_buf(0)
+  : CPlayer(newopl), flag_mkf(0), file_buffer(0), file_copy(0), file_fp(0),
+    rix_buf(0), cursubsong(0)
 {
 }
 
 CrixPlayer::~CrixPlayer()
 {
-  if(file_buffer)
-    delete [] file_buffer;
+  delete [] file_copy;
+  if(file_fp) file_fp->unview(file_buffer);
 }
 
-bool CrixPlayer::load(const std::string &filename, const CFileProvider &fp)
+CPlayer::ProbeScore CrixPlayer::probe(const std::string &filename,
+				      const unsigned char *head,
+				      unsigned long len,
+				      unsigned long filesize)
+{
+  // the song in an .mkf archive starts at an offset given by its first bytes
+  if(CFileProvider::extension(filename, ".mkf"))
+    return PROBE_MAYBE;
+
+  return len >= 2 && head[0] == 0xaa && head[1] == 0x55 ? PROBE_YES : PROBE_NO;
+}
+
+bool CrixPlayer::loadfile(const std::string &filename, const CFileProvider &fp)
 {
   binistream *f = fp.open(filename); if(!f) return false;
-  uint32_t i=0;
+  unsigned long size;
 
   if(stricmp(filename.substr(filename.length()-4,4).c_str(),".mkf")==0)
   {
@@ -90,11 +102,13 @@ bool CrixPlayer::load(const std::string &filename, const CFileProvider &fp)
 	  f->seek(offset);
   }
   if(f->readInt(2)!=0x55aa){ fp.close(f);return false; }
-  file_buffer = new uint8_t [fp.filesize(f) + 1];
   f->seek(0);
-  while(!f->eof())
-	file_buffer[i++]=f->readInt(1);
-  length=i;
+  size = fp.filesize(f);
+  delete [] file_copy;
+  if(file_fp) file_fp->unview(file_buffer);
+  file_buffer = fp.contents(f, size, file_copy);
+  file_fp = file_copy ? 0 : &fp;
+  length=size+1;  /* as when it was read up to EOF, one byte too far */
   fp.close(f);
   if(!flag_mkf)
 	  rix_buf=file_buffer;
@@ -110,6 +124,9 @@ bool CrixPlayer::update()
 
 void CrixPlayer::rewind(int subsong)
 {
+  if(subsong == -1) subsong = cursubsong;
+  cursubsong = subsong;
+
   I = 0; T = 0;
   mus_block = 0;
   ins_block = 0;
@@ -137,7 +154,7 @@ void CrixPlayer::rewind(int subsong)
 
   if(flag_mkf)
   {
-	  uint32_t *buf_index=(uint32_t *)file_buffer;
+	  const uint32_t *buf_index=(const uint32_t *)file_buffer;
 	  int offset1=RIX_SWAP32(buf_index[subsong]),offset2;
 	  while((offset2=RIX_SWAP32(buf_index[++subsong]))==offset1);
 	  length=offset2-offset1+1;
@@ -149,11 +166,24 @@ void CrixPlayer::rewind(int subsong)
   data_initial();
 }
 
+bool CrixPlayer::snapshot(CSnapshot &s)
+{
+  s.ptr(rix_buf, file_buffer);
+  s.io(length); s.io(pos); s.io(index); s.io(cursubsong);
+  s.io(f_buffer); s.io(a0b0_data2); s.io(a0b0_data3); s.io(a0b0_data4);
+  s.io(a0b0_data5); s.io(addrs_head); s.io(insbuf); s.io(displace);
+  s.io(reg_bufs); s.io(for40reg);
+  s.io(I); s.io(T); s.io(mus_block); s.io(ins_block); s.io(rhythm);
+  s.io(music_on); s.io(pause_flag); s.io(band); s.io(band_low);
+  s.io(e0_reg_flag); s.io(bd_modify); s.io(sustain); s.io(play_end);
+  return true;
+}
+
 uint32_t CrixPlayer::getsubsongs()
 {
 	if(flag_mkf)
 	{
-		uint32_t *buf_index=(uint32_t *)file_buffer;
+		const uint32_t *buf_index=(const uint32_t *)file_buffer;
 		int songs=RIX_SWAP32(buf_index[0])/4,i=0;
 		for(i=0;i<songs;i++)
 			if(buf_index[i+1]==buf_index[i])
@@ -273,7 +303,7 @@ inline uint16_t CrixPlayer::rix_proc()
   uint8_t ctrl = 0;
   if(music_on == 0||pause_flag == 1) return 0;
   band = 0;
-  while(rix_buf[I] != 0x80 && I<length-1)
+  while(I<length-1 && rix_buf[I] != 0x80)
     {
       band_low = rix_buf[I-1];
       ctrl = rix_buf[I]; I+=2;
@@ -298,7 +328,7 @@ inline uint16_t CrixPlayer::rix_proc()
 inline void CrixPlayer::rix_get_ins()
 {
   int		i;
-  uint8_t	*baddr = (&rix_buf[ins_block])+(band_low<<6);
+  const uint8_t	*baddr = (&rix_buf[ins_block])+(band_low<<6);
 
   for(i = 0; i < 28; i++)
     insbuf[i] = (baddr[i * 2 + 1] << 8) + baddr[i * 2];
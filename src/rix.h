@@ -26,27 +26,36 @@ class CrixPlayer: public CPlayer
 {
  public:
   static CPlayer *factory(Copl *newopl);
+  static ProbeScore probe(const std::string &filename,
+			  const unsigned char *head,
+			  unsigned long len, unsigned long filesize);
 
   CrixPlayer(Copl *newopl);
   ~CrixPlayer();
 
-  bool load(const std::string &filename, const CFileProvider &fp);
+  bool loadfile(const std::string &filename, const CFileProvider &fp);
   bool update();
   void rewind(int subsong);
   float getrefresh();
   uint32_t getsubsongs();
+  uint32_t getsubsong()
+    { return cursubsong; };
 
   std::string gettype()
     { return std::string("Softstar RIX OPL Music Format"); };
 
  protected:	
+  bool snapshot(CSnapshot &s);
+
   typedef struct {
     uint8_t v[14];
   } ADDT;
 
   int flag_mkf;
-  uint8_t *file_buffer;
-  uint8_t *rix_buf;  /* rix files' f_buffer */
+  const uint8_t *file_buffer;
+  uint8_t *file_copy;  /* file_buffer, unless the file provider keeps it */
+  const CFileProvider *file_fp;  /* keeps it, to unview() it */
+  const uint8_t *rix_buf;  /* rix files' f_buffer */
   uint16_t f_buffer[300];//9C0h-C18h
   uint16_t a0b0_data2[11];
   uint8_t a0b0_data3[18];
@@ -56,7 +65,9 @@ class CrixPlayer: public CPlayer
   uint16_t insbuf[28];
   uint16_t displace[11];
   ADDT reg_bufs[18];
+  uint8_t for40reg[18];
   uint32_t pos,length;
+  uint32_t cursubsong;
   uint8_t index;
 
   static const uint8_t adflag[18];
@@ -64,7 +75,6 @@ class CrixPlayer: public CPlayer
   static const uint8_t ad_C0_offs[18];
   static const uint8_t modify[28];
   static const uint8_t bd_reg_data[124];
-  static uint8_t for40reg[18];
   static const uint16_t mus_time;
   uint32_t I,T;
   uint16_t mus_block;
@@ -24,7 +24,9 @@
 #include <algorithm>
 
 #include "rol.h"
+#include "snapshot.h"
 #include "debug.h"
+#include "fcursor.h"
 
 #if !defined(UINT8_MAX)
     typedef signed char    int8_t;
@@ -129,6 +131,7 @@ static inline float fmin(int const a, int const b)
 }
 //---------------------------------------------------------
 int   const CrolPlayer::kSizeofDataRecord    = 30;
+int   const CrolPlayer::CRolBank::kSizeofNameEntry = 3 + ROL_MAX_NAME_SIZE;
 int   const CrolPlayer::kMaxTickBeat         = 60;
 int   const CrolPlayer::kSilenceNote         = -12;
 int   const CrolPlayer::kNumMelodicVoices    = 9;
@@ -182,7 +185,19 @@ CrolPlayer::~CrolPlayer()
     }
 }
 //---------------------------------------------------------
-bool CrolPlayer::load(const std::string & filename, const CFileProvider & fp)
+CPlayer::ProbeScore CrolPlayer::probe(const std::string &filename,
+				      const unsigned char *head,
+				      unsigned long len,
+				      unsigned long filesize)
+{
+    if(len < 4 || (head[0] | head[1] << 8) != skVersionMinor ||
+       (head[2] | head[3] << 8) != skVersionMajor)
+        return PROBE_NO;
+
+    return PROBE_YES;
+}
+//---------------------------------------------------------
+bool CrolPlayer::loadfile(const std::string & filename, const CFileProvider & fp)
 {
     binistream *f = fp.open(filename);
 
@@ -191,11 +206,13 @@ bool CrolPlayer::load(const std::string & filename, const CFileProvider & fp)
         return false;
     }
 
+    CFileCursor c(fp, f);
+
     char *fn = new char[filename.length()+13];
     int i;
     std::string bnk_filename;
 
-    AdPlug_LogWrite("*** CrolPlayer::load(f, \"%s\") ***\n", filename.c_str());
+    AdPlug_LogWrite("*** CrolPlayer::loadfile(f, \"%s\") ***\n", filename.c_str());
     strcpy(fn,filename.data());
     for (i = strlen(fn) - 1; i >= 0; i--)
     {
@@ -209,11 +226,17 @@ bool CrolPlayer::load(const std::string & filename, const CFileProvider & fp)
     delete [] fn;
     AdPlug_LogWrite("bnk_filename = \"%s\"\n",bnk_filename.c_str());
 
+    // drop the song loaded before, if any
+    delete mpROLHeader;
+    mTempoEvents.clear();
+    mVoiceData.clear();
+    mInstrumentList.clear();
+
     mpROLHeader = new SRolHeader;
     memset(mpROLHeader, 0, sizeof(SRolHeader));
 
-    mpROLHeader->version_major = static_cast<uint16_t>(f->readInt(2));
-    mpROLHeader->version_minor = static_cast<uint16_t>(f->readInt(2));
+    mpROLHeader->version_major = static_cast<uint16_t>(c.u16le());
+    mpROLHeader->version_minor = static_cast<uint16_t>(c.u16le());
 
     // Version check
     if ((mpROLHeader->version_major != skVersionMinor) || (mpROLHeader->version_minor != skVersionMajor))
@@ -225,26 +248,26 @@ bool CrolPlayer::load(const std::string & filename, const CFileProvider & fp)
         return false;
     }
 
-    f->seek(ROL_UNSUED0_SIZE, binio::Add); // Seek past 'SRolHeader.unused' field of header
+    c.skip(ROL_UNSUED0_SIZE); // Seek past 'SRolHeader.unused' field of header
 
-    mpROLHeader->ticks_per_beat    = static_cast<uint16_t>(f->readInt(2));
-    mpROLHeader->beats_per_measure = static_cast<uint16_t>(f->readInt(2));
-    mpROLHeader->edit_scale_y      = static_cast<uint16_t>(f->readInt(2));
-    mpROLHeader->edit_scale_x      = static_cast<uint16_t>(f->readInt(2));
+    mpROLHeader->ticks_per_beat    = static_cast<uint16_t>(c.u16le());
+    mpROLHeader->beats_per_measure = static_cast<uint16_t>(c.u16le());
+    mpROLHeader->edit_scale_y      = static_cast<uint16_t>(c.u16le());
+    mpROLHeader->edit_scale_x      = static_cast<uint16_t>(c.u16le());
 
-    f->seek(ROL_UNUSED1_SIZE, binio::Add); // Seek past 'SRolHeader.(unused1)' field of the header.
+    c.skip(ROL_UNUSED1_SIZE); // Seek past 'SRolHeader.(unused1)' field of the header.
 
-    mpROLHeader->mode = static_cast<uint8_t>(f->readInt(1));
+    mpROLHeader->mode = static_cast<uint8_t>(c.u8());
 
-    f->seek(ROL_UNUSED2_SIZE + ROL_FILLER0_SIZE + ROL_FILLER1_SIZE, binio::Add); // Seek past 'SRolHeader.(unused2, filler0, filler1)' field of header
+    c.skip(ROL_UNUSED2_SIZE + ROL_FILLER0_SIZE + ROL_FILLER1_SIZE); // Seek past 'SRolHeader.(unused2, filler0, filler1)' field of header
 
-    mpROLHeader->basic_tempo = static_cast<float>(f->readFloat(binio::Single));
+    mpROLHeader->basic_tempo = static_cast<float>(c.f32le());
 
-    load_tempo_events(f);
+    load_tempo_events(c);
 
     mTimeOfLastNote = 0;
 
-    if (load_voice_data(f, bnk_filename, fp) != true)
+    if (load_voice_data(c, bnk_filename, fp) != true)
     {
       AdPlug_LogWrite("CrolPlayer::load_voice_data(f) failed!\n");
       AdPlug_LogWrite("--- CrolPlayer::load ---\n");
@@ -329,6 +352,50 @@ void CrolPlayer::rewind(int subsong)
     SetRefresh(1.0f);
 }
 //---------------------------------------------------------
+bool CrolPlayer::snapshot(CSnapshot & s)
+{
+    TVoiceData::iterator curr = mVoiceData.begin();
+    TVoiceData::iterator end  = mVoiceData.end();
+
+    while(curr != end)
+    {
+        CVoiceData & voice = *curr;
+
+        s.io(voice.mEventStatus);
+        s.io(voice.mNoteDuration);
+        s.io(voice.current_note_duration);
+        s.io(voice.current_note);
+        s.io(voice.next_instrument_event);
+        s.io(voice.next_volume_event);
+        s.io(voice.next_pitch_event);
+        s.io(voice.mForceNote);
+        ++curr;
+    }
+
+    // The frequency table pointers all point into skFNumNotes
+    for (TUint16PtrVector::size_type i = 0; i < mFNumFreqPtrList.size(); ++i)
+    {
+        s.ptr(mFNumFreqPtrList[i], skFNumNotes);
+    }
+    s.ptr(mpOldFNumFreqPtr, skFNumNotes);
+
+    s.io(mHalfToneOffset);
+    s.io(mVolumeCache);
+    s.io(mKSLTLCache);
+    s.io(mNoteCache);
+    s.io(mKOnOctFNumCache);
+    s.io(mKeyOnCache);
+    s.io(mRefresh);
+    s.io(mOldPitchBendLength);
+    s.io(mPitchRangeStep);
+    s.io(mNextTempoEvent);
+    s.io(mCurrTick);
+    s.io(mOldHalfToneOffset);
+    s.io(mAMVibRhythmCache);
+
+    return true;
+}
+//---------------------------------------------------------
 void CrolPlayer::SetRefresh( float const multiplier )
 {
     float const tickBeat = static_cast<float>(fmin(kMaxTickBeat, mpROLHeader->ticks_per_beat));
@@ -573,7 +640,7 @@ void CrolPlayer::SetVolume(int const voice, uint8_t const volume)
 //---------------------------------------------------------
 void CrolPlayer::send_ins_data_to_chip(int const voice, int const ins_index)
 {
-    SRolInstrument const & instrument = mInstrumentList[ins_index].instrument;
+    SRolInstrument const & instrument = mInstrumentList[ins_index];
 
     send_operator(voice, instrument.modulator, instrument.carrier);
 }
@@ -613,9 +680,9 @@ void CrolPlayer::send_operator(int const voice, SOPL2Op const & modulator,  SOPL
     }
 }
 //---------------------------------------------------------
-void CrolPlayer::load_tempo_events(binistream *f)
+void CrolPlayer::load_tempo_events(CFileCursor &f)
 {
-    int16_t const num_tempo_events = static_cast<uint16_t>(f->readInt(2));
+    int16_t const num_tempo_events = static_cast<uint16_t>(f.u16le());
 
     mTempoEvents.reserve(num_tempo_events);
 
@@ -623,20 +690,21 @@ void CrolPlayer::load_tempo_events(binistream *f)
     {
         STempoEvent event;
 
-        event.time       = static_cast<int16_t>(f->readInt(2));
-        event.multiplier = static_cast<float>(f->readFloat(binio::Single));
+        event.time       = static_cast<int16_t>(f.u16le());
+        event.multiplier = static_cast<float>(f.f32le());
         mTempoEvents.push_back(event);
     }
 }
 //---------------------------------------------------------
-bool CrolPlayer::load_voice_data(binistream *f, std::string const &bnk_filename, const CFileProvider &fp)
+bool CrolPlayer::load_voice_data(CFileCursor &f, std::string const &bnk_filename, const CFileProvider &fp)
 {
-    SBnkHeader bnk_header;
-    binistream *bnk_file = fp.open(bnk_filename.c_str());
+    CRolBank const *bank = static_cast<CRolBank const *>(fp.resource(bnk_filename, CRolBank::load));
 
-    if (bnk_file)
+    if (bank)
     {
-        load_bnk_info(bnk_file, bnk_header);
+        // our instrument for each of the bank's, the last one standing for
+        // those it doesn't have
+        TInt16Vector ins_of_bank(bank->size() + 1, -1);
 
         int const numVoices = mpROLHeader->mode ? kNumMelodicVoices : kNumPercussiveVoices;
 
@@ -646,14 +714,14 @@ bool CrolPlayer::load_voice_data(binistream *f, std::string const &bnk_filename,
             CVoiceData voice;
 
             load_note_events(f, voice);
-            load_instrument_events(f, voice, bnk_file, bnk_header);
+            load_instrument_events(f, voice, *bank, ins_of_bank);
             load_volume_events(f, voice);
             load_pitch_events(f, voice);
 
             mVoiceData.push_back(voice);
         }
 
-        fp.close(bnk_file);
+        fp.release(bank);
 
         return true;
     }
@@ -661,11 +729,11 @@ bool CrolPlayer::load_voice_data(binistream *f, std::string const &bnk_filename,
     return false;
 }
 //---------------------------------------------------------
-void CrolPlayer::load_note_events(binistream *f, CVoiceData & voice)
+void CrolPlayer::load_note_events(CFileCursor &f, CVoiceData & voice)
 {
-    f->seek(ROL_FILLER_SIZE, binio::Add);
+    f.skip(ROL_FILLER_SIZE);
 
-    int16_t const time_of_last_note = static_cast<int16_t>(f->readInt(2));
+    int16_t const time_of_last_note = static_cast<int16_t>(f.u16le());
 
     if (time_of_last_note != 0)
     {
@@ -676,15 +744,15 @@ void CrolPlayer::load_note_events(binistream *f, CVoiceData & voice)
         {
             SNoteEvent event;
 
-            event.number   = static_cast<int16_t>(f->readInt(2));
-            event.duration = static_cast<int16_t>(f->readInt(2));
+            event.number   = static_cast<int16_t>(f.u16le());
+            event.duration = static_cast<int16_t>(f.u16le());
 
             event.number += kSilenceNote; // adding -12
 
             note_events.push_back(event);
 
             total_duration += event.duration;
-        } while (total_duration < time_of_last_note);
+        } while (total_duration < time_of_last_note && !f.error());
 
         if (time_of_last_note > mTimeOfLastNote)
         {
@@ -692,13 +760,13 @@ void CrolPlayer::load_note_events(binistream *f, CVoiceData & voice)
         }
     }
 
-    f->seek(ROL_FILLER_SIZE, binio::Add);
+    f.skip(ROL_FILLER_SIZE);
 }
 //---------------------------------------------------------
-void CrolPlayer::load_instrument_events(binistream *f, CVoiceData & voice,
-                                        binistream *bnk_file, SBnkHeader const & bnk_header)
+void CrolPlayer::load_instrument_events(CFileCursor &f, CVoiceData & voice,
+                                        CRolBank const & bank, TInt16Vector & ins_of_bank)
 {
-    int16_t const number_of_instrument_events = static_cast<int16_t>(f->readInt(2));
+    int16_t const number_of_instrument_events = static_cast<int16_t>(f.u16le());
 
     TInstrumentEvents & instrument_events = voice.instrument_events;
 
@@ -707,25 +775,25 @@ void CrolPlayer::load_instrument_events(binistream *f, CVoiceData & voice,
     for (int16_t i = 0; i < number_of_instrument_events; ++i)
     {
         SInstrumentEvent event;
-        event.time = static_cast<int16_t>(f->readInt(2));
-        f->readString(event.name, ROL_MAX_NAME_SIZE);
+        event.time = static_cast<int16_t>(f.u16le());
+        f.bytes(event.name, ROL_MAX_NAME_SIZE);
 
         std::string event_name = event.name;
         if (std::find(usedInstruments.begin(), usedInstruments.end(), event_name) == usedInstruments.end())
             usedInstruments.push_back(event_name);
-        event.ins_index = load_rol_instrument(bnk_file, bnk_header, event_name);
+        event.ins_index = load_rol_instrument(bank, ins_of_bank, event_name);
 
         instrument_events.push_back(event);
 
-        f->seek(ROL_INSTRUMENT_EVENT_FILLER_SIZE, binio::Add);
+        f.skip(ROL_INSTRUMENT_EVENT_FILLER_SIZE);
     }
 
-    f->seek(ROL_FILLER_SIZE, binio::Add);
+    f.skip(ROL_FILLER_SIZE);
 }
 //---------------------------------------------------------
-void CrolPlayer::load_volume_events(binistream *f, CVoiceData & voice)
+void CrolPlayer::load_volume_events(CFileCursor &f, CVoiceData & voice)
 {
-    int16_t const number_of_volume_events = static_cast<int16_t>(f->readInt(2));
+    int16_t const number_of_volume_events = static_cast<int16_t>(f.u16le());
 
     TVolumeEvents & volume_events = voice.volume_events;
 
@@ -734,18 +802,18 @@ void CrolPlayer::load_volume_events(binistream *f, CVoiceData & voice)
     for (int i=0; i<number_of_volume_events; ++i)
     {
         SVolumeEvent event;
-        event.time       = static_cast<int16_t>(f->readInt(2));
-        event.multiplier = static_cast<float>(f->readFloat(binio::Single));
+        event.time       = static_cast<int16_t>(f.u16le());
+        event.multiplier = static_cast<float>(f.f32le());
 
         volume_events.push_back(event);
     }
 
-    f->seek(ROL_FILLER_SIZE, binio::Add);
+    f.skip(ROL_FILLER_SIZE);
 }
 //---------------------------------------------------------
-void CrolPlayer::load_pitch_events(binistream *f, CVoiceData & voice)
+void CrolPlayer::load_pitch_events(CFileCursor &f, CVoiceData & voice)
 {
-    int16_t const number_of_pitch_events = static_cast<int16_t>(f->readInt(2));
+    int16_t const number_of_pitch_events = static_cast<int16_t>(f.u16le());
 
     TPitchEvents & pitch_events = voice.pitch_events;
 
@@ -754,126 +822,230 @@ void CrolPlayer::load_pitch_events(binistream *f, CVoiceData & voice)
     for (int i=0; i<number_of_pitch_events; ++i)
     {
         SPitchEvent event;
-        event.time      = static_cast<int16_t>(f->readInt(2));
-        event.variation = static_cast<float>(f->readFloat(binio::Single));
+        event.time      = static_cast<int16_t>(f.u16le());
+        event.variation = static_cast<float>(f.f32le());
 
         pitch_events.push_back(event);
     }
 }
 //---------------------------------------------------------
-bool CrolPlayer::load_bnk_info(binistream *f, SBnkHeader & header)
+CFileResource *CrolPlayer::CRolBank::load(binistream *f, CFileProvider const & fp)
 {
-    header.version_major = static_cast<uint8_t>(f->readInt(1));
-    header.version_minor = static_cast<uint8_t>(f->readInt(1));
-    f->readString(header.signature, ROL_BNK_SIGNATURE_SIZE);
-
-    header.number_of_list_entries_used  = static_cast<uint16_t>(f->readInt(2));
-    header.total_number_of_list_entries = static_cast<uint16_t>(f->readInt(2));
+    CFileCursor c(fp, f);
+    SBnkHeader  header;
+    CRolBank    *bank = new CRolBank;
 
-    header.abs_offset_of_name_list = static_cast<int32>(f->readInt(4));
-    header.abs_offset_of_data      = static_cast<int32>(f->readInt(4));
+    load_bnk_info(c, header);
 
-    f->seek(header.abs_offset_of_name_list, binio::Set);
+    int const num_instruments = header.number_of_list_entries_used;
 
-    TInstrumentNames & ins_name_list = header.ins_name_list;
-    ins_name_list.reserve(header.number_of_list_entries_used);
+    // Both lists are copied as they are, as without a cache every song
+    // loads the bank. The names are folded when hashed and compared.
+    // Entries cut off at the end of the file read as 0xff bytes, as from
+    // the cursor.
+    copy(c, header.abs_offset_of_name_list, num_instruments * kSizeofNameEntry, bank->mNames);
 
-    for (uint16_t i=0; i<header.number_of_list_entries_used; ++i)
+    int records = 0;
+    for (int i=0; i<num_instruments; ++i)
     {
-        SInstrumentName instrument;
+        records = std::max(records, bank->record(i) + 1);
+    }
 
-        instrument.index = static_cast<uint16_t>(f->readInt(2));
-        instrument.record_used = static_cast<uint8_t>(f->readInt(1));
-        f->readString(instrument.name, ROL_MAX_NAME_SIZE);
+    copy(c, header.abs_offset_of_data, records * kSizeofDataRecord, bank->mData);
+
+    // chained from the end, so that names found twice give the first one,
+    // as the binary search over the name list did
+    size_t buckets = 16;
+    while (buckets < 2 * static_cast<size_t>(num_instruments)) buckets <<= 1;
+
+    bank->mBuckets.assign(buckets, -1);
+    bank->mChain.assign(num_instruments, -1);
+    for (int i=num_instruments-1; i>=0; --i)
+    {
+        int & first = bank->mBuckets[hash(bank->name_at(i)) & (buckets - 1)];
 
-        ins_name_list.push_back( instrument );
+        bank->mChain[i] = first;
+        first = i;
     }
 
-    return true;
+    return bank;
 }
 //---------------------------------------------------------
-int CrolPlayer::load_rol_instrument(binistream *f, SBnkHeader const & header, std::string const & name)
+int CrolPlayer::CRolBank::find(std::string const & name) const
 {
-    TInstrumentNames const & ins_name_list = header.ins_name_list;
+    char folded[ROL_MAX_NAME_SIZE];
 
-    int const ins_index = get_ins_index(name);
+    if (!fold(name.c_str(), name.size(), folded))
+    {
+        return -1;
+    }
 
-    if (ins_index != -1)
+    for (int i = mBuckets[hash(folded) & (mBuckets.size() - 1)]; i != -1; i = mChain[i])
     {
-        return ins_index;
+        if (same(name_at(i), folded))
+        {
+            return i;
+        }
     }
 
-    SInstrument usedInstrument;
-    usedInstrument.name = name;
+    return -1;
+}
+//---------------------------------------------------------
+void CrolPlayer::CRolBank::instrument(int index, SRolInstrument & ins) const
+{
+    read_rol_instrument(reinterpret_cast<unsigned char const *>(&mData[record(index) * kSizeofDataRecord]), ins);
+}
+//---------------------------------------------------------
+int CrolPlayer::CRolBank::record(int index) const
+{
+    unsigned char const * const entry = reinterpret_cast<unsigned char const *>(&mNames[index * kSizeofNameEntry]);
 
-    typedef TInstrumentNames::const_iterator TInsIter;
-    typedef std::pair<TInsIter, TInsIter>    TInsIterPair;
+    return entry[0] | (entry[1] << 8);
+}
+//---------------------------------------------------------
+void CrolPlayer::CRolBank::copy(CFileCursor & f, unsigned long pos, unsigned long size, TCharVector & to)
+{
+    // Copies 'size' bytes from 'pos' on, 0xff padded, into 'to'
+    f.seek(pos);
 
-    TInsIterPair const range = std::equal_range(ins_name_list.begin(), 
-                                                ins_name_list.end(), 
-                                                name, 
-                                                StringCompare());
+    char const * const from = reinterpret_cast<char const *>(f.here());
 
-    if (range.first != range.second)
+    to.assign(from, from + std::min(f.left(), size));
+    to.resize(size, '\xff');
+}
+//---------------------------------------------------------
+unsigned long CrolPlayer::CRolBank::memsize() const
+{
+    return sizeof(*this) + mData.size() + mNames.size() +
+        (mBuckets.size() + mChain.size()) * sizeof(int);
+}
+//---------------------------------------------------------
+unsigned long CrolPlayer::CRolBank::hash(char const * name)
+{
+    // FNV-1a of the case folded name, up to its first 0
+    unsigned long h = 2166136261UL;
+
+    for (size_t i=0; i<ROL_MAX_NAME_SIZE && name[i] != '\0'; ++i)
+    {
+        h = ((h ^ static_cast<unsigned char>(lower(name[i]))) * 16777619UL) & 0xffffffffUL;
+    }
+
+    return h;
+}
+//---------------------------------------------------------
+bool CrolPlayer::CRolBank::same(char const * name, char const * folded)
+{
+    // Whether bank name 'name' is 'folded' from fold(), in any case
+    for (size_t i=0; i<ROL_MAX_NAME_SIZE; ++i)
     {
-        int const seekOffs = header.abs_offset_of_data + (range.first->index * kSizeofDataRecord);
-        f->seek(seekOffs, binio::Set);
+        if (lower(name[i]) != folded[i])
+        {
+            return false;
+        }
 
-        read_rol_instrument(f, usedInstrument.instrument);
+        if (name[i] == '\0')
+        {
+            break;
+        }
     }
-    else
+
+    return true;
+}
+//---------------------------------------------------------
+bool CrolPlayer::CRolBank::fold(char const * name, size_t size, char * folded)
+{
+    // Puts 'name', up to its first 0, in ASCII lower case and 0 padded into
+    // 'folded'. Returns false if it doesn't fit.
+    size_t i = 0;
+
+    for (; i<size && name[i] != '\0'; ++i)
     {
-        // set up default instrument data here
-        memset(&usedInstrument.instrument, 0, sizeof(SRolInstrument));
+        if (i == ROL_MAX_NAME_SIZE)
+        {
+            return false;
+        }
+
+        folded[i] = lower(name[i]);
     }
 
-    mInstrumentList.push_back( usedInstrument );
+    memset(folded + i, 0, ROL_MAX_NAME_SIZE - i);
+
+    return true;
+}
+//---------------------------------------------------------
+void CrolPlayer::load_bnk_info(CFileCursor &f, SBnkHeader & header)
+{
+    header.version_major = static_cast<uint8_t>(f.u8());
+    header.version_minor = static_cast<uint8_t>(f.u8());
+    f.bytes(header.signature, ROL_BNK_SIGNATURE_SIZE);
+
+    header.number_of_list_entries_used  = static_cast<uint16_t>(f.u16le());
+    header.total_number_of_list_entries = static_cast<uint16_t>(f.u16le());
 
-    return mInstrumentList.size()-1;
+    header.abs_offset_of_name_list = static_cast<int32>(f.u32le());
+    header.abs_offset_of_data      = static_cast<int32>(f.u32le());
 }
 //---------------------------------------------------------
-int CrolPlayer::get_ins_index(std::string const & name) const
+int CrolPlayer::load_rol_instrument(CRolBank const & bank, TInt16Vector & ins_of_bank,
+                                    std::string const & name)
 {
-    for (size_t index = 0; index<mInstrumentList.size(); ++index)
+    int bank_index = bank.find(name);
+
+    if (bank_index == -1)
     {
-        if (stricmp(mInstrumentList[index].name.c_str(), name.c_str()) == 0)
+        bank_index = bank.size();
+    }
+
+    if (ins_of_bank[bank_index] == -1)
+    {
+        SRolInstrument instrument;
+
+        if (bank_index < bank.size())
         {
-            return index;
+            bank.instrument(bank_index, instrument);
         }
+        else
+        {
+            // set up default instrument data here
+            memset(&instrument, 0, sizeof(SRolInstrument));
+        }
+
+        mInstrumentList.push_back( instrument );
+        ins_of_bank[bank_index] = mInstrumentList.size()-1;
     }
 
-    return -1;
+    return ins_of_bank[bank_index];
 }
 //---------------------------------------------------------
-void CrolPlayer::read_rol_instrument(binistream * f, SRolInstrument & instrument)
+void CrolPlayer::read_rol_instrument(unsigned char const * record, SRolInstrument & instrument)
 {
-    instrument.mode = static_cast<uint8_t>(f->readInt(1));
-    instrument.voice_number = static_cast<uint8_t>(f->readInt(1));
+    instrument.mode = record[0];
+    instrument.voice_number = record[1];
 
-    read_fm_operator(f, instrument.modulator);
-    read_fm_operator(f, instrument.carrier);
+    read_fm_operator(record + 2, instrument.modulator);
+    read_fm_operator(record + 15, instrument.carrier);
 
-    instrument.modulator.waveform = static_cast<uint8_t>(f->readInt(1));
-    instrument.carrier.waveform = static_cast<uint8_t>(f->readInt(1));
+    instrument.modulator.waveform = record[28];
+    instrument.carrier.waveform = record[29];
 }
 //---------------------------------------------------------
-void CrolPlayer::read_fm_operator(binistream *f, SOPL2Op &opl2_op)
+void CrolPlayer::read_fm_operator(unsigned char const * op, SOPL2Op &opl2_op)
 {
     SFMOperator fm_op;
 
-    fm_op.key_scale_level = static_cast<uint8_t>(f->readInt(1));
-    fm_op.freq_multiplier = static_cast<uint8_t>(f->readInt(1));
-    fm_op.feed_back = static_cast<uint8_t>(f->readInt(1));
-    fm_op.attack_rate = static_cast<uint8_t>(f->readInt(1));
-    fm_op.sustain_level = static_cast<uint8_t>(f->readInt(1));
-    fm_op.sustaining_sound = static_cast<uint8_t>(f->readInt(1));
-    fm_op.decay_rate = static_cast<uint8_t>(f->readInt(1));
-    fm_op.release_rate = static_cast<uint8_t>(f->readInt(1));
-    fm_op.output_level = static_cast<uint8_t>(f->readInt(1));
-    fm_op.amplitude_vibrato = static_cast<uint8_t>(f->readInt(1));
-    fm_op.frequency_vibrato = static_cast<uint8_t>(f->readInt(1));
-    fm_op.envelope_scaling = static_cast<uint8_t>(f->readInt(1));
-    fm_op.fm_type = static_cast<uint8_t>(f->readInt(1));
+    fm_op.key_scale_level = op[0];
+    fm_op.freq_multiplier = op[1];
+    fm_op.feed_back = op[2];
+    fm_op.attack_rate = op[3];
+    fm_op.sustain_level = op[4];
+    fm_op.sustaining_sound = op[5];
+    fm_op.decay_rate = op[6];
+    fm_op.release_rate = op[7];
+    fm_op.output_level = op[8];
+    fm_op.amplitude_vibrato = op[9];
+    fm_op.frequency_vibrato = op[10];
+    fm_op.envelope_scaling = op[11];
+    fm_op.fm_type = op[12];
 
     opl2_op.ammulti = fm_op.amplitude_vibrato << 7 | fm_op.frequency_vibrato << 6 | fm_op.sustaining_sound << 5 | fm_op.envelope_scaling << 4 | fm_op.freq_multiplier;
     opl2_op.ksltl   = fm_op.key_scale_level   << 6 | fm_op.output_level;
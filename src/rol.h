@@ -28,6 +28,8 @@
 
 #include "player.h"
 
+class CFileCursor;
+
 // These are here since Visual C 6 doesn't support statics declared and defined in class.
 #define ROL_UNSUED0_SIZE 40U
 #define ROL_UNUSED1_SIZE 1U
@@ -43,12 +45,15 @@ class CrolPlayer: public CPlayer
 {
 public:
     static CPlayer *factory(Copl * pNewOpl);
+    static ProbeScore probe(const std::string &filename,
+			    const unsigned char *head,
+			    unsigned long len, unsigned long filesize);
 
     explicit CrolPlayer(Copl * const pNewOpl);
 
     virtual ~CrolPlayer();
 
-    virtual bool  load      (const std::string &filename, const CFileProvider &fp);
+    virtual bool  loadfile      (const std::string &filename, const CFileProvider &fp);
     virtual bool  update    ();
     virtual void  rewind    (int subsong);	// rewinds to specified subsong
     virtual float getrefresh();			// returns needed timer refresh rate
@@ -63,6 +68,9 @@ public:
         return usedInstruments[n];
     };
 
+protected:
+    virtual bool snapshot(CSnapshot & s);
+
 private:
 
 #if !defined(UINT8_MAX)
@@ -186,15 +194,6 @@ private:
         bool              mForceNote;
     };
 
-    typedef struct
-    {
-        uint16_t index;
-        uint8_t  record_used;
-        char     name[ROL_MAX_NAME_SIZE];
-    } SInstrumentName;
-
-    typedef std::vector<SInstrumentName> TInstrumentNames;
-
     typedef struct
     {
         uint8_t  version_major;
@@ -204,8 +203,6 @@ private:
         uint16_t total_number_of_list_entries;
         int32    abs_offset_of_name_list;
         int32    abs_offset_of_data;
-
-        TInstrumentNames ins_name_list;
     } SBnkHeader;
 
     typedef struct
@@ -243,25 +240,69 @@ private:
         SOPL2Op carrier;
     } SRolInstrument;
 
-    typedef struct
+    typedef uint16_t const *             TUint16ConstPtr;
+    typedef std::vector<STempoEvent>     TTempoEvents;
+    typedef std::vector<CVoiceData>      TVoiceData;
+    typedef std::vector<SRolInstrument>  TInstrumentList;
+    typedef std::vector<TUint16ConstPtr> TUint16PtrVector;
+    typedef std::vector<int16_t>         TInt16Vector;
+    typedef std::vector<uint8_t>         TUInt8Vector;
+    typedef std::vector<bool>            TBoolVector;
+    typedef std::vector<std::string>     TStringVector;
+
+    // The instruments of a .bnk file, indexed by their case folded names.
+    // Made once, through CFileProvider::resource(), and not changed after
+    // that, so that the songs using it share it. Keeps the raw records, so
+    // that a song only decodes the instruments it uses.
+    class CRolBank: public CFileResource
     {
-        std::string    name;
-        SRolInstrument instrument;
-    } SInstrument;
-
-    void load_tempo_events     (binistream *f);
-    bool load_voice_data       (binistream *f, std::string const & bnk_filename, CFileProvider const & fp);
-    void load_note_events      (binistream *f, CVoiceData & voice);
-    void load_instrument_events(binistream *f, CVoiceData & voice,
-                                binistream *bnk_file, SBnkHeader const & bnk_header);
-    void load_volume_events    (binistream *f, CVoiceData & voice);
-    void load_pitch_events     (binistream *f, CVoiceData & voice);
-
-    bool load_bnk_info         (binistream *f, SBnkHeader & header);
-    int  load_rol_instrument   (binistream *f, SBnkHeader const & header, std::string const & name);
-    void read_rol_instrument   (binistream *f, SRolInstrument & ins);
-    void read_fm_operator      (binistream *f, SOPL2Op & opl2_op);
-    int  get_ins_index         (std::string const & name) const;
+    public:
+        static CFileResource *load(binistream *f, CFileProvider const & fp);
+
+        // The instrument called 'name', in any case, or -1 if there is none
+        int find(std::string const & name) const;
+
+        int size() const { return mChain.size(); }
+
+        // Decodes the instrument at 'index' into 'ins'
+        void instrument(int index, SRolInstrument & ins) const;
+
+        unsigned long memsize() const;
+
+    private:
+        typedef std::vector<int>  TIndexVector;
+        typedef std::vector<char> TCharVector;
+
+        TCharVector     mData;          // the records, kSizeofDataRecord each
+        TCharVector     mNames;         // the name list, kSizeofNameEntry each
+        TIndexVector    mBuckets;       // first instrument of each hash, or -1
+        TIndexVector    mChain;         // next instrument of the same hash, or -1
+
+        static int const kSizeofNameEntry; // record, used flag, name
+
+        char const * name_at(int index) const { return &mNames[index * kSizeofNameEntry + 3]; }
+        int record(int index) const;
+
+        static char lower(char c) { return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c; }
+        static unsigned long hash(char const * name);
+        static bool fold(char const * name, size_t size, char * folded);
+        static bool same(char const * name, char const * folded);
+        static void copy(CFileCursor & f, unsigned long pos, unsigned long size, TCharVector & to);
+    };
+
+    void load_tempo_events     (CFileCursor &f);
+    bool load_voice_data       (CFileCursor &f, std::string const & bnk_filename, CFileProvider const & fp);
+    void load_note_events      (CFileCursor &f, CVoiceData & voice);
+    void load_instrument_events(CFileCursor &f, CVoiceData & voice,
+                                CRolBank const & bank, TInt16Vector & ins_of_bank);
+    void load_volume_events    (CFileCursor &f, CVoiceData & voice);
+    void load_pitch_events     (CFileCursor &f, CVoiceData & voice);
+
+    static void load_bnk_info  (CFileCursor &f, SBnkHeader & header);
+    int  load_rol_instrument   (CRolBank const & bank, TInt16Vector & ins_of_bank,
+                                std::string const & name);
+    static void read_rol_instrument(unsigned char const * record, SRolInstrument & ins);
+    static void read_fm_operator   (unsigned char const * op, SOPL2Op & opl2_op);
 
     void UpdateVoice(int const voice, CVoiceData & voiceData);
     void SetNote(int const voice, int const note);
@@ -276,40 +317,6 @@ private:
     void send_ins_data_to_chip(int const voice, int const ins_index);
     void send_operator(int const voice, SOPL2Op const & modulator, SOPL2Op const & carrier);
 
-    class StringCompare
-    {
-    public:
-        bool operator()(SInstrumentName const & lhs, SInstrumentName const & rhs) const
-        {
-            return keyLess(lhs.name, rhs.name);
-        }
-
-        bool operator()(SInstrumentName const & lhs, std::string const &rhs) const
-        {
-            return keyLess(lhs.name, rhs.c_str());
-        }
-
-        bool operator()(std::string const & lhs, SInstrumentName const & rhs) const
-        {
-            return keyLess(lhs.c_str(), rhs.name);
-        }
-    private:
-        bool keyLess(char const * const lhs, char const * const rhs) const
-        {
-            return stricmp(lhs, rhs) < 0;
-        }
-    };
-
-    typedef uint16_t const *             TUint16ConstPtr;
-    typedef std::vector<STempoEvent>     TTempoEvents;
-    typedef std::vector<CVoiceData>      TVoiceData;
-    typedef std::vector<SInstrument>     TInstrumentList;
-    typedef std::vector<TUint16ConstPtr> TUint16PtrVector;
-    typedef std::vector<int16_t>         TInt16Vector;
-    typedef std::vector<uint8_t>         TUInt8Vector;
-    typedef std::vector<bool>            TBoolVector;
-    typedef std::vector<std::string>     TStringVector;
-
     SRolHeader      * mpROLHeader;
     TUint16ConstPtr   mpOldFNumFreqPtr;
     TTempoEvents      mTempoEvents;
@@ -24,6 +24,8 @@
 
 #include <cstring>
 #include "s3m.h"
+#include "snapshot.h"
+#include "fcursor.h"
 
 const signed char Cs3mPlayer::chnresolv[] =	// S3M -> adlib channel conversion
   {-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,0,1,2,3,4,5,6,7,8,-1,-1,-1,-1,-1,-1,-1};
@@ -56,9 +58,22 @@ Cs3mPlayer::Cs3mPlayer(Copl *newopl): CPlayer(newopl)
       }
 }
 
-bool Cs3mPlayer::load(const std::string &filename, const CFileProvider &fp)
+CPlayer::ProbeScore Cs3mPlayer::probe(const std::string &filename,
+				      const unsigned char *head,
+				      unsigned long len,
+				      unsigned long filesize)
+{
+  if(len < 48 || head[28] != 0x1a || head[29] != 16 ||
+     (head[34] | head[35] << 8) > 99 || memcmp(head + 44, "SCRM", 4))
+    return PROBE_NO;
+
+  return PROBE_YES;
+}
+
+bool Cs3mPlayer::loadfile(const std::string &filename, const CFileProvider &fp)
 {
   binistream		*f = fp.open(filename); if(!f) return false;
+  CFileCursor		c(fp, f);
   unsigned short	insptr[99],pattptr[99];
   int			i,row;
   unsigned char		bufval,bufval2;
@@ -68,7 +83,7 @@ bool Cs3mPlayer::load(const std::string &filename, const CFileProvider &fp)
 
   // file validation section
   checkhead = new s3mheader;
-  load_header(f, checkhead);
+  load_header(c, checkhead);
   if(checkhead->kennung != 0x1a || checkhead->typ != 16
      || checkhead->insnum > 99) {
     delete checkhead; fp.close(f); return false;
@@ -76,12 +91,12 @@ bool Cs3mPlayer::load(const std::string &filename, const CFileProvider &fp)
     if(strncmp(checkhead->scrm,"SCRM",4)) {
       delete checkhead; fp.close(f); return false;
     } else {	// is an adlib module?
-      f->seek(checkhead->ordnum, binio::Add);
+      c.skip(checkhead->ordnum);
       for(i = 0; i < checkhead->insnum; i++)
-	insptr[i] = f->readInt(2);
+	insptr[i] = c.u16le();
       for(i=0;i<checkhead->insnum;i++) {
-	f->seek(insptr[i]*16);
-	if(f->readInt(1) >= 2) {
+	c.seek(insptr[i]*16);
+	if(c.u8() >= 2) {
 	  adlibins = true;
 	  break;
 	}
@@ -91,8 +106,8 @@ bool Cs3mPlayer::load(const std::string &filename, const CFileProvider &fp)
     }
 
   // load section
-  f->seek(0);			// rewind for load
-  load_header(f, &header);	// read header
+  c.seek(0);			// rewind for load
+  load_header(c, &header);	// read header
 
   // security check
   if(header.ordnum > 256 || header.insnum > 99 || header.patnum > 99) {
@@ -100,48 +115,48 @@ bool Cs3mPlayer::load(const std::string &filename, const CFileProvider &fp)
     return false;
   }
 
-  for(i = 0; i < header.ordnum; i++) orders[i] = f->readInt(1);	// read orders
-  for(i = 0; i < header.insnum; i++) insptr[i] = f->readInt(2);	// instrument parapointers
-  for(i = 0; i < header.patnum; i++) pattptr[i] = f->readInt(2); // pattern parapointers
+  for(i = 0; i < header.ordnum; i++) orders[i] = c.u8();	// read orders
+  for(i = 0; i < header.insnum; i++) insptr[i] = c.u16le();	// instrument parapointers
+  for(i = 0; i < header.patnum; i++) pattptr[i] = c.u16le(); // pattern parapointers
 
   for(i=0;i<header.insnum;i++) {	// load instruments
-    f->seek(insptr[i]*16);
-    inst[i].type = f->readInt(1);
-    f->readString(inst[i].filename, 15);
-    inst[i].d00 = f->readInt(1); inst[i].d01 = f->readInt(1);
-    inst[i].d02 = f->readInt(1); inst[i].d03 = f->readInt(1);
-    inst[i].d04 = f->readInt(1); inst[i].d05 = f->readInt(1);
-    inst[i].d06 = f->readInt(1); inst[i].d07 = f->readInt(1);
-    inst[i].d08 = f->readInt(1); inst[i].d09 = f->readInt(1);
-    inst[i].d0a = f->readInt(1); inst[i].d0b = f->readInt(1);
-    inst[i].volume = f->readInt(1); inst[i].dsk = f->readInt(1);
-    f->ignore(2);
-    inst[i].c2spd = f->readInt(4);
-    f->ignore(12);
-    f->readString(inst[i].name, 28);
-    f->readString(inst[i].scri, 4);
+    c.seek(insptr[i]*16);
+    inst[i].type = c.u8();
+    c.bytes(inst[i].filename, 15);
+    inst[i].d00 = c.u8(); inst[i].d01 = c.u8();
+    inst[i].d02 = c.u8(); inst[i].d03 = c.u8();
+    inst[i].d04 = c.u8(); inst[i].d05 = c.u8();
+    inst[i].d06 = c.u8(); inst[i].d07 = c.u8();
+    inst[i].d08 = c.u8(); inst[i].d09 = c.u8();
+    inst[i].d0a = c.u8(); inst[i].d0b = c.u8();
+    inst[i].volume = c.u8(); inst[i].dsk = c.u8();
+    c.skip(2);
+    inst[i].c2spd = c.u32le();
+    c.skip(12);
+    c.bytes(inst[i].name, 28);
+    c.bytes(inst[i].scri, 4);
   }
 
   for(i=0;i<header.patnum;i++) {	// depack patterns
-    f->seek(pattptr[i]*16);
-    ppatlen = f->readInt(2);
-    unsigned long pattpos = f->pos();
+    c.seek(pattptr[i]*16);
+    ppatlen = c.u16le();
+    unsigned long pattpos = c.pos();
     for(row=0;(row<64) && (pattpos-pattptr[i]*16<=ppatlen);row++)
       do {
-	bufval = f->readInt(1);
+	bufval = c.u8();
 	if(bufval & 32) {
-	  bufval2 = f->readInt(1);
+	  bufval2 = c.u8();
 	  pattern[i][row][bufval & 31].note = bufval2 & 15;
 	  pattern[i][row][bufval & 31].oct = (bufval2 & 240) >> 4;
-	  pattern[i][row][bufval & 31].instrument = f->readInt(1);
+	  pattern[i][row][bufval & 31].instrument = c.u8();
 	}
 	if(bufval & 64)
-	  pattern[i][row][bufval & 31].volume = f->readInt(1);
+	  pattern[i][row][bufval & 31].volume = c.u8();
 	if(bufval & 128) {
-	  pattern[i][row][bufval & 31].command = f->readInt(1);
-	  pattern[i][row][bufval & 31].info = f->readInt(1);
+	  pattern[i][row][bufval & 31].command = c.u8();
+	  pattern[i][row][bufval & 31].info = c.u8();
 	}
-      } while(bufval);
+      } while(bufval && !c.error());	// cut off files read 0xff for ever
   }
 
   fp.close(f);
@@ -404,6 +419,14 @@ void Cs3mPlayer::rewind(int subsong)
   opl->write(1,32);			// Go to ym3812 mode
 }
 
+bool Cs3mPlayer::snapshot(CSnapshot &s)
+{
+  s.io(channel);
+  s.io(crow); s.io(ord); s.io(speed); s.io(tempo); s.io(del);
+  s.io(songend); s.io(loopstart); s.io(loopcnt);
+  return true;
+}
+
 std::string Cs3mPlayer::gettype()
 {
   char filever[5];
@@ -426,22 +449,22 @@ float Cs3mPlayer::getrefresh()
 
 /*** private methods *************************************/
 
-void Cs3mPlayer::load_header(binistream *f, s3mheader *h)
+void Cs3mPlayer::load_header(CFileCursor &c, s3mheader *h)
 {
   int i;
 
-  f->readString(h->name, 28);
-  h->kennung = f->readInt(1); h->typ = f->readInt(1);
-  f->ignore(2);
-  h->ordnum = f->readInt(2); h->insnum = f->readInt(2);
-  h->patnum = f->readInt(2); h->flags = f->readInt(2);
-  h->cwtv = f->readInt(2); h->ffi = f->readInt(2);
-  f->readString(h->scrm, 4);
-  h->gv = f->readInt(1); h->is = f->readInt(1); h->it = f->readInt(1);
-  h->mv = f->readInt(1); h->uc = f->readInt(1); h->dp = f->readInt(1);
-  f->ignore(8);
-  h->special = f->readInt(2);
-  for(i = 0; i < 32; i++) h->chanset[i] = f->readInt(1);
+  c.bytes(h->name, 28);
+  h->kennung = c.u8(); h->typ = c.u8();
+  c.skip(2);
+  h->ordnum = c.u16le(); h->insnum = c.u16le();
+  h->patnum = c.u16le(); h->flags = c.u16le();
+  h->cwtv = c.u16le(); h->ffi = c.u16le();
+  c.bytes(h->scrm, 4);
+  h->gv = c.u8(); h->is = c.u8(); h->it = c.u8();
+  h->mv = c.u8(); h->uc = c.u8(); h->dp = c.u8();
+  c.skip(8);
+  h->special = c.u16le();
+  for(i = 0; i < 32; i++) h->chanset[i] = c.u8();
 }
 
 void Cs3mPlayer::setvolume(unsigned char chan)
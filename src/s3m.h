@@ -24,14 +24,19 @@
 
 #include "player.h"
 
+class CFileCursor;
+
 class Cs3mPlayer: public CPlayer
 {
  public:
   static CPlayer *factory(Copl *newopl);
+  static ProbeScore probe(const std::string &filename,
+			  const unsigned char *head,
+			  unsigned long len, unsigned long filesize);
 
   Cs3mPlayer(Copl *newopl);
 
-  bool load(const std::string &filename, const CFileProvider &fp);
+  bool loadfile(const std::string &filename, const CFileProvider &fp);
   bool update();
   void rewind(int subsong);
   float getrefresh();
@@ -58,6 +63,8 @@ class Cs3mPlayer: public CPlayer
     { return std::string(inst[n].name); };
 
  protected:
+  bool snapshot(CSnapshot &s);
+
   struct s3mheader {
     char name[28];				// song name
     unsigned char kennung,typ,dummy[2];
@@ -94,7 +101,7 @@ class Cs3mPlayer: public CPlayer
   static const unsigned short notetable[12];
   static const unsigned char vibratotab[32];
 
-  void load_header(binistream *f, s3mheader *h);
+  void load_header(CFileCursor &c, s3mheader *h);
   void setvolume(unsigned char chan);
   void setfreq(unsigned char chan);
   void playnote(unsigned char chan);
@@ -25,6 +25,7 @@
 #include <string.h>
 
 #include "sa2.h"
+#include "fcursor.h"
 #include "debug.h"
 
 CPlayer *Csa2Loader::factory(Copl *newopl)
@@ -32,9 +33,18 @@ CPlayer *Csa2Loader::factory(Copl *newopl)
   return new Csa2Loader(newopl);
 }
 
-bool Csa2Loader::load(const std::string &filename, const CFileProvider &fp)
+CPlayer::ProbeScore Csa2Loader::probe(const std::string &filename,
+				      const unsigned char *head,
+				      unsigned long len,
+				      unsigned long filesize)
+{
+  return len >= 4 && !memcmp(head, "SAdT", 4) ? PROBE_YES : PROBE_NO;
+}
+
+bool Csa2Loader::loadfile(const std::string &filename, const CFileProvider &fp)
 {
   binistream *f = fp.open(filename); if(!f) return false;
+  CFileCursor c(fp, f);
   struct {
     unsigned char data[11],arpstart,arpspeed,arppos,arpspdcnt;
   } insts;
@@ -54,8 +64,8 @@ bool Csa2Loader::load(const std::string &filename, const CFileProvider &fp)
   };
 
   // read header
-  f->readString(header.sadt, 4);
-  header.version = f->readInt(1);
+  c.bytes(header.sadt, 4);
+  header.version = c.u8();
 
   // file validation section
   if(strncmp(header.sadt,"SAdT",4)) { fp.close(f); return false; }
@@ -101,17 +111,17 @@ bool Csa2Loader::load(const std::string &filename, const CFileProvider &fp)
   // instruments
   for(i = 0; i < 31; i++) {
     if(sat_type & HAS_ARPEGIO) {
-      for(j = 0; j < 11; j++) insts.data[j] = f->readInt(1);
-      insts.arpstart = f->readInt(1);
-      insts.arpspeed = f->readInt(1);
-      insts.arppos = f->readInt(1);
-      insts.arpspdcnt = f->readInt(1);
+      for(j = 0; j < 11; j++) insts.data[j] = c.u8();
+      insts.arpstart = c.u8();
+      insts.arpspeed = c.u8();
+      insts.arppos = c.u8();
+      insts.arpspdcnt = c.u8();
       inst[i].arpstart = insts.arpstart;
       inst[i].arpspeed = insts.arpspeed;
       inst[i].arppos = insts.arppos;
       inst[i].arpspdcnt = insts.arpspdcnt;
     } else {
-      for(j = 0; j < 11; j++) insts.data[j] = f->readInt(1);
+      for(j = 0; j < 11; j++) insts.data[j] = c.u8();
       inst[i].arpstart = 0;
       inst[i].arpspeed = 0;
       inst[i].arppos = 0;
@@ -124,31 +134,31 @@ bool Csa2Loader::load(const std::string &filename, const CFileProvider &fp)
   }
 
   // instrument names
-  for(i = 0; i < 29; i++) f->readString(instname[i], 17);
+  for(i = 0; i < 29; i++) c.bytes(instname[i], 17);
 
-  f->ignore(3);		// dummy bytes
-  for(i = 0; i < 128; i++) order[i] = f->readInt(1);	// pattern orders
-  if(sat_type & HAS_UNKNOWN127) f->ignore(127);
+  c.skip(3);		// dummy bytes
+  for(i = 0; i < 128; i++) order[i] = c.u8();	// pattern orders
+  if(sat_type & HAS_UNKNOWN127) c.skip(127);
 
   // infos
-  nop = f->readInt(2); length = f->readInt(1); restartpos = f->readInt(1);
+  nop = c.u16le(); length = c.u8(); restartpos = c.u8();
 
   // bpm
-  bpm = f->readInt(2);
+  bpm = c.u16le();
   if(sat_type & HAS_OLDBPM) {
     bpm = bpm * 125 / 50;		// cps -> bpm
   }
 
   if(sat_type & HAS_ARPEGIOLIST) {
     init_specialarp();
-    for(i = 0; i < 256; i++) arplist[i] = f->readInt(1);	// arpeggio list
-    for(i = 0; i < 256; i++) arpcmd[i] = f->readInt(1);	// arpeggio commands
+    for(i = 0; i < 256; i++) arplist[i] = c.u8();	// arpeggio list
+    for(i = 0; i < 256; i++) arpcmd[i] = c.u8();	// arpeggio commands
   }
 
   for(i=0;i<64;i++) {				// track orders
     for(j=0;j<9;j++) {
       if(sat_type & HAS_TRACKORDER)
-	trackord[i][j] = f->readInt(1);
+	trackord[i][j] = c.u8();
       else
 	{
 	  trackord[i][j] = i * 9 + j;
@@ -157,24 +167,24 @@ bool Csa2Loader::load(const std::string &filename, const CFileProvider &fp)
   }
 
   if(sat_type & HAS_ACTIVECHANNELS)
-    activechan = f->readInt(2) << 16;		// active channels
+    activechan = c.u16le() << 16;		// active channels
 
-  AdPlug_LogWrite("Csa2Loader::load(\"%s\"): sat_type = %x, nop = %d, "
+  AdPlug_LogWrite("Csa2Loader::loadfile(\"%s\"): sat_type = %x, nop = %d, "
 		  "length = %d, restartpos = %d, activechan = %x, bpm = %d\n",
 		  filename.c_str(), sat_type, nop, length, restartpos, activechan, bpm);
 
   // track data
   if(sat_type & HAS_OLDPATTERNS) {
     i = 0;
-    while(!f->ateof()) {
+    while(c.left()) {
       for(j=0;j<64;j++) {
 	for(k=0;k<9;k++) {
-	  buf = f->readInt(1);
+	  buf = c.u8();
 	  tracks[i+k][j].note = buf ? (buf + notedis) : 0;
-	  tracks[i+k][j].inst = f->readInt(1);
-	  tracks[i+k][j].command = convfx[f->readInt(1) & 0xf];
-	  tracks[i+k][j].param1 = f->readInt(1);
-	  tracks[i+k][j].param2 = f->readInt(1);
+	  tracks[i+k][j].inst = c.u8();
+	  tracks[i+k][j].command = convfx[c.u8() & 0xf];
+	  tracks[i+k][j].param1 = c.u8();
+	  tracks[i+k][j].param2 = c.u8();
 	}
       }
       i+=9;
@@ -182,16 +192,16 @@ bool Csa2Loader::load(const std::string &filename, const CFileProvider &fp)
   } else
     if(sat_type & HAS_V7PATTERNS) {
       i = 0;
-      while(!f->ateof()) {
+      while(c.left()) {
 	for(j=0;j<64;j++) {
 	  for(k=0;k<9;k++) {
-	    buf = f->readInt(1);
+	    buf = c.u8();
 	    tracks[i+k][j].note = buf >> 1;
 	    tracks[i+k][j].inst = (buf & 1) << 4;
-	    buf = f->readInt(1);
+	    buf = c.u8();
 	    tracks[i+k][j].inst += buf >> 4;
 	    tracks[i+k][j].command = convfx[buf & 0x0f];
-	    buf = f->readInt(1);
+	    buf = c.u8();
 	    tracks[i+k][j].param1 = buf >> 4;
 	    tracks[i+k][j].param2 = buf & 0x0f;
 	  }
@@ -200,15 +210,15 @@ bool Csa2Loader::load(const std::string &filename, const CFileProvider &fp)
       }
     } else {
       i = 0;
-      while(!f->ateof()) {
+      while(c.left()) {
 	for(j=0;j<64;j++) {
-	  buf = f->readInt(1);
+	  buf = c.u8();
 	  tracks[i][j].note = buf >> 1;
 	  tracks[i][j].inst = (buf & 1) << 4;
-	  buf = f->readInt(1);
+	  buf = c.u8();
 	  tracks[i][j].inst += buf >> 4;
 	  tracks[i][j].command = convfx[buf & 0x0f];
-	  buf = f->readInt(1);
+	  buf = c.u8();
 	  tracks[i][j].param1 = buf >> 4;
 	  tracks[i][j].param2 = buf & 0x0f;
 	}
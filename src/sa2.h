@@ -26,12 +26,15 @@ class Csa2Loader: public CmodPlayer
 {
 public:
   static CPlayer *factory(Copl *newopl);
+  static ProbeScore probe(const std::string &filename,
+			  const unsigned char *head,
+			  unsigned long len, unsigned long filesize);
 
 	Csa2Loader(Copl *newopl)
 		: CmodPlayer(newopl)
 	{ }
 
-	bool load(const std::string &filename, const CFileProvider &fp);
+	bool loadfile(const std::string &filename, const CFileProvider &fp);
 
 	std::string gettype();
 	std::string gettitle();
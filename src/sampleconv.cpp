@@ -0,0 +1,216 @@
+/*
+ * Adplug - Replayer for many OPL2/OPL3 audio file formats.
+ * Copyright (C) 1999 - 2008 Simon Peter, <dn.tlp@gmx.net>, et al.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * sampleconv.cpp - Sample format conversion for Copl::updatefmt()
+ */
+
+#include "sampleconv.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+  (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SAMPLECONV_SSE2
+#include <emmintrin.h>
+#endif
+
+// Samples converted in one go by sampleconv_update()
+#define CHUNK	512
+
+// F32 sample of the largest 16 bit value + 1
+#define F32_SCALE	(1.0f / 32768.0f)
+
+/***** Local functions *****/
+
+static inline void put(long v, void *buf, unsigned long i,
+		       const Copl::Format &fmt)
+  /*
+   * Stores sample 'v' at index 'i' of 'buf'.
+   */
+{
+  switch(fmt.type) {
+  case Copl::S16: {
+    short *p = (short *)buf + i;
+
+    if(fmt.add) v += *p;
+    *p = v > 32767 ? 32767 : (v < -32768 ? -32768 : (short)v);
+    break;
+  }
+
+  case Copl::S32:
+    if(fmt.add) ((int *)buf)[i] += v; else ((int *)buf)[i] = v;
+    break;
+
+  case Copl::F32:
+    if(fmt.add) ((float *)buf)[i] += v * F32_SCALE;
+    else ((float *)buf)[i] = v * F32_SCALE;
+    break;
+  }
+}
+
+#ifdef SAMPLECONV_SSE2
+static inline __m128i widen(__m128i v)
+  /*
+   * Sign extends the lower four 16 bit values of 'v' to 32 bits.
+   */
+{
+  return _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+}
+
+static inline void load4(const short *left, const short *right,
+			 unsigned int stride, unsigned long i,
+			 __m128i &l, __m128i &r)
+  /*
+   * Loads samples 'i' to 'i' + 3 of both channels as 32 bit values.
+   */
+{
+  if(stride == 2) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(left + i * 2));
+
+    l = _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+    r = _mm_srai_epi32(v, 16);
+  } else {
+    l = widen(_mm_loadl_epi64((const __m128i *)(left + i)));
+    r = right == left ? l : widen(_mm_loadl_epi64((const __m128i *)(right + i)));
+  }
+}
+
+static inline void load4(const int *left, const int *right,
+			 unsigned int stride, unsigned long i,
+			 __m128i &l, __m128i &r)
+{
+  if(stride == 2) {
+    __m128 a = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *)(left + i * 2)));
+    __m128 b = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *)(left + i * 2 + 4)));
+
+    l = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+    r = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+  } else {
+    l = _mm_loadu_si128((const __m128i *)(left + i));
+    r = right == left ? l : _mm_loadu_si128((const __m128i *)(right + i));
+  }
+}
+
+static inline void put4(__m128i v, void *buf, unsigned long i,
+			const Copl::Format &fmt)
+  /*
+   * Stores the four samples in 'v' from index 'i' of 'buf' on.
+   */
+{
+  switch(fmt.type) {
+  case Copl::S16: {
+    __m128i *p = (__m128i *)((short *)buf + i);
+
+    if(fmt.add) v = _mm_add_epi32(v, widen(_mm_loadl_epi64(p)));
+    _mm_storel_epi64(p, _mm_packs_epi32(v, v));
+    break;
+  }
+
+  case Copl::S32: {
+    __m128i *p = (__m128i *)((int *)buf + i);
+
+    if(fmt.add) v = _mm_add_epi32(v, _mm_loadu_si128(p));
+    _mm_storeu_si128(p, v);
+    break;
+  }
+
+  case Copl::F32: {
+    float *p = (float *)buf + i;
+    __m128 f = _mm_mul_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(F32_SCALE));
+
+    if(fmt.add) f = _mm_add_ps(f, _mm_loadu_ps(p));
+    _mm_storeu_ps(p, f);
+    break;
+  }
+  }
+}
+#endif
+
+template <class T> static void convert(const T *left, const T *right,
+				       unsigned int stride, void **bufs,
+				       unsigned long offset,
+				       unsigned long samples,
+				       const Copl::Format &fmt)
+{
+  unsigned long i = 0;
+
+#ifdef SAMPLECONV_SSE2
+  __m128i l, r;
+
+  for(; i + 4 <= samples; i += 4) {
+    load4(left, right, stride, i, l, r);
+    if(!fmt.stereo) {
+      if(right != left)
+	l = _mm_srai_epi32(_mm_add_epi32(l, r), 1);
+      put4(l, bufs[0], offset + i, fmt);
+    } else if(fmt.planar) {
+      put4(l, bufs[0], offset + i, fmt);
+      put4(r, bufs[1], offset + i, fmt);
+    } else {
+      put4(_mm_unpacklo_epi32(l, r), bufs[0], (offset + i) * 2, fmt);
+      put4(_mm_unpackhi_epi32(l, r), bufs[0], (offset + i) * 2 + 4, fmt);
+    }
+  }
+#endif
+
+  for(; i < samples; i++) {
+    long l = left[i * stride], r = right[i * stride];
+
+    if(!fmt.stereo)
+      put((l + r) >> 1, bufs[0], offset + i, fmt);
+    else if(fmt.planar) {
+      put(l, bufs[0], offset + i, fmt);
+      put(r, bufs[1], offset + i, fmt);
+    } else {
+      put(l, bufs[0], (offset + i) * 2, fmt);
+      put(r, bufs[0], (offset + i) * 2 + 1, fmt);
+    }
+  }
+}
+
+/***** Public functions *****/
+
+void sampleconv(const short *left, const short *right, unsigned int stride,
+		void **bufs, unsigned long offset, unsigned long samples,
+		const Copl::Format &fmt)
+{
+  convert(left, right, stride, bufs, offset, samples, fmt);
+}
+
+void sampleconv(const int *left, const int *right, unsigned int stride,
+		void **bufs, unsigned long offset, unsigned long samples,
+		const Copl::Format &fmt)
+{
+  convert(left, right, stride, bufs, offset, samples, fmt);
+}
+
+bool sampleconv_update(Copl *opl, bool stereo, void **bufs, int samples,
+		       const Copl::Format &fmt)
+{
+  short		buf[CHUNK * 2];
+  unsigned long	done, n;
+
+  for(done = 0; done < (unsigned long)samples; done += n) {
+    n = samples - done < CHUNK ? samples - done : CHUNK;
+    opl->update(buf, n);
+    if(stereo)
+      sampleconv(buf, buf + 1, 2, bufs, done, n, fmt);
+    else
+      sampleconv(buf, buf, 1, bufs, done, n, fmt);
+  }
+
+  return true;
+}
@@ -0,0 +1,49 @@
+/*
+ * Adplug - Replayer for many OPL2/OPL3 audio file formats.
+ * Copyright (C) 1999 - 2008 Simon Peter, <dn.tlp@gmx.net>, et al.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * sampleconv.h - Sample format conversion for Copl::updatefmt()
+ *
+ * NOTES:
+ * The converters read an emulator's output as 16 bit samples, or as
+ * unclipped 32 bit sums of the same range, through one pointer for each
+ * channel. With a 'stride' of 1 the channels are separate buffers, a mono
+ * source has both pointers the same. With a 'stride' of 2 they are
+ * interleaved, 'right' being 'left' + 1. Mono goes to both channels of a
+ * stereo format, stereo is mixed down to their average for a mono one.
+ */
+
+#ifndef H_ADPLUG_SAMPLECONV
+#define H_ADPLUG_SAMPLECONV
+
+#include "opl.h"
+
+// Converts 'samples' samples into 'bufs', as given to Copl::updatefmt(),
+// starting 'offset' samples into them.
+void sampleconv(const short *left, const short *right, unsigned int stride,
+		void **bufs, unsigned long offset, unsigned long samples,
+		const Copl::Format &fmt);
+void sampleconv(const int *left, const int *right, unsigned int stride,
+		void **bufs, unsigned long offset, unsigned long samples,
+		const Copl::Format &fmt);
+
+// Copl::updatefmt() by way of update(), for emulators that make 16 bit
+// samples, mono or stereo as given.
+bool sampleconv_update(Copl *opl, bool stereo, void **bufs, int samples,
+		       const Copl::Format &fmt);
+
+#endif
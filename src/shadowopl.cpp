@@ -0,0 +1,198 @@
+/*
+ * Adplug - Replayer for many OPL2/OPL3 audio file formats.
+ * Copyright (C) 1999 - 2008 Simon Peter, <dn.tlp@gmx.net>, et al.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * shadowopl.cpp - Drops register writes that don't change the chip
+ */
+
+#include <string.h>
+#include "shadowopl.h"
+
+// Writes passed on in one go by write_batch()
+#define BATCH	128
+
+CShadowopl::CShadowopl(Copl *newopl)
+  : opl(newopl), passed(0), dropped(0)
+{
+  currType = opl->gettype();
+  currChip = opl->getchip();
+  memset(always, 0, sizeof(always));
+  forget();
+}
+
+CShadowopl::~CShadowopl()
+{
+  delete opl;
+}
+
+void CShadowopl::update(short *buf, int samples)
+{
+  opl->update(buf, samples);
+  advance(samples);
+}
+
+bool CShadowopl::updatefmt(void **bufs, int samples, const Format &fmt)
+{
+  if(!opl->updatefmt(bufs, samples, fmt)) return false;
+  advance(samples);
+  return true;
+}
+
+bool CShadowopl::updatestems(short *buf, short **stems, int samples)
+{
+  if(!opl->updatestems(buf, stems, samples)) return false;
+  advance(samples);
+  return true;
+}
+
+void CShadowopl::write(int reg, int val)
+{
+  if(changes(currChip, reg, val))
+    opl->write(reg, val);
+}
+
+void CShadowopl::write_at(unsigned long offset, int reg, int val)
+{
+  // queued by the OPL, and here to know when it's done
+  opl->write_at(offset, reg, val);
+  passed++;
+  if(reg >= 0 && reg <= 0xff) {
+    enqueue(offset, reg, val);
+    pending[currChip][reg]++;
+  }
+}
+
+void CShadowopl::write_batch(const RegWrite *w, size_t n)
+{
+  RegWrite	out[BATCH];
+  size_t	i, m = 0;
+
+  for(i = 0; i < n; i++)
+    if(changes(w[i].chip, w[i].reg, w[i].val)) {
+      out[m++] = w[i];
+      if(m == BATCH) {
+	opl->write_batch(out, m);
+	m = 0;
+      }
+    }
+
+  if(m) opl->write_batch(out, m);
+}
+
+unsigned long CShadowopl::getactive()
+{
+  return opl->getactive();
+}
+
+void CShadowopl::setchannelmask(unsigned long mask)
+{
+  Copl::setchannelmask(mask);
+  opl->setchannelmask(mask);
+}
+
+void CShadowopl::setchip(int n)
+{
+  Copl::setchip(n);
+  opl->setchip(n);
+}
+
+int CShadowopl::getchip()
+{
+  return opl->getchip();
+}
+
+void CShadowopl::init()
+{
+  opl->init();
+  forget();
+}
+
+bool CShadowopl::save_state(std::string &state)
+{
+  return opl->save_state(state);
+}
+
+bool CShadowopl::load_state(const std::string &state)
+{
+  if(!opl->load_state(state)) return false;
+
+  currChip = opl->getchip();
+  forget();
+  return true;
+}
+
+void CShadowopl::passrewrites(int from, int to)
+{
+  for(int r = from < 0 ? 0 : from; r <= to && r <= 0xff; r++)
+    always[r] = true;
+}
+
+/*** private methods *************************************/
+
+bool CShadowopl::changes(int chip, int reg, int val)
+  /*
+   * Returns whether writing 'val' into register 'reg' of chip 'chip' has
+   * any effect, and updates the image and statistics accordingly.
+   */
+{
+  if(reg < 0 || reg > 0xff || always[reg] || pending[chip][reg] ||
+     (!chip && reg >= 2 && reg <= 4)) {
+    passed++;
+    return true;
+  }
+
+  if(image[chip][reg] == val) {
+    dropped++;
+    return false;
+  }
+
+  image[chip][reg] = val;
+  passed++;
+  return true;
+}
+
+void CShadowopl::forget()
+  /*
+   * Makes all registers unknown and drops the queued writes, which the OPL
+   * has dropped as well.
+   */
+{
+  for(int c = 0; c < 2; c++)
+    for(int r = 0; r < 256; r++)
+      image[c][r] = -1;
+
+  memset(pending, 0, sizeof(pending));
+  clearqueue();
+}
+
+void CShadowopl::advance(int samples)
+  /*
+   * Puts the queued writes the OPL did while generating 'samples' samples
+   * into the image.
+   */
+{
+  unsigned long end = queuetime + samples;
+
+  for(; !queue.empty() && queue.front().time < end; queue.pop_front()) {
+    const QueuedWrite &w = queue.front();
+
+    if(!--pending[w.chip][w.reg])
+      image[w.chip][w.reg] = w.val;
+  }
+
+  queuetime = queue.empty() ? 0 : end;
+}
@@ -0,0 +1,89 @@
+/*
+ * Adplug - Replayer for many OPL2/OPL3 audio file formats.
+ * Copyright (C) 1999 - 2008 Simon Peter, <dn.tlp@gmx.net>, et al.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * shadowopl.h - Drops register writes that don't change the chip
+ *
+ * NOTES:
+ * CShadowopl keeps an image of both chips' registers and passes on only
+ * the writes that change them. It works in front of any OPL class, which
+ * is owned by the CShadowopl from then on. All other OPL access is passed
+ * on to it.
+ *
+ * Key on bits only act when they change, so writes repeating them are
+ * dropped like any other. The timer registers 2 to 4 of the first chip act
+ * on every write and always pass. Not every OPL class clears its registers
+ * in init(), so after init() and load_state() all registers are unknown
+ * until written.
+ * Writes queued with write_at() pass, and leave their register unknown
+ * until they are done.
+ *
+ * The output is bit-exact only with OPL classes that act on register
+ * changes alone. CEmuopl resumes a held envelope on every write of
+ * 0x60-0x95, and CKemuopl takes a new multiplier from 0x20-0x35 only on
+ * the next write of 0x40-0x55 or 0xA0-0xB8. Pass those rewrites on with
+ * passrewrites() to keep their output the same. CNemuopl can't be kept
+ * bit-exact: it delays every write after the one before, so a dropped
+ * write moves the later ones a few samples ahead.
+ */
+
+#ifndef H_ADPLUG_SHADOWOPL
+#define H_ADPLUG_SHADOWOPL
+
+#include "opl.h"
+
+class CShadowopl: public Copl
+{
+public:
+  CShadowopl(Copl *opl);
+  ~CShadowopl();
+
+  void update(short *buf, int samples);
+  bool updatefmt(void **bufs, int samples, const Format &fmt);
+  bool updatestems(short *buf, short **stems, int samples);
+  void write(int reg, int val);
+  void write_at(unsigned long offset, int reg, int val);
+  void write_batch(const RegWrite *w, size_t n);
+  unsigned long getactive();
+  void setchannelmask(unsigned long mask);
+  void setchip(int n);
+  int getchip();
+  void init();
+
+  bool save_state(std::string &state);
+  bool load_state(const std::string &state);
+
+  // Passes on rewrites of registers 'from' to 'to' as well, on both chips
+  void passrewrites(int from, int to);
+
+  // Writes passed on and dropped so far
+  unsigned long getpassed() { return passed; }
+  unsigned long getdropped() { return dropped; }
+
+private:
+  Copl		*opl;
+  short		image[2][256];		// register values, -1 if unknown
+  unsigned int	pending[2][256];	// writes queued for the registers
+  bool		always[256];		// registers whose writes all pass
+  unsigned long	passed, dropped;
+
+  bool changes(int chip, int reg, int val);
+  void forget();
+  void advance(int samples);
+};
+
+#endif
@@ -25,5 +25,6 @@ class CSilentopl: public Copl
 {
 public:
 	void write(int reg, int val) {}
+	void write_batch(const RegWrite *w, size_t n) {}
 	void init() {}
 };
@@ -0,0 +1,137 @@
+/*
+ * Adplug - Replayer for many OPL2/OPL3 audio file formats.
+ * Copyright (C) 1999 - 2008 Simon Peter, <dn.tlp@gmx.net>, et al.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * snapshot.h - Replay state snapshot stream
+ *
+ * NOTES:
+ * A CSnapshot either stores variables into a state blob or restores them
+ * from one. Replayers describe their state once, by passing every member
+ * that changes during playback to io(), and the same code then works in
+ * both directions. Pointers into loaded song data are stored as offsets via
+ * ptr(), so a blob can be restored into any instance of the same replayer
+ * that has loaded the same file. Blobs are only meaningful within the
+ * process that created them.
+ */
+
+#ifndef H_ADPLUG_SNAPSHOT
+#define H_ADPLUG_SNAPSHOT
+
+#include <string>
+#include <vector>
+#include <cstring>
+
+class CSnapshot
+{
+public:
+  CSnapshot(std::string *out)		// store state into 'out'
+    : out(out), in(0), inpos(0), error(false)
+    {
+    }
+
+  CSnapshot(const std::string &in)	// restore state from 'in'
+    : out(0), in(&in), inpos(0), error(false)
+    {
+    }
+
+  bool saving() const
+    { return out != 0; }
+
+  // true if a restore consumed the whole blob without running short
+  bool good() const
+    { return !error && (out || inpos == in->size()); }
+
+  void io(void *data, unsigned long len)
+    {
+      if(out) {
+	out->append((const char *)data, len);
+	return;
+      }
+
+      if(error || in->size() - inpos < len) {
+	error = true;
+	return;
+      }
+
+      memcpy(data, in->data() + inpos, len);
+      inpos += len;
+    }
+
+  template <class T> void io(T &v)
+    { io(&v, sizeof(T)); }
+
+  template <class T> void io(std::vector<T> &v)
+    {
+      unsigned long n = v.size();
+
+      io(n);
+      if(!saving()) {
+	if(error || n > in->size() - inpos) { error = true; return; }
+	v.resize(n);
+      }
+      for(unsigned long i = 0; i < n; i++)
+	io(v[i]);
+    }
+
+  void io(std::string &v)
+    {
+      unsigned long n = v.size();
+
+      io(n);
+      if(saving()) {
+	out->append(v);
+	return;
+      }
+      if(error || n > in->size() - inpos) { error = true; return; }
+      v.assign(in->data() + inpos, n);
+      inpos += n;
+    }
+
+  void io(std::vector<bool> &v)
+    {
+      unsigned long n = v.size();
+
+      io(n);
+      if(!saving()) {
+	if(error || n > in->size() - inpos) { error = true; return; }
+	v.resize(n);
+      }
+      for(unsigned long i = 0; i < n; i++) {
+	bool b = v[i];
+	io(b);
+	v[i] = b;
+      }
+    }
+
+  // pointer into the buffer at 'base' (or NULL), stored as an offset
+  template <class T> void ptr(T *&p, const void *base)
+    {
+      long off = p ? (const char *)p - (const char *)base + 1 : 0;
+
+      io(off);
+      if(!saving() && !error)
+	p = off ? (T *)((const char *)base + off - 1) : 0;
+    }
+
+private:
+  std::string		*out;
+  const std::string	*in;
+  unsigned long		inpos;
+  bool			error;
+};
+
+#endif
@@ -21,13 +21,22 @@
 
 #include <cstring>
 #include "sng.h"
+#include "snapshot.h"
 
 CPlayer *CsngPlayer::factory(Copl *newopl)
 {
   return new CsngPlayer(newopl);
 }
 
-bool CsngPlayer::load(const std::string &filename, const CFileProvider &fp)
+CPlayer::ProbeScore CsngPlayer::probe(const std::string &filename,
+				      const unsigned char *head,
+				      unsigned long len,
+				      unsigned long filesize)
+{
+  return len >= 4 && !memcmp(head, "ObsM", 4) ? PROBE_YES : PROBE_NO;
+}
+
+bool CsngPlayer::loadfile(const std::string &filename, const CFileProvider &fp)
 {
   binistream *f = fp.open(filename); if(!f) return false;
   int i;
@@ -83,3 +92,9 @@ void CsngPlayer::rewind(int subsong)
   pos = header.start; del = header.delay; songend = false;
   opl->init(); opl->write(1,32);	// go to OPL2 mode
 }
+
+bool CsngPlayer::snapshot(CSnapshot &s)
+{
+  s.io(del); s.io(pos); s.io(songend);
+  return true;
+}
@@ -28,6 +28,9 @@ class CsngPlayer: public CPlayer
 {
 public:
   static CPlayer *factory(Copl *newopl);
+  static ProbeScore probe(const std::string &filename,
+			  const unsigned char *head,
+			  unsigned long len, unsigned long filesize);
 
 	CsngPlayer(Copl *newopl)
 		: CPlayer(newopl), data(0)
@@ -35,7 +38,7 @@ public:
 	~CsngPlayer()
 	{ if(data) delete [] data; };
 
-	bool load(const std::string &filename, const CFileProvider &fp);
+	bool loadfile(const std::string &filename, const CFileProvider &fp);
 	bool update();
 	void rewind(int subsong);
 	float getrefresh()
@@ -45,6 +48,8 @@ public:
 	{ return std::string("SNG File Format"); };
 
 protected:
+	bool snapshot(CSnapshot &s);
+
 	struct {
 		char id[4];
 		unsigned short length,start,loop;
@@ -23,10 +23,17 @@
  * Please give credit if you use this algorithm elsewhere :-)
  */
 
-#include <math.h> // for pow()
+#include <math.h> // for ldexp()
 #include "surroundopl.h"
+#include "sampleconv.h"
 #include "debug.h"
 
+// Samples rendered in one go by updatefmt()
+#define CHUNK 512
+
+// Writes transposed in one go by write_batch()
+#define BATCH 128
+
 CSurroundopl::CSurroundopl(Copl *a, Copl *b, bool use16bit)
 	: use16bit(use16bit),
 		bufsize(4096),
@@ -47,6 +54,12 @@ CSurroundopl::~CSurroundopl()
 
 void CSurroundopl::update(short *buf, int samples)
 {
+	Format fmt = { S16, true, false, false };
+	void *bufs[1] = { buf };
+
+	// 16-bit output can be rendered without the buffers below
+	if (this->use16bit && this->updatefmt(bufs, samples, fmt)) return;
+
 	if (samples * 2 > this->bufsize) {
 		// Need to realloc the buffer
 		delete[] this->rbuf;
@@ -56,26 +69,89 @@ void CSurroundopl::update(short *buf, int samples)
 		this->rbuf = new short[this->bufsize];
 	}
 
-	a->update(this->lbuf, samples);
-	b->update(this->rbuf, samples);
+	for (int done = 0, n; done < samples; done += n) {
+		n = this->dequeue(samples - done);
+		a->update(this->lbuf, n);
+		b->update(this->rbuf, n);
 
-	// Copy the two mono OPL buffers into the stereo buffer
-	for (int i = 0; i < samples; i++) {
-		if (this->use16bit) {
-			buf[i * 2] = this->lbuf[i];
-			buf[i * 2 + 1] = this->rbuf[i];
-		} else {
-			((char *)buf)[i * 2] = ((char *)this->lbuf)[i];
-			((char *)buf)[i * 2 + 1] = ((char *)this->rbuf)[i];
+		// Copy the two mono OPL buffers into the stereo buffer
+		for (int i = 0; i < n; i++) {
+			if (this->use16bit) {
+				buf[(done + i) * 2] = this->lbuf[i];
+				buf[(done + i) * 2 + 1] = this->rbuf[i];
+			} else {
+				((char *)buf)[(done + i) * 2] = ((char *)this->lbuf)[i];
+				((char *)buf)[(done + i) * 2 + 1] = ((char *)this->rbuf)[i];
+			}
 		}
 	}
 }
 
-void CSurroundopl::write(int reg, int val)
+bool CSurroundopl::updatefmt(void **bufs, int samples, const Format &fmt)
 {
-	a->write(reg, val);
+	Format mono = { S32, false, false, false };
+	int left[CHUNK], right[CHUNK];
+	void *lbufs[1] = { left }, *rbufs[1] = { right };
+	int done, n;
+
+	// Both OPLs have to support it, asking for no samples tells
+	if (!a->updatefmt(lbufs, 0, mono) || !b->updatefmt(rbufs, 0, mono))
+		return false;
+
+	// Planar stereo goes straight into the two buffers, one OPL each
+	if (fmt.stereo && fmt.planar) {
+		int size = fmt.type == S16 ? 2 : 4;
+
+		mono = fmt;
+		mono.stereo = false;
+		for (done = 0; done < samples; done += n) {
+			n = this->dequeue(samples - done);
+			lbufs[0] = (char *)bufs[0] + done * size;
+			rbufs[0] = (char *)bufs[1] + done * size;
+			a->updatefmt(lbufs, n, mono);
+			b->updatefmt(rbufs, n, mono);
+		}
+		return true;
+	}
+
+	// Otherwise the OPLs are rendered a chunk at a time and combined, before
+	// any clipping
+	for (done = 0; done < samples; done += n) {
+		n = this->dequeue(samples - done < CHUNK ? samples - done : CHUNK);
+		a->updatefmt(lbufs, n, mono);
+		b->updatefmt(rbufs, n, mono);
+		sampleconv(left, right, 1, bufs, done, n, fmt);
+	}
+
+	return true;
+}
+
+void CSurroundopl::write_at(unsigned long offset, int reg, int val)
+{
+	// Queued here, so both OPLs get the write at the same time
+	this->enqueue(offset, reg, val);
+}
+
+unsigned long CSurroundopl::getactive()
+{
+	return a->getactive() | b->getactive();
+}
+
+void CSurroundopl::setchannelmask(unsigned long mask)
+{
+	Copl::setchannelmask(mask);
+	a->setchannelmask(mask);
+	b->setchannelmask(mask);
+}
 
-	// Transpose the other channel to produce the harmonic effect
+int CSurroundopl::transpose(int chip, int reg, int val, RegWrite *out)
+	/*
+	 * Transposes a write for the other channel, to produce the harmonic
+	 * effect. Puts the writes for 'b' into 'out', two at most, and returns
+	 * how many there are.
+	 */
+{
+	int n = 0;
 	int iChannel = -1;
 	int iRegister = reg; // temp
 	int iValue = val; // temp
@@ -83,13 +159,13 @@ void CSurroundopl::write(int reg, int val)
 
 	// Remember the FM state, so that the harmonic effect can access
 	// previously assigned register values.
-	this->iFMReg[this->currChip][iRegister] = iValue;
+	this->iFMReg[chip][iRegister] = iValue;
 
 	if ((iChannel >= 0)) {// && (i == 1)) {
-		uint8_t iBlock = (this->iFMReg[this->currChip][0xB0 + iChannel] >> 2) & 0x07;
-		uint16_t iFNum = ((this->iFMReg[this->currChip][0xB0 + iChannel] & 0x03) << 8) | this->iFMReg[this->currChip][0xA0 + iChannel];
+		uint8_t iBlock = (this->iFMReg[chip][0xB0 + iChannel] >> 2) & 0x07;
+		uint16_t iFNum = ((this->iFMReg[chip][0xB0 + iChannel] & 0x03) << 8) | this->iFMReg[chip][0xA0 + iChannel];
 		//double dbOriginalFreq = 50000.0 * (double)iFNum * pow(2, iBlock - 20);
-		double dbOriginalFreq = 49716.0 * (double)iFNum * pow(2.0, iBlock - 20);
+		double dbOriginalFreq = 49716.0 * (double)iFNum * ldexp(1.0, iBlock - 20);
 
 		uint8_t iNewBlock = iBlock;
 		uint16_t iNewFNum;
@@ -97,7 +173,7 @@ void CSurroundopl::write(int reg, int val)
 		// Adjust the frequency and calculate the new FNum
 		//double dbNewFNum = (dbOriginalFreq+(dbOriginalFreq/FREQ_OFFSET)) / (50000.0 * pow(2, iNewBlock - 20));
 		//#define calcFNum() ((dbOriginalFreq+(dbOriginalFreq/FREQ_OFFSET)) / (50000.0 * pow(2, iNewBlock - 20)))
-		#define calcFNum() ((dbOriginalFreq+(dbOriginalFreq/FREQ_OFFSET)) / (49716.0 * pow(2.0, iNewBlock - 20)))
+		#define calcFNum() ((dbOriginalFreq+(dbOriginalFreq/FREQ_OFFSET)) / (49716.0 * ldexp(1.0, iNewBlock - 20)))
 		double dbNewFNum = calcFNum();
 
 		// Make sure it's in range for the OPL chip
@@ -152,15 +228,15 @@ void CSurroundopl::write(int reg, int val)
 			// Overwrite the supplied value with the new F-Number and Block.
 			iValue = (iValue & ~0x1F) | (iNewBlock << 2) | ((iNewFNum >> 8) & 0x03);
 
-			this->iCurrentTweakedBlock[this->currChip][iChannel] = iNewBlock; // save it so we don't have to update register 0xB0 later on
-			this->iCurrentFNum[this->currChip][iChannel] = iNewFNum;
+			this->iCurrentTweakedBlock[chip][iChannel] = iNewBlock; // save it so we don't have to update register 0xB0 later on
+			this->iCurrentFNum[chip][iChannel] = iNewFNum;
 
-			if (this->iTweakedFMReg[this->currChip][0xA0 + iChannel] != (iNewFNum & 0xFF)) {
+			if (this->iTweakedFMReg[chip][0xA0 + iChannel] != (iNewFNum & 0xFF)) {
 				// Need to write out low bits
 				uint8_t iAdditionalReg = 0xA0 + iChannel;
 				uint8_t iAdditionalValue = iNewFNum & 0xFF;
-				b->write(iAdditionalReg, iAdditionalValue);
-				this->iTweakedFMReg[this->currChip][iAdditionalReg] = iAdditionalValue;
+				out[n].chip = chip; out[n].reg = iAdditionalReg; out[n].val = iAdditionalValue; n++;
+				this->iTweakedFMReg[chip][iAdditionalReg] = iAdditionalValue;
 			}
 		} else if ((iRegister >= 0xA0) && (iRegister <= 0xA8)) {
 
@@ -168,17 +244,17 @@ void CSurroundopl::write(int reg, int val)
 			iValue = iNewFNum & 0xFF;
 
 			// See if we need to update the block number, which is stored in a different register
-			uint8_t iNewB0Value = (this->iFMReg[this->currChip][0xB0 + iChannel] & ~0x1F) | (iNewBlock << 2) | ((iNewFNum >> 8) & 0x03);
+			uint8_t iNewB0Value = (this->iFMReg[chip][0xB0 + iChannel] & ~0x1F) | (iNewBlock << 2) | ((iNewFNum >> 8) & 0x03);
 			if (
 				(iNewB0Value & 0x20) && // but only update if there's a note currently playing (otherwise we can just wait
-				(this->iTweakedFMReg[this->currChip][0xB0 + iChannel] != iNewB0Value)   // until the next noteon and update it then)
+				(this->iTweakedFMReg[chip][0xB0 + iChannel] != iNewB0Value)   // until the next noteon and update it then)
 			) {
 				AdPlug_LogWrite("OPL INFO: CH%d - FNum %d/B#%d -> FNum %d/B#%d == keyon register update!\n",
 					iChannel, iFNum, iBlock, iNewFNum, iNewBlock);
 					// The note is already playing, so we need to adjust the upper bits too
 					uint8_t iAdditionalReg = 0xB0 + iChannel;
-					b->write(iAdditionalReg, iNewB0Value);
-					this->iTweakedFMReg[this->currChip][iAdditionalReg] = iNewB0Value;
+					out[n].chip = chip; out[n].reg = iAdditionalReg; out[n].val = iNewB0Value; n++;
+					this->iTweakedFMReg[chip][iAdditionalReg] = iNewB0Value;
 			} // else the note is not playing, the upper bits will be set when the note is next played
 
 		} // if (register 0xB0 or 0xA0)
@@ -186,14 +262,41 @@ void CSurroundopl::write(int reg, int val)
 	} // if (a register we're interested in)
 
 	// Now write to the original register with a possibly modified value
-	b->write(iRegister, iValue);
-	this->iTweakedFMReg[this->currChip][iRegister] = iValue;
+	out[n].chip = chip; out[n].reg = iRegister; out[n].val = iValue; n++;
+	this->iTweakedFMReg[chip][iRegister] = iValue;
+	return n;
+}
+
+void CSurroundopl::write(int reg, int val)
+{
+	RegWrite out[2];
+	int n;
+
+	a->write(reg, val);
+	n = this->transpose(this->currChip, reg, val, out);
+	for (int i = 0; i < n; i++) b->write(out[i].reg, out[i].val);
+}
+
+void CSurroundopl::write_batch(const RegWrite *w, size_t n)
+{
+	RegWrite out[BATCH * 2];
+	size_t done, i, m;
+
+	a->write_batch(w, n);
+
+	// The transposed writes are batched for 'b' in parts
+	for (done = 0; done < n; done += i) {
+		for (i = m = 0; i < BATCH && done + i < n; i++)
+			m += this->transpose(w[done + i].chip, w[done + i].reg, w[done + i].val, out + m);
+		b->write_batch(out, m);
+	}
 }
 
 void CSurroundopl::init()
 {
 	a->init();
 	b->init();
+	this->clearqueue();
 	for (int c = 0; c < 2; c++) {
 		for (int i = 0; i < 256; i++) {
 			this->iFMReg[c][i] = 0;
@@ -208,6 +311,7 @@ void CSurroundopl::init()
 
 void CSurroundopl::setchip(int n)
 {
+	Copl::setchip(n);
 	a->setchip(n);
 	b->setchip(n);
 }
@@ -54,13 +54,20 @@ class CSurroundopl: public Copl
 		uint8_t iCurrentTweakedBlock[2][9]; // Current value of the Block in the tweaked OPL chip
 		uint8_t iCurrentFNum[2][9];         // Current value of the FNum in the tweaked OPL chip
 
+		int transpose(int chip, int reg, int val, RegWrite *out);
+
 	public:
 
 		CSurroundopl(Copl *a, Copl *b, bool use16bit);
 		~CSurroundopl();
 
 		void update(short *buf, int samples);
+		bool updatefmt(void **bufs, int samples, const Format &fmt);
 		void write(int reg, int val);
+		void write_at(unsigned long offset, int reg, int val);
+		void write_batch(const RegWrite *w, size_t n);
+		unsigned long getactive();
+		void setchannelmask(unsigned long mask);
 
 		void init();
 		void setchip(int n);
@@ -20,6 +20,15 @@
  */
 
 #include "temuopl.h"
+#include "sampleconv.h"
+
+// Samples rendered in one go
+#define CHUNK	512
+
+// Builds fmopl's shared tables at load time, see OPLInitTable() in fmopl.h
+static struct CTemuoplTables {
+  CTemuoplTables() { OPLInitTable(); }
+} tables;
 
 CTemuopl::CTemuopl(int rate, bool bit16, bool usestereo)
   : use16bit(bit16), stereo(usestereo)
@@ -34,33 +43,38 @@ CTemuopl::~CTemuopl()
 
 void CTemuopl::update(short *buf, int samples)
 {
-  int i;
+  Format	fmt = { S16, stereo, false, false };
+  short		tempbuf[CHUNK * 2];
+  void		*bufs[1] = { buf };
+  char		*out = (char *)buf;
+  int		i, n;
 
   if(use16bit) {
-    YM3812UpdateOne(opl,buf,samples);
-
-    if(stereo)
-      for(i=samples-1;i>=0;i--) {
-	buf[i*2] = buf[i];
-	buf[i*2+1] = buf[i];
-      }
-  } else {
-    short *tempbuf = new short[stereo ? samples*2 : samples];
-    int i;
-
-    YM3812UpdateOne(opl,tempbuf,samples);
+    updatefmt(bufs, samples, fmt);
+    return;
+  }
 
-    if(stereo)
-      for(i=samples-1;i>=0;i--) {
-	tempbuf[i*2] = tempbuf[i];
-	tempbuf[i*2+1] = tempbuf[i];
-      }
+  bufs[0] = tempbuf;
+  for(; samples > 0; samples -= n) {
+    n = samples < CHUNK ? samples : CHUNK;
+    updatefmt(bufs, n, fmt);
+    for(i = 0; i < (stereo ? n * 2 : n); i++)
+      *out++ = (tempbuf[i] >> 8) ^ 0x80;
+  }
+}
 
-    for(i=0;i<(stereo ? samples*2 : samples);i++)
-      ((char *)buf)[i] = (tempbuf[i] >> 8) ^ 0x80;
+bool CTemuopl::updatefmt(void **bufs, int samples, const Format &fmt)
+{
+  short		tempbuf[CHUNK];
+  unsigned long	done, n;
 
-    delete [] tempbuf;
+  for(done = 0; done < (unsigned long)samples; done += n) {
+    n = dequeue(samples - done < CHUNK ? samples - done : CHUNK);
+    YM3812UpdateOne(opl, tempbuf, n);
+    sampleconv(tempbuf, tempbuf, 1, bufs, done, n, fmt);
   }
+
+  return true;
 }
 
 void CTemuopl::write(int reg, int val)
@@ -69,7 +83,27 @@ void CTemuopl::write(int reg, int val)
   OPLWrite(opl,1,val);
 }
 
+void CTemuopl::write_batch(const RegWrite *w, size_t n)
+{
+  for(size_t i = 0; i < n; i++) {
+    OPLWrite(opl,0,w[i].reg);
+    OPLWrite(opl,1,w[i].val);
+  }
+}
+
+unsigned long CTemuopl::getactive()
+{
+  return OPLActiveChannels(opl);
+}
+
+void CTemuopl::setchannelmask(unsigned long mask)
+{
+  Copl::setchannelmask(mask);
+  OPLSetChannelMask(opl, channelmask);
+}
+
 void CTemuopl::init()
 {
   OPLResetChip(opl);
+  clearqueue();
 }
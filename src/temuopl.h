@@ -34,9 +34,17 @@ class CTemuopl: public Copl
   virtual ~CTemuopl();
 
   void update(short *buf, int samples);	// fill buffer
+  bool updatefmt(void **bufs, int samples, const Format &fmt);
+  unsigned long getactive();
+  void setchannelmask(unsigned long mask);
 
   // template methods
   void write(int reg, int val);
+  void write_at(unsigned long offset, int reg, int val)
+    {
+      enqueue(offset, reg, val);
+    }
+  void write_batch(const RegWrite *w, size_t n);
   void init();
 
  private:
@@ -21,6 +21,7 @@
  */
 
 #include "u6m.h"
+#include "snapshot.h"
 
 // Makes security checks on output buffer before writing
 #define SAVE_OUTPUT_ROOT(c, d, p) \
@@ -34,7 +35,21 @@ CPlayer *Cu6mPlayer::factory(Copl *newopl)
   return new Cu6mPlayer(newopl);
 }
 
-bool Cu6mPlayer::load(const std::string &filename, const CFileProvider &fp)
+CPlayer::ProbeScore Cu6mPlayer::probe(const std::string &filename,
+				      const unsigned char *head,
+				      unsigned long len,
+				      unsigned long filesize)
+{
+  // there is no signature, just a pseudo-header to check
+  if(filesize < 6 || len < 6 || head[2] || head[3] ||
+     head[4] + ((head[5] & 0x1) << 8) != 0x100 ||
+     (unsigned long)(head[0] + (head[1] << 8)) <= filesize - 4)
+    return PROBE_NO;
+
+  return PROBE_MAYBE;
+}
+
+bool Cu6mPlayer::loadfile(const std::string &filename, const CFileProvider &fp)
 {
   // file validation section
   // this section only checks a few *necessary* conditions
@@ -186,6 +201,36 @@ void Cu6mPlayer::rewind(int subsong)
 }
 
 
+bool Cu6mPlayer::snapshot(CSnapshot &s)
+{
+  std::vector<subsong_info> stack;
+
+  if (s.saving())
+    for (std::stack<subsong_info> copy = subsong_stack; !copy.empty(); copy.pop())
+      stack.insert(stack.begin(), copy.top());
+
+  s.io(played_ticks); s.io(driver_active); s.io(songend);
+  s.io(song_pos); s.io(loop_position); s.io(read_delay);
+  s.io(stack);
+  s.io(instrument_offsets);
+  s.io(vb_current_value); s.io(vb_double_amplitude);
+  s.io(vb_multiplier); s.io(vb_direction_flag);
+  s.io(carrier_mf); s.io(carrier_mf_signed_delta);
+  s.io(carrier_mf_mod_delay_backup); s.io(carrier_mf_mod_delay);
+  s.io(channel_freq); s.io(channel_freq_signed_delta);
+
+  if (!s.saving())
+    {
+      while (!subsong_stack.empty())
+        subsong_stack.pop();
+      for (size_t i = 0; i < stack.size(); i++)
+        subsong_stack.push(stack[i]);
+    }
+
+  return true;
+}
+
+
 float Cu6mPlayer::getrefresh()
 {
   return ((float)60);   // the Ultima 6 music driver expects to be called at 60 Hz
@@ -195,7 +240,7 @@ float Cu6mPlayer::getrefresh()
 // ============================================================================================
 //
 //
-//    Functions called by load()
+//    Functions called by loadfile()
 //
 //
 // ============================================================================================
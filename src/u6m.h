@@ -31,6 +31,9 @@ class Cu6mPlayer: public CPlayer
 {
  public:
   static CPlayer *factory(Copl *newopl);
+  static ProbeScore probe(const std::string &filename,
+			  const unsigned char *head,
+			  unsigned long len, unsigned long filesize);
 
   Cu6mPlayer(Copl *newopl) : CPlayer(newopl), song_data(0)
     {
@@ -42,7 +45,7 @@ class Cu6mPlayer: public CPlayer
       if(song_data) delete[] song_data;
     };
 
-  bool load(const std::string &filename, const CFileProvider &fp);
+  bool loadfile(const std::string &filename, const CFileProvider &fp);
   bool update();
   void rewind(int subsong);
   float getrefresh();
@@ -53,6 +56,8 @@ class Cu6mPlayer: public CPlayer
     };
 
  protected:
+  bool snapshot(CSnapshot &s);
+
 
   struct byte_pair
   {
@@ -159,7 +164,7 @@ class Cu6mPlayer: public CPlayer
   void out_adlib(unsigned char adlib_register, unsigned char adlib_data);
   void out_adlib_opcell(int channel, bool carrier, unsigned char adlib_register, unsigned char out_byte);
 
-  // protected functions used by load()
+  // protected functions used by loadfile()
   bool lzw_decompress(data_block source, data_block dest);
   int get_next_codeword (long& bits_read, unsigned char *source, int codeword_size);
   void output_root(unsigned char root, unsigned char *destination, long& position);
@@ -22,7 +22,9 @@
 #ifndef H_ADPLUG_WEMUOPL
 #define H_ADPLUG_WEMUOPL
 
+#include <cstring>
 #include "opl.h"
+#include "sampleconv.h"
 extern "C" {
 #include "woodyopl.h"
 }
@@ -38,7 +40,51 @@ public:
 
   void update(short *buf, int samples)
     {
-      opl.adlib_getsample(buf, samples);
+      for(int n; samples > 0; samples -= n) {
+	n = dequeue(samples);
+	opl.adlib_getsample(buf, n);
+	buf = (short *)((char *)buf + n * samplesize());
+      }
+    }
+
+  // The chip's output is converted before it is clipped
+  bool updatefmt(void **bufs, int samples, const Format &fmt)
+    {
+      Output out = { bufs, &fmt, 0 };
+
+      for(int n; samples > 0; samples -= n, out.offset += n) {
+	n = dequeue(samples);
+	opl.adlib_getsample(NULL, n, NULL, convert, &out);
+      }
+      return true;
+    }
+
+  bool updatestems(short *buf, short **stems, int samples)
+    {
+      short	*part[18];
+      int	n, c;
+
+      for(c = 0; c < 18; c++)
+	part[c] = stems[c];
+      for(; samples > 0; samples -= n) {
+	n = dequeue(samples);
+	opl.adlib_getsample(buf, n, part);
+	buf = (short *)((char *)buf + n * samplesize());
+	for(c = 0; c < 18; c++)
+	  if(part[c]) part[c] = (short *)((char *)part[c] + n * samplesize());
+      }
+      return true;
+    }
+
+  unsigned long getactive()
+    {
+      return opl.adlib_active();
+    }
+
+  void setchannelmask(unsigned long mask)
+    {
+      Copl::setchannelmask(mask);
+      opl.chanmask = channelmask;
     }
 
   // template methods
@@ -47,10 +93,67 @@ public:
       opl.adlib_write((currChip << 8) | reg, val);
     };
 
-  void init() {};
+  void write_at(unsigned long offset, int reg, int val)
+    {
+      enqueue(offset, reg, val);
+    }
+
+  void write_batch(const RegWrite *w, size_t n)
+    {
+      for(size_t i = 0; i < n; i++)
+	opl.adlib_write((w[i].chip << 8) | w[i].reg, w[i].val);
+    }
+
+  void init()
+    {
+      clearqueue();
+    }
+
+  // The chip class holds no pointers into itself, so it is saved verbatim
+  bool save_state(std::string &state)
+    {
+      state.assign((const char *)&opl, sizeof(opl));
+      state.append((const char *)&currChip, sizeof(currChip));
+      return true;
+    }
+
+  bool load_state(const std::string &state)
+    {
+      const OPLChipClass *chip = (const OPLChipClass *)state.data();
+
+      if(state.size() != sizeof(opl) + sizeof(currChip) ||
+	 chip->int_samplerate != opl.int_samplerate)
+	return false;
+
+      memcpy(&opl, chip, sizeof(opl));
+      memcpy(&currChip, state.data() + sizeof(opl), sizeof(currChip));
+      opl.chanmask = channelmask;	// a setting, not part of the state
+      clearqueue();
+      return true;
+    }
 
 private:
+  struct Output {		// where updatefmt() puts the chip's output
+    void		**bufs;
+    const Format	*fmt;
+    unsigned long	offset;		// samples of it done so far
+  };
+
   OPLChipClass	opl;
+
+  int samplesize()		// bytes per sample of update()'s output
+    {
+      return opl.int_numsamplechannels * opl.int_bytespersample;
+    }
+
+  static void convert(void *ctx, Bit32s *outbufl, Bit32s *outbufr,
+		      Bits offset, Bits count)
+    {
+      const Output *out = (const Output *)ctx;
+
+      sampleconv(outbufl, outbufr ? outbufr : outbufl, 1, out->bufs,
+		 out->offset + offset, count, *out->fmt);
+    }
 };
 
 #endif
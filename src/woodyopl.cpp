@@ -34,7 +34,12 @@
 #include "woodyopl.h"
 
 
-static fltype recipsamp;	// inverse of sampling rate
+// The tables below are shared by all chips and don't depend on the sampling
+// rate. They are built once, by OPLChipClass::adlib_init_tables(), and only
+// read afterwards. Building them isn't thread safe, so the static
+// OPLChipTables below does it while the library is loaded, before any
+// thread can set up a chip.
+
 static Bit16s wavtable[WAVEPREC*3];	// wave form table
 
 // vibrato/tremolo tables
@@ -44,16 +49,6 @@ static Bit32s trem_table[TREMTAB_SIZE*2];
 static Bit32s vibval_const[BLOCKBUF_SIZE];
 static Bit32s tremval_const[BLOCKBUF_SIZE];
 
-// vibrato value tables (used per-operator)
-static Bit32s vibval_var1[BLOCKBUF_SIZE];
-static Bit32s vibval_var2[BLOCKBUF_SIZE];
-//static Bit32s vibval_var3[BLOCKBUF_SIZE];
-//static Bit32s vibval_var4[BLOCKBUF_SIZE];
-
-// vibrato/trmolo value table pointers
-static Bit32s *vibval1, *vibval2, *vibval3, *vibval4;
-static Bit32s *tremval1, *tremval2, *tremval3, *tremval4;
-
 
 // key scale level lookup table
 static const fltype kslmul[4] = {
@@ -64,8 +59,6 @@ static const fltype kslmul[4] = {
 static const fltype frqmul_tab[16] = {
 	0.5,1,2,3,4,5,6,7,8,9,10,10,12,12,15,15
 };
-// calculated frequency multiplication values (depend on sampling rate)
-static fltype frqmul[16];
 
 // key scale levels
 static Bit8u kslev[8][16];
@@ -148,7 +141,7 @@ static fltype decrelconst[4] = {
 };
 
 
-void operator_advance(op_type* op_pt, Bit32s vib) {
+void OPLChipClass::operator_advance(op_type* op_pt, Bit32s vib) {
 	op_pt->wfpos = op_pt->tcount;						// waveform position
 
 	// advance waveform time
@@ -158,7 +151,7 @@ void operator_advance(op_type* op_pt, Bit32s vib) {
 	op_pt->generator_pos += generator_add;
 }
 
-void operator_advance_drums(op_type* op_pt1, Bit32s vib1, op_type* op_pt2, Bit32s vib2, op_type* op_pt3, Bit32s vib3) {
+void OPLChipClass::operator_advance_drums(op_type* op_pt1, Bit32s vib1, op_type* op_pt2, Bit32s vib2, op_type* op_pt3, Bit32s vib3) {
 	Bit32u c1 = op_pt1->tcount/FIXEDPT;
 	Bit32u c3 = op_pt3->tcount/FIXEDPT;
 	Bit32u phasebit = (((c1 & 0x88) ^ ((c1<<5) & 0x80)) | ((c3 ^ (c3<<2)) & 0x20)) ? 0x02 : 0x00;
@@ -476,12 +469,83 @@ void disable_operator(op_type* op_pt, Bit32u act_type) {
 	}
 }
 
-void OPLChipClass::adlib_init(Bit32u samplerate, Bit32u numchannels, Bit32u bytespersample) {
+void OPLChipClass::adlib_init_tables() {
+	static bool tables_ready = false;
 	Bits i, j, oct;
 
+	if (tables_ready) return;
+
+	// create vibrato table
+	vib_table[0] = 8;
+	vib_table[1] = 4;
+	vib_table[2] = 0;
+	vib_table[3] = -4;
+	for (i=4; i<VIBTAB_SIZE; i++) vib_table[i] = vib_table[i-4]*-1;
+
+	for (i=0; i<BLOCKBUF_SIZE; i++) vibval_const[i] = 0;
+
+
+	// create tremolo table
+	Bit32s trem_table_int[TREMTAB_SIZE];
+	for (i=0; i<14; i++)	trem_table_int[i] = i-13;		// upwards (13 to 26 -> -0.5/6 to 0)
+	for (i=14; i<41; i++)	trem_table_int[i] = -i+14;		// downwards (26 to 0 -> 0 to -1/6)
+	for (i=41; i<53; i++)	trem_table_int[i] = i-40-26;	// upwards (1 to 12 -> -1/6 to -0.5/6)
+
+	for (i=0; i<TREMTAB_SIZE; i++) {
+		// 0.0 .. -26/26*4.8/6 == [0.0 .. -0.8], 4/53 steps == [1 .. 0.57]
+		fltype trem_val1=(fltype)(((fltype)trem_table_int[i])*4.8/26.0/6.0);				// 4.8db
+		fltype trem_val2=(fltype)((fltype)((Bit32s)(trem_table_int[i]/4))*1.2/6.0/6.0);		// 1.2db (larger stepping)
+
+		trem_table[i] = (Bit32s)(pow(FL2,trem_val1)*FIXEDPT);
+		trem_table[TREMTAB_SIZE+i] = (Bit32s)(pow(FL2,trem_val2)*FIXEDPT);
+	}
+
+	for (i=0; i<BLOCKBUF_SIZE; i++) tremval_const[i] = FIXEDPT;
+
+
+	// create waveform tables
+	for (i=0;i<(WAVEPREC>>1);i++) {
+		wavtable[(i<<1)  +WAVEPREC]	= (Bit16s)(16384*sin((fltype)((i<<1)  )*PI*2/WAVEPREC));
+		wavtable[(i<<1)+1+WAVEPREC]	= (Bit16s)(16384*sin((fltype)((i<<1)+1)*PI*2/WAVEPREC));
+		wavtable[i]					= wavtable[(i<<1)  +WAVEPREC];
+		// alternative: (zero-less)
+/*		wavtable[(i<<1)  +WAVEPREC]	= (Bit16s)(16384*sin((fltype)((i<<2)+1)*PI/WAVEPREC));
+		wavtable[(i<<1)+1+WAVEPREC]	= (Bit16s)(16384*sin((fltype)((i<<2)+3)*PI/WAVEPREC));
+		wavtable[i]					= wavtable[(i<<1)-1+WAVEPREC]; */
+	}
+	for (i=0;i<(WAVEPREC>>3);i++) {
+		wavtable[i+(WAVEPREC<<1)]		= wavtable[i+(WAVEPREC>>3)]-16384;
+		wavtable[i+((WAVEPREC*17)>>3)]	= wavtable[i+(WAVEPREC>>2)]+16384;
+	}
+
+	// key scale level table verified ([table in book]*8/3)
+	kslev[7][0] = 0;	kslev[7][1] = 24;	kslev[7][2] = 32;	kslev[7][3] = 37;
+	kslev[7][4] = 40;	kslev[7][5] = 43;	kslev[7][6] = 45;	kslev[7][7] = 47;
+	kslev[7][8] = 48;
+	for (i=9;i<16;i++) kslev[7][i] = (Bit8u)(i+41);
+	for (j=6;j>=0;j--) {
+		for (i=0;i<16;i++) {
+			oct = (Bits)kslev[j+1][i]-8;
+			if (oct < 0) oct = 0;
+			kslev[j][i] = (Bit8u)oct;
+		}
+	}
+
+	tables_ready = true;
+}
+
+// Builds the shared tables at load time, see above
+static struct OPLChipTables {
+	OPLChipTables() { OPLChipClass::adlib_init_tables(); }
+} tables;
+
+void OPLChipClass::adlib_init(Bit32u samplerate, Bit32u numchannels, Bit32u bytespersample) {
+	Bits i;
+
 	int_samplerate = samplerate;
 	int_numsamplechannels = numchannels;
 	int_bytespersample = bytespersample;
+	chanmask = ((Bitu)1<<NUM_CHANNELS)-1;
 
 	generator_add = (Bit32u)(INTFREQU*FIXEDPT/int_samplerate);
 
@@ -528,75 +592,15 @@ void OPLChipClass::adlib_init(Bit32u samplerate, Bit32u numchannels, Bit32u byte
 	opl_index = 0;
 
 
-	// create vibrato table
-	vib_table[0] = 8;
-	vib_table[1] = 4;
-	vib_table[2] = 0;
-	vib_table[3] = -4;
-	for (i=4; i<VIBTAB_SIZE; i++) vib_table[i] = vib_table[i-4]*-1;
-
 	// vibrato at ~6.1 ?? (opl3 docs say 6.1, opl4 docs say 6.0, y8950 docs say 6.4)
 	vibtab_add = static_cast<Bit32u>(VIBTAB_SIZE*FIXEDPT_LFO/8192*INTFREQU/int_samplerate);
 	vibtab_pos = 0;
 
-	for (i=0; i<BLOCKBUF_SIZE; i++) vibval_const[i] = 0;
-
-
-	// create tremolo table
-	Bit32s trem_table_int[TREMTAB_SIZE];
-	for (i=0; i<14; i++)	trem_table_int[i] = i-13;		// upwards (13 to 26 -> -0.5/6 to 0)
-	for (i=14; i<41; i++)	trem_table_int[i] = -i+14;		// downwards (26 to 0 -> 0 to -1/6)
-	for (i=41; i<53; i++)	trem_table_int[i] = i-40-26;	// upwards (1 to 12 -> -1/6 to -0.5/6)
-
-	for (i=0; i<TREMTAB_SIZE; i++) {
-		// 0.0 .. -26/26*4.8/6 == [0.0 .. -0.8], 4/53 steps == [1 .. 0.57]
-		fltype trem_val1=(fltype)(((fltype)trem_table_int[i])*4.8/26.0/6.0);				// 4.8db
-		fltype trem_val2=(fltype)((fltype)((Bit32s)(trem_table_int[i]/4))*1.2/6.0/6.0);		// 1.2db (larger stepping)
-
-		trem_table[i] = (Bit32s)(pow(FL2,trem_val1)*FIXEDPT);
-		trem_table[TREMTAB_SIZE+i] = (Bit32s)(pow(FL2,trem_val2)*FIXEDPT);
-	}
-
 	// tremolo at 3.7hz
 	tremtab_add = (Bit32u)((fltype)TREMTAB_SIZE * TREM_FREQ * FIXEDPT_LFO / (fltype)int_samplerate);
 	tremtab_pos = 0;
 
-	for (i=0; i<BLOCKBUF_SIZE; i++) tremval_const[i] = FIXEDPT;
-
-
-	static Bitu initfirstime = 0;
-	if (!initfirstime) {
-		initfirstime = 1;
-
-		// create waveform tables
-		for (i=0;i<(WAVEPREC>>1);i++) {
-			wavtable[(i<<1)  +WAVEPREC]	= (Bit16s)(16384*sin((fltype)((i<<1)  )*PI*2/WAVEPREC));
-			wavtable[(i<<1)+1+WAVEPREC]	= (Bit16s)(16384*sin((fltype)((i<<1)+1)*PI*2/WAVEPREC));
-			wavtable[i]					= wavtable[(i<<1)  +WAVEPREC];
-			// alternative: (zero-less)
-/*			wavtable[(i<<1)  +WAVEPREC]	= (Bit16s)(16384*sin((fltype)((i<<2)+1)*PI/WAVEPREC));
-			wavtable[(i<<1)+1+WAVEPREC]	= (Bit16s)(16384*sin((fltype)((i<<2)+3)*PI/WAVEPREC));
-			wavtable[i]					= wavtable[(i<<1)-1+WAVEPREC]; */
-		}
-		for (i=0;i<(WAVEPREC>>3);i++) {
-			wavtable[i+(WAVEPREC<<1)]		= wavtable[i+(WAVEPREC>>3)]-16384;
-			wavtable[i+((WAVEPREC*17)>>3)]	= wavtable[i+(WAVEPREC>>2)]+16384;
-		}
-
-		// key scale level table verified ([table in book]*8/3)
-		kslev[7][0] = 0;	kslev[7][1] = 24;	kslev[7][2] = 32;	kslev[7][3] = 37;
-		kslev[7][4] = 40;	kslev[7][5] = 43;	kslev[7][6] = 45;	kslev[7][7] = 47;
-		kslev[7][8] = 48;
-		for (i=9;i<16;i++) kslev[7][i] = (Bit8u)(i+41);
-		for (j=6;j>=0;j--) {
-			for (i=0;i<16;i++) {
-				oct = (Bits)kslev[j+1][i]-8;
-				if (oct < 0) oct = 0;
-				kslev[j][i] = (Bit8u)oct;
-			}
-		}
-	}
-
+	adlib_init_tables();
 }
 
 
@@ -952,39 +956,161 @@ static void OPL_INLINE clipit8(Bit32s ival, Bit8s* outval) {
 
 
 // be careful with this
-// uses cptr and chanval, outputs into outbufl(/outbufr)
+// uses cptr and chanval, outputs into chl(/chr), the current channel's output
 // for opl3 check if opl3-mode is enabled (which uses stereo panning)
 #undef CHANVAL_OUT
 #if defined(OPLTYPE_IS_OPL3)
 #define CHANVAL_OUT									\
 	if (adlibreg[0x105]&1) {						\
-		outbufl[i] += chanval*cptr[0].left_pan;		\
-		outbufr[i] += chanval*cptr[0].right_pan;	\
+		chl[i] += chanval*cptr[0].left_pan;			\
+		chr[i] += chanval*cptr[0].right_pan;		\
 	} else {										\
-		outbufl[i] += chanval;						\
+		chl[i] += chanval;							\
 	}
 #else
 #define CHANVAL_OUT									\
-	outbufl[i] += chanval;
+	chl[i] += chanval;
 #endif
 
-void OPLChipClass::adlib_getsample(Bit16s* sndptr, Bits numsamples) {
+// the output of channel ch goes to its own buffers while stems are put out
+#undef CHANNEL_OUT
+#if defined(OPLTYPE_IS_OPL3)
+#define CHANNEL_OUT(ch)								\
+	if (stembuf) {									\
+		chl = stembuf[ch];							\
+		chr = stembuf[NUM_CHANNELS+(ch)];			\
+	}
+#else
+#define CHANNEL_OUT(ch)								\
+	if (stembuf) chl = stembuf[ch];
+#endif
+
+// clip 'count' samples of the mixed output into the sample format set up
+void OPLChipClass::adlib_clipblock(Bit32s* outbufl, Bit32s* outbufr, void* dest, Bits count) {
+	Bit16s* sndptr = (Bit16s *)dest;
+	Bit8s* sndptr1 = (Bit8s *)dest;
+	Bits i;
+
+#if defined(OPLTYPE_IS_OPL3)
+	if (adlibreg[0x105]&1) {
+		if (int_numsamplechannels == 1) {
+			if (int_bytespersample == 1) {
+				for (i=0;i<count;i++) {
+					clipit8((outbufl[i]+outbufr[i])/2,sndptr1++);
+				}
+			} else {
+				for (i=0;i<count;i++) {
+					clipit16((outbufl[i]+outbufr[i])/2,sndptr++);
+				}
+			}
+		} else {
+			if (int_bytespersample == 1) {
+				for (i=0;i<count;i++) {
+					clipit8(outbufl[i],sndptr1++);
+					clipit8(outbufr[i],sndptr1++);
+				}
+			} else {
+				for (i=0;i<count;i++) {
+					clipit16(outbufl[i],sndptr++);
+					clipit16(outbufr[i],sndptr++);
+				}
+			}
+		}
+	} else
+#endif
+	if (int_numsamplechannels == 1) {
+		if (int_bytespersample == 1) {
+			for (i=0;i<count;i++) {
+				clipit8(outbufl[i],sndptr1++);
+			}
+		} else {
+			for (i=0;i<count;i++) {
+				clipit16(outbufl[i],sndptr++);
+			}
+		}
+	} else {
+		if (int_bytespersample == 1) {
+			for (i=0;i<count;i++) {
+				clipit8(outbufl[i],sndptr1++);
+				clipit8(outbufl[i],sndptr1++);
+			}
+		} else {
+			for (i=0;i<count;i++) {
+				clipit16(outbufl[i],sndptr++);
+				clipit16(outbufl[i],sndptr++);
+			}
+		}
+	}
+
+}
+
+// bitmask of the channels with an operator that isn't off, bit n for channel n
+Bitu OPLChipClass::adlib_active() {
+	Bitu active = 0;
+	for (Bitu ch=0; ch<NUM_CHANNELS; ch++) {
+		op_type* cptr = &op[ch<9 ? ch : ch+9];
+		if ((cptr[0].op_state != OF_TYPE_OFF) || (cptr[9].op_state != OF_TYPE_OFF)) active |= (Bitu)1<<ch;
+	}
+	return active;
+}
+
+void OPLChipClass::adlib_getsample(Bit16s* sndptr, Bits numsamples, Bit16s** stems, adlib_sink sink, void* sinkctx) {
 	Bits i, endsamples;
 	op_type* cptr;
-	Bit8s* sndptr1 = (Bit8s *)sndptr;
 
 	Bit32s outbufl[BLOCKBUF_SIZE];
 #if defined(OPLTYPE_IS_OPL3)
 	// second output buffer (right channel for opl3 stereo)
 	Bit32s outbufr[BLOCKBUF_SIZE];
+	Bit32s* chr = outbufr;
+#else
+	Bit32s* outbufr = outbufl;
 #endif
+	Bit32s* chl = outbufl;
+
+	// with stems, every channel is generated into its own buffers (the left
+	// ones, then the right ones) and mixed afterwards
+	Bit32s (*stembuf)[BLOCKBUF_SIZE] = NULL;
 
 	// vibrato/tremolo lookup tables (global, to possibly be used by all operators)
 	Bit32s vib_lut[BLOCKBUF_SIZE];
 	Bit32s trem_lut[BLOCKBUF_SIZE];
 
+	// vibrato value tables (used per-operator)
+	Bit32s vibval_var1[BLOCKBUF_SIZE];
+	Bit32s vibval_var2[BLOCKBUF_SIZE];
+
+	// vibrato/tremolo value table pointers
+	Bit32s *vibval1, *vibval2, *vibval3, *vibval4;
+	Bit32s *tremval1, *tremval2, *tremval3, *tremval4;
+
 	Bits samples_to_process = numsamples;
 
+	// with every operator off nothing sounds until the next key on, only the
+	// vibrato/tremolo positions move on
+	if (!adlib_active()) {
+		for (Bits cursmp=0; cursmp<samples_to_process; cursmp+=endsamples) {
+			endsamples = samples_to_process-cursmp;
+			if (endsamples>BLOCKBUF_SIZE) endsamples = BLOCKBUF_SIZE;
+			vibtab_pos = (vibtab_pos+vibtab_add*endsamples)%(VIBTAB_SIZE*FIXEDPT_LFO);
+			tremtab_pos = (tremtab_pos+tremtab_add*endsamples)%(TREMTAB_SIZE*FIXEDPT_LFO);
+			if (sink) {
+				memset(outbufl,0,endsamples*sizeof(Bit32s));
+				sink(sinkctx,outbufl,NULL,cursmp,endsamples);
+			}
+		}
+		if (sink) return;
+		// silence is 0, or 128 for unsigned 8 bit samples
+		memset(sndptr,int_bytespersample==1 ? 0x80 : 0,
+			   samples_to_process*int_numsamplechannels*int_bytespersample);
+		for (Bitu ch=0; stems && ch<NUM_CHANNELS; ch++) {
+			if (stems[ch]) memcpy(stems[ch],sndptr,samples_to_process*int_numsamplechannels*int_bytespersample);
+		}
+		return;
+	}
+
+	if (stems) stembuf = new Bit32s[NUM_CHANNELS*2][BLOCKBUF_SIZE];
+
 	for (Bits cursmp=0; cursmp<samples_to_process; cursmp+=endsamples) {
 		endsamples = samples_to_process-cursmp;
 		if (endsamples>BLOCKBUF_SIZE) endsamples = BLOCKBUF_SIZE;
@@ -994,6 +1120,7 @@ void OPLChipClass::adlib_getsample(Bit16s* sndptr, Bits numsamples) {
 		// clear second output buffer (opl3 stereo)
 		if (adlibreg[0x105]&1) memset((void*)&outbufr,0,endsamples*sizeof(Bit32s));
 #endif
+		if (stembuf) memset(stembuf,0,NUM_CHANNELS*2*sizeof(stembuf[0]));
 
 		// calculate vibrato/tremolo lookup tables
 		Bit32s vib_tshift = ((adlibreg[ARC_PERC_MODE]&0x40)==0) ? 1 : 0;	// 14cents/7cents switching
@@ -1013,9 +1140,10 @@ void OPLChipClass::adlib_getsample(Bit16s* sndptr, Bits numsamples) {
 		if (adlibreg[ARC_PERC_MODE]&0x20) {
 			//BassDrum
 			cptr = &op[6];
+			CHANNEL_OUT(6)
 			if (adlibreg[ARC_FEEDBACK+6]&1) {
 				// additive synthesis
-				if (cptr[9].op_state != OF_TYPE_OFF) {
+				if ((cptr[9].op_state != OF_TYPE_OFF) && (chanmask&(1<<6))) {
 					if (cptr[9].vibrato) {
 						vibval1 = vibval_var1;
 						for (i=0;i<endsamples;i++)
@@ -1036,7 +1164,7 @@ void OPLChipClass::adlib_getsample(Bit16s* sndptr, Bits numsamples) {
 				}
 			} else {
 				// frequency modulation
-				if ((cptr[9].op_state != OF_TYPE_OFF) || (cptr[0].op_state != OF_TYPE_OFF)) {
+				if (((cptr[9].op_state != OF_TYPE_OFF) || (cptr[0].op_state != OF_TYPE_OFF)) && (chanmask&(1<<6))) {
 					if ((cptr[0].vibrato) && (cptr[0].op_state != OF_TYPE_OFF)) {
 						vibval1 = vibval_var1;
 						for (i=0;i<endsamples;i++)
@@ -1069,8 +1197,9 @@ void OPLChipClass::adlib_getsample(Bit16s* sndptr, Bits numsamples) {
 			}
 
 			//TomTom (j=8)
-			if (op[8].op_state != OF_TYPE_OFF) {
+			if ((op[8].op_state != OF_TYPE_OFF) && (chanmask&(1<<8))) {
 				cptr = &op[8];
+				CHANNEL_OUT(8)
 				if (cptr[0].vibrato) {
 					vibval3 = vibval_var1;
 					for (i=0;i<endsamples;i++)
@@ -1091,8 +1220,8 @@ void OPLChipClass::adlib_getsample(Bit16s* sndptr, Bits numsamples) {
 			}
 
 			//Snare/Hihat (j=7), Cymbal (j=8)
-			if ((op[7].op_state != OF_TYPE_OFF) || (op[16].op_state != OF_TYPE_OFF) ||
-				(op[17].op_state != OF_TYPE_OFF)) {
+			if (((op[7].op_state != OF_TYPE_OFF) || (op[16].op_state != OF_TYPE_OFF) ||
+				(op[17].op_state != OF_TYPE_OFF)) && (chanmask&((1<<7)|(1<<8)))) {
 				cptr = &op[7];
 				if ((cptr[0].vibrato) && (cptr[0].op_state != OF_TYPE_OFF)) {
 					vibval1 = vibval_var1;
@@ -1120,6 +1249,14 @@ void OPLChipClass::adlib_getsample(Bit16s* sndptr, Bits numsamples) {
 				if (cptr[9].tremolo) tremval4 = trem_lut;	// tremolo enabled, use table
 				else tremval4 = tremval_const;
 
+				// hihat and snare belong to channel 7, the cymbal to channel 8
+				CHANNEL_OUT(8)
+				Bit32s* cyl = chl;
+#if defined(OPLTYPE_IS_OPL3)
+				Bit32s* cyr = chr;
+#endif
+				CHANNEL_OUT(7)
+
 				// calculate channel output
 				for (i=0;i<endsamples;i++) {
 					operator_advance_drums(&op[7],vibval1[i],&op[7+9],vibval2[i],&op[8+9],vibval4[i]);
@@ -1133,8 +1270,22 @@ void OPLChipClass::adlib_getsample(Bit16s* sndptr, Bits numsamples) {
 					opfuncs[op[8+9].op_state](&op[8+9]);		//Cymbal
 					operator_output(&op[8+9],0,tremval4[i]);
 
-					Bit32s chanval = (op[7].cval + op[7+9].cval + op[8+9].cval)*2;
+					Bit32s chanval = 0;
+					if (chanmask&(1<<7)) chanval = (op[7].cval + op[7+9].cval)*2;
+					CHANVAL_OUT
+					chanval = 0;
+					if (chanmask&(1<<8)) chanval = op[8+9].cval*2;
+					Bit32s* hsl = chl;
+					chl = cyl;
+#if defined(OPLTYPE_IS_OPL3)
+					Bit32s* hsr = chr;
+					chr = cyr;
+#endif
 					CHANVAL_OUT
+					chl = hsl;
+#if defined(OPLTYPE_IS_OPL3)
+					chr = hsr;
+#endif
 				}
 			}
 		}
@@ -1146,6 +1297,8 @@ void OPLChipClass::adlib_getsample(Bit16s* sndptr, Bits numsamples) {
 		for (Bits cur_ch=max_channel-1; cur_ch>=0; cur_ch--) {
 			// skip drum/percussion operators
 			if ((adlibreg[ARC_PERC_MODE]&0x20) && (cur_ch >= 6) && (cur_ch < 9)) continue;
+			// skip muted channels, a 4-op voice goes with its first channel
+			if (!(chanmask&((Bitu)1<<cur_ch))) continue;
 
 			Bitu k = cur_ch;
 #if defined(OPLTYPE_IS_OPL3)
@@ -1160,6 +1313,7 @@ void OPLChipClass::adlib_getsample(Bit16s* sndptr, Bits numsamples) {
 #else
 			cptr = &op[cur_ch];
 #endif
+			CHANNEL_OUT(cur_ch)
 
 			// check for FM/AM
 			if (adlibreg[ARC_FEEDBACK+k]&1) {
@@ -1457,56 +1611,24 @@ void OPLChipClass::adlib_getsample(Bit16s* sndptr, Bits numsamples) {
 			}
 		}
 
-#if defined(OPLTYPE_IS_OPL3)
-		if (adlibreg[0x105]&1) {
-			if (int_numsamplechannels == 1) {
-				if (int_bytespersample == 1) {
-					for (i=0;i<endsamples;i++) {
-						clipit8((outbufl[i]+outbufr[i])/2,sndptr1++);
-					}
-				} else {
-					for (i=0;i<endsamples;i++) {
-						clipit16((outbufl[i]+outbufr[i])/2,sndptr++);
-					}
-				}
-			} else {
-				if (int_bytespersample == 1) {
-					for (i=0;i<endsamples;i++) {
-						clipit8(outbufl[i],sndptr1++);
-						clipit8(outbufr[i],sndptr1++);
-					}
-				} else {
-					for (i=0;i<endsamples;i++) {
-						clipit16(outbufl[i],sndptr++);
-						clipit16(outbufr[i],sndptr++);
-					}
-				}
-			}
-		} else
-#endif
-		if (int_numsamplechannels == 1) {
-			if (int_bytespersample == 1) {
+		Bits offset = cursmp*int_numsamplechannels*int_bytespersample;
+		if (stembuf) {
+			for (Bitu ch=0; ch<NUM_CHANNELS; ch++) {
 				for (i=0;i<endsamples;i++) {
-					clipit8(outbufl[i],sndptr1++);
-				}
-			} else {
-				for (i=0;i<endsamples;i++) {
-					clipit16(outbufl[i],sndptr++);
-				}
-			}
-		} else {
-			if (int_bytespersample == 1) {
-				for (i=0;i<endsamples;i++) {
-					clipit8(outbufl[i],sndptr1++);
-					clipit8(outbufl[i],sndptr1++);
-				}
-			} else {
-				for (i=0;i<endsamples;i++) {
-					clipit16(outbufl[i],sndptr++);
-					clipit16(outbufl[i],sndptr++);
+					outbufl[i] += stembuf[ch][i];
+					outbufr[i] += stembuf[NUM_CHANNELS+ch][i];
 				}
+				if (stems[ch]) adlib_clipblock(stembuf[ch],stembuf[NUM_CHANNELS+ch],(Bit8s *)stems[ch]+offset,endsamples);
 			}
 		}
-
+		if (sink) {
+#if defined(OPLTYPE_IS_OPL3)
+			sink(sinkctx,outbufl,(adlibreg[0x105]&1) ? outbufr : NULL,cursmp,endsamples);
+#else
+			sink(sinkctx,outbufl,NULL,cursmp,endsamples);
+#endif
+		} else adlib_clipblock(outbufl,outbufr,(Bit8s *)sndptr+offset,endsamples);
 	}
+
+	delete[] stembuf;
 }
@@ -157,6 +157,10 @@ typedef struct operator_struct {
 #endif
 } op_type;
 
+// receives blocks of the mixed output before it is clipped, 'outbufr' is
+// NULL for mono output; 'offset' counts samples from the start
+typedef void (*adlib_sink)(void* ctx, Bit32s* outbufl, Bit32s* outbufr, Bits offset, Bits count);
+
 class OPLChipClass {
 public:
 
@@ -170,6 +174,7 @@ public:
 	
 	Bit8u status;
 	Bit32u opl_index;
+	Bitu chanmask;		// channels to generate, the others stand still
 	#if defined(OPLTYPE_IS_OPL3)
 	Bit8u adlibreg[512];	// adlib register set (including second set)
 	Bit8u wave_sel[44];		// waveform selection
@@ -179,6 +184,11 @@ public:
 	#endif
 
 
+	// values that depend on the sampling rate
+	fltype recipsamp;		// inverse of sampling rate
+	fltype frqmul[16];		// frequency multiplication values
+	Bit32u generator_add;
+
 	// vibrato/tremolo increment/counter
 	Bit32u vibtab_pos;
 	Bit32u vibtab_add;
@@ -186,6 +196,10 @@ public:
 	Bit32u tremtab_add;
 
 
+	// advance the operators' waveform positions
+	void operator_advance(op_type* op_pt, Bit32s vib);
+	void operator_advance_drums(op_type* op_pt1, Bit32s vib1, op_type* op_pt2, Bit32s vib2, op_type* op_pt3, Bit32s vib3);
+
 	// enable an operator
 	void enable_operator(Bitu regbase, op_type* op_pt, Bit32u act_type);
 
@@ -202,14 +216,15 @@ public:
 	void change_feedback(Bitu chanbase, op_type* op_pt);
 
 	// general functions
+	static void adlib_init_tables();	// done by adlib_init() as needed
 	void adlib_init(Bit32u samplerate, Bit32u numchannels, Bit32u bytespersample);
 	void adlib_write(Bitu idx, Bit8u val);
-	void adlib_getsample(Bit16s* sndptr, Bits numsamples);
+	void adlib_getsample(Bit16s* sndptr, Bits numsamples, Bit16s** stems = NULL, adlib_sink sink = NULL, void* sinkctx = NULL);
+	void adlib_clipblock(Bit32s* outbufl, Bit32s* outbufr, void* dest, Bits count);
+	Bitu adlib_active();
 
 	Bitu adlib_reg_read(Bitu port);
 	void adlib_write_index(Bitu port, Bit8u val);
 };
 
-static Bit32u generator_add;	// should be a chip parameter
-
 #endif
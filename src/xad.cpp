@@ -19,7 +19,10 @@
   xad.cpp - XAD shell player by Riven the Mage <riven@ok.ru>
 */
 
+#include <string.h>
+
 #include "xad.h"
+#include "snapshot.h"
 #include "debug.h"
 
 /* -------- Public Methods -------------------------------- */
@@ -35,7 +38,17 @@ CxadPlayer::~CxadPlayer()
     delete [] tune;
 }
 
-bool CxadPlayer::load(const std::string &filename, const CFileProvider &fp)
+CPlayer::ProbeScore CxadPlayer::probe_xad(const unsigned char *head,
+					  unsigned long len, int fmt)
+{
+  // 'XAD!' signed, and in the format of the player
+  if(len < 78 || memcmp(head, "XAD!", 4) || (head[76] | head[77] << 8) != fmt)
+    return PROBE_NO;
+
+  return PROBE_YES;
+}
+
+bool CxadPlayer::loadfile(const std::string &filename, const CFileProvider &fp)
 {
   binistream *f = fp.open(filename); if(!f) return false;
   bool ret = false;
@@ -138,3 +151,11 @@ void CxadPlayer::opl_write(int reg, int val)
 #endif
   opl->write(reg,val);
 }
+
+bool CxadPlayer::snapshot(CSnapshot &s)
+{
+  s.io(plr);
+  s.io(adlib);
+
+  return xadplayer_snapshot(s);
+}
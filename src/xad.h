@@ -32,7 +32,7 @@ public:
         CxadPlayer(Copl * newopl);
         ~CxadPlayer();
 
-        bool	load(const std::string &filename, const CFileProvider &fp);
+        bool	loadfile(const std::string &filename, const CFileProvider &fp);
         bool	update();
         void	rewind(int subsong);
         float	getrefresh();
@@ -65,9 +65,17 @@ protected:
 	  {
 	    return 0;
 	  }
+	virtual bool xadplayer_snapshot(CSnapshot &s)
+	  {
+	    return false;
+	  }
 
 	enum { HYP=1, PSI, FLASH, BMF, RAT, HYBRID };
 
+	// probe() of the player for tunes of format 'fmt'
+	static ProbeScore probe_xad(const unsigned char *head, unsigned long len,
+				    int fmt);
+
         struct xad_header
         {
 	    unsigned long   id;
@@ -91,6 +99,7 @@ protected:
 
         unsigned char   adlib[256];
 
+        bool snapshot(CSnapshot &s);
         void opl_write(int reg, int val);
 };
 
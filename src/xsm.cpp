@@ -22,6 +22,7 @@
 #include <string.h>
 
 #include "xsm.h"
+#include "snapshot.h"
 
 CxsmPlayer::CxsmPlayer(Copl *newopl)
   : CPlayer(newopl), music(0)
@@ -33,7 +34,18 @@ CxsmPlayer::~CxsmPlayer()
   if(music) delete [] music;
 }
 
-bool CxsmPlayer::load(const std::string &filename, const CFileProvider &fp)
+CPlayer::ProbeScore CxsmPlayer::probe(const std::string &filename,
+				      const unsigned char *head,
+				      unsigned long len,
+				      unsigned long filesize)
+{
+  if(len < 8 || memcmp(head, "ofTAZ!", 6) || (head[6] | head[7] << 8) > 3200)
+    return PROBE_NO;
+
+  return PROBE_YES;
+}
+
+bool CxsmPlayer::loadfile(const std::string &filename, const CFileProvider &fp)
 {
   binistream *f = fp.open(filename); if(!f) return false;
   char			id[6];
@@ -102,6 +114,12 @@ void CxsmPlayer::rewind(int subsong)
   songend = false;
 }
 
+bool CxsmPlayer::snapshot(CSnapshot &s)
+{
+  s.io(last); s.io(notenum); s.io(songend);
+  return true;
+}
+
 float CxsmPlayer::getrefresh()
 {
   return 5.0f;
@@ -25,11 +25,14 @@ class CxsmPlayer: public CPlayer
 {
 public:
   static CPlayer *factory(Copl *newopl) { return new CxsmPlayer(newopl); }
+  static ProbeScore probe(const std::string &filename,
+			  const unsigned char *head,
+			  unsigned long len, unsigned long filesize);
 
   CxsmPlayer(Copl *newopl);
   ~CxsmPlayer();
 
-  bool load(const std::string &filename, const CFileProvider &fp);
+  bool loadfile(const std::string &filename, const CFileProvider &fp);
   bool update();
   void rewind(int subsong);
   float getrefresh();
@@ -37,6 +40,8 @@ public:
   std::string gettype() { return std::string("eXtra Simple Music"); }
 
 private:
+  bool snapshot(CSnapshot &s);
+
   unsigned short	songlen;
   char			*music;
   unsigned int		last, notenum;
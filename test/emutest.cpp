@@ -21,17 +21,34 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <vector>
 
 #include "../src/emuopl.h"
+#include "../src/temuopl.h"
+#include "../src/kemuopl.h"
+#include "../src/wemuopl.h"
+#include "../src/nemuopl.h"
+#include "../src/surroundopl.h"
+#include "../src/resampleopl.h"
+#include "../src/silentopl.h"
+#include "../src/shadowopl.h"
 
 /***** Local variables *****/
 
 // String holding the relative path to the source directory
 static char *srcdir;
 
+// Whether to time the OPL classes too, when ADPLUG_BENCHMARK is set
+static bool bench;
+
 /***** Local functions *****/
 
 #define BUF_SIZE	1024
+#define BENCH_WRITES	(1L << 21)	// register writes to time, per OPL
+#define BENCH_CREATES	2000		// instances to create, per OPL class
 
 static bool check_emu_output(CEmuopl *emu)
   /*
@@ -70,6 +87,657 @@ static bool check_emu_output(CEmuopl *emu)
   return (nonull && no10k && nom10k);
 }
 
+static bool check_emu_silence(Copl *emu)
+  /*
+   * Test if the emulator falls silent after a key off, and sounds again on
+   * the next key on.
+   */
+{
+  short	*buf = (short *)calloc(BUF_SIZE, sizeof(short));
+  bool	resumed = false;
+  int	i, n, quiet = 0;
+
+  // play a note with a quick release, then let go of it
+  emu->init();
+  emu->write(0x20, 1);
+  emu->write(0x23, 1);
+  emu->write(0x63, 0xf0);
+  emu->write(0x83, 0x7f);
+  emu->write(0xa0, 0x98);
+  emu->write(0xb0, 0x31);
+  emu->update(buf, BUF_SIZE);
+  emu->write(0xb0, 0x11);
+
+  // the output has to be all zeroes within 8 buffers, and stay that way
+  for(n = 0; n < 16; n++) {
+    bool zero = true;
+
+    emu->update(buf, BUF_SIZE);
+    for(i = 0; i < BUF_SIZE; i++)
+      if(buf[i] != 0) zero = false;
+    if(zero)
+      quiet++;
+    else if(quiet) {
+      quiet = 0;
+      break;
+    }
+  }
+
+  emu->write(0xb0, 0x31);
+  emu->update(buf, BUF_SIZE);
+  for(i = 0; i < BUF_SIZE; i++)
+    if(buf[i] != 0) resumed = true;
+
+  free(buf);
+
+  return quiet >= 8 && resumed;
+}
+
+static bool check_emu_active(Copl *emu)
+  /*
+   * Test if the emulator reports a channel as active while its note sounds,
+   * and as inactive once both operators have been released.
+   */
+{
+  short		*buf = (short *)calloc(BUF_SIZE * 2, sizeof(short));
+  unsigned long	playing, released, resumed;
+
+  // a sustained note on channel 1, both operators with the quickest release
+  emu->init();
+  emu->write(0x21, 0x21);
+  emu->write(0x24, 0x21);
+  emu->write(0x61, 0xf0);
+  emu->write(0x64, 0xf0);
+  emu->write(0x81, 0x0f);
+  emu->write(0x84, 0x0f);
+  emu->write(0xa1, 0x98);
+  emu->write(0xb1, 0x31);
+  emu->update(buf, BUF_SIZE);
+  playing = emu->getactive();
+  emu->write(0xb1, 0x11);
+  for(int n = 0; n < 16; n++)
+    emu->update(buf, BUF_SIZE);
+  released = emu->getactive();
+  emu->write(0xb1, 0x31);
+  emu->update(buf, BUF_SIZE);
+  resumed = emu->getactive();
+
+  free(buf);
+
+  return playing == 2 && released == 0 && resumed == 2;
+}
+
+static void score_write(Copl *emu, long at, int reg, int val)
+  /*
+   * Writes 'val' into register 'reg', 'at' samples into the output of the
+   * next update(), or right away if 'at' is negative.
+   */
+{
+  if(at < 0)
+    emu->write(reg, val);
+  else
+    emu->write_at(at, reg, val);
+}
+
+static void play_score(Copl *emu, bool opl3, short *buf, int samples,
+		       short **stems = 0, const Copl::Format *fmt = 0,
+		       void **out = 0, bool queued = false)
+  /*
+   * Plays a few notes on melodic channels with differing instruments, the
+   * rhythm section and, on an OPL3, on a 4-op voice and the second register
+   * set, into 'buf'. With 'stems', every channel goes into its own buffer
+   * there, too. With 'fmt', the output goes into 'out' in that format
+   * instead. With 'queued', the notes are all queued with write_at() first
+   * and played in two uneven update() calls.
+   */
+{
+  short *stem[18];
+  void *part[2];
+
+  static const unsigned char op[9] = { 0, 1, 2, 8, 9, 10, 16, 17, 18 };
+  int c, b, set, bufs = samples / BUF_SIZE, n;
+  long at;
+
+  srand(1);			// Woody's rhythm noise comes from rand()
+  emu->init();
+  emu->setchip(0);
+  emu->write(1, 0x20);
+  if(opl3) {
+    emu->setchip(1);
+    emu->write(5, 1);		// OPL3 mode
+    emu->write(4, 1);		// channels 0 and 3 form a 4-op voice
+    emu->setchip(0);
+  }
+  for(set = 0; set < (opl3 ? 2 : 1); set++) {
+    emu->setchip(set);
+    for(c = 0; c < 9; c++) {
+      emu->write(0x20 + op[c], 0x20 | (c % 4 + 1));
+      emu->write(0x23 + op[c], 0x21);
+      emu->write(0x40 + op[c], 0x18 + c);
+      emu->write(0x43 + op[c], 0x14);
+      emu->write(0x60 + op[c], 0xf4);
+      emu->write(0x63 + op[c], 0xd3);
+      emu->write(0x80 + op[c], 0x35);
+      emu->write(0x83 + op[c], 0x46);
+      emu->write(0xe0 + op[c], c % 4);
+      emu->write(0xc0 + c, 0x30 | (c % 4) << 1 | (c == 2));
+      emu->write(0xa0 + c, 0x40 + c * 20);
+      emu->write(0xb0 + c, 0x10 + (c % 3) * 4);
+    }
+  }
+  emu->setchip(0);
+
+  for(b = 0; b < bufs; b++) {
+    c = b % 6;
+    at = queued ? b * BUF_SIZE : -1;
+    score_write(emu, at, 0xb0 + c, 0x30 + (b % 3) * 4);
+    score_write(emu, at, 0xb0 + (c + 5) % 6, 0x10);
+    score_write(emu, at, 0xbd, 0x20 | (b * 7 & 0x1f));
+    if(opl3) {
+      emu->setchip(1);
+      score_write(emu, at, 0xb0 + c % 3, b & 1 ? 0x2d : 0x0d);
+      emu->setchip(0);
+    }
+    if(queued) continue;
+    if(stems) {
+      for(c = 0; c < 18; c++)
+	stem[c] = stems[c] ? stems[c] + b * BUF_SIZE * (opl3 ? 2 : 1) : 0;
+      emu->updatestems(buf + b * BUF_SIZE * (opl3 ? 2 : 1), stem, BUF_SIZE);
+    } else if(fmt) {
+      int size = (fmt->type == Copl::S16 ? 2 : 4) *
+	(fmt->stereo && !fmt->planar ? 2 : 1);
+      for(c = 0; c < (fmt->stereo && fmt->planar ? 2 : 1); c++)
+	part[c] = (char *)out[c] + b * BUF_SIZE * size;
+      emu->updatefmt(part, BUF_SIZE, *fmt);
+    } else
+      emu->update(buf + b * BUF_SIZE * (opl3 ? 2 : 1), BUF_SIZE);
+  }
+
+  if(queued) {
+    n = bufs * BUF_SIZE / 3;
+    emu->update(buf, n);
+    emu->update(buf + n * (opl3 ? 2 : 1), bufs * BUF_SIZE - n);
+  }
+}
+
+static Copl *new_emuopl() { return new CEmuopl(8000, true, false); }
+static Copl *new_temuopl() { return new CTemuopl(8000, true, false); }
+static Copl *new_kemuopl() { return new CKemuopl(8000, true, false); }
+static Copl *new_wemuopl() { return new CWemuopl(8000, true, false); }
+static Copl *new_nemuopl() { return new CNemuopl(8000); }
+static Copl *new_surroundopl()
+{
+  return new CSurroundopl(new CEmuopl(8000, true, false),
+			  new CEmuopl(8000, true, false), true);
+}
+static Copl *new_resampleopl()
+{
+  return new CResampleopl(new CNemuopl(CResampleopl::NATIVE_RATE), 8000, true);
+}
+static Copl *new_shadowopl() { return new CShadowopl(new_emuopl()); }
+
+static bool check_emu_solo(Copl *(*create)(), bool opl3)
+  /*
+   * Test if the channels, each played solo on a new emulator, add up to
+   * the full mix. Every solo may be off by one in rounding.
+   */
+{
+  const int	channels = opl3 ? 18 : 9, n = 16 * BUF_SIZE * (opl3 ? 2 : 1);
+  short		*full = (short *)calloc(n, sizeof(short));
+  short		*solo = (short *)calloc(n, sizeof(short));
+  long		*sum = (long *)calloc(n, sizeof(long));
+  bool		sounds = false, ok = true;
+  int		c, i;
+
+  Copl		*emu = create();
+
+  play_score(emu, opl3, full, 16 * BUF_SIZE);
+  delete emu;
+  for(c = 0; c < channels; c++) {
+    emu = create();
+    emu->setchannelmask(1UL << c);
+    play_score(emu, opl3, solo, 16 * BUF_SIZE);
+    delete emu;
+    for(i = 0; i < n; i++)
+      sum[i] += solo[i];
+  }
+
+  for(i = 0; i < n; i++) {
+    if(full[i]) sounds = true;
+    if(labs(sum[i] - full[i]) > channels) ok = false;
+  }
+
+  free(full); free(solo); free(sum);
+  return sounds && ok;
+}
+
+static bool check_emu_stems(Copl *(*create)(), bool opl3)
+  /*
+   * Test if rendering all channels apart in one go gives the same full mix
+   * as update(), and the channels add up to it. Every channel may be off by
+   * one in rounding.
+   */
+{
+  const int	channels = opl3 ? 18 : 9, n = 16 * BUF_SIZE * (opl3 ? 2 : 1);
+  short		*full = (short *)calloc(n, sizeof(short));
+  short		*mix = (short *)calloc(n, sizeof(short));
+  short		*stems[18];
+  bool		sounds = false, ok = true;
+  long		sum;
+  int		c, i;
+
+  for(c = 0; c < 18; c++)
+    stems[c] = c < channels ? (short *)calloc(n, sizeof(short)) : 0;
+
+  Copl		*emu = create();
+
+  play_score(emu, opl3, full, 16 * BUF_SIZE);
+  delete emu;
+  emu = create();
+  play_score(emu, opl3, mix, 16 * BUF_SIZE, stems);
+  delete emu;
+  if(memcmp(full, mix, n * sizeof(short))) ok = false;
+
+  for(i = 0; i < n; i++) {
+    for(sum = 0, c = 0; c < channels; c++)
+      sum += stems[c][i];
+    if(sum) sounds = true;
+    if(labs(sum - mix[i]) > channels) ok = false;
+  }
+
+  for(c = 0; c < 18; c++)
+    free(stems[c]);
+  free(full); free(mix);
+  return sounds && ok;
+}
+
+static long mixdown(long l, long r)
+  /*
+   * Returns stereo sample 'l', 'r' mixed down to mono.
+   */
+{
+  return (l + r) >> 1;
+}
+
+static long clip(long v)
+{
+  return v > 32767 ? 32767 : (v < -32768 ? -32768 : v);
+}
+
+static bool check_emu_format(Copl *(*create)(), bool opl3)
+  /*
+   * Test if the output comes out the same in other formats: unchanged in
+   * the emulator's own format, as interleaved 16 bit stereo that mixes down
+   * to it, added into planar float buffers and, mixed down, into a 32 bit
+   * mono buffer. Emulators that mix without clipping may go beyond 16 bit,
+   * so the float and 32 bit samples are clipped to compare them.
+   */
+{
+  const int	channels = opl3 ? 2 : 1, n = 16 * BUF_SIZE;
+  short		*full = (short *)calloc(n * channels, sizeof(short));
+  short		*same = (short *)calloc(n * channels, sizeof(short));
+  short		*stereo = (short *)calloc(n * 2, sizeof(short));
+  float		*planar[2];
+  int		*mono = (int *)calloc(n, sizeof(int));
+  bool		ok = true;
+  long		l, r;
+  int		c, i;
+
+  const Copl::Format
+    fmt_same = { Copl::S16, opl3, false, false },
+    fmt_stereo = { Copl::S16, true, false, false },
+    fmt_planar = { Copl::F32, true, true, true },
+    fmt_mono = { Copl::S32, false, false, true };
+
+  for(c = 0; c < 2; c++) {
+    planar[c] = (float *)calloc(n, sizeof(float));
+    for(i = 0; i < n; i++) planar[c][i] = 0.5f;
+  }
+  for(i = 0; i < n; i++) mono[i] = 100000;
+
+  Copl		*emu = create();
+  play_score(emu, opl3, full, n);
+  delete emu;
+  emu = create();
+  play_score(emu, opl3, 0, n, 0, &fmt_same, (void **)&same);
+  delete emu;
+  emu = create();
+  play_score(emu, opl3, 0, n, 0, &fmt_stereo, (void **)&stereo);
+  delete emu;
+  emu = create();
+  play_score(emu, opl3, 0, n, 0, &fmt_planar, (void **)planar);
+  delete emu;
+  emu = create();
+  play_score(emu, opl3, 0, n, 0, &fmt_mono, (void **)&mono);
+  delete emu;
+
+  if(memcmp(full, same, n * channels * sizeof(short))) ok = false;
+
+  for(i = 0; i < n; i++) {
+    l = stereo[i * 2]; r = stereo[i * 2 + 1];
+    if(opl3 ? l != full[i * 2] || r != full[i * 2 + 1] :
+       mixdown(l, r) != full[i])
+      ok = false;
+
+    if(clip((long)floor((planar[0][i] - 0.5f) * 32768.0f + 0.5f)) != l ||
+       clip((long)floor((planar[1][i] - 0.5f) * 32768.0f + 0.5f)) != r)
+      ok = false;
+
+    if(clip(mono[i] - 100000) != mixdown(l, r)) ok = false;
+  }
+
+  for(c = 0; c < 2; c++)
+    free(planar[c]);
+  free(full); free(same); free(stereo); free(mono);
+  return ok;
+}
+
+static bool check_emu_queue(Copl *(*create)(), bool opl3)
+  /*
+   * Test if writes queued with write_at() and played in one go come out
+   * the same as those done between update() calls.
+   */
+{
+  const int	n = 16 * BUF_SIZE * (opl3 ? 2 : 1);
+  short		*full = (short *)calloc(n, sizeof(short));
+  short		*queued = (short *)calloc(n, sizeof(short));
+  bool		ok;
+
+  Copl		*emu = create();
+  play_score(emu, opl3, full, 16 * BUF_SIZE);
+  delete emu;
+  emu = create();
+  play_score(emu, opl3, queued, 16 * BUF_SIZE, 0, 0, 0, true);
+  delete emu;
+
+  ok = !memcmp(full, queued, n * sizeof(short));
+  free(full); free(queued);
+  return ok;
+}
+
+static bool check_emu_unqueue(Copl *(*create)())
+  /*
+   * Test if init(), and load_state() where the emulator has states, drop
+   * the writes still queued with write_at(), so that a note queued before
+   * doesn't sound afterwards.
+   */
+{
+  static const int	note[][2] = {
+    { 0x20, 1 }, { 0x23, 1 }, { 0x63, 0xf0 }, { 0x83, 0x7f }, { 0xa0, 0x98 },
+    { 0xb0, 0x31 }
+  };
+  short			*buf = (short *)calloc(BUF_SIZE * 2, sizeof(short));
+  Copl			*emu = create();
+  std::string		state;
+  bool			ok = true;
+  int			i;
+
+  for(int pass = 0; pass < 2; pass++) {
+    emu->init();
+    if(pass && !emu->save_state(state)) break;
+
+    for(i = 0; i < 6; i++)
+      emu->write_at(0, note[i][0], note[i][1]);
+
+    if(pass)
+      ok = emu->load_state(state) && ok;
+    else
+      emu->init();
+
+    emu->update(buf, BUF_SIZE);
+    for(i = 0; i < BUF_SIZE * 2; i++)
+      if(buf[i] != 0) ok = false;
+  }
+
+  delete emu;
+  free(buf);
+  return ok;
+}
+
+static void add_write(std::vector<Copl::RegWrite> &w, int chip, int reg,
+		      int val)
+{
+  Copl::RegWrite r;
+
+  r.chip = chip; r.reg = reg; r.val = val;
+  w.push_back(r);
+}
+
+static void score_tick(std::vector<Copl::RegWrite> &w, int b, bool opl3)
+  /*
+   * Makes the writes for tick 'b' of a score: the instruments with the
+   * first, then notes changing in pitch and going on and off.
+   */
+{
+  static const unsigned char op[9] = { 0, 1, 2, 8, 9, 10, 16, 17, 18 };
+  int c, set, sets = opl3 ? 2 : 1;
+
+  w.clear();
+  if(!b) {
+    add_write(w, 0, 1, 0x20);
+    if(opl3) {
+      add_write(w, 1, 5, 1);		// OPL3 mode
+      add_write(w, 1, 4, 1);		// channels 0 and 3 form a 4-op voice
+    }
+    for(set = 0; set < sets; set++)
+      for(c = 0; c < 9; c++) {
+	add_write(w, set, 0x20 + op[c], 0x20 | (c % 4 + 1));
+	add_write(w, set, 0x23 + op[c], 0x21);
+	add_write(w, set, 0x40 + op[c], 0x18 + c);
+	add_write(w, set, 0x43 + op[c], 0x14);
+	add_write(w, set, 0x60 + op[c], 0xf4);
+	add_write(w, set, 0x63 + op[c], 0xd3);
+	add_write(w, set, 0x80 + op[c], 0x35);
+	add_write(w, set, 0x83 + op[c], 0x46);
+	add_write(w, set, 0xc0 + c, 0x30 | (c % 4) << 1);
+      }
+  }
+  for(set = 0; set < sets; set++)
+    for(c = b % 3; c < 9; c += 3) {
+      add_write(w, set, 0xa0 + c, (b * 37 + c * 20) & 0xff);
+      add_write(w, set, 0xb0 + c, (b + c) & 1 ? 0x31 + (b % 3) * 4 : 0x10);
+    }
+}
+
+static bool check_emu_batch(Copl *(*create)(), bool opl3, int channels)
+  /*
+   * Test if writes done with write_batch() come out the same as those done
+   * one by one with write().
+   */
+{
+  const int			n = 16 * BUF_SIZE * channels;
+  short				*single = (short *)calloc(n, sizeof(short));
+  short				*batched = (short *)calloc(n, sizeof(short));
+  std::vector<Copl::RegWrite>	w;
+  Copl				*emu;
+  bool				ok;
+
+  for(int pass = 0; pass < 2; pass++) {
+    short *buf = pass ? batched : single;
+
+    emu = create();
+    emu->init();
+    for(int b = 0; b < 16; b++) {
+      score_tick(w, b, opl3);
+      if(pass)
+	emu->write_batch(&w[0], w.size());
+      else
+	for(size_t i = 0; i < w.size(); i++) {
+	  emu->setchip(w[i].chip);
+	  emu->write(w[i].reg, w[i].val);
+	}
+      emu->setchip(0);
+      emu->update(buf + b * BUF_SIZE * channels, BUF_SIZE);
+    }
+    delete emu;
+  }
+
+  ok = !memcmp(single, batched, n * sizeof(short));
+  free(single); free(batched);
+  return ok;
+}
+
+static bool check_emu_shadow(Copl *(*create)(), bool opl3, int channels,
+			     bool late = false)
+  /*
+   * Test if an emulator behind a CShadowopl sounds the same with every
+   * write done twice, and the second ones are dropped. On odd ticks the
+   * first ones are queued to the middle of the tick, so none are dropped.
+   * With 'late', the second ones follow in the middle of the tick, after
+   * an emulator that delays every write after the one before has done the
+   * first ones.
+   */
+{
+  const int			n = 16 * BUF_SIZE * channels;
+  short				*plain = (short *)calloc(n, sizeof(short));
+  short				*shadowed = (short *)calloc(n, sizeof(short));
+  std::vector<Copl::RegWrite>	w;
+  CShadowopl			*shadow = 0;
+  Copl				*emu;
+  unsigned long			repeated = 0;
+  bool				ok;
+
+  for(int pass = 0; pass < 2; pass++) {
+    short *buf = pass ? shadowed : plain;
+
+    emu = pass ? shadow = new CShadowopl(create()) : create();
+    emu->init();
+    for(int b = 0; b < 16; b++) {
+      short *out = buf + b * BUF_SIZE * channels;
+      bool split = late && !(b & 1);
+
+      score_tick(w, b, opl3);
+      for(size_t i = 0; i < w.size(); i++) {
+	emu->setchip(w[i].chip);
+	if(b & 1)
+	  emu->write_at(BUF_SIZE / 2, w[i].reg, w[i].val);
+	else
+	  emu->write(w[i].reg, w[i].val);
+	if(!split) emu->write(w[i].reg, w[i].val);
+      }
+      if(split) {
+	emu->setchip(0);
+	emu->update(out, BUF_SIZE / 2);
+	out += BUF_SIZE / 2 * channels;
+	for(size_t i = 0; i < w.size(); i++) {
+	  emu->setchip(w[i].chip);
+	  emu->write(w[i].reg, w[i].val);
+	}
+      }
+      if(!pass && !(b & 1)) repeated += w.size();
+      emu->setchip(0);
+      emu->update(out, split ? BUF_SIZE / 2 : BUF_SIZE);
+    }
+    if(pass) ok = shadow->getdropped() >= repeated;
+    delete emu;
+  }
+
+  ok = ok && !memcmp(plain, shadowed, n * sizeof(short));
+  free(plain); free(shadowed);
+  return ok;
+}
+
+static bool check_emu_rewrite(Copl *(*create)(), int from1, int to1,
+			      int from2 = 0, int to2 = -1)
+  /*
+   * Test if an emulator behind a CShadowopl, which passes on rewrites of
+   * registers 'from1' to 'to1' and 'from2' to 'to2', sounds the same as
+   * without. A sustained note has its decay and frequency registers
+   * rewritten on every tick, and its multiplier changed halfway.
+   */
+{
+  short		*plain = (short *)calloc(16 * BUF_SIZE, sizeof(short));
+  short		*shadowed = (short *)calloc(16 * BUF_SIZE, sizeof(short));
+  CShadowopl	*shadow;
+  Copl		*emu;
+  bool		ok;
+
+  for(int pass = 0; pass < 2; pass++) {
+    short *buf = pass ? shadowed : plain;
+
+    emu = pass ? shadow = new CShadowopl(create()) : create();
+    if(pass) {
+      shadow->passrewrites(from1, to1);
+      shadow->passrewrites(from2, to2);
+    }
+    emu->init();
+    emu->write(0x20, 0x01);
+    emu->write(0x23, 0x21);
+    emu->write(0x40, 0x3f);
+    emu->write(0x43, 0x00);
+    emu->write(0x63, 0xf4);
+    emu->write(0x83, 0x57);
+    emu->write(0xa0, 0x98);
+    emu->write(0xb0, 0x31);
+    for(int b = 0; b < 16; b++) {
+      if(b == 8) emu->write(0x23, 0x22);
+      emu->write(0x63, 0xf4);
+      emu->write(0xa0, 0x98);
+      emu->update(buf + b * BUF_SIZE, BUF_SIZE);
+    }
+    delete emu;
+  }
+
+  ok = !memcmp(plain, shadowed, 16 * BUF_SIZE * sizeof(short));
+  free(plain); free(shadowed);
+  return ok;
+}
+
+static void benchmark_writes(const char *name, Copl *opl)
+  /*
+   * Prints how many register writes per second go through 'opl', one at a
+   * time with write() and in blocks of 64 with write_batch().
+   */
+{
+  Copl::RegWrite	w[64];
+  clock_t		start;
+  double		single, batched;
+  long			n;
+  int			i;
+
+  // Pitch changes and key on/off, all over the channels
+  for(i = 0; i < 64; i++) {
+    w[i].chip = 0;
+    w[i].reg = (i & 1 ? 0xb0 : 0xa0) + (i >> 1) % 9;
+    w[i].val = i & 1 ? (i & 2 ? 0x31 : 0x11) : i * 4;
+  }
+
+  opl->init();
+  start = clock();
+  for(n = 0; n < BENCH_WRITES; n += 64)
+    for(i = 0; i < 64; i++)
+      opl->write(w[i].reg, w[i].val);
+  single = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+  opl->init();
+  start = clock();
+  for(n = 0; n < BENCH_WRITES; n += 64)
+    opl->write_batch(w, 64);
+  batched = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+  printf("Writes through %s: %.1f M/s with write(), %.1f M/s with write_batch()\n",
+	 name, BENCH_WRITES / single / 1e6, BENCH_WRITES / batched / 1e6);
+  delete opl;
+}
+
+static void benchmark_create(const char *name, Copl *(*create)())
+  /*
+   * Prints how long creating, initializing and deleting an instance takes.
+   */
+{
+  clock_t	start = clock();
+
+  for(int n = 0; n < BENCH_CREATES; n++) {
+    Copl *opl = create();
+
+    opl->init();
+    delete opl;
+  }
+
+  printf("Creating %s: %.1f us\n", name,
+	 (double)(clock() - start) / CLOCKS_PER_SEC / BENCH_CREATES * 1e6);
+}
+
 /***** Main program *****/
 
 int main(int argc, char *argv[])
@@ -79,11 +747,97 @@ int main(int argc, char *argv[])
   // Set path to source directory
   srcdir = getenv("srcdir");
   if(!srcdir) srcdir = ".";
+  bench = getenv("ADPLUG_BENCHMARK") != NULL;
 
   {
     CEmuopl emu(8000, true, false);
     retval = check_emu_output(&emu);
   }
 
+  {
+    CEmuopl emu(8000, true, false);
+    CKemuopl kemu(8000, true, false);
+    CWemuopl wemu(8000, true, false);
+
+    if(!check_emu_silence(&emu) || !check_emu_silence(&kemu) ||
+       !check_emu_silence(&wemu))
+      retval = false;
+  }
+
+  {
+    CEmuopl emu(8000, true, false);
+    CKemuopl kemu(8000, true, false);
+    CWemuopl wemu(8000, true, false);
+    CNemuopl nemu(8000);
+
+    if(!check_emu_active(&emu) || !check_emu_active(&kemu) ||
+       !check_emu_active(&wemu) || !check_emu_active(&nemu))
+      retval = false;
+  }
+
+  if(!check_emu_solo(new_emuopl, false) || !check_emu_solo(new_kemuopl, false) ||
+     !check_emu_solo(new_wemuopl, false) || !check_emu_solo(new_nemuopl, true))
+    retval = false;
+
+  if(!check_emu_stems(new_wemuopl, false) || !check_emu_stems(new_nemuopl, true))
+    retval = false;
+
+  if(!check_emu_format(new_emuopl, false) ||
+     !check_emu_format(new_kemuopl, false) ||
+     !check_emu_format(new_wemuopl, false) ||
+     !check_emu_format(new_nemuopl, true))
+    retval = false;
+
+  if(!check_emu_queue(new_emuopl, false) ||
+     !check_emu_queue(new_kemuopl, false) ||
+     !check_emu_queue(new_wemuopl, false) ||
+     !check_emu_queue(new_nemuopl, true))
+    retval = false;
+
+  if(!check_emu_unqueue(new_emuopl) || !check_emu_unqueue(new_temuopl) ||
+     !check_emu_unqueue(new_kemuopl) || !check_emu_unqueue(new_wemuopl) ||
+     !check_emu_unqueue(new_nemuopl) || !check_emu_unqueue(new_surroundopl) ||
+     !check_emu_unqueue(new_resampleopl) || !check_emu_unqueue(new_shadowopl))
+    retval = false;
+
+  if(!check_emu_batch(new_emuopl, false, 1) ||
+     !check_emu_batch(new_kemuopl, false, 1) ||
+     !check_emu_batch(new_wemuopl, false, 1) ||
+     !check_emu_batch(new_nemuopl, true, 2) ||
+     !check_emu_batch(new_surroundopl, false, 2) ||
+     !check_emu_batch(new_resampleopl, true, 2))
+    retval = false;
+
+  // Nuked delays every write after the one before, like the chip does, so
+  // its repeats only go once it's done with the first ones
+  if(!check_emu_shadow(new_emuopl, false, 1) ||
+     !check_emu_shadow(new_kemuopl, false, 1) ||
+     !check_emu_shadow(new_wemuopl, false, 1) ||
+     !check_emu_shadow(new_nemuopl, true, 2, true))
+    retval = false;
+
+  // the rewrites MAME and Ken act on, see shadowopl.h
+  if(!check_emu_rewrite(new_emuopl, 0x60, 0x95) ||
+     !check_emu_rewrite(new_kemuopl, 0x40, 0x55, 0xa0, 0xb8))
+    retval = false;
+
+  if(bench) {
+    benchmark_writes("CEmuopl", new_emuopl());
+    benchmark_writes("CTemuopl", new_temuopl());
+    benchmark_writes("CKemuopl", new_kemuopl());
+    benchmark_writes("CWemuopl", new_wemuopl());
+    benchmark_writes("CNemuopl", new_nemuopl());
+    benchmark_writes("CSurroundopl", new_surroundopl());
+    benchmark_writes("CResampleopl", new_resampleopl());
+    benchmark_writes("CSilentopl", new CSilentopl());
+
+    benchmark_create("CEmuopl", new_emuopl);
+    benchmark_create("CTemuopl", new_temuopl);
+    benchmark_create("CKemuopl", new_kemuopl);
+    benchmark_create("CWemuopl", new_wemuopl);
+    benchmark_create("CNemuopl", new_nemuopl);
+    benchmark_create("CResampleopl", new_resampleopl);
+  }
+
   return retval ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -0,0 +1,258 @@
+/*
+ * Adplug - Replayer for many OPL2/OPL3 audio file formats.
+ * Copyright (C) 1999 - 2008 Simon Peter, <dn.tlp@gmx.net>, et al.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * lengthtest.cpp - Test song lengths kept in the database
+ *
+ * A SongLength record has to come back the same after saving and loading
+ * the database. songlength() has to store what it measures in the database
+ * set with CAdPlug::set_database(), and take it from there the next time.
+ *
+ * Every subsong of the ADL files is measured, which used to run the driver
+ * into programs outside the sound data, and a subsong whose program lies
+ * outside has to play nothing.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <binfile.h>
+
+#include "../src/adplug.h"
+#include "../src/database.h"
+#include "../src/silentopl.h"
+
+#ifdef MSDOS
+#	define DIR_DELIM	"\\"
+#else
+#	define DIR_DELIM	"/"
+#endif
+
+/***** Local variables *****/
+
+// ADL files, all of whose subsongs are measured, with the size of their
+// track entries: 120 bytes before version 3, 250 words since
+static const struct {
+  const char	*filename;
+  unsigned int	entrysize;
+} adllist[] = {
+  { "DUNE19.ADL", 1 }, { "EOBSOUND.ADL", 1 }, { "LOREINTR.ADL", 2 },
+  { NULL, 0 }
+};
+
+// String holding the relative path to the source directory
+static const char *srcdir;
+
+/***** Keyopl *****/
+
+// Counts the notes keyed on
+class Keyopl: public Copl
+{
+public:
+  unsigned long	keyons;
+
+  Keyopl()
+    : keyons(0)
+  {
+  }
+
+  void write(int reg, int val)
+  {
+    if((reg & 0xf0) == 0xb0 && (val & 0x20)) keyons++;
+  }
+
+  void init()
+  {
+  }
+};
+
+/***** Local functions *****/
+
+static bool same(const CLengthRecord::Subsong &a,
+		 const CLengthRecord::Subsong &b)
+{
+  return a.length == b.length && a.loopstart == b.loopstart &&
+    a.loopend == b.loopend;
+}
+
+static bool testrecord()
+  /*
+   * Saves a database with a SongLength record, where one subsong isn't
+   * measured, loads it again and checks that the record is still the same.
+   */
+{
+  const std::string		dbfn = "lengthtest.db";
+  CAdPlugDatabase		db, loaded;
+  CLengthRecord			*record = new CLengthRecord, *back;
+  CLengthRecord::Subsong	first = { 98681, 1000, 98681 },
+				third = { 12200, 12200, 12200 }, len;
+  bool				ok;
+
+  std::cout << "Saving and loading a SongLength record - ";
+
+  record->key.crc16 = 0x1234;
+  record->key.crc32 = 0x89abcdefUL;
+  record->filetype = "test";
+  record->comment = "round trip";
+  record->set(0, first);
+  record->set(2, third);
+  db.insert(record);
+
+  ok = db.save(dbfn) && loaded.load(dbfn);
+  back = ok ? (CLengthRecord *)loaded.search(record->key) : 0;
+  ok = back && back->type == CAdPlugDatabase::CRecord::SongLength &&
+    back->filetype == record->filetype && back->comment == record->comment &&
+    back->subsongs.size() == 3 &&
+    back->get(0, len) && same(len, first) &&
+    !back->get(1, len) &&
+    back->get(2, len) && same(len, third);
+
+  remove(dbfn.c_str());
+  std::cout << (ok ? "OK\n" : "FAIL\n");
+  return ok;
+}
+
+static bool testcache(const std::string filename)
+  /*
+   * Measures file 'filename' with a database set, checks that the length
+   * went into it, and that a player loaded afterwards takes the length from
+   * there instead of measuring it.
+   */
+{
+  std::string		fn = std::string(srcdir) + DIR_DELIM + filename;
+  CProvider_Filesystem	fp;
+  CAdPlugDatabase	db;
+  CLengthRecord		*record = 0;
+  CLengthRecord::Subsong	len = { 0, 0, 0 };
+  CSilentopl		opl;
+  CPlayer		*p;
+  binistream		*f;
+  unsigned long		length = 0;
+  bool			ok;
+
+  std::cout << "Keeping the length of " << filename << " - ";
+
+  CAdPlug::set_database(&db);
+
+  if((p = CAdPlug::factory(fn, &opl))) {
+    length = p->songlength();
+    delete p;
+  }
+
+  if((f = fp.open(fn))) {
+    CAdPlugDatabase::CKey key(*f);
+
+    fp.close(f);
+    record = (CLengthRecord *)db.search(key);
+  }
+
+  ok = length && record &&
+    record->type == CAdPlugDatabase::CRecord::SongLength &&
+    record->get(0, len) && len.length == length;
+
+  // a length that can only come from the database
+  if(ok) {
+    len.length = len.loopstart = len.loopend = length + 1234;
+    record->set(0, len);
+    p = CAdPlug::factory(fn, &opl);
+    ok = p && p->songlength() == length + 1234;
+    delete p;
+  }
+
+  CAdPlug::set_database(0);
+  std::cout << (ok ? "OK\n" : "FAIL\n");
+  return ok;
+}
+
+static bool testadl(const std::string filename, unsigned int entrysize)
+  /*
+   * Measures every subsong of ADL file 'filename'. Then, in a copy of the
+   * file, the program of subsong 2, which the player starts when loading,
+   * is pointed past the end of the sound data, and must play nothing.
+   */
+{
+  std::string		fn = std::string(srcdir) + DIR_DELIM + filename;
+  const std::string	copyfn = "lengthtest.adl";
+  std::vector<unsigned char>	data;
+  unsigned long		header = entrysize == 1 ? 120 : 500, program;
+  CSilentopl		opl;
+  Keyopl		keyopl;
+  CPlayer		*p = CAdPlug::factory(fn, &opl);
+  unsigned int		subsong;
+  FILE			*f;
+  bool			ok = p != 0;
+
+  std::cout << "Measuring all subsongs of " << filename << " - ";
+
+  for(subsong = 0; ok && subsong < p->getsubsongs(); subsong++)
+    p->songlength(subsong);
+  delete p;
+
+  if(ok && (f = fopen(fn.c_str(), "rb"))) {
+    unsigned char	buf[4096];
+    size_t		n;
+
+    while((n = fread(buf, 1, sizeof(buf), f)) > 0)
+      data.insert(data.end(), buf, buf + n);
+    fclose(f);
+  }
+
+  program = data.size() > header ? data[2 * entrysize] : 0;
+  if(entrysize == 2 && data.size() > header) program |= data[5] << 8;
+  program = header + 2 * program;
+  ok = ok && data.size() > program + 1;
+
+  if(ok && (f = fopen(copyfn.c_str(), "wb"))) {
+    data[program] = data[program + 1] = 0xff;
+    ok = fwrite(&data[0], 1, data.size(), f) == data.size();
+    fclose(f);
+
+    p = ok ? CAdPlug::factory(copyfn, &keyopl) : 0;
+    ok = p && !p->update() && keyopl.keyons == 0;
+    delete p;
+    remove(copyfn.c_str());
+  } else
+    ok = false;
+
+  std::cout << (ok ? "OK\n" : "FAIL\n");
+  return ok;
+}
+
+/***** Main program *****/
+
+int main(int argc, char *argv[])
+{
+  bool	retval = true;
+
+  // Set path to source directory
+  srcdir = getenv("srcdir");
+  if(!srcdir) srcdir = ".";
+
+  if(!testrecord())
+    retval = false;
+
+  if(!testcache("CHILD1.XSM"))
+    retval = false;
+
+  for(int i = 0; adllist[i].filename != NULL; i++)
+    if(!testadl(adllist[i].filename, adllist[i].entrysize))
+      retval = false;
+
+  return retval ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -23,9 +23,13 @@
 #include <stdio.h>
 #include <cstring>
 #include <string>
+#include <map>
+#include <time.h>
 
 #include "../src/adplug.h"
 #include "../src/opl.h"
+#include "../src/nemuopl.h"
+#include "../src/silentopl.h"
 
 #ifdef MSDOS
 #	define DIR_DELIM	"\\"
@@ -87,9 +91,45 @@ static const char *filelist[] = {
   NULL
 };
 
+// Songs of the players that keep the file in the provider's memory, to test
+// from memory
+static const char *viewlist[] = {
+  "mi2.laa",		// CmidPlayer
+  "michaeld.cmf",	// CmidPlayer
+  "RI051.RIX",		// CrixPlayer
+  "dro_v2.dro",		// Cdro2Player
+  "DUNE19.ADL",		// CadlPlayer
+  NULL
+};
+
+// Songs of the players that load companion files, to test through the cache
+static const char *companionlist[] = {
+  "SONG1.sng",		// CadtrackLoader, SONG1.ins
+  "BEGIN.KSM",		// CksmPlayer, insts.dat
+  "ice_thnk.sci",	// CmidPlayer, icepatch.003
+  "HIP_D.ROL",		// CrolPlayer, standard.bnk
+  NULL
+};
+
+// Songs of the players with the most register writes, to time
+static const char *benchlist[] = {
+  "ALLOYRUN.RAD",	// CmodPlayer
+  "MARIO.A2M",		// CmodPlayer
+  "VIB_VOL3.D00",	// Cd00Player
+  "mi2.laa",		// CmidPlayer
+  "DUNE19.ADL",		// CadlPlayer
+  NULL
+};
+
+#define BENCH_TICKS	1000000	// player ticks to time, per song
+#define BENCH_IDENTIFY	10	// times to identify all files
+
 // String holding the relative path to the source directory
 static const char *srcdir;
 
+// Whether to time the players too, when ADPLUG_BENCHMARK is set
+static bool bench;
+
 /***** Testopl *****/
 
 class Testopl: public Copl
@@ -142,6 +182,40 @@ private:
   FILE	*f;
 };
 
+/***** CProvider_Stripped *****/
+
+// Opens the test files by their names without extension, all other files
+// by their real names, and counts how many files it opens
+class CProvider_Stripped: public CProvider_Filesystem
+{
+public:
+  CProvider_Stripped()
+    : opens(0)
+  {
+  }
+
+  std::string add(const std::string &filename)	// returns the stripped name
+  {
+    std::string stripped = filename.substr(0, filename.find_last_of("."));
+
+    names[stripped] = filename;
+    return stripped;
+  }
+
+  binistream *open(std::string filename) const
+  {
+    std::map<std::string, std::string>::const_iterator i = names.find(filename);
+
+    opens++;
+    return CProvider_Filesystem::open(i != names.end() ? i->second : filename);
+  }
+
+  mutable unsigned long	opens;
+
+private:
+  std::map<std::string, std::string>	names;
+};
+
 /***** Local functions *****/
 
 static bool diff(const std::string fn1, const std::string fn2)
@@ -177,10 +251,13 @@ static bool diff(const std::string fn1, const std::string fn2)
   return retval;
 }
 
-static bool testplayer(const std::string filename)
+static bool testplayer(const std::string filename,
+		       const CFileProvider &fp = CProvider_Filesystem(),
+		       const char *from = "")
   /*
    * Tests playback of file 'filename' by comparing its RAW output with a
    * prerecorded original and returns true if they match, false otherwise.
+   * Opens it through 'fp', which 'from' tells about in the output.
    */
 {
   std::string	fn = std::string(srcdir) + DIR_DELIM + filename;
@@ -191,15 +268,15 @@ static bool testplayer(const std::string filename)
 #endif
   std::string	reffn = fn.substr(0, fn.find_last_of(".")) + ".ref";
   Testopl	*opl = new Testopl(testfn);
-  CPlayer	*p = CAdPlug::factory(fn, opl);
+  CPlayer	*p = CAdPlug::factory(fn, opl, CAdPlug::players, fp);
 
   if(!p) {
-    std::cout << "Error loading: " << fn << std::endl;
+    std::cout << "Error loading: " << fn << from << std::endl;
     delete opl; return false;
   }
 
   // Output file information
-  std::cout << "Testing format: " << p->gettype() << " - ";
+  std::cout << "Testing format: " << p->gettype() << from << " - ";
 
   // Write whole file to disk
   while(p->update())
@@ -218,6 +295,155 @@ static bool testplayer(const std::string filename)
   }
 }
 
+static bool testmemory(const std::string filename)
+  /*
+   * Tests playback of file 'filename' like testplayer(), with the file read
+   * into memory first and opened from there.
+   */
+{
+  std::string		fn = std::string(srcdir) + DIR_DELIM + filename;
+  std::string		buf;
+  CProvider_Memory	fp;
+  FILE			*f = fopen(fn.c_str(), "rb");
+  char			chunk[4096];
+  size_t		n;
+
+  if(!f) {
+    std::cout << "Error loading: " << fn << " from memory" << std::endl;
+    return false;
+  }
+  while((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+    buf.append(chunk, n);
+  fclose(f);
+
+  fp.add(fn, buf.data(), buf.size());
+  return testplayer(filename, fp, " from memory");
+}
+
+static void benchmark(const std::string filename)
+  /*
+   * Prints how many ticks per second the player of file 'filename' plays
+   * on the Nuked emulator, without generating any samples.
+   */
+{
+  std::string	fn = std::string(srcdir) + DIR_DELIM + filename;
+  CNemuopl	opl(44100);
+  CPlayer	*p = CAdPlug::factory(fn, &opl);
+  clock_t	start;
+  double	secs;
+
+  if(!p) return;
+
+  start = clock();
+  for(long i = 0; i < BENCH_TICKS; i++)
+    if(!p->update()) p->rewind(0);
+  secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+  std::cout << "Speed of " << p->gettype() << ": "
+	    << (long)(BENCH_TICKS / secs) << " ticks/s" << std::endl;
+  delete p;
+}
+
+static CPlayer *trial_load(const std::string &fn, Copl *opl,
+			   const CFileProvider &fp)
+  /*
+   * Identifies file 'fn' the way CAdPlug::factory() did before probing, by
+   * calling the load() method of every player until one succeeds.
+   */
+{
+  CPlayers::const_iterator	i;
+  CPlayer			*p;
+
+  for(i = CAdPlug::players.begin(); i != CAdPlug::players.end(); i++)
+    if((p = (*i)->factory(opl))) {
+      if(p->load(fn, fp)) return p;
+      delete p;
+    }
+
+  return 0;
+}
+
+static bool identify()
+  /*
+   * Identifies all test files without their extensions, with the factory
+   * and by trial loading, and checks that both pick the same players.
+   * With ADPLUG_BENCHMARK set, also prints how long both take and how many
+   * files they open.
+   */
+{
+  CSilentopl		opl;
+  CProvider_Stripped	fp;
+  std::vector<std::string> names;
+  CPlayer		*p, *q;
+  clock_t		start;
+  double		secs[2];
+  unsigned long		opens[2];
+  bool			ok = true;
+  int			i, n, method;
+
+  for(i = 0; filelist[i] != NULL; i++)
+    names.push_back(fp.add(std::string(srcdir) + DIR_DELIM + filelist[i]));
+
+  for(i = 0; i < (int)names.size(); i++) {
+    p = CAdPlug::factory(names[i], &opl, CAdPlug::players, fp);
+    q = trial_load(names[i], &opl, fp);
+    if(!p != !q || (p && p->gettype() != q->gettype())) {
+      std::cout << "Identified " << names[i] << " as "
+		<< (p ? p->gettype() : "nothing") << " instead of "
+		<< (q ? q->gettype() : "nothing") << std::endl;
+      ok = false;
+    }
+    delete p; delete q;
+  }
+
+  if(!bench) return ok;
+
+  for(method = 0; method < 2; method++) {
+    fp.opens = 0;
+    start = clock();
+    for(n = 0; n < BENCH_IDENTIFY; n++)
+      for(i = 0; i < (int)names.size(); i++)
+	delete (method ? trial_load(names[i], &opl, fp) :
+		CAdPlug::factory(names[i], &opl, CAdPlug::players, fp));
+    secs[method] = (double)(clock() - start) / CLOCKS_PER_SEC;
+    opens[method] = fp.opens;
+  }
+
+  std::cout << "Identifying " << names.size() << " files without extension: "
+	    << secs[0] * 1000 / BENCH_IDENTIFY << " ms and "
+	    << opens[0] / BENCH_IDENTIFY << " opens probing, "
+	    << secs[1] * 1000 / BENCH_IDENTIFY << " ms and "
+	    << opens[1] / BENCH_IDENTIFY << " opens trial loading" << std::endl;
+  return ok;
+}
+
+static bool testcache()
+  /*
+   * Tests playback of the songs with companion files through a
+   * CProvider_Cache, twice, so that the second time uses what the first
+   * one left in the cache.
+   */
+{
+  CProvider_Filesystem	fs;
+  CProvider_Cache	fp(fs);
+  bool			retval = true;
+  unsigned long		n = 0;
+
+  for(int pass = 0; pass < 2; pass++)
+    for(int i = 0; companionlist[i] != NULL; i++, n++)
+      if(!testplayer(companionlist[i], fp, pass ? " cached" : " to cache"))
+	retval = false;
+
+  if(fp.getmade() != n / 2 || fp.gethits() != n / 2) {
+    std::cout << "Cache made " << fp.getmade() << " and found "
+	      << fp.gethits() << " companion files, expected " << n / 2
+	      << " each: FAIL\n";
+    retval = false;
+  }
+
+  return retval;
+}
+
 /***** Main program *****/
 
 int main(int argc, char *argv[])
@@ -228,16 +454,46 @@ int main(int argc, char *argv[])
   // Set path to source directory
   srcdir = getenv("srcdir");
   if(!srcdir) srcdir = ".";
+  bench = getenv("ADPLUG_BENCHMARK") != NULL;
 
   // Try all files one by one
   if(argc > 1) {
     for(i = 1; i < argc; i++)
       if(!testplayer(argv[i]))
 	retval = false;
-  } else
+  } else {
+    CProvider_Mmap	fp;
+
     for(i = 0; filelist[i] != NULL; i++)
       if(!testplayer(filelist[i]))
 	retval = false;
 
+    for(i = 0; filelist[i] != NULL; i++)
+      if(!testplayer(filelist[i], fp, " mapped"))
+	retval = false;
+
+    // every player handed its view back when it was deleted
+    if(fp.getmapped()) {
+      std::cout << fp.getmapped() << " files still mapped: FAIL\n";
+      retval = false;
+    }
+
+    for(i = 0; viewlist[i] != NULL; i++)
+      if(!testmemory(viewlist[i]))
+	retval = false;
+
+    if(!testcache())
+      retval = false;
+  }
+
+  if(argc <= 1) {
+    if(!identify())
+      retval = false;
+
+    if(bench)
+      for(i = 0; benchlist[i] != NULL; i++)
+	benchmark(benchlist[i]);
+  }
+
   return retval ? EXIT_SUCCESS : EXIT_FAILURE;
 }
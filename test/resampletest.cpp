@@ -0,0 +1,188 @@
+/*
+ * Adplug - Replayer for many OPL2/OPL3 audio file formats.
+ * Copyright (C) 1999 - 2008 Simon Peter, <dn.tlp@gmx.net>, et al.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * resampletest.cpp - Test and benchmark the resampler
+ *
+ * Resamples sine tones from the OPL's native rate to 44.1 and 48 kHz, at
+ * every quality. A tone in the pass band has to come out as the same tone,
+ * one above the output's Nyquist frequency has to be filtered out as far as
+ * the quality allows. The output must not depend on the chunk size, or on a
+ * save/restore in between. With ADPLUG_BENCHMARK set, the speed of every
+ * quality is reported in ns per output sample, too.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include <vector>
+#include <iostream>
+
+#include "../src/resampler.h"
+
+#define IN_RATE		49716	// native OPL rate
+#define LENGTH		20000	// output samples per test
+#define BENCH_SECONDS	10	// seconds of output to time, per quality
+
+#ifndef M_PI
+#	define M_PI	3.14159265358979323846
+#endif
+
+/***** Local variables *****/
+
+static const struct {
+  const char		*name;
+  CResampler::Quality	quality;
+  double		snr;		// min. dB of the 1 kHz tone over errors
+  double		rejection;	// min. dB a 24 kHz tone is lowered by
+} qualities[] = {
+  { "linear", CResampler::LINEAR, 35.0, 0.0 },
+  { "sinc8", CResampler::SINC8, 60.0, 10.0 },
+  { "sinc32", CResampler::SINC32, 70.0, 50.0 },
+  { NULL }
+};
+
+static const unsigned long out_rates[] = { 44100, 48000, 0 };
+
+// Whether to time the qualities too, when ADPLUG_BENCHMARK is set
+static bool bench;
+
+/***** Local functions *****/
+
+static std::vector<short> tone(double freq, double rate, unsigned long n)
+  /*
+   * Returns 'n' stereo samples of a sine tone at 'freq' Hz, 'rate' samples
+   * per second. The right channel has the inverted tone.
+   */
+{
+  std::vector<short> v(n * 2);
+
+  for(unsigned long i = 0; i < n; i++) {
+    v[i * 2] = (short)floor(16000.0 * sin(2 * M_PI * freq * i / rate) + 0.5);
+    v[i * 2 + 1] = -v[i * 2];
+  }
+
+  return v;
+}
+
+static bool check(unsigned int q, unsigned long rate)
+{
+  unsigned long		n = LENGTH, needed, used, done, k, m, i;
+  CResampler		r(IN_RATE, rate, true, qualities[q].quality);
+  std::vector<short>	in, out, ref, part;
+  double		signal = 0.0, error = 0.0, snr, rejection;
+  std::string		state;
+  bool			ok = true;
+
+  // pass band tone
+  needed = r.needed(n);
+  in = tone(1000.0, IN_RATE, needed);
+  out.resize(n * 2);
+  r.process(&in[0], &out[0], n);
+  ref = tone(1000.0, rate, n);
+  for(i = r.gettaps() * 2; i < n * 2; i++) {
+    signal += (double)ref[i] * ref[i];
+    error += ((double)out[i] - ref[i]) * ((double)out[i] - ref[i]);
+  }
+  snr = 10.0 * log10(signal / (error + 1.0));
+  if(snr < qualities[q].snr) ok = false;
+
+  // the same in chunks, with a save and restore in the middle
+  r.reset();
+  part.resize(n * 2);
+  used = done = 0;
+  k = 1;
+  while(done < n) {
+    if(k > n - done) k = n - done;
+    m = r.needed(k);
+    r.process(&in[used * 2], &part[done * 2], k);
+    used += m;
+    done += k;
+    k = k * 3 + 1;
+    if(done > n / 2 && state.empty()) {
+      r.save_state(state);
+      CResampler other(IN_RATE, rate, true, qualities[q].quality);
+      if(!other.load_state(state)) ok = false;
+      r.reset();
+      if(!r.load_state(state)) ok = false;
+    }
+  }
+  if(part != out) ok = false;
+
+  // stop band tone, between both Nyquist frequencies
+  r.reset();
+  in = tone(24000.0, IN_RATE, needed);
+  r.process(&in[0], &out[0], n);
+  error = 0.0;
+  for(i = r.gettaps() * 2; i < n * 2; i++)
+    error += (double)out[i] * out[i];
+  error /= n * 2 - r.gettaps() * 2;
+  signal = 16000.0 * 16000.0 / 2;
+  rejection = 10.0 * log10(signal / (error + 1.0));
+  if(rejection < qualities[q].rejection) ok = false;
+
+  std::cout << "Testing " << qualities[q].name << " to " << rate << " Hz: "
+	    << "SNR " << (int)snr << " dB, rejection " << (int)rejection
+	    << " dB - " << (ok ? "OK" : "FAIL") << std::endl;
+  return ok;
+}
+
+static void benchmark(unsigned int q)
+  /*
+   * Times one continuous stream of BENCH_SECONDS seconds at 44.1 kHz,
+   * resampled 1024 samples at a time like CResampleopl does.
+   */
+{
+  CResampler		r(IN_RATE, 44100, true, qualities[q].quality);
+  const unsigned long	n = BENCH_SECONDS * 44100UL;
+  std::vector<short>	in = tone(1000.0, IN_RATE, r.needed(n));
+  std::vector<short>	out(1024 * 2);
+  unsigned long		done, used = 0, k, m;
+  clock_t		start = clock();
+
+  for(done = 0; done < n; done += k) {
+    k = n - done < 1024 ? n - done : 1024;
+    m = r.needed(k);
+    r.process(&in[used * 2], &out[0], k);
+    used += m;
+  }
+
+  std::cout << "Speed of " << qualities[q].name << ": "
+	    << (double)(clock() - start) / CLOCKS_PER_SEC * 1e9 / n
+	    << " ns per stereo sample" << std::endl;
+}
+
+/***** Main program *****/
+
+int main(int argc, char *argv[])
+{
+  bool retval = true;
+
+  bench = getenv("ADPLUG_BENCHMARK") != NULL;
+
+  for(unsigned int q = 0; qualities[q].name; q++)
+    for(unsigned int i = 0; out_rates[i]; i++)
+      if(!check(q, out_rates[i]))
+	retval = false;
+
+  if(bench)
+    for(unsigned int q = 0; qualities[q].name; q++)
+      benchmark(q);
+
+  return retval ? EXIT_SUCCESS : EXIT_FAILURE;
+}
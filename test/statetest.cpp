@@ -0,0 +1,498 @@
+/*
+ * Adplug - Replayer for many OPL2/OPL3 audio file formats.
+ * Copyright (C) 1999 - 2008 Simon Peter, <dn.tlp@gmx.net>, et al.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * statetest.cpp - Test replay state snapshots
+ *
+ * Plays every file of the playertest corpus, but interrupts playback at
+ * pseudo-random ticks: the replayer state is saved, playback is led astray
+ * or the file is loaded into a fresh replayer, and the saved state is
+ * restored. The resulting register stream must still match the reference.
+ *
+ * Seeking is tested by comparing the OPL registers after seek() with those
+ * of playing up to the same tick, also in a replayer that has seeked in
+ * another song before loading this one.
+ *
+ * songlength() is tested on a song that ends by itself, which must end at
+ * the reported length without a loop, and on one played endlessly, whose
+ * replayer state at the reported loop end must be that of the loop start.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <cstring>
+#include <string>
+
+#include "../src/adplug.h"
+#include "../src/opl.h"
+#include "../src/silentopl.h"
+#include "../src/hsc.h"
+
+#ifdef MSDOS
+#	define DIR_DELIM	"\\"
+#else
+#	define DIR_DELIM	"/"
+#endif
+
+#define MAX_GAP		100	// max. ticks between two snapshots
+#define MAX_DETOUR	50	// max. ticks played astray before restoring
+#define SEEK_TICKS	100	// ticks compared after seeking
+#define SEEK_KEYFRAMES	1000	// keyframe interval for seeking, in ms
+#define MAX_LENGTH	600000	// songlength()'s limit, in ms
+
+/***** Local variables *****/
+
+// List of all filenames to test
+static const char *filelist[] = {
+  "SONG1.sng", "2001.MKJ", "ADAGIO.DFM", "adlibsp.s3m", "ALLOYRUN.RAD",
+  "ARAB.BAM", "BEGIN.KSM", "BOOTUP.M", "CHILD1.XSM", "DTM-TRK1.DTM",
+  "ice_thnk.sci", "inc.raw", "loudness.lds", "MARIO.A2M", "mi2.laa",
+  "michaeld.cmf", "PLAYMUS1.SNG", "rat.xad", "REVELAT.SNG", "SAILOR.CFF",
+  "samurai.dro", "doofus.dro", "SCALES.SA2", "SMKEREM.HSC", "TOCCATA.MAD",
+  "TUBES.SAT", "TU_BLESS.AMD", "VIB_VOL3.D00", "WONDERIN.WLF", "bmf1_2.xad",
+  "flash.xad", "HIP_D.ROL", "hybrid.xad", "hyp.xad", "psi1.xad",
+  "SATNIGHT.HSP", "blaster2.msc", "RI051.RIX", "EOBSOUND.ADL", "DUNE19.ADL",
+  "LOREINTR.ADL", "DEMO4.JBM", "dro_v2.dro", "menu.got", "opensong.got",
+  NULL
+};
+
+// Files to seek in, after the file played before in the same replayer
+static const char *seeklist[][2] = {
+  { "menu.got", "opensong.got" },
+  { "doofus.dro", "samurai.dro" },
+  { "MARIO.A2M", "MARIO.A2M" },
+  { "HIP_D.ROL", "HIP_D.ROL" },
+  { "DUNE19.ADL", "DUNE19.ADL" },
+  { NULL, NULL }
+};
+
+// String holding the relative path to the source directory
+static const char *srcdir;
+
+// State of the pseudo-random generator, so every run is the same
+static unsigned long seed = 1;
+
+/***** Testopl *****/
+
+class Testopl: public Copl
+{
+public:
+  Testopl(const std::string filename)
+    : muted(false)
+  {
+    f = fopen(filename.c_str(), "w");
+    if(!f) std::cerr << "Error opening for writing: " << filename << std::endl;
+
+    currType = TYPE_OPL3;
+  }
+
+  virtual ~Testopl()
+  {
+    if(f) fclose(f);
+  }
+
+  void update(CPlayer *p)
+  {
+    if(!f || muted) return;
+    fprintf(f, "r%.2f\n", p->getrefresh());
+  }
+
+  // while muted, nothing is logged
+  void mute(bool m)
+  {
+    muted = m;
+  }
+
+  // template methods
+  void write(int reg, int val)
+  {
+    if(!f || muted) return;
+    fprintf(f, "%x <- %x\n", reg, val);
+  }
+
+  void setchip(int n)
+  {
+    Copl::setchip(n);
+
+    if(!f || muted) return;
+    fprintf(f, "setchip(%d)\n", n);
+  }
+
+  void init()
+  {
+    if(!f || muted) return;
+    fprintf(f, "init\n");
+  }
+
+private:
+  FILE	*f;
+  bool	muted;
+};
+
+/***** Imageopl *****/
+
+// Keeps the values written into the registers since the last init()
+class Imageopl: public Copl
+{
+public:
+  short	regs[2][256];	// -1 if not written
+
+  Imageopl()
+  {
+    currType = TYPE_OPL3;
+    init();
+  }
+
+  void write(int reg, int val)
+  {
+    regs[(currChip | reg >> 8) & 1][reg & 0xff] = val & 0xff;
+  }
+
+  void init()
+  {
+    for(int c = 0; c < 2; c++)
+      for(int r = 0; r < 256; r++)
+	regs[c][r] = -1;
+  }
+
+  bool operator==(const Imageopl &o) const
+  {
+    return !memcmp(regs, o.regs, sizeof(regs));
+  }
+};
+
+/***** Endless *****/
+
+// Replayer 'P' that never signals the end of the song, but loops on
+template <class P> class Endless: public P
+{
+public:
+  Endless(Copl *newopl)
+    : P(newopl)
+  {
+  }
+
+  bool update()
+  {
+    P::update();
+    return true;
+  }
+};
+
+/***** Local functions *****/
+
+static unsigned long pick(unsigned long max)
+  /*
+   * Returns a pseudo-random number between 1 and 'max'.
+   */
+{
+  seed = seed * 1103515245 + 12345;
+  return (seed / 65536) % max + 1;
+}
+
+static bool diff(const std::string fn1, const std::string fn2)
+  /*
+   * Compares files 'fn1' and 'fn2' line by line and returns true if they are
+   * equal or false otherwise. A line is at most 79 characters in length or the
+   * comparison will fail.
+   */
+{
+  FILE	*f1, *f2;
+  bool	retval = true;
+
+  // open both files
+  if(!(f1 = fopen(fn1.c_str(), "r"))) return false;
+  if(!(f2 = fopen(fn2.c_str(), "r"))) { fclose(f1); return false; }
+
+  // compare both files line by line
+  char	*s1 = (char *)malloc(80), *s2 = (char *)malloc(80);
+  while(!(feof(f1) || feof(f2))) {
+    fgets(s1, 80, f1);
+    fgets(s2, 80, f2);
+    if(strncmp(s1, s2, 79)) {
+      retval = false;
+      break;
+    }
+  }
+  free(s1), free(s2);
+  if(feof(f1) != feof(f2))
+    retval = false;
+
+  // close both files
+  fclose(f1), fclose(f2);
+  return retval;
+}
+
+static unsigned long ticks(const std::string fn)
+  /*
+   * Returns the number of ticks recorded in reference file 'fn'.
+   */
+{
+  FILE		*f = fopen(fn.c_str(), "r");
+  char		s[80];
+  unsigned long	n = 0;
+
+  if(!f) return 0;
+  while(fgets(s, 80, f))
+    if(s[0] == 'r') n++;
+  fclose(f);
+  return n;
+}
+
+static bool teststate(const std::string filename)
+  /*
+   * Plays file 'filename', restoring saved states along the way, and returns
+   * true if its RAW output matches the prerecorded original.
+   */
+{
+  std::string	fn = std::string(srcdir) + DIR_DELIM + filename;
+#ifdef __WATCOMC__
+  std::string	testfn = tmpnam(NULL);
+#else
+  std::string	testfn = filename + ".state";
+#endif
+  std::string	reffn = fn.substr(0, fn.find_last_of(".")) + ".ref";
+  Testopl	*opl = new Testopl(testfn);
+  CPlayer	*p = CAdPlug::factory(fn, opl);
+  unsigned long	tick = 0, next = pick(MAX_GAP), snapshots = 0,
+		maxticks = ticks(reffn);
+  bool		ok = true;
+
+  if(!p) {
+    std::cout << "Error loading: " << fn << std::endl;
+    delete opl; return false;
+  }
+
+  // Output file information
+  std::cout << "Testing format: " << p->gettype() << " - ";
+
+  while(ok && p->update()) {
+    opl->update(p);
+    if(++tick > maxticks) break;	// restored state doesn't find the end
+    if(tick < next) continue;
+
+    std::string	state;
+    int		chip = opl->getchip();
+
+    if(!p->save_state(state)) {
+      std::cout << "no state support - ";
+      ok = false;
+      break;
+    }
+
+    opl->mute(true);
+    if(snapshots++ & 1) {
+      // continue in a freshly loaded replayer
+      CPlayer *q = CAdPlug::factory(fn, opl);
+
+      delete p;
+      p = q;
+    } else {
+      // lead the replayer astray, then come back
+      for(unsigned long n = pick(MAX_DETOUR); n && p->update(); n--) ;
+    }
+
+    ok = p && p->load_state(state);
+    opl->setchip(chip);
+    opl->mute(false);
+    next = tick + pick(MAX_GAP);
+  }
+
+  delete p;
+  delete opl;
+
+  if(ok && diff(reffn, testfn)) {
+    std::cout << "OK (" << snapshots << " snapshots)\n";
+    remove(std::string(testfn).c_str());
+    return true;
+  } else {
+    std::cout << "FAIL\n";
+    return false;
+  }
+}
+
+static CPlayer *playto(const std::string fn, Imageopl *opl, unsigned long ms)
+  /*
+   * Loads file 'fn' into a fresh replayer and plays it from the start up to
+   * where seek() to 'ms' stops.
+   */
+{
+  CPlayer	*p = CAdPlug::factory(fn, opl);
+  float		pos = 0.0f;
+
+  if(!p) return 0;
+  p->rewind();
+  while(pos < ms && p->update())
+    pos += 1000 / p->getrefresh();
+  return p;
+}
+
+static bool seekplayer(CPlayer *p, Imageopl *opl, const std::string fn,
+		       unsigned long ms)
+  /*
+   * Seeks replayer 'p', which has loaded file 'fn', to 'ms' and checks that
+   * the registers in 'opl' follow those of playing it from the start for a
+   * while.
+   */
+{
+  Imageopl	refopl;
+  CPlayer	*ref = playto(fn, &refopl, ms);
+  bool		ok = ref != 0;
+
+  p->seek(ms);
+  for(int n = 0; ok && n < SEEK_TICKS; n++)
+    ok = *opl == refopl && p->update() == ref->update();
+
+  ok = ok && *opl == refopl;
+  delete ref;
+  return ok;
+}
+
+static bool testseek(const std::string before, const std::string filename)
+  /*
+   * Seeks to the middle of file 'filename', in a fresh replayer and in one
+   * that has seeked in file 'before' and then loaded 'filename', and
+   * returns true if both play on like playing from the start does.
+   */
+{
+  std::string	fn = std::string(srcdir) + DIR_DELIM + filename;
+  Imageopl	opl, reloadopl;
+  CPlayer	*p = CAdPlug::factory(fn, &opl),
+		*reload = CAdPlug::factory(std::string(srcdir) + DIR_DELIM +
+					   before, &reloadopl);
+  unsigned long	ms;
+  bool		ok = p && reload;
+
+  std::cout << "Seeking in " << filename << " after " << before << " - ";
+
+  if(ok) {
+    p->set_keyframe_interval(SEEK_KEYFRAMES);
+    reload->set_keyframe_interval(SEEK_KEYFRAMES);
+    ms = p->songlength() / 2;
+
+    // keyframes of the other song, for load() to drop
+    reload->songlength();
+    reload->seek(ms);
+
+    ok = reload->load(fn) && seekplayer(p, &opl, fn, ms) &&
+      seekplayer(reload, &reloadopl, fn, ms);
+  }
+
+  delete p; delete reload;
+  std::cout << (ok ? "OK\n" : "FAIL\n");
+  return ok;
+}
+
+static bool testlength(const std::string filename)
+  /*
+   * Checks songlength() on file 'filename', which ends by itself: the song
+   * has to end at the reported length, and there must be no loop.
+   */
+{
+  std::string	fn = std::string(srcdir) + DIR_DELIM + filename;
+  CSilentopl	opl;
+  CPlayer	*p = CAdPlug::factory(fn, &opl);
+  unsigned long	loopstart, loopend, length;
+  float		pos = 0.0f;
+  bool		ok = p != 0;
+
+  std::cout << "Measuring " << filename << " - ";
+
+  if(ok) {
+    length = p->songlength(-1, loopstart, loopend);
+    ok = length < MAX_LENGTH && loopstart == length && loopend == length;
+
+    p->rewind();
+    while(p->update())
+      pos += 1000.0f / p->getrefresh();
+    ok = ok && (unsigned long)pos == length;
+  }
+
+  delete p;
+  std::cout << (ok ? "OK\n" : "FAIL\n");
+  return ok;
+}
+
+static bool testloop(CPlayer *p, const std::string filename)
+  /*
+   * Checks songlength() on replayer 'p', which has loaded file 'filename'
+   * and plays it endlessly: a loop has to be found before songlength()
+   * gives up, and the replayer state has to be the same at its start and
+   * at its end.
+   */
+{
+  std::string	fn = std::string(srcdir) + DIR_DELIM + filename;
+  std::string	start, end;
+  unsigned long	loopstart, loopend, ms;
+  float		pos = 0.0f;
+  bool		ok = p->load(fn);
+
+  std::cout << "Measuring " << filename << ", played endlessly - ";
+
+  if(ok) {
+    p->songlength(-1, loopstart, loopend);
+    ok = loopstart < loopend && loopend < MAX_LENGTH;
+
+    p->rewind();
+    for(;;) {
+      ms = (unsigned long)pos;
+      if(ms == loopstart && start.empty()) p->save_state(start);
+      if(ms >= loopend || !p->update()) break;
+      pos += 1000.0f / p->getrefresh();
+    }
+    p->save_state(end);
+    ok = ok && ms == loopend && !start.empty() && start == end;
+  }
+
+  std::cout << (ok ? "OK\n" : "FAIL\n");
+  return ok;
+}
+
+/***** Main program *****/
+
+int main(int argc, char *argv[])
+{
+  int	i;
+  bool	retval = true;
+
+  // Set path to source directory
+  srcdir = getenv("srcdir");
+  if(!srcdir) srcdir = ".";
+
+  // Try all files one by one
+  if(argc > 1) {
+    for(i = 1; i < argc; i++)
+      if(!teststate(argv[i]))
+	retval = false;
+  } else {
+    for(i = 0; filelist[i] != NULL; i++)
+      if(!teststate(filelist[i]))
+	retval = false;
+
+    for(i = 0; seeklist[i][0] != NULL; i++)
+      if(!testseek(seeklist[i][0], seeklist[i][1]))
+	retval = false;
+
+    CSilentopl			opl;
+    Endless<ChscPlayer>	hsc(&opl);
+
+    if(!testlength("CHILD1.XSM") || !testloop(&hsc, "SMKEREM.HSC"))
+      retval = false;
+  }
+
+  return retval ? EXIT_SUCCESS : EXIT_FAILURE;
+}
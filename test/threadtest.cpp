@@ -0,0 +1,306 @@
+/*
+ * Adplug - Replayer for many OPL2/OPL3 audio file formats.
+ * Copyright (C) 1999 - 2008 Simon Peter, <dn.tlp@gmx.net>, et al.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * threadtest.cpp - Test emulator instances running on several threads
+ *
+ * Renders a few songs on every emulator, one after the other, then renders
+ * them again, each on its own thread, all at the same time. Every emulator
+ * instance must keep to itself, so both runs have to produce the same output.
+ * The threads load the songs through one CProvider_Cache, sharing their
+ * companion files, which it has to make only once.
+ *
+ * Also asks a CProvider_Cache for a resource from several threads while it
+ * is being made, which must not hold up a thread asking for another one.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "../src/adplug.h"
+#include "../src/renderer.h"
+#include "../src/emuopl.h"
+#include "../src/temuopl.h"
+#include "../src/kemuopl.h"
+
+#ifdef MSDOS
+#	define DIR_DELIM	"\\"
+#else
+#	define DIR_DELIM	"/"
+#endif
+
+#define FREQ		22050	// output sample rate
+#define SECONDS		20	// rendered length of every song
+#define BUF_SIZE	512	// samples rendered in one go
+
+/***** Local variables *****/
+
+// Songs rendered at the same time, one thread per song and emulator
+static const char *filelist[] = {
+  "BEGIN.KSM", "DTM-TRK1.DTM", "SMKEREM.HSC", "ADAGIO.DFM", "HIP_D.ROL", NULL
+};
+
+// Companion files of these songs: insts.dat and standard.bnk
+#define COMPANIONS	2
+
+// Emulators to test
+enum Emulator { EMU_MAME, EMU_TATSUYUKI, EMU_KEN, EMU_COUNT };
+
+static const char *emuname[EMU_COUNT] = { "mame", "satoh", "ken" };
+
+// String holding the relative path to the source directory
+static const char *srcdir;
+
+// Guards the state of the resources made by testmaking()
+static pthread_mutex_t	makelock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	makecond = PTHREAD_COND_INITIALIZER;
+static int		slowmade = 0;		// slow makes begun
+static bool		slowgo = false;		// slow makes may finish
+static bool		quickdone = false;	// the quick resource is there
+
+/***** Local functions *****/
+
+static Copl *newopl(Emulator emu)
+{
+  switch(emu) {
+  case EMU_MAME: return new CEmuopl(FREQ, true, true);
+  case EMU_TATSUYUKI: return new CTemuopl(FREQ, true, true);
+  default: return new CKemuopl(FREQ, true, true);
+  }
+}
+
+struct Job {
+  const CFileProvider	*fp;
+  Emulator		emu;
+  std::string		filename;
+  std::vector<short>	output;
+  bool			ok;
+};
+
+static void *render(void *arg)
+  /*
+   * Renders the song of Job 'arg' into its output buffer. Everything the
+   * rendering needs is created on the calling thread.
+   */
+{
+  Job		*job = (Job *)arg;
+  std::string	fn = std::string(srcdir) + DIR_DELIM + job->filename;
+  Copl		*opl = newopl(job->emu);
+  CPlayer	*p = CAdPlug::factory(fn, opl, CAdPlug::players, *job->fp);
+  short		buf[BUF_SIZE * 2];
+  unsigned long	n;
+
+  job->output.clear();
+  job->ok = p != 0;
+
+  if(p) {
+    CRenderer r(p, opl, FREQ, true, true);
+
+    r.rewind(0);
+    r.setlimit(SECONDS * 1000);
+    while((n = r.render(buf, BUF_SIZE)))
+      job->output.insert(job->output.end(), buf, buf + n * 2);
+  }
+
+  delete p;
+  delete opl;
+  return 0;
+}
+
+/***** Making resources *****/
+
+class CTestResource: public CFileResource
+{
+public:
+  unsigned long memsize() const { return 1; }
+};
+
+struct Fetch {
+  const CFileProvider		*fp;
+  std::string			filename;
+  CFileProvider::ResourceMaker	make;
+  const CFileResource		*res;
+};
+
+static CFileResource *make_slow(binistream *f, const CFileProvider &fp)
+  /*
+   * Makes a resource only once the test lets it.
+   */
+{
+  pthread_mutex_lock(&makelock);
+  slowmade++;
+  pthread_cond_broadcast(&makecond);
+  while(!slowgo)
+    pthread_cond_wait(&makecond, &makelock);
+  pthread_mutex_unlock(&makelock);
+  return new CTestResource;
+}
+
+static CFileResource *make_quick(binistream *f, const CFileProvider &fp)
+{
+  return new CTestResource;
+}
+
+static void *fetch(void *arg)
+  /*
+   * Asks for the resource of Fetch 'arg'.
+   */
+{
+  Fetch	*job = (Fetch *)arg;
+
+  job->res = job->fp->resource(job->filename, job->make);
+
+  if(job->make == make_quick) {
+    pthread_mutex_lock(&makelock);
+    quickdone = true;
+    pthread_cond_broadcast(&makecond);
+    pthread_mutex_unlock(&makelock);
+  }
+  return 0;
+}
+
+static bool testmaking(const CFileProvider &fs)
+  /*
+   * Asks a CProvider_Cache for one resource from several threads, while
+   * the first of them makes it, and for another one meanwhile. The first
+   * resource has to be made once, and the other one mustn't wait for it.
+   */
+{
+  CProvider_Cache	cache(fs);
+  Fetch			jobs[5];
+  pthread_t		threads[5];
+  struct timespec	until;
+  int			i, n = 0;
+  bool			ok = true;
+
+  std::cout << "Testing resources made without holding up others - ";
+
+  for(i = 0; i < 5; i++) {
+    jobs[i].fp = &cache;
+    jobs[i].filename = std::string(srcdir) + DIR_DELIM +
+      (i < 4 ? "insts.dat" : "standard.bnk");
+    jobs[i].make = i < 4 ? make_slow : make_quick;
+    jobs[i].res = 0;
+  }
+
+  // the first thread starts making, the others come while it does
+  pthread_mutex_lock(&makelock);
+  for(i = 0; i < 5 && ok; i++, n++) {
+    ok = !pthread_create(&threads[i], NULL, fetch, &jobs[i]);
+    while(ok && !i && !slowmade)
+      pthread_cond_wait(&makecond, &makelock);
+  }
+
+  // the other resource doesn't wait, those asking for the slow one do
+  until.tv_sec = time(NULL) + 10;
+  until.tv_nsec = 0;
+  while(ok && !quickdone &&
+	!pthread_cond_timedwait(&makecond, &makelock, &until)) ;
+  ok = ok && quickdone;
+  pthread_mutex_unlock(&makelock);
+  usleep(100000);
+
+  pthread_mutex_lock(&makelock);
+  slowgo = true;
+  pthread_cond_broadcast(&makecond);
+  pthread_mutex_unlock(&makelock);
+  for(i = 0; i < n; i++)
+    pthread_join(threads[i], NULL);
+
+  ok = ok && n == 5 && slowmade == 1 && cache.getmade() == 2;
+  for(i = 0; i < n; i++) {
+    if(!jobs[i].res || (i < 4 && jobs[i].res != jobs[0].res)) ok = false;
+    if(jobs[i].res) cache.release(jobs[i].res);
+  }
+
+  std::cout << (ok ? "OK" : "FAIL") << std::endl;
+  return ok;
+}
+
+/***** Main program *****/
+
+int main(int argc, char *argv[])
+{
+  std::vector<Job>	serial, parallel;
+  CProvider_Filesystem	fs;
+  CProvider_Cache	cache(fs);
+  std::vector<pthread_t> threads;
+  unsigned int		i, e;
+  bool			retval = true;
+
+  // Set path to source directory
+  srcdir = getenv("srcdir");
+  if(!srcdir) srcdir = ".";
+
+  for(e = 0; e < EMU_COUNT; e++)
+    for(i = 0; filelist[i] != NULL; i++) {
+      Job job;
+
+      job.emu = (Emulator)e;
+      job.filename = filelist[i];
+      job.fp = &fs;
+      serial.push_back(job);
+      job.fp = &cache;
+      parallel.push_back(job);
+    }
+
+  // render all songs one after the other
+  for(i = 0; i < serial.size(); i++)
+    render(&serial[i]);
+
+  // render all songs at the same time
+  threads.resize(parallel.size());
+  for(i = 0; i < parallel.size(); i++)
+    if(pthread_create(&threads[i], NULL, render, &parallel[i])) {
+      std::cout << "Error creating thread" << std::endl;
+      return EXIT_FAILURE;
+    }
+  for(i = 0; i < parallel.size(); i++)
+    pthread_join(threads[i], NULL);
+
+  std::cout << "Testing shared companion files - ";
+  if(cache.getmade() == COMPANIONS &&
+     cache.gethits() == COMPANIONS * (EMU_COUNT - 1))
+    std::cout << "OK" << std::endl;
+  else {
+    std::cout << "FAIL" << std::endl;
+    retval = false;
+  }
+
+  for(i = 0; i < serial.size(); i++) {
+    std::cout << "Testing " << emuname[serial[i].emu] << " emulator: "
+	      << serial[i].filename << " - ";
+
+    if(serial[i].ok && parallel[i].ok && !serial[i].output.empty() &&
+       serial[i].output == parallel[i].output)
+      std::cout << "OK" << std::endl;
+    else {
+      std::cout << "FAIL" << std::endl;
+      retval = false;
+    }
+  }
+
+  if(!testmaking(fs))
+    retval = false;
+
+  return retval ? EXIT_SUCCESS : EXIT_FAILURE;
+}